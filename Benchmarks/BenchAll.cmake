@@ -0,0 +1,46 @@
+# BenchAll.cmake
+#
+#    Script driven by the bench_all target.  Runs each sample listed in
+#    BENCH_SAMPLES_FILE headless with --bench=BENCH_FRAMES from its own
+#    build directory (so relative asset paths resolve), then writes the
+#    per-sample JSON lines into a single document at BENCH_OUTPUT.
+#
+include( ${BENCH_SAMPLES_FILE} )
+
+set( ENV{ES_HEADLESS} 1 )
+
+set( results "" )
+set( failed "" )
+
+foreach( sample ${BENCH_SAMPLES} )
+   get_filename_component( sample_dir ${sample} PATH )
+   get_filename_component( sample_name ${sample} NAME_WE )
+
+   execute_process( COMMAND ${sample} --bench=${BENCH_FRAMES}
+                    WORKING_DIRECTORY ${sample_dir}
+                    OUTPUT_VARIABLE output
+                    ERROR_VARIABLE output
+                    RESULT_VARIABLE result )
+
+   string( REGEX MATCH "{\"sample\"[^\n]*}" json "${output}" )
+
+   if( result EQUAL 0 AND json )
+      string( REGEX MATCH "\"fps\":[0-9.]+" fps "${json}" )
+      message( STATUS "${sample_name}: ${fps}" )
+      if( results )
+         set( results "${results},\n" )
+      endif()
+      set( results "${results}  ${json}" )
+   else()
+      message( WARNING "${sample_name} failed (${result}):\n${output}" )
+      list( APPEND failed ${sample_name} )
+   endif()
+endforeach()
+
+string( TIMESTAMP timestamp UTC )
+file( WRITE ${BENCH_OUTPUT} "{\"timestamp\":\"${timestamp}\",\"frames\":\"${BENCH_FRAMES}\",\"results\":[\n${results}\n]}\n" )
+message( STATUS "Wrote ${BENCH_OUTPUT}" )
+
+if( failed )
+   message( FATAL_ERROR "Benchmark failed for: ${failed}" )
+endif()
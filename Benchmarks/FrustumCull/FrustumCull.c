@@ -0,0 +1,278 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// FrustumCull.c
+//
+//    Microbenchmark of frustum culling: a scalar loop that stops at the
+//    first plane an object is outside of, against esCullSpheres and
+//    esCullBoxes on one thread and on a thread pool, at 100k and 1M
+//    objects scattered around the camera.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esUtil.h"
+
+#define NUM_SIZES       2
+
+// Objects are scattered through a cube this far from the camera on each axis
+#define SCENE_EXTENT    100.0f
+
+static const int sizes[NUM_SIZES] = { 100000, 1000000 };
+static const int iterations[NUM_SIZES] = { 200, 20 };
+
+///
+// RandomRange()
+//
+static GLfloat RandomRange ( GLfloat lo, GLfloat hi )
+{
+   return lo + ( hi - lo ) * ( GLfloat ) rand() / RAND_MAX;
+}
+
+///
+// PlaneDistance()
+//
+//    Summed in the order esCull uses, so both agree on objects touching a plane
+//
+static GLfloat PlaneDistance ( const GLfloat *plane, GLfloat x, GLfloat y, GLfloat z )
+{
+   return plane[0] * x + ( plane[1] * y + ( plane[2] * z + plane[3] ) );
+}
+
+///
+// CullSpheresScalar()
+//
+//    The usual loop: one sphere at a time, rejected at the first plane it is behind
+//
+static int CullSpheresScalar ( const ESFrustumPlanes *frustum, const ESSphereArrays *spheres, int count, GLuint *visible )
+{
+   int n = 0;
+   int i, p;
+
+   for ( i = 0; i < count; i++ )
+   {
+      for ( p = 0; p < 6; p++ )
+      {
+         if ( PlaneDistance ( frustum->planes[p], spheres->x[i], spheres->y[i], spheres->z[i] ) + spheres->radius[i] < 0.0f )
+         {
+            break;
+         }
+      }
+
+      if ( p == 6 )
+      {
+         visible[n++] = i;
+      }
+   }
+
+   return n;
+}
+
+///
+// CullBoxesScalar()
+//
+static int CullBoxesScalar ( const ESFrustumPlanes *frustum, const ESBoxArrays *boxes, int count, GLuint *visible )
+{
+   int n = 0;
+   int i, p;
+
+   for ( i = 0; i < count; i++ )
+   {
+      for ( p = 0; p < 6; p++ )
+      {
+         const GLfloat *plane = frustum->planes[p];
+         GLfloat d = PlaneDistance ( plane, boxes->x[i], boxes->y[i], boxes->z[i] );
+
+         d = fabsf ( plane[0] ) * boxes->extentX[i] + ( fabsf ( plane[1] ) * boxes->extentY[i] + ( fabsf ( plane[2] ) * boxes->extentZ[i] + d ) );
+
+         if ( d < 0.0f )
+         {
+            break;
+         }
+      }
+
+      if ( p == 6 )
+      {
+         visible[n++] = i;
+      }
+   }
+
+   return n;
+}
+
+///
+// Report()
+//
+static void Report ( const char *name, int count, double seconds, double baseline )
+{
+   printf ( "   %-28s %8.3f ms/cull %8.2f Mobjects/s   x%.2f\n", name,
+            seconds * 1e3, count / seconds * 1e-6, baseline / seconds );
+}
+
+///
+// CheckVisible()
+//
+//    Prints a mismatch against the scalar loop's result, returns nonzero if there is one
+//
+static int CheckVisible ( const GLuint *expected, int expectedCount, const GLuint *visible, int visibleCount )
+{
+   if ( visibleCount != expectedCount || memcmp ( expected, visible, visibleCount * sizeof ( GLuint ) ) != 0 )
+   {
+      printf ( "   ERROR: %d visible, expected %d\n", visibleCount, expectedCount );
+      return 1;
+   }
+
+   return 0;
+}
+
+int main ( void )
+{
+   ESThreadPool *pool = esThreadPoolCreate ( 0 );
+   ESFrustumPlanes frustum;
+   ESMatrix perspective, view, mvp;
+   int failed = 0;
+   int s;
+
+   if ( pool == NULL )
+   {
+      return 1;
+   }
+
+   // A camera at the origin looking a little off axis, so no plane is axis aligned
+   esMatrixLoadIdentity ( &perspective );
+   esPerspective ( &perspective, 60.0f, 16.0f / 9.0f, 1.0f, SCENE_EXTENT );
+   esMatrixLookAt ( &view, 0.0f, 0.0f, 0.0f, 0.3f, 0.2f, -1.0f, 0.0f, 1.0f, 0.0f );
+   esMatrixMultiply ( &mvp, &view, &perspective );
+   esExtractFrustumPlanes ( &frustum, &mvp );
+
+   printf ( "Frustum cull benchmark, %d worker threads\n", esThreadPoolSize ( pool ) );
+
+   for ( s = 0; s < NUM_SIZES; s++ )
+   {
+      int count = sizes[s];
+      GLfloat *data = malloc ( 7 * count * sizeof ( GLfloat ) );
+      GLuint *expected = malloc ( count * sizeof ( GLuint ) );
+      GLuint *visible = malloc ( count * sizeof ( GLuint ) );
+      ESSphereArrays spheres;
+      ESBoxArrays boxes;
+      GLuint64 start;
+      double scalarTime, time;
+      int i, iter, expectedCount = 0, visibleCount = 0;
+
+      if ( data == NULL || expected == NULL || visible == NULL )
+      {
+         return 1;
+      }
+
+      // Spheres and boxes share their centers
+      spheres.x = boxes.x = data;
+      spheres.y = boxes.y = data + count;
+      spheres.z = boxes.z = data + 2 * count;
+      spheres.radius = data + 3 * count;
+      boxes.extentX = data + 4 * count;
+      boxes.extentY = data + 5 * count;
+      boxes.extentZ = data + 6 * count;
+
+      srand ( 0 );
+
+      for ( i = 0; i < count; i++ )
+      {
+         data[i] = RandomRange ( -SCENE_EXTENT, SCENE_EXTENT );
+         data[count + i] = RandomRange ( -SCENE_EXTENT, SCENE_EXTENT );
+         data[2 * count + i] = RandomRange ( -SCENE_EXTENT, SCENE_EXTENT );
+         data[3 * count + i] = RandomRange ( 0.1f, 2.0f );
+         data[4 * count + i] = RandomRange ( 0.1f, 2.0f );
+         data[5 * count + i] = RandomRange ( 0.1f, 2.0f );
+         data[6 * count + i] = RandomRange ( 0.1f, 2.0f );
+      }
+
+      // Spheres
+      start = esGetTimeNs();
+
+      for ( iter = 0; iter < iterations[s]; iter++ )
+      {
+         expectedCount = CullSpheresScalar ( &frustum, &spheres, count, expected );
+      }
+
+      scalarTime = ( esGetTimeNs() - start ) * 1e-9 / iterations[s];
+      printf ( "%d spheres, %d visible:\n", count, expectedCount );
+      Report ( "scalar", count, scalarTime, scalarTime );
+
+      for ( i = 0; i < 2; i++ )
+      {
+         start = esGetTimeNs();
+
+         for ( iter = 0; iter < iterations[s]; iter++ )
+         {
+            visibleCount = esCullSpheres ( i ? pool : NULL, &frustum, &spheres, count, visible );
+         }
+
+         time = ( esGetTimeNs() - start ) * 1e-9 / iterations[s];
+         Report ( i ? "esCullSpheres (pool)" : "esCullSpheres", count, time, scalarTime );
+         failed |= CheckVisible ( expected, expectedCount, visible, visibleCount );
+      }
+
+      // Boxes
+      start = esGetTimeNs();
+
+      for ( iter = 0; iter < iterations[s]; iter++ )
+      {
+         expectedCount = CullBoxesScalar ( &frustum, &boxes, count, expected );
+      }
+
+      scalarTime = ( esGetTimeNs() - start ) * 1e-9 / iterations[s];
+      printf ( "%d boxes, %d visible:\n", count, expectedCount );
+      Report ( "scalar", count, scalarTime, scalarTime );
+
+      for ( i = 0; i < 2; i++ )
+      {
+         start = esGetTimeNs();
+
+         for ( iter = 0; iter < iterations[s]; iter++ )
+         {
+            visibleCount = esCullBoxes ( i ? pool : NULL, &frustum, &boxes, count, visible );
+         }
+
+         time = ( esGetTimeNs() - start ) * 1e-9 / iterations[s];
+         Report ( i ? "esCullBoxes (pool)" : "esCullBoxes", count, time, scalarTime );
+         failed |= CheckVisible ( expected, expectedCount, visible, visibleCount );
+      }
+
+      free ( data );
+      free ( expected );
+      free ( visible );
+   }
+
+   esThreadPoolDestroy ( pool );
+
+   return failed;
+}
@@ -0,0 +1,475 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// InstanceStreaming.c
+//
+//    How the per-instance transform work of Instancing scales with
+//    threads, and what streaming a compact transform saves over a full
+//    MVP.  Every frame streams the transforms of NUM_INSTANCES cubes (or
+//    ES_INSTANCES) in each encoding, once for each thread count from one
+//    to one per core, the threads writing disjoint ranges of the mapped
+//    stream buffer, and draws them.  Run it with --bench (and
+//    ES_HEADLESS=1) for a fixed number of frames; the comparison is
+//    printed at shutdown.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "esUtil.h"
+
+#define NUM_INSTANCES   100000
+#define MAX_THREADS     64
+#define POSITION_LOC    0
+#define INSTANCE_LOC    1
+
+// Frames of instance data the stream buffer holds
+#define INSTANCE_FRAMES 4
+
+#define PI              3.1415926535897932384626433832795f
+
+enum
+{
+   ENCODING_MATRIX,
+   ENCODING_COMPACT,
+   NUM_ENCODINGS
+};
+
+// Position, scale and rotation quaternion, as Instancing streams them
+typedef struct
+{
+   GLfloat position[3];
+   GLfloat scale;
+   GLshort rotation[4];
+} CompactTransform;
+
+typedef struct
+{
+   GLuint programObjects[NUM_ENCODINGS];
+   GLint  viewProjLoc;
+   GLuint positionVBO;
+   GLuint indicesIBO;
+   int    numIndices;
+
+   int    numInstances;
+   GLfloat *centerX;
+   GLfloat *centerY;
+   GLfloat *angle;
+   GLfloat  scale;
+
+   ESStreamBuffer *instanceStream;
+   ESMatrix        perspective;
+   void           *instanceBuf;
+
+   // pools[i] runs i + 1 threads, the calling thread and i workers
+   ESThreadPool *pools[MAX_THREADS];
+   int           numThreadCounts;
+
+   // Accumulated time for each encoding and thread count: filling the
+   // mapped buffer, and filling, drawing and glFinish
+   GLuint64 updateNs[NUM_ENCODINGS][MAX_THREADS];
+   GLuint64 totalNs[NUM_ENCODINGS][MAX_THREADS];
+   int frames;
+
+} UserData;
+
+static const GLsizeiptr instanceSizes[NUM_ENCODINGS] = { sizeof ( ESMatrix ), sizeof ( CompactTransform ) };
+
+///
+// GetInstanceCount()
+//
+static int GetInstanceCount ( void )
+{
+   const char *env = getenv ( "ES_INSTANCES" );
+   int count = env != NULL ? atoi ( env ) : 0;
+
+   return count > 0 ? count : NUM_INSTANCES;
+}
+
+///
+// UpdateMatrices()
+//
+//    The per-instance MVPs Instancing used to stream, for the instances in [begin, end)
+//
+static void ESCALLBACK UpdateMatrices ( void *arg, int begin, int end )
+{
+   UserData *userData = ( UserData * ) arg;
+   ESMatrix *matrixBuf = ( ESMatrix * ) userData->instanceBuf;
+   int i;
+
+   for ( i = begin; i < end; i++ )
+   {
+      ESMatrix modelview;
+
+      esMatrixLoadIdentity ( &modelview );
+      esTranslate ( &modelview, userData->centerX[i], userData->centerY[i], -2.0f );
+      esScale ( &modelview, userData->scale, userData->scale, userData->scale );
+      esRotate ( &modelview, userData->angle[i], 1.0, 0.0, 1.0 );
+      esMatrixMultiply ( &matrixBuf[i], &modelview, &userData->perspective );
+   }
+}
+
+///
+// UpdateCompact()
+//
+//    The compact transforms Instancing streams, for the instances in [begin, end)
+//
+static void ESCALLBACK UpdateCompact ( void *arg, int begin, int end )
+{
+   UserData *userData = ( UserData * ) arg;
+   CompactTransform *transformBuf = ( CompactTransform * ) userData->instanceBuf;
+   int i;
+
+   for ( i = begin; i < end; i++ )
+   {
+      GLfloat sinHalf = -sinf ( userData->angle[i] * PI / 360.0f ) * 0.70710678f;
+      GLfloat cosHalf = cosf ( userData->angle[i] * PI / 360.0f );
+
+      transformBuf[i].position[0] = userData->centerX[i];
+      transformBuf[i].position[1] = userData->centerY[i];
+      transformBuf[i].position[2] = -2.0f;
+      transformBuf[i].scale = userData->scale;
+      transformBuf[i].rotation[0] = ( GLshort ) floorf ( sinHalf * 32767.0f + 0.5f );
+      transformBuf[i].rotation[1] = 0;
+      transformBuf[i].rotation[2] = ( GLshort ) floorf ( sinHalf * 32767.0f + 0.5f );
+      transformBuf[i].rotation[3] = ( GLshort ) floorf ( cosHalf * 32767.0f + 0.5f );
+   }
+}
+
+///
+// SetInstanceAttribs()
+//
+static void SetInstanceAttribs ( int encoding, GLintptr offset )
+{
+   int i;
+
+   if ( encoding == ENCODING_MATRIX )
+   {
+      // One matrix row per location
+      for ( i = 0; i < 4; i++ )
+      {
+         glVertexAttribPointer ( INSTANCE_LOC + i, 4, GL_FLOAT, GL_FALSE, sizeof ( ESMatrix ),
+                                 ( const void * ) ( offset + sizeof ( GLfloat ) * 4 * i ) );
+         glEnableVertexAttribArray ( INSTANCE_LOC + i );
+      }
+   }
+   else
+   {
+      glVertexAttribPointer ( INSTANCE_LOC, 4, GL_FLOAT, GL_FALSE, sizeof ( CompactTransform ),
+                              ( const void * ) offset );
+      glVertexAttribPointer ( INSTANCE_LOC + 1, 4, GL_SHORT, GL_TRUE, sizeof ( CompactTransform ),
+                              ( const void * ) ( offset + sizeof ( GLfloat ) * 4 ) );
+      glEnableVertexAttribArray ( INSTANCE_LOC );
+      glEnableVertexAttribArray ( INSTANCE_LOC + 1 );
+      glDisableVertexAttribArray ( INSTANCE_LOC + 2 );
+      glDisableVertexAttribArray ( INSTANCE_LOC + 3 );
+   }
+}
+
+///
+// Init()
+//
+static int Init ( ESContext *esContext )
+{
+   UserData *userData = esContext->userData;
+   const char *vShaderStr[NUM_ENCODINGS] =
+   {
+      "#version 300 es                             \n"
+      "layout(location = 0) in vec4 a_position;    \n"
+      "layout(location = 1) in mat4 a_mvpMatrix;   \n"
+      "void main()                                 \n"
+      "{                                           \n"
+      "   gl_Position = a_mvpMatrix * a_position;  \n"
+      "}                                           \n",
+
+      "#version 300 es                             \n"
+      "layout(location = 0) in vec4 a_position;    \n"
+      "layout(location = 1) in vec4 a_transform;   \n"
+      "layout(location = 2) in vec4 a_rotation;    \n"
+      "uniform mat4 u_viewProjMatrix;              \n"
+      "void main()                                 \n"
+      "{                                           \n"
+      "   vec3 p = a_position.xyz * a_transform.w;                    \n"
+      "   vec3 t = cross ( a_rotation.xyz, p ) + a_rotation.w * p;    \n"
+      "   p += 2.0 * cross ( a_rotation.xyz, t ) + a_transform.xyz;   \n"
+      "   gl_Position = u_viewProjMatrix * vec4 ( p, 1.0 );           \n"
+      "}                                           \n"
+   };
+
+   char fShaderStr[] =
+      "#version 300 es                                \n"
+      "precision mediump float;                       \n"
+      "layout(location = 0) out vec4 outColor;        \n"
+      "void main()                                    \n"
+      "{                                              \n"
+      "  outColor = vec4 ( 0.2, 0.4, 0.8, 1.0 );      \n"
+      "}                                              \n";
+
+   GLfloat *positions;
+   GLuint *indices;
+   ESThreadPool *pool;
+   int numRows;
+   int i;
+
+   for ( i = 0; i < NUM_ENCODINGS; i++ )
+   {
+      userData->programObjects[i] = esLoadProgram ( vShaderStr[i], fShaderStr );
+
+      if ( userData->programObjects[i] == 0 )
+      {
+         return FALSE;
+      }
+   }
+
+   userData->viewProjLoc = glGetUniformLocation ( userData->programObjects[ENCODING_COMPACT], "u_viewProjMatrix" );
+
+   // The Instancing sample's grid of cubes
+   userData->numInstances = GetInstanceCount ( );
+   numRows = ( int ) ceilf ( sqrtf ( ( float ) userData->numInstances ) );
+   userData->scale = 1.0f / numRows;
+   userData->numIndices = esGenCube ( 1.0f, &positions, NULL, NULL, &indices );
+
+   glGenBuffers ( 1, &userData->indicesIBO );
+   glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->indicesIBO );
+   glBufferData ( GL_ELEMENT_ARRAY_BUFFER, sizeof ( GLuint ) * userData->numIndices, indices, GL_STATIC_DRAW );
+   free ( indices );
+
+   glGenBuffers ( 1, &userData->positionVBO );
+   glBindBuffer ( GL_ARRAY_BUFFER, userData->positionVBO );
+   glBufferData ( GL_ARRAY_BUFFER, 24 * sizeof ( GLfloat ) * 3, positions, GL_STATIC_DRAW );
+   free ( positions );
+
+   userData->centerX = malloc ( userData->numInstances * sizeof ( GLfloat ) );
+   userData->centerY = malloc ( userData->numInstances * sizeof ( GLfloat ) );
+   userData->angle = malloc ( userData->numInstances * sizeof ( GLfloat ) );
+
+   if ( userData->centerX == NULL || userData->centerY == NULL || userData->angle == NULL )
+   {
+      return FALSE;
+   }
+
+   srand ( 0 );
+
+   for ( i = 0; i < userData->numInstances; i++ )
+   {
+      userData->centerX[i] = ( ( float ) ( i % numRows ) / ( float ) numRows ) * 2.0f - 1.0f;
+      userData->centerY[i] = ( ( float ) ( i / numRows ) / ( float ) numRows ) * 2.0f - 1.0f;
+      userData->angle[i] = ( float ) ( rand() % 32768 ) / 32767.0f * 360.0f;
+   }
+
+   // Sized for the larger encoding
+   userData->instanceStream = esStreamBufferCreate ( GL_ARRAY_BUFFER, INSTANCE_FRAMES * userData->numInstances * sizeof ( ESMatrix ) );
+
+   if ( userData->instanceStream == NULL )
+   {
+      return FALSE;
+   }
+
+   // One thread count per core, one thread being no pool at all
+   pool = esThreadPoolCreate ( 0 );
+
+   if ( pool == NULL )
+   {
+      return FALSE;
+   }
+
+   userData->numThreadCounts = esThreadPoolSize ( pool );
+   esThreadPoolDestroy ( pool );
+
+   if ( userData->numThreadCounts > MAX_THREADS )
+   {
+      userData->numThreadCounts = MAX_THREADS;
+   }
+
+   for ( i = 1; i < userData->numThreadCounts; i++ )
+   {
+      userData->pools[i] = esThreadPoolCreate ( i );
+
+      if ( userData->pools[i] == NULL )
+      {
+         return FALSE;
+      }
+   }
+
+   esMatrixLoadIdentity ( &userData->perspective );
+   esPerspective ( &userData->perspective, 60.0f, ( GLfloat ) esContext->width / esContext->height, 1.0f, 20.0f );
+
+   glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->indicesIBO );
+   glBindBuffer ( GL_ARRAY_BUFFER, userData->positionVBO );
+   glVertexAttribPointer ( POSITION_LOC, 3, GL_FLOAT, GL_FALSE, 3 * sizeof ( GLfloat ), ( const void * ) NULL );
+   glEnableVertexAttribArray ( POSITION_LOC );
+
+   for ( i = 0; i < 4; i++ )
+   {
+      glVertexAttribDivisor ( INSTANCE_LOC + i, 1 );
+   }
+
+   glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
+   return TRUE;
+}
+
+///
+// Draw()
+//
+static void Draw ( ESContext *esContext )
+{
+   UserData *userData = esContext->userData;
+   ESRangeFunc updateFuncs[NUM_ENCODINGS] = { UpdateMatrices, UpdateCompact };
+   int encoding, threads, i;
+
+   glViewport ( 0, 0, esContext->width, esContext->height );
+   glClear ( GL_COLOR_BUFFER_BIT );
+   glFinish ();
+
+   for ( encoding = 0; encoding < NUM_ENCODINGS; encoding++ )
+   {
+      glUseProgram ( userData->programObjects[encoding] );
+
+      if ( encoding == ENCODING_COMPACT )
+      {
+         glUniformMatrix4fv ( userData->viewProjLoc, 1, GL_FALSE, ( GLfloat * ) &userData->perspective.m[0][0] );
+      }
+
+      for ( threads = 0; threads < userData->numThreadCounts; threads++ )
+      {
+         GLuint64 start, updated, finished;
+         GLintptr offset;
+
+         start = esGetTimeNs ();
+
+         userData->instanceBuf = esStreamBufferMap ( userData->instanceStream, userData->numInstances * instanceSizes[encoding],
+                                                     sizeof ( GLfloat ), &offset );
+
+         if ( userData->instanceBuf == NULL )
+         {
+            return;
+         }
+
+         esParallelFor ( userData->pools[threads], userData->numInstances, updateFuncs[encoding], userData );
+         esStreamBufferUnmap ( userData->instanceStream );
+
+         updated = esGetTimeNs ();
+
+         glBindBuffer ( GL_ARRAY_BUFFER, esStreamBufferId ( userData->instanceStream ) );
+         SetInstanceAttribs ( encoding, offset );
+         glDrawElementsInstanced ( GL_TRIANGLES, userData->numIndices, GL_UNSIGNED_INT, ( const void * ) NULL, userData->numInstances );
+         esStreamBufferFence ( userData->instanceStream );
+         glFinish ();
+
+         finished = esGetTimeNs ();
+
+         userData->updateNs[encoding][threads] += updated - start;
+         userData->totalNs[encoding][threads] += finished - start;
+      }
+   }
+
+   // Turn the cubes a little each frame
+   for ( i = 0; i < userData->numInstances; i++ )
+   {
+      userData->angle[i] += 1.0f;
+   }
+
+   userData->frames++;
+}
+
+///
+// ShutDown()
+//
+static void ShutDown ( ESContext *esContext )
+{
+   UserData *userData = esContext->userData;
+   const char *names[NUM_ENCODINGS] = { "MVP matrix", "compact" };
+   double frames = ( double ) userData->frames;
+   int encoding, threads;
+
+   if ( userData->frames > 0 )
+   {
+      printf ( "Instance streaming benchmark, %d frames of %d instances\n", userData->frames, userData->numInstances );
+
+      // Speedup is against the MVP matrices on one thread
+      for ( encoding = 0; encoding < NUM_ENCODINGS; encoding++ )
+      {
+         printf ( "%s, %d bytes per instance, %.2f MB uploaded per frame\n", names[encoding],
+                  ( int ) instanceSizes[encoding], userData->numInstances * instanceSizes[encoding] / ( 1024.0 * 1024.0 ) );
+
+         for ( threads = 0; threads < userData->numThreadCounts; threads++ )
+         {
+            printf ( "   %2d threads %8.3f ms update %8.2f Minstances/s   x%.2f %8.3f ms with draw and glFinish\n",
+                     threads + 1, userData->updateNs[encoding][threads] / frames * 1e-6,
+                     userData->numInstances * frames / userData->updateNs[encoding][threads] * 1e3,
+                     ( double ) userData->updateNs[ENCODING_MATRIX][0] / userData->updateNs[encoding][threads],
+                     userData->totalNs[encoding][threads] / frames * 1e-6 );
+         }
+      }
+   }
+
+   for ( threads = 0; threads < userData->numThreadCounts; threads++ )
+   {
+      esThreadPoolDestroy ( userData->pools[threads] );
+   }
+
+   esStreamBufferDestroy ( userData->instanceStream );
+   glDeleteBuffers ( 1, &userData->positionVBO );
+   glDeleteBuffers ( 1, &userData->indicesIBO );
+
+   for ( encoding = 0; encoding < NUM_ENCODINGS; encoding++ )
+   {
+      glDeleteProgram ( userData->programObjects[encoding] );
+   }
+
+   free ( userData->centerX );
+   free ( userData->centerY );
+   free ( userData->angle );
+}
+
+int esMain ( ESContext *esContext )
+{
+   esContext->userData = calloc ( 1, sizeof ( UserData ) );
+
+   if ( esContext->userData == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   if ( !esCreateWindow ( esContext, "InstanceStreaming", 320, 240, ES_WINDOW_RGB ) )
+   {
+      return GL_FALSE;
+   }
+
+   if ( !Init ( esContext ) )
+   {
+      return GL_FALSE;
+   }
+
+   esRegisterDrawFunc ( esContext, Draw );
+   esRegisterShutdownFunc ( esContext, ShutDown );
+
+   return GL_TRUE;
+}
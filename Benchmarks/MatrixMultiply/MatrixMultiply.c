@@ -0,0 +1,173 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// MatrixMultiply.c
+//
+//    Microbenchmark comparing the scalar reference 4x4 matrix multiply
+//    against esMatrixMultiply() and esMatrixMultiplyBatch().
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "esUtil.h"
+#include "esSimd.h"
+
+#define NUM_MATRICES    65536
+#define NUM_ITERATIONS  64
+
+///
+// ScalarMultiply()
+//
+//    The original triple loop, kept here as the baseline
+//
+static void ScalarMultiply ( ESMatrix *result, const ESMatrix *srcA, const ESMatrix *srcB )
+{
+   ESMatrix tmp;
+   int      i, j;
+
+   for ( i = 0; i < 4; i++ )
+   {
+      for ( j = 0; j < 4; j++ )
+      {
+         tmp.m[i][j] = ( srcA->m[i][0] * srcB->m[0][j] ) +
+                       ( srcA->m[i][1] * srcB->m[1][j] ) +
+                       ( srcA->m[i][2] * srcB->m[2][j] ) +
+                       ( srcA->m[i][3] * srcB->m[3][j] );
+      }
+   }
+
+   memcpy ( result, &tmp, sizeof ( ESMatrix ) );
+}
+
+///
+// MaxError()
+//
+static float MaxError ( const ESMatrix *a, const ESMatrix *b, int count )
+{
+   const float *pa = ( const float * ) a;
+   const float *pb = ( const float * ) b;
+   float maxErr = 0.0f;
+   int   i;
+
+   for ( i = 0; i < count * 16; i++ )
+   {
+      float err = fabsf ( pa[i] - pb[i] );
+      maxErr = err > maxErr ? err : maxErr;
+   }
+
+   return maxErr;
+}
+
+///
+// Report()
+//
+static void Report ( const char *name, double seconds, double baseline )
+{
+   double total = ( double ) NUM_MATRICES * NUM_ITERATIONS;
+
+   printf ( "%-22s %8.2f ns/multiply %10.2f M/s   x%.2f\n", name,
+            seconds * 1e9 / total, total / seconds * 1e-6, baseline / seconds );
+}
+
+int main ( void )
+{
+   ESMatrix *a = malloc ( NUM_MATRICES * sizeof ( ESMatrix ) );
+   ESMatrix *b = malloc ( NUM_MATRICES * sizeof ( ESMatrix ) );
+   ESMatrix *ref = malloc ( NUM_MATRICES * sizeof ( ESMatrix ) );
+   ESMatrix *out = malloc ( NUM_MATRICES * sizeof ( ESMatrix ) );
+   GLuint64  start;
+   double    scalarTime, singleTime, batchTime;
+   int       i, iter;
+
+   if ( a == NULL || b == NULL || ref == NULL || out == NULL )
+   {
+      return 1;
+   }
+
+   srand ( 0 );
+
+   for ( i = 0; i < NUM_MATRICES * 16; i++ )
+   {
+      ( ( float * ) a ) [i] = ( float ) rand() / RAND_MAX * 2.0f - 1.0f;
+      ( ( float * ) b ) [i] = ( float ) rand() / RAND_MAX * 2.0f - 1.0f;
+   }
+
+   printf ( "esMatrixMultiply benchmark: %d matrices x %d iterations, SIMD path: %s\n",
+            NUM_MATRICES, NUM_ITERATIONS, ES_SIMD_NAME );
+
+   start = esGetTimeNs();
+
+   for ( iter = 0; iter < NUM_ITERATIONS; iter++ )
+   {
+      for ( i = 0; i < NUM_MATRICES; i++ )
+      {
+         ScalarMultiply ( &ref[i], &a[i], &b[i] );
+      }
+   }
+
+   scalarTime = ( esGetTimeNs() - start ) * 1e-9;
+
+   start = esGetTimeNs();
+
+   for ( iter = 0; iter < NUM_ITERATIONS; iter++ )
+   {
+      for ( i = 0; i < NUM_MATRICES; i++ )
+      {
+         esMatrixMultiply ( &out[i], &a[i], &b[i] );
+      }
+   }
+
+   singleTime = ( esGetTimeNs() - start ) * 1e-9;
+   printf ( "esMatrixMultiply max error: %g\n", MaxError ( ref, out, NUM_MATRICES ) );
+
+   memset ( out, 0, NUM_MATRICES * sizeof ( ESMatrix ) );
+   start = esGetTimeNs();
+
+   for ( iter = 0; iter < NUM_ITERATIONS; iter++ )
+   {
+      esMatrixMultiplyBatch ( out, a, b, NUM_MATRICES );
+   }
+
+   batchTime = ( esGetTimeNs() - start ) * 1e-9;
+   printf ( "esMatrixMultiplyBatch max error: %g\n", MaxError ( ref, out, NUM_MATRICES ) );
+
+   Report ( "scalar reference", scalarTime, scalarTime );
+   Report ( "esMatrixMultiply", singleTime, scalarTime );
+   Report ( "esMatrixMultiplyBatch", batchTime, scalarTime );
+
+   free ( a );
+   free ( b );
+   free ( ref );
+   free ( out );
+
+   return 0;
+}
@@ -0,0 +1,188 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// RadixSort.c
+//
+//    Microbenchmark of the particle depth sort: qsort against esRadixSort
+//    and esRadixSortIndices, on one thread and on a thread pool, at 100k
+//    and 1M keys.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esUtil.h"
+
+#define NUM_SIZES       2
+
+static const int sizes[NUM_SIZES] = { 100000, 1000000 };
+static const int iterations[NUM_SIZES] = { 50, 5 };
+
+///
+// CompareKeys()
+//
+static int CompareKeys ( const void *a, const void *b )
+{
+   GLuint ka = * ( const GLuint * ) a;
+   GLuint kb = * ( const GLuint * ) b;
+
+   return ka < kb ? -1 : ka > kb;
+}
+
+///
+// CheckSorted()
+//
+//    Returns the number of out of order neighbours, read through indices if given
+//
+static int CheckSorted ( const GLuint *keys, const GLuint *indices, int count )
+{
+   int errors = 0;
+   int i;
+
+   for ( i = 1; i < count; i++ )
+   {
+      GLuint prev = indices != NULL ? keys[indices[i - 1]] : keys[i - 1];
+      GLuint cur = indices != NULL ? keys[indices[i]] : keys[i];
+
+      errors += prev > cur;
+   }
+
+   return errors;
+}
+
+///
+// Report()
+//
+static void Report ( const char *name, int count, double seconds, double baseline )
+{
+   printf ( "   %-28s %8.3f ms/sort %8.2f Mkeys/s   x%.2f\n", name,
+            seconds * 1e3, count / seconds * 1e-6, baseline / seconds );
+}
+
+int main ( void )
+{
+   ESThreadPool *pool = esThreadPoolCreate ( 0 );
+   int s;
+
+   if ( pool == NULL )
+   {
+      return 1;
+   }
+
+   printf ( "Radix sort benchmark, %d worker threads\n", esThreadPoolSize ( pool ) );
+
+   for ( s = 0; s < NUM_SIZES; s++ )
+   {
+      int count = sizes[s];
+      GLuint *depths = malloc ( count * sizeof ( GLuint ) );
+      GLuint *keys = malloc ( count * sizeof ( GLuint ) );
+      GLuint *indices = malloc ( count * sizeof ( GLuint ) );
+      GLuint *scratch = malloc ( 3 * count * sizeof ( GLuint ) );
+      GLuint64 start;
+      double qsortTime, time;
+      int i, iter, errors;
+
+      if ( depths == NULL || keys == NULL || indices == NULL || scratch == NULL )
+      {
+         return 1;
+      }
+
+      // Particle depths in [-1, 1], as esParticleSystemUpload would key them
+      srand ( 0 );
+
+      for ( i = 0; i < count; i++ )
+      {
+         depths[i] = esFloatSortKey ( ( float ) rand() / RAND_MAX * 2.0f - 1.0f );
+      }
+
+      printf ( "%d keys:\n", count );
+
+      start = esGetTimeNs();
+
+      for ( iter = 0; iter < iterations[s]; iter++ )
+      {
+         memcpy ( keys, depths, count * sizeof ( GLuint ) );
+         qsort ( keys, count, sizeof ( GLuint ), CompareKeys );
+      }
+
+      qsortTime = ( esGetTimeNs() - start ) * 1e-9 / iterations[s];
+      Report ( "qsort", count, qsortTime, qsortTime );
+
+      // Keys only, one thread and then the pool
+      for ( i = 0; i < 2; i++ )
+      {
+         start = esGetTimeNs();
+
+         for ( iter = 0; iter < iterations[s]; iter++ )
+         {
+            memcpy ( keys, depths, count * sizeof ( GLuint ) );
+            esRadixSort ( i ? pool : NULL, keys, count, scratch );
+         }
+
+         time = ( esGetTimeNs() - start ) * 1e-9 / iterations[s];
+         errors = CheckSorted ( keys, NULL, count );
+         Report ( i ? "esRadixSort (pool)" : "esRadixSort", count, time, qsortTime );
+
+         if ( errors != 0 )
+         {
+            printf ( "   ERROR: %d keys out of order\n", errors );
+         }
+      }
+
+      // Indices only, the keys stay where they are
+      for ( i = 0; i < 2; i++ )
+      {
+         start = esGetTimeNs();
+
+         for ( iter = 0; iter < iterations[s]; iter++ )
+         {
+            esRadixSortIndices ( i ? pool : NULL, depths, indices, count, scratch );
+         }
+
+         time = ( esGetTimeNs() - start ) * 1e-9 / iterations[s];
+         errors = CheckSorted ( depths, indices, count );
+         Report ( i ? "esRadixSortIndices (pool)" : "esRadixSortIndices", count, time, qsortTime );
+
+         if ( errors != 0 )
+         {
+            printf ( "   ERROR: %d indices out of order\n", errors );
+         }
+      }
+
+      free ( depths );
+      free ( keys );
+      free ( indices );
+      free ( scratch );
+   }
+
+   esThreadPoolDestroy ( pool );
+
+   return 0;
+}
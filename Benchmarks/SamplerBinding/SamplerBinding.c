@@ -0,0 +1,258 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// SamplerBinding.c
+//
+//    Per-draw CPU cost of switching texture wrap modes with
+//    glTexParameteri, as TextureWrap used to, against binding sampler
+//    objects from esGetSampler.  Every frame issues NUM_DRAWS small draws
+//    each way, cycling through three wrap modes, and as many draws with no
+//    state change as the baseline.  Run it with --bench (and ES_HEADLESS=1)
+//    for a fixed number of frames; the comparison is printed at shutdown.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include "esUtil.h"
+
+#define NUM_DRAWS       1000
+#define NUM_MODES       3
+
+enum
+{
+   METHOD_NONE,
+   METHOD_TEX_PARAMETER,
+   METHOD_BIND_SAMPLER,
+   NUM_METHODS
+};
+
+typedef struct
+{
+   GLuint programObject;
+   GLuint textureId;
+   GLuint vertexBuffer;
+
+   ESSamplerCache *samplerCache;
+   GLuint samplers[NUM_MODES];
+
+   // Accumulated time for each method: submitting the draws, and
+   // submitting plus glFinish
+   GLuint64 submitNs[NUM_METHODS];
+   GLuint64 totalNs[NUM_METHODS];
+   int frames;
+
+} UserData;
+
+static const GLenum wrapModes[NUM_MODES] = { GL_REPEAT, GL_CLAMP_TO_EDGE, GL_MIRRORED_REPEAT };
+
+///
+// Init()
+//
+static int Init ( ESContext *esContext )
+{
+   UserData *userData = esContext->userData;
+   char vShaderStr[] =
+      "#version 300 es                            \n"
+      "layout(location = 0) in vec4 a_position;   \n"
+      "out vec2 v_texCoord;                       \n"
+      "void main()                                \n"
+      "{                                          \n"
+      "   gl_Position = a_position;               \n"
+      "   v_texCoord = a_position.xy * 8.0;       \n"
+      "}                                          \n";
+
+   char fShaderStr[] =
+      "#version 300 es                                     \n"
+      "precision mediump float;                            \n"
+      "in vec2 v_texCoord;                                 \n"
+      "layout(location = 0) out vec4 outColor;             \n"
+      "uniform sampler2D s_texture;                        \n"
+      "void main()                                         \n"
+      "{                                                   \n"
+      "   outColor = texture( s_texture, v_texCoord );     \n"
+      "}                                                   \n";
+
+   // A quad of a few pixels, so the GPU work per draw is negligible
+   GLfloat vertices[] = { -0.02f, -0.02f, 0.0f, 1.0f,
+                           0.02f, -0.02f, 0.0f, 1.0f,
+                          -0.02f,  0.02f, 0.0f, 1.0f,
+                           0.02f,  0.02f, 0.0f, 1.0f
+                        };
+   GLubyte pixels[4 * 4 * 3];
+   ESSamplerDesc desc;
+   int i;
+
+   userData->programObject = esLoadProgram ( vShaderStr, fShaderStr );
+
+   if ( userData->programObject == 0 )
+   {
+      return FALSE;
+   }
+
+   for ( i = 0; i < ( int ) sizeof ( pixels ); i++ )
+   {
+      pixels[i] = ( GLubyte ) ( i * 37 );
+   }
+
+   glGenTextures ( 1, &userData->textureId );
+   glBindTexture ( GL_TEXTURE_2D, userData->textureId );
+   glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGB, 4, 4, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels );
+   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+
+   glGenBuffers ( 1, &userData->vertexBuffer );
+   glBindBuffer ( GL_ARRAY_BUFFER, userData->vertexBuffer );
+   glBufferData ( GL_ARRAY_BUFFER, sizeof ( vertices ), vertices, GL_STATIC_DRAW );
+   glVertexAttribPointer ( 0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof ( GLfloat ), ( const void * ) 0 );
+   glEnableVertexAttribArray ( 0 );
+
+   userData->samplerCache = esSamplerCacheCreate ();
+
+   if ( userData->samplerCache == NULL )
+   {
+      return FALSE;
+   }
+
+   esSamplerDescInit ( &desc );
+   desc.minFilter = GL_LINEAR;
+
+   for ( i = 0; i < NUM_MODES; i++ )
+   {
+      desc.wrapS = wrapModes[i];
+      desc.wrapT = wrapModes[i];
+      userData->samplers[i] = esGetSampler ( userData->samplerCache, &desc );
+   }
+
+   glUseProgram ( userData->programObject );
+   glClearColor ( 0.0f, 0.0f, 0.0f, 0.0f );
+   return TRUE;
+}
+
+///
+// Draw()
+//
+static void Draw ( ESContext *esContext )
+{
+   UserData *userData = esContext->userData;
+   int method, i;
+
+   glViewport ( 0, 0, esContext->width, esContext->height );
+   glClear ( GL_COLOR_BUFFER_BIT );
+   glFinish ();
+
+   for ( method = 0; method < NUM_METHODS; method++ )
+   {
+      GLuint64 start, submitted, finished;
+
+      start = esGetTimeNs ();
+
+      for ( i = 0; i < NUM_DRAWS; i++ )
+      {
+         if ( method == METHOD_TEX_PARAMETER )
+         {
+            glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapModes[i % NUM_MODES] );
+            glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrapModes[i % NUM_MODES] );
+         }
+         else if ( method == METHOD_BIND_SAMPLER )
+         {
+            glBindSampler ( 0, userData->samplers[i % NUM_MODES] );
+         }
+
+         glDrawArrays ( GL_TRIANGLE_STRIP, 0, 4 );
+      }
+
+      submitted = esGetTimeNs ();
+      glFinish ();
+      finished = esGetTimeNs ();
+
+      // The texture parameters apply again once no sampler is bound
+      glBindSampler ( 0, 0 );
+
+      userData->submitNs[method] += submitted - start;
+      userData->totalNs[method] += finished - start;
+   }
+
+   userData->frames++;
+}
+
+///
+// ShutDown()
+//
+static void ShutDown ( ESContext *esContext )
+{
+   UserData *userData = esContext->userData;
+   const char *names[NUM_METHODS] = { "no state change", "glTexParameteri", "glBindSampler" };
+   double draws = ( double ) userData->frames * NUM_DRAWS;
+   int method;
+
+   if ( userData->frames > 0 )
+   {
+      printf ( "Sampler binding benchmark, %d frames of %d draws\n", userData->frames, NUM_DRAWS );
+
+      // Overhead is the CPU submit cost over the baseline draws, the time
+      // spent in glFinish is GPU work and not what the state change costs
+      for ( method = 0; method < NUM_METHODS; method++ )
+      {
+         printf ( "   %-16s %8.1f ns/draw submit %8.1f ns/draw with glFinish %8.1f ns/draw overhead\n",
+                  names[method], userData->submitNs[method] / draws, userData->totalNs[method] / draws,
+                  ( ( double ) userData->submitNs[method] - userData->submitNs[METHOD_NONE] ) / draws );
+      }
+   }
+
+   esSamplerCacheDestroy ( userData->samplerCache );
+   glDeleteBuffers ( 1, &userData->vertexBuffer );
+   glDeleteTextures ( 1, &userData->textureId );
+   glDeleteProgram ( userData->programObject );
+}
+
+int esMain ( ESContext *esContext )
+{
+   esContext->userData = calloc ( 1, sizeof ( UserData ) );
+
+   if ( esContext->userData == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   if ( !esCreateWindow ( esContext, "SamplerBinding", 320, 240, ES_WINDOW_RGB ) )
+   {
+      return GL_FALSE;
+   }
+
+   if ( !Init ( esContext ) )
+   {
+      return GL_FALSE;
+   }
+
+   esRegisterDrawFunc ( esContext, Draw );
+   esRegisterShutdownFunc ( esContext, ShutDown );
+
+   return GL_TRUE;
+}
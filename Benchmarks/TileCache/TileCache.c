@@ -0,0 +1,239 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//
+// TileCache.c
+//
+//    Streams a window of tiles through an esTileCache with fewer layers
+//    than tiles, so every pass over the file evicts the tiles of the last
+//    one and has to load them again.  Init first checks that evicted tiles
+//    come back and that the caller's array texture binding is kept, and
+//    fails if not.  Run it with --bench (and ES_HEADLESS=1) to time the
+//    streaming; the counts are printed at shutdown.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include "esUtil.h"
+
+#define TILE_FILE       "TileCache.tiles"
+#define TILE_SIZE       256
+#define NUM_TILES       64
+#define NUM_SLOTS       8
+
+// Tiles needed each frame, and how far the window moves
+#define WINDOW_TILES    4
+#define WINDOW_STEP     2
+
+typedef struct
+{
+   ESTileCache *cache;
+   int frames;
+
+   // Requested tiles that were not resident after esTileCacheFinish
+   int missing;
+
+} UserData;
+
+///
+// FillTile()
+//
+static void ESCALLBACK FillTile ( void *arg, int tile, void *pixels )
+{
+   GLubyte *texels = pixels;
+   int i;
+
+   ( void ) arg;
+
+   for ( i = 0; i < TILE_SIZE * TILE_SIZE; i++ )
+   {
+      texels[i] = ( GLubyte ) ( tile * 4 + i );
+   }
+}
+
+///
+// StreamWindow()
+//
+//    Request the tiles of the window starting at first, wait for them and
+//    return how many are still not resident
+//
+static int StreamWindow ( ESTileCache *cache, int first )
+{
+   int missing = 0;
+   int i;
+
+   for ( i = 0; i < WINDOW_TILES; i++ )
+   {
+      esTileCacheRequest ( cache, ( first + i ) % NUM_TILES, i );
+   }
+
+   esTileCacheFinish ( cache );
+
+   for ( i = 0; i < WINDOW_TILES; i++ )
+   {
+      missing += esTileCacheLookup ( cache, ( first + i ) % NUM_TILES ) < 0;
+   }
+
+   esTileCacheUpdate ( cache );
+
+   return missing;
+}
+
+///
+// CheckEviction()
+//
+//    Two passes over the file, the second only finds its tiles if the ones
+//    evicted in the first are loaded again
+//
+static int CheckEviction ( ESTileCache *cache )
+{
+   const ESTileCacheStats *stats;
+   GLuint texture;
+   GLint bound;
+   int missing = 0;
+   int first;
+
+   glGenTextures ( 1, &texture );
+   glBindTexture ( GL_TEXTURE_2D_ARRAY, texture );
+
+   for ( first = 0; first < 2 * NUM_TILES; first += WINDOW_STEP )
+   {
+      missing += StreamWindow ( cache, first );
+   }
+
+   glGetIntegerv ( GL_TEXTURE_BINDING_2D_ARRAY, &bound );
+   glBindTexture ( GL_TEXTURE_2D_ARRAY, 0 );
+   glDeleteTextures ( 1, &texture );
+
+   stats = esTileCacheGetStats ( cache );
+
+   if ( missing != 0 )
+   {
+      esLogMessage ( "ERROR: %d requested tiles not resident, %u loaded, %u evicted\n", missing,
+                     ( GLuint ) stats->tilesLoaded, ( GLuint ) stats->tilesEvicted );
+      return FALSE;
+   }
+
+   if ( ( GLuint ) bound != texture )
+   {
+      esLogMessage ( "ERROR: the upload changed the GL_TEXTURE_2D_ARRAY binding\n" );
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+///
+// Init()
+//
+static int Init ( ESContext *esContext )
+{
+   UserData *userData = esContext->userData;
+
+   if ( !esTileFileWrite ( TILE_FILE, TILE_SIZE, TILE_SIZE, NUM_TILES, GL_R8, GL_RED, GL_UNSIGNED_BYTE,
+                           NULL, 0, FillTile, NULL ) )
+   {
+      return FALSE;
+   }
+
+   userData->cache = esTileCacheCreate ( esContext->platformData, TILE_FILE, NUM_SLOTS );
+
+   if ( userData->cache == NULL )
+   {
+      return FALSE;
+   }
+
+   if ( !CheckEviction ( userData->cache ) )
+   {
+      return FALSE;
+   }
+
+   glClearColor ( 0.0f, 0.0f, 0.0f, 0.0f );
+   return TRUE;
+}
+
+///
+// Draw()
+//
+static void Draw ( ESContext *esContext )
+{
+   UserData *userData = esContext->userData;
+
+   glViewport ( 0, 0, esContext->width, esContext->height );
+   glClear ( GL_COLOR_BUFFER_BIT );
+
+   userData->missing += StreamWindow ( userData->cache, userData->frames * WINDOW_STEP );
+   userData->frames++;
+}
+
+///
+// ShutDown()
+//
+static void ShutDown ( ESContext *esContext )
+{
+   UserData *userData = esContext->userData;
+
+   if ( userData->frames > 0 )
+   {
+      const ESTileCacheStats *stats = esTileCacheGetStats ( userData->cache );
+
+      printf ( "Tile cache benchmark, %d frames of %d tiles in %d layers\n", userData->frames,
+               WINDOW_TILES, NUM_SLOTS );
+      printf ( "   %u tiles loaded, %u evicted, %.1f MB uploaded, %d requested tiles missing\n",
+               ( GLuint ) stats->tilesLoaded, ( GLuint ) stats->tilesEvicted,
+               stats->bytesUploaded / ( 1024.0 * 1024.0 ), userData->missing );
+   }
+
+   esTileCacheDestroy ( userData->cache );
+   remove ( TILE_FILE );
+}
+
+int esMain ( ESContext *esContext )
+{
+   esContext->userData = calloc ( 1, sizeof ( UserData ) );
+
+   if ( esContext->userData == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   if ( !esCreateWindow ( esContext, "TileCache", 320, 240, ES_WINDOW_RGB ) )
+   {
+      return GL_FALSE;
+   }
+
+   if ( !Init ( esContext ) )
+   {
+      return GL_FALSE;
+   }
+
+   esRegisterDrawFunc ( esContext, Draw );
+   esRegisterShutdownFunc ( esContext, ShutDown );
+
+   return GL_TRUE;
+}
@@ -50,36 +50,31 @@ typedef struct
    GLuint baseMapTexId;
    GLuint lightMapTexId;
 
+   // Loads the textures in the background
+   ESAssetLoader *assetLoader;
+
 } UserData;
 
 ///
 // Load texture from disk
 //
-GLuint LoadTexture ( void *ioContext, char *fileName )
+GLuint LoadTexture ( ESAssetLoader *assetLoader, void *ioContext, char *fileName )
 {
-   int width,
-       height;
-
-   char *buffer = esLoadTGA ( ioContext, fileName, &width, &height );
-   GLuint texId;
+   // Decoded on a worker thread and uploaded by esAssetLoaderUpdate
+   GLuint texId = esAssetLoaderLoadTexture ( assetLoader, ioContext, fileName, GL_RGB, GL_RGB );
 
-   if ( buffer == NULL )
+   if ( texId == 0 )
    {
       esLogMessage ( "Error loading (%s) image.\n", fileName );
       return 0;
    }
 
-   glGenTextures ( 1, &texId );
    glBindTexture ( GL_TEXTURE_2D, texId );
-
-   glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, buffer );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 
-   free ( buffer );
-
    return texId;
 }
 
@@ -126,9 +121,16 @@ int Init ( ESContext *esContext )
    userData->baseMapLoc = glGetUniformLocation ( userData->programObject, "s_baseMap" );
    userData->lightMapLoc = glGetUniformLocation ( userData->programObject, "s_lightMap" );
 
+   userData->assetLoader = esAssetLoaderCreate ( NULL, 0, 0 );
+
+   if ( userData->assetLoader == NULL )
+   {
+      return FALSE;
+   }
+
    // Load the textures
-   userData->baseMapTexId = LoadTexture ( esContext->platformData, "basemap.tga" );
-   userData->lightMapTexId = LoadTexture ( esContext->platformData, "lightmap.tga" );
+   userData->baseMapTexId = LoadTexture ( userData->assetLoader, esContext->platformData, "basemap.tga" );
+   userData->lightMapTexId = LoadTexture ( userData->assetLoader, esContext->platformData, "lightmap.tga" );
 
    if ( userData->baseMapTexId == 0 || userData->lightMapTexId == 0 )
    {
@@ -156,6 +158,9 @@ void Draw ( ESContext *esContext )
                          };
    GLushort indices[] = { 0, 1, 2, 0, 2, 3 };
 
+   // Upload any textures that have finished decoding
+   esAssetLoaderUpdate ( userData->assetLoader );
+
    // Set the viewport
    glViewport ( 0, 0, esContext->width, esContext->height );
 
@@ -199,6 +204,8 @@ void ShutDown ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
+   esAssetLoaderDestroy ( userData->assetLoader );
+
    // Delete texture object
    glDeleteTextures ( 1, &userData->baseMapTexId );
    glDeleteTextures ( 1, &userData->lightMapTexId );
@@ -10,8 +10,23 @@ LOCAL_MODULE    := MRTs
 LOCAL_CFLAGS    += -DANDROID
 
 
-LOCAL_SRC_FILES := $(COMMON_SRC_PATH)/esShader.c \
+LOCAL_SRC_FILES := $(COMMON_SRC_PATH)/esArena.c \
+				   $(COMMON_SRC_PATH)/esAssetLoader.c \
+				   $(COMMON_SRC_PATH)/esCull.c \
+				   $(COMMON_SRC_PATH)/esFenceRing.c \
+				   $(COMMON_SRC_PATH)/esMeshOptimize.c \
+				   $(COMMON_SRC_PATH)/esMipmap.c \
+				   $(COMMON_SRC_PATH)/esNoise.c \
+				   $(COMMON_SRC_PATH)/esParticles.c \
+				   $(COMMON_SRC_PATH)/esSampler.c \
+				   $(COMMON_SRC_PATH)/esShader.c \
 				   $(COMMON_SRC_PATH)/esShapes.c \
+				   $(COMMON_SRC_PATH)/esSort.c \
+				   $(COMMON_SRC_PATH)/esStateCache.c \
+				   $(COMMON_SRC_PATH)/esStreamBuffer.c \
+				   $(COMMON_SRC_PATH)/esTerrain.c \
+				   $(COMMON_SRC_PATH)/esThreadPool.c \
+				   $(COMMON_SRC_PATH)/esTileCache.c \
 				   $(COMMON_SRC_PATH)/esTransform.c \
 				   $(COMMON_SRC_PATH)/esUtil.c \
 				   $(COMMON_SRC_PATH)/Android/esUtil_Android.c \
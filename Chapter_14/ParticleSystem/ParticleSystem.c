@@ -32,18 +32,19 @@
 // ParticleSystem.c
 //
 //    This is an example that demonstrates rendering a particle system
-//    using a vertex shader and point sprites.
+//    using a vertex shader and point sprites.  The particles are simulated
+//    on the CPU by an ESParticleSystem and streamed to a vertex buffer
+//    every frame, sorted back to front so they can be alpha blended.
 //
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "esUtil.h"
 
 #define NUM_PARTICLES   1000
-#define PARTICLE_SIZE   7
 
-#define ATTRIBUTE_LIFETIME_LOCATION       0
-#define ATTRIBUTE_STARTPOSITION_LOCATION  1
-#define ATTRIBUTE_ENDPOSITION_LOCATION    2
+#define ATTRIBUTE_POSITION_LOCATION       0
+#define ATTRIBUTE_AGE_LOCATION            1
 
 typedef struct
 {
@@ -51,49 +52,50 @@ typedef struct
    GLuint programObject;
 
    // Uniform location
-   GLint timeLoc;
    GLint colorLoc;
-   GLint centerPositionLoc;
    GLint samplerLoc;
 
    // Texture handle
    GLuint textureId;
 
-   // Particle vertex data
-   float particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+   // Loads the textures in the background
+   ESAssetLoader *assetLoader;
 
-   // Current time
+   // Simulated particles and the emitter bursts come from
+   ESParticleSystem *particles;
+   int emitter;
+
+   // Time since the last burst
    float time;
 
+   // Color of the current burst
+   float color[4];
+
+   // Drops the state Draw sets again every frame
+   ESStateCache *stateCache;
+
 } UserData;
 
 ///
 // Load texture from disk
 //
-GLuint LoadTexture ( void *ioContext, char *fileName )
+GLuint LoadTexture ( ESAssetLoader *assetLoader, void *ioContext, char *fileName )
 {
-   int width,
-       height;
-   char *buffer = esLoadTGA ( ioContext, fileName, &width, &height );
-   GLuint texId;
+   // Decoded on a worker thread and uploaded by esAssetLoaderUpdate
+   GLuint texId = esAssetLoaderLoadTexture ( assetLoader, ioContext, fileName, GL_RGB, GL_RGB );
 
-   if ( buffer == NULL )
+   if ( texId == 0 )
    {
       esLogMessage ( "Error loading (%s) image.\n", fileName );
       return 0;
    }
 
-   glGenTextures ( 1, &texId );
    glBindTexture ( GL_TEXTURE_2D, texId );
-
-   glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, buffer );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 
-   free ( buffer );
-
    return texId;
 }
 
@@ -104,31 +106,17 @@ GLuint LoadTexture ( void *ioContext, char *fileName )
 int Init ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
-   int i;
+   ESParticleEmitter emitter;
 
    char vShaderStr[] =
       "#version 300 es                                      \n"
-      "uniform float u_time;                                \n"
-      "uniform vec3 u_centerPosition;                       \n"
-      "layout(location = 0) in float a_lifetime;            \n"
-      "layout(location = 1) in vec3 a_startPosition;        \n"
-      "layout(location = 2) in vec3 a_endPosition;          \n"
+      "layout(location = 0) in vec3 a_position;             \n"
+      "layout(location = 1) in float a_age;                 \n"
       "out float v_lifetime;                                \n"
       "void main()                                          \n"
       "{                                                    \n"
-      "  if ( u_time <= a_lifetime )                        \n"
-      "  {                                                  \n"
-      "    gl_Position.xyz = a_startPosition +              \n"
-      "                      (u_time * a_endPosition);      \n"
-      "    gl_Position.xyz += u_centerPosition;             \n"
-      "    gl_Position.w = 1.0;                             \n"
-      "  }                                                  \n"
-      "  else                                               \n"
-      "  {                                                  \n"
-      "     gl_Position = vec4( -1000, -1000, 0, 0 );       \n"
-      "  }                                                  \n"
-      "  v_lifetime = 1.0 - ( u_time / a_lifetime );        \n"
-      "  v_lifetime = clamp ( v_lifetime, 0.0, 1.0 );       \n"
+      "  gl_Position = vec4( a_position, 1.0 );             \n"
+      "  v_lifetime = clamp ( 1.0 - a_age, 0.0, 1.0 );      \n"
       "  gl_PointSize = ( v_lifetime * v_lifetime ) * 40.0; \n"
       "}";
 
@@ -143,53 +131,66 @@ int Init ( ESContext *esContext )
       "{                                                    \n"
       "  vec4 texColor;                                     \n"
       "  texColor = texture( s_texture, gl_PointCoord );    \n"
-      "  fragColor = vec4( u_color ) * texColor;            \n"
-      "  fragColor.a *= v_lifetime;                         \n"
+      "  fragColor.rgb = u_color.rgb;                       \n"
+      "  fragColor.a = u_color.a * texColor.r * v_lifetime; \n"
       "}                                                    \n";
 
    // Load the shaders and get a linked program object
    userData->programObject = esLoadProgram ( vShaderStr, fShaderStr );
 
    // Get the uniform locations
-   userData->timeLoc = glGetUniformLocation ( userData->programObject, "u_time" );
-   userData->centerPositionLoc = glGetUniformLocation ( userData->programObject, "u_centerPosition" );
    userData->colorLoc = glGetUniformLocation ( userData->programObject, "u_color" );
    userData->samplerLoc = glGetUniformLocation ( userData->programObject, "s_texture" );
 
    glClearColor ( 0.0f, 0.0f, 0.0f, 0.0f );
 
-   // Fill in particle data array
-   srand ( 0 );
+   // Particles start within 0.125 of the emitter, fly off at up to 1 unit
+   // per second on each axis and live for up to a second
+   userData->particles = esParticleSystemCreate ( NUM_PARTICLES, NULL );
 
-   for ( i = 0; i < NUM_PARTICLES; i++ )
+   if ( userData->particles == NULL )
    {
-      float *particleData = &userData->particleData[i * PARTICLE_SIZE];
+      return FALSE;
+   }
 
-      // Lifetime of particle
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 10000.0f );
+   memset ( &emitter, 0, sizeof ( emitter ) );
+   emitter.positionSpread[0] = emitter.positionSpread[1] = emitter.positionSpread[2] = 0.125f;
+   emitter.velocitySpread[0] = emitter.velocitySpread[1] = emitter.velocitySpread[2] = 1.0f;
+   emitter.lifeMin = 0.0f;
+   emitter.lifeMax = 1.0f;
 
-      // End position of particle
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 5000.0f ) - 1.0f;
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 5000.0f ) - 1.0f;
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 5000.0f ) - 1.0f;
+   userData->emitter = esParticleSystemAddEmitter ( userData->particles, &emitter );
 
-      // Start position of particle
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 40000.0f ) - 0.125f;
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 40000.0f ) - 0.125f;
-      ( *particleData++ ) = ( ( float ) ( rand() % 10000 ) / 40000.0f ) - 0.125f;
+   // Draw back to front; the positions are already in clip space, where
+   // depth increases along +z
+   esParticleSystemSetSortDirection ( userData->particles, 0.0f, 0.0f, 1.0f );
 
-   }
+   srand ( 0 );
 
    // Initialize time to cause reset on first update
    userData->time = 1.0f;
 
-   userData->textureId = LoadTexture ( esContext->platformData, "smoke.tga" );
+   userData->assetLoader = esAssetLoaderCreate ( NULL, 0, 0 );
+
+   if ( userData->assetLoader == NULL )
+   {
+      return FALSE;
+   }
+
+   userData->textureId = LoadTexture ( userData->assetLoader, esContext->platformData, "smoke.tga" );
 
    if ( userData->textureId <= 0 )
    {
       return FALSE;
    }
 
+   userData->stateCache = esStateCacheCreate ( );
+
+   if ( userData->stateCache == NULL )
+   {
+      return FALSE;
+   }
+
    return TRUE;
 }
 
@@ -202,33 +203,27 @@ void Update ( ESContext *esContext, float deltaTime )
 
    userData->time += deltaTime;
 
-   glUseProgram ( userData->programObject );
+   esParticleSystemUpdate ( userData->particles, deltaTime );
 
    if ( userData->time >= 1.0f )
    {
-      float centerPos[3];
-      float color[4];
+      ESParticleEmitter *emitter = esParticleSystemGetEmitter ( userData->particles, userData->emitter );
 
       userData->time = 0.0f;
 
       // Pick a new start location and color
-      centerPos[0] = ( ( float ) ( rand() % 10000 ) / 10000.0f ) - 0.5f;
-      centerPos[1] = ( ( float ) ( rand() % 10000 ) / 10000.0f ) - 0.5f;
-      centerPos[2] = ( ( float ) ( rand() % 10000 ) / 10000.0f ) - 0.5f;
+      emitter->position[0] = ( ( float ) ( rand() % 10000 ) / 10000.0f ) - 0.5f;
+      emitter->position[1] = ( ( float ) ( rand() % 10000 ) / 10000.0f ) - 0.5f;
+      emitter->position[2] = ( ( float ) ( rand() % 10000 ) / 10000.0f ) - 0.5f;
 
-      glUniform3fv ( userData->centerPositionLoc, 1, &centerPos[0] );
+      esParticleSystemEmit ( userData->particles, userData->emitter, NUM_PARTICLES );
 
       // Random color
-      color[0] = ( ( float ) ( rand() % 10000 ) / 20000.0f ) + 0.5f;
-      color[1] = ( ( float ) ( rand() % 10000 ) / 20000.0f ) + 0.5f;
-      color[2] = ( ( float ) ( rand() % 10000 ) / 20000.0f ) + 0.5f;
-      color[3] = 0.5;
-
-      glUniform4fv ( userData->colorLoc, 1, &color[0] );
+      userData->color[0] = ( ( float ) ( rand() % 10000 ) / 20000.0f ) + 0.5f;
+      userData->color[1] = ( ( float ) ( rand() % 10000 ) / 20000.0f ) + 0.5f;
+      userData->color[2] = ( ( float ) ( rand() % 10000 ) / 20000.0f ) + 0.5f;
+      userData->color[3] = 0.5;
    }
-
-   // Load uniform time variable
-   glUniform1f ( userData->timeLoc, userData->time );
 }
 
 ///
@@ -238,6 +233,9 @@ void Draw ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
+   // Upload any textures that have finished decoding
+   esAssetLoaderUpdate ( userData->assetLoader );
+
    // Set the viewport
    glViewport ( 0, 0, esContext->width, esContext->height );
 
@@ -245,38 +243,34 @@ void Draw ( ESContext *esContext )
    glClear ( GL_COLOR_BUFFER_BIT );
 
    // Use the program object
-   glUseProgram ( userData->programObject );
+   esStateUseProgram ( userData->stateCache, userData->programObject );
 
-   // Load the vertex attributes
-   glVertexAttribPointer ( ATTRIBUTE_LIFETIME_LOCATION, 1, GL_FLOAT,
-                           GL_FALSE, PARTICLE_SIZE * sizeof ( GLfloat ),
-                           userData->particleData );
+   // Stream the live particles to the vertex buffer and load the vertex attributes
+   esParticleSystemUpload ( userData->particles );
 
-   glVertexAttribPointer ( ATTRIBUTE_ENDPOSITION_LOCATION, 3, GL_FLOAT,
-                           GL_FALSE, PARTICLE_SIZE * sizeof ( GLfloat ),
-                           &userData->particleData[1] );
+   glVertexAttribPointer ( ATTRIBUTE_POSITION_LOCATION, 3, GL_FLOAT,
+                           GL_FALSE, sizeof ( ESParticleVertex ),
+                           ( const void * ) 0 );
 
-   glVertexAttribPointer ( ATTRIBUTE_STARTPOSITION_LOCATION, 3, GL_FLOAT,
-                           GL_FALSE, PARTICLE_SIZE * sizeof ( GLfloat ),
-                           &userData->particleData[4] );
+   glVertexAttribPointer ( ATTRIBUTE_AGE_LOCATION, 1, GL_FLOAT,
+                           GL_FALSE, sizeof ( ESParticleVertex ),
+                           ( const void * ) ( sizeof ( GLfloat ) * 3 ) );
 
+   esStateEnableVertexAttribArray ( userData->stateCache, ATTRIBUTE_POSITION_LOCATION );
+   esStateEnableVertexAttribArray ( userData->stateCache, ATTRIBUTE_AGE_LOCATION );
 
-   glEnableVertexAttribArray ( ATTRIBUTE_LIFETIME_LOCATION );
-   glEnableVertexAttribArray ( ATTRIBUTE_ENDPOSITION_LOCATION );
-   glEnableVertexAttribArray ( ATTRIBUTE_STARTPOSITION_LOCATION );
-
-   // Blend particles
-   glEnable ( GL_BLEND );
-   glBlendFunc ( GL_SRC_ALPHA, GL_ONE );
+   // Blend particles, they arrive sorted back to front
+   esStateEnable ( userData->stateCache, GL_BLEND );
+   esStateBlendFunc ( userData->stateCache, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
 
    // Bind the texture
-   glActiveTexture ( GL_TEXTURE0 );
-   glBindTexture ( GL_TEXTURE_2D, userData->textureId );
+   esStateBindTexture ( userData->stateCache, 0, GL_TEXTURE_2D, userData->textureId );
 
-   // Set the sampler texture unit to 0
-   glUniform1i ( userData->samplerLoc, 0 );
+   // Set the sampler texture unit to 0 and the burst color
+   esStateUniform1i ( userData->stateCache, userData->samplerLoc, 0 );
+   esStateUniform4fv ( userData->stateCache, userData->colorLoc, userData->color );
 
-   glDrawArrays ( GL_POINTS, 0, NUM_PARTICLES );
+   glDrawArrays ( GL_POINTS, 0, esParticleSystemCount ( userData->particles ) );
 }
 
 ///
@@ -285,12 +279,22 @@ void Draw ( ESContext *esContext )
 void ShutDown ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
+   const ESStateCacheStats *stats = esStateCacheGetStats ( userData->stateCache );
+
+   esLogMessage ( "State cache: %llu calls issued, %llu filtered\n",
+                  ( unsigned long long ) stats->issued, ( unsigned long long ) stats->filtered );
+
+   esAssetLoaderDestroy ( userData->assetLoader );
+
+   esParticleSystemDestroy ( userData->particles );
 
    // Delete texture object
-   glDeleteTextures ( 1, &userData->textureId );
+   esStateDeleteTexture ( userData->stateCache, userData->textureId );
 
    // Delete program object
-   glDeleteProgram ( userData->programObject );
+   esStateDeleteProgram ( userData->stateCache, userData->programObject );
+
+   esStateCacheDestroy ( userData->stateCache );
 }
 
 
@@ -32,17 +32,36 @@
 // ParticleSystemTransformFeedback.c
 //
 //    This is an example that demonstrates a particle system
-//    using transform feedback.
+//    using transform feedback.  New particles are written by transform
+//    feedback into a ring buffer in the order they are born.  As every
+//    particle lives for the same time, the live particles always form one
+//    contiguous window of the ring, and only that window is drawn, so the
+//    cost follows the live particle count rather than the buffer capacity.
+//    A fence ring lets up to FRAMES_IN_FLIGHT frames of emit and draw work
+//    queue up on the GPU before the CPU has to wait.  Set ES_PARTICLES to
+//    the number of particles to keep alive; the ring is sized to match.
 //
 #include <stdlib.h>
 #include <math.h>
 #include <stddef.h>
 #include "esUtil.h"
-#include "Noise3D.h"
 
-#define NUM_PARTICLES   200
-#define EMISSION_RATE   0.3f
-#define ACCELERATION   -1.0f
+// Size of the particle ring and particles emitted per second unless
+// ES_PARTICLES says otherwise.  The ring must hold EMISSION_RATE *
+// PARTICLE_LIFETIME particles.
+#define PARTICLE_CAPACITY  ( 1 << 16 )
+#define EMISSION_RATE      100.0f
+#define PARTICLE_LIFETIME  2.0f
+#define ACCELERATION      -1.0f
+
+// Emission batches tracked to find the start of the live window
+#define MAX_BATCHES        256
+
+// Frames the CPU may run ahead of the GPU
+#define FRAMES_IN_FLIGHT   3
+
+// Seconds between reports of the particle counts and CPU waits
+#define REPORT_INTERVAL    5.0f
 
 #define ATTRIBUTE_POSITION      0
 #define ATTRIBUTE_VELOCITY      1
@@ -59,6 +78,16 @@ typedef struct
    float lifetime;
 } Particle;
 
+// Particles emitted in one frame
+typedef struct
+{
+   GLuint start;
+   GLuint count;
+
+   // Emission time, every particle of the batch is dead PARTICLE_LIFETIME later
+   float time;
+} EmitBatch;
+
 typedef struct
 {
    // Handle to a program object
@@ -67,7 +96,9 @@ typedef struct
 
    // Emit shader uniform locations
    GLint emitTimeLoc;
-   GLint emitEmissionRateLoc;
+   GLint emitDeltaTimeLoc;
+   GLint emitIdOffsetLoc;
+   GLint emitLifetimeLoc;
    GLint emitNoiseSamplerLoc;
 
    // Draw shader uniform location
@@ -80,35 +111,63 @@ typedef struct
    GLuint textureId;
    GLuint noiseTextureId;
 
-   // Particle vertex data
-   Particle particleData[ NUM_PARTICLES ];
+   // Particle ring buffer and the vertex array object drawing from it
+   GLuint particleVBO;
+   GLuint drawVAO;
 
-   // Particle VBOs
-   GLuint particleVBOs[2];
+   // Particles the ring holds, and particles emitted per second
+   GLuint capacity;
+   float emissionRate;
 
-   // Index into particleVBOs (0 or 1) as to which is the source.
-   // Ping-pong between the two VBOs
-   GLuint curSrcIndex;
+   // Next slot of the ring to write
+   GLuint head;
+
+   // Particles in the live window, which ends at head
+   GLuint windowCount;
+
+   // Batches in the live window, oldest first
+   EmitBatch batches[MAX_BATCHES];
+   int firstBatch;
+   int numBatches;
+
+   // Fraction of a particle left over from the previous frame's emission
+   float emitCarry;
+
+   // Fences for the frames in flight, and the slot of the current frame
+   ESFenceRing *frameFences;
+   int frameSlot;
+
+   // Particles emitted since the last report
+   GLuint emittedCount;
+   float reportTime;
 
    // Current time
    float time;
 
-   // synch object to synchronize the transform feedback results and the draw
-   GLsync emitSync;
-
 } UserData;
 
+///
+// GetParticleCount()
+//
+//    Live particles asked for with ES_PARTICLES, 0 if unset
+//
+static GLuint GetParticleCount ( void )
+{
+   const char *env = getenv ( "ES_PARTICLES" );
+   int count = env != NULL ? atoi ( env ) : 0;
+
+   return count > 0 ? ( GLuint ) count : 0;
+}
+
 ///
 // Load texture from disk
 //
 GLuint LoadTexture ( void *ioContext, char *fileName )
 {
-   int width,
-       height;
-   char *buffer = esLoadTGA ( ioContext, fileName, &width, &height );
+   ESImage image;
    GLuint texId;
 
-   if ( buffer == NULL )
+   if ( !esLoadTGAImage ( ioContext, fileName, &image ) )
    {
       esLogMessage ( "Error loading (%s) image.\n", fileName );
       return 0;
@@ -117,13 +176,13 @@ GLuint LoadTexture ( void *ioContext, char *fileName )
    glGenTextures ( 1, &texId );
    glBindTexture ( GL_TEXTURE_2D, texId );
 
-   glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, buffer );
+   glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGB, image.width, image.height, 0, GL_RGB, GL_UNSIGNED_BYTE, image.pixels );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 
-   free ( buffer );
+   esReleaseImage ( &image );
 
    return texId;
 }
@@ -132,24 +191,15 @@ void InitEmitParticles ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
+   // No vertex inputs, every vertex is a new particle
    char vShaderStr[] =
       "#version 300 es                                                     \n"
-      "#define NUM_PARTICLES           200                                 \n"
-      "#define ATTRIBUTE_POSITION      0                                   \n"
-      "#define ATTRIBUTE_VELOCITY      1                                   \n"
-      "#define ATTRIBUTE_SIZE          2                                   \n"
-      "#define ATTRIBUTE_CURTIME       3                                   \n"
-      "#define ATTRIBUTE_LIFETIME      4                                   \n"
       "uniform float u_time;                                               \n"
-      "uniform float u_emissionRate;                                       \n"
+      "uniform float u_deltaTime;                                          \n"
+      "uniform float u_idOffset;                                           \n"
+      "uniform float u_lifetime;                                           \n"
       "uniform mediump sampler3D s_noiseTex;                               \n"
       "                                                                    \n"
-      "layout(location = ATTRIBUTE_POSITION) in vec2 a_position;           \n"
-      "layout(location = ATTRIBUTE_VELOCITY) in vec2 a_velocity;           \n"
-      "layout(location = ATTRIBUTE_SIZE) in float a_size;                  \n"
-      "layout(location = ATTRIBUTE_CURTIME) in float a_curtime;            \n"
-      "layout(location = ATTRIBUTE_LIFETIME) in float a_lifetime;          \n"
-      "                                                                    \n"
       "out vec2 v_position;                                                \n"
       "out vec2 v_velocity;                                                \n"
       "out float v_size;                                                   \n"
@@ -158,7 +208,7 @@ void InitEmitParticles ( ESContext *esContext )
       "                                                                    \n"
       "float randomValue( inout float seed )                               \n"
       "{                                                                   \n"
-      "   float vertexId = float( gl_VertexID ) / float( NUM_PARTICLES );  \n"
+      "   float vertexId = ( float( gl_VertexID ) + u_idOffset ) * 0.0073; \n"
       "   vec3 texCoord = vec3( u_time, vertexId, seed );                  \n"
       "   seed += 0.1;                                                     \n"
       "   return texture( s_noiseTex, texCoord ).r;                        \n"
@@ -166,24 +216,12 @@ void InitEmitParticles ( ESContext *esContext )
       "void main()                                                         \n"
       "{                                                                   \n"
       "  float seed = u_time;                                              \n"
-      "  float lifetime = a_curtime - u_time;                              \n"
-      "  if( lifetime <= 0.0 && randomValue(seed) < u_emissionRate )       \n"
-      "  {                                                                 \n"
-      "     v_position = vec2( 0.0, -1.0 );                                \n"
-      "     v_velocity = vec2( randomValue(seed) * 2.0 - 1.00,             \n"
-      "                        randomValue(seed) * 1.4 + 1.0 );            \n"
-      "     v_size = randomValue(seed) * 20.0 + 60.0;                      \n"
-      "     v_curtime = u_time;                                            \n"
-      "     v_lifetime = 2.0;                                              \n"
-      "  }                                                                 \n"
-      "  else                                                              \n"
-      "  {                                                                 \n"
-      "     v_position = a_position;                                       \n"
-      "     v_velocity = a_velocity;                                       \n"
-      "     v_size = a_size;                                               \n"
-      "     v_curtime = a_curtime;                                         \n"
-      "     v_lifetime = a_lifetime;                                       \n"
-      "  }                                                                 \n"
+      "  v_position = vec2( 0.0, -1.0 );                                   \n"
+      "  v_velocity = vec2( randomValue(seed) * 2.0 - 1.00,                \n"
+      "                     randomValue(seed) * 1.4 + 1.0 );               \n"
+      "  v_size = randomValue(seed) * 20.0 + 60.0;                         \n"
+      "  v_curtime = u_time - randomValue(seed) * u_deltaTime;             \n"
+      "  v_lifetime = u_lifetime;                                          \n"
       "  gl_Position = vec4( v_position, 0.0, 1.0 );                       \n"
       "}                                                                   \n";
 
@@ -196,8 +234,6 @@ void InitEmitParticles ( ESContext *esContext )
       "  fragColor = vec4(1.0);                             \n"
       "}                                                    \n";
 
-   userData->emitProgramObject = esLoadProgram ( vShaderStr, fShaderStr );
-
    {
       const char *feedbackVaryings[5] =
       {
@@ -208,16 +244,16 @@ void InitEmitParticles ( ESContext *esContext )
          "v_lifetime"
       };
 
-      // Set the vertex shader outputs as transform feedback varyings
-      glTransformFeedbackVaryings ( userData->emitProgramObject, 5, feedbackVaryings, GL_INTERLEAVED_ATTRIBS );
-
-      // Link program must occur after calling glTransformFeedbackVaryings
-      glLinkProgram ( userData->emitProgramObject );
+      // Set the vertex shader outputs as transform feedback varyings and link the program
+      userData->emitProgramObject = esLoadProgramFeedback ( vShaderStr, fShaderStr, 5, feedbackVaryings,
+                                                            GL_INTERLEAVED_ATTRIBS );
 
-      // Get the uniform locations - this also needs to happen after glLinkProgram is called again so
-      // that the uniforms that output to varyings are active
+      // Get the uniform locations - this needs to happen after the program is linked with the
+      // transform feedback varyings so that the uniforms that output to varyings are active
       userData->emitTimeLoc = glGetUniformLocation ( userData->emitProgramObject, "u_time" );
-      userData->emitEmissionRateLoc = glGetUniformLocation ( userData->emitProgramObject, "u_emissionRate" );
+      userData->emitDeltaTimeLoc = glGetUniformLocation ( userData->emitProgramObject, "u_deltaTime" );
+      userData->emitIdOffsetLoc = glGetUniformLocation ( userData->emitProgramObject, "u_idOffset" );
+      userData->emitLifetimeLoc = glGetUniformLocation ( userData->emitProgramObject, "u_lifetime" );
       userData->emitNoiseSamplerLoc = glGetUniformLocation ( userData->emitProgramObject, "s_noiseTex" );
    }
 }
@@ -227,9 +263,9 @@ void InitEmitParticles ( ESContext *esContext )
 //
 int Init ( ESContext *esContext )
 {
-   Particle particleData[ NUM_PARTICLES ];
    UserData *userData = ( UserData * ) esContext->userData;
-   int i;
+   ESThreadPool *pool;
+   GLuint particleCount;
 
    char vShaderStr[] =
       "#version 300 es                                                     \n"
@@ -290,7 +326,20 @@ int Init ( ESContext *esContext )
    userData->samplerLoc = glGetUniformLocation ( userData->drawProgramObject, "s_texture" );
 
    userData->time = 0.0f;
-   userData->curSrcIndex = 0;
+   userData->head = 0;
+   userData->windowCount = 0;
+   userData->firstBatch = 0;
+   userData->numBatches = 0;
+   userData->emitCarry = 0.0f;
+   userData->emittedCount = 0;
+   userData->reportTime = 0.0f;
+
+   // Emit enough to keep the asked for particles alive.  The ring holds
+   // twice that, so batches outliving their lifetime by a frame do not
+   // hold back emission.
+   particleCount = GetParticleCount ( );
+   userData->capacity = particleCount > 0 ? particleCount * 2 : PARTICLE_CAPACITY;
+   userData->emissionRate = particleCount > 0 ? particleCount / PARTICLE_LIFETIME : EMISSION_RATE;
 
    glClearColor ( 0.0f, 0.0f, 0.0f, 0.0f );
 
@@ -302,37 +351,24 @@ int Init ( ESContext *esContext )
    }
 
    // Create a 3D noise texture for random values
-   userData->noiseTextureId = Create3DNoiseTexture ( 128, 50.0 );
+   pool = esThreadPoolCreate ( 0 );
+   userData->noiseTextureId = esCreateNoise3DTexture ( pool, 128, 50.0f, 1 );
+   esThreadPoolDestroy ( pool );
 
-   // Initialize particle data
-   for ( i = 0; i < NUM_PARTICLES; i++ )
+   if ( userData->noiseTextureId == 0 )
    {
-      Particle *particle = &particleData[i];
-      particle->position[0] = 0.0f;
-      particle->position[1] = 0.0f;
-      particle->velocity[0] = 0.0f;
-      particle->velocity[1] = 0.0f;
-      particle->size = 0.0f;
-      particle->curtime = 0.0f;
-      particle->lifetime = 0.0f;
+      return FALSE;
    }
 
+   // Create the particle ring, only ever written by transform feedback
+   glGenBuffers ( 1, &userData->particleVBO );
+   glBindBuffer ( GL_ARRAY_BUFFER, userData->particleVBO );
+   glBufferData ( GL_ARRAY_BUFFER, sizeof ( Particle ) * userData->capacity, NULL, GL_DYNAMIC_COPY );
 
-   // Create the particle VBOs
-   glGenBuffers ( 2, &userData->particleVBOs[0] );
+   // The draw reads the ring through a VAO, so the emit pass runs with no vertex arrays enabled
+   glGenVertexArrays ( 1, &userData->drawVAO );
+   glBindVertexArray ( userData->drawVAO );
 
-   for ( i = 0; i < 2; i++ )
-   {
-      glBindBuffer ( GL_ARRAY_BUFFER, userData->particleVBOs[i] );
-      glBufferData ( GL_ARRAY_BUFFER, sizeof ( Particle ) * NUM_PARTICLES, particleData, GL_DYNAMIC_COPY );
-   }
-
-   return TRUE;
-}
-
-void SetupVertexAttributes ( ESContext *esContext, GLuint vboID )
-{
-   glBindBuffer ( GL_ARRAY_BUFFER, vboID );
    glVertexAttribPointer ( ATTRIBUTE_POSITION, 2, GL_FLOAT,
                            GL_FALSE, sizeof ( Particle ),
                            ( const void * ) NULL );
@@ -358,51 +394,153 @@ void SetupVertexAttributes ( ESContext *esContext, GLuint vboID )
    glEnableVertexAttribArray ( ATTRIBUTE_SIZE );
    glEnableVertexAttribArray ( ATTRIBUTE_CURTIME );
    glEnableVertexAttribArray ( ATTRIBUTE_LIFETIME );
+
+   glBindVertexArray ( 0 );
+   glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+
+   userData->frameFences = esFenceRingCreate ( FRAMES_IN_FLIGHT );
+
+   if ( userData->frameFences == NULL )
+   {
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+///
+// Drop the batches whose particles have all died from the live window
+//
+void RetireBatches ( UserData *userData )
+{
+   while ( userData->numBatches > 0 )
+   {
+      EmitBatch *batch = &userData->batches[userData->firstBatch];
+
+      if ( batch->time + PARTICLE_LIFETIME > userData->time )
+      {
+         break;
+      }
+
+      userData->windowCount -= batch->count;
+      userData->firstBatch = ( userData->firstBatch + 1 ) % MAX_BATCHES;
+      userData->numBatches--;
+   }
+}
+
+///
+// Log the particle counts and CPU waits every REPORT_INTERVAL seconds
+//
+void ReportStats ( UserData *userData )
+{
+   if ( userData->time - userData->reportTime >= REPORT_INTERVAL )
+   {
+      const ESFenceRingStats *stats = esFenceRingGetStats ( userData->frameFences );
+
+      esLogMessage ( "Particles: %u emitted in %.0f s, %u in the live window, "
+                     "CPU waited on %u of %u frames (%.1f ms)\n",
+                     userData->emittedCount, userData->time - userData->reportTime, userData->windowCount,
+                     ( GLuint ) stats->waits, ( GLuint ) stats->acquires, stats->waitNs / 1000000.0 );
+      userData->emittedCount = 0;
+      userData->reportTime = userData->time;
+      esFenceRingResetStats ( userData->frameFences );
+   }
+}
+
+///
+// Write count new particles to the ring starting at slot start
+//
+void EmitRange ( UserData *userData, GLuint start, GLuint count )
+{
+   glBindBufferRange ( GL_TRANSFORM_FEEDBACK_BUFFER, 0, userData->particleVBO,
+                       start * sizeof ( Particle ), count * sizeof ( Particle ) );
+
+   // Decorrelate the random values of particles in different slots
+   glUniform1f ( userData->emitIdOffsetLoc, ( float ) start );
+
+   glBeginTransformFeedback ( GL_POINTS );
+   glDrawArrays ( GL_POINTS, 0, count );
+   glEndTransformFeedback();
 }
 
 void EmitParticles ( ESContext *esContext, float deltaTime )
 {
    UserData *userData = esContext->userData;
-   GLuint srcVBO = userData->particleVBOs[ userData->curSrcIndex ];
-   GLuint dstVBO = userData->particleVBOs[ ( userData->curSrcIndex + 1 ) % 2 ];
+   GLuint count;
+   GLuint first;
 
-   glUseProgram ( userData->emitProgramObject );
+   RetireBatches ( userData );
+
+   // Particles due this frame, as far as the ring has room
+   userData->emitCarry += userData->emissionRate * deltaTime;
+   count = ( GLuint ) userData->emitCarry;
+   userData->emitCarry -= ( float ) count;
+
+   if ( count > userData->capacity - userData->windowCount )
+   {
+      count = userData->capacity - userData->windowCount;
+   }
 
-   SetupVertexAttributes ( esContext, srcVBO );
+   if ( count == 0 )
+   {
+      return;
+   }
 
-   // Set transform feedback buffer
-   glBindBuffer ( GL_TRANSFORM_FEEDBACK_BUFFER, dstVBO );
-   glBindBufferBase ( GL_TRANSFORM_FEEDBACK_BUFFER, 0, dstVBO );
+   glUseProgram ( userData->emitProgramObject );
 
    // Turn off rasterization - we are not drawing
    glEnable ( GL_RASTERIZER_DISCARD );
 
    // Set uniforms
    glUniform1f ( userData->emitTimeLoc, userData->time );
-   glUniform1f ( userData->emitEmissionRateLoc, EMISSION_RATE );
+   glUniform1f ( userData->emitDeltaTimeLoc, deltaTime );
+   glUniform1f ( userData->emitLifetimeLoc, PARTICLE_LIFETIME );
 
    // Bind the 3D noise texture
    glActiveTexture ( GL_TEXTURE0 );
    glBindTexture ( GL_TEXTURE_3D, userData->noiseTextureId );
    glUniform1i ( userData->emitNoiseSamplerLoc, 0 );
 
-   // Emit particles using transform feedback
-   glBeginTransformFeedback ( GL_POINTS );
-   glDrawArrays ( GL_POINTS, 0, NUM_PARTICLES );
-   glEndTransformFeedback();
+   // Emit particles using transform feedback, in two parts when the ring wraps
+   first = userData->capacity - userData->head;
+   first = count < first ? count : first;
+
+   EmitRange ( userData, userData->head, first );
 
-   // Create a sync object to ensure transform feedback results are completed before the draw that uses them.
-   userData->emitSync = glFenceSync ( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+   if ( count > first )
+   {
+      EmitRange ( userData, 0, count - first );
+   }
 
    // Restore state
    glDisable ( GL_RASTERIZER_DISCARD );
    glUseProgram ( 0 );
    glBindBufferBase ( GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0 );
-   glBindBuffer ( GL_ARRAY_BUFFER, 0 );
    glBindTexture ( GL_TEXTURE_3D, 0 );
 
-   // Ping pong the buffers
-   userData->curSrcIndex = ( userData->curSrcIndex + 1 ) % 2;
+   // Add the particles to the live window
+   if ( userData->numBatches == MAX_BATCHES )
+   {
+      // Out of batches, fold into the newest one.  Its time moves forward so
+      // the window keeps all of its particles until they have died.
+      EmitBatch *batch = &userData->batches[( userData->firstBatch + MAX_BATCHES - 1 ) % MAX_BATCHES];
+
+      batch->count += count;
+      batch->time = userData->time;
+   }
+   else
+   {
+      EmitBatch *batch = &userData->batches[( userData->firstBatch + userData->numBatches ) % MAX_BATCHES];
+
+      batch->start = userData->head;
+      batch->count = count;
+      batch->time = userData->time;
+      userData->numBatches++;
+   }
+
+   userData->windowCount += count;
+   userData->emittedCount += count;
+   userData->head = ( userData->head + count ) % userData->capacity;
 }
 
 
@@ -415,6 +553,11 @@ void Update ( ESContext *esContext, float deltaTime )
 
    userData->time += deltaTime;
 
+   // Only blocks when the GPU is still FRAMES_IN_FLIGHT frames behind
+   userData->frameSlot = esFenceRingAcquire ( userData->frameFences, GL_TIMEOUT_IGNORED );
+
+   ReportStats ( userData );
+
    EmitParticles ( esContext, deltaTime );
 }
 
@@ -424,10 +567,8 @@ void Update ( ESContext *esContext, float deltaTime )
 void Draw ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
-
-   // Block the GL server until transform feedback results are completed
-   glWaitSync ( userData->emitSync, 0, GL_TIMEOUT_IGNORED );
-   glDeleteSync ( userData->emitSync );
+   GLuint start;
+   GLuint first;
 
    // Set the viewport
    glViewport ( 0, 0, esContext->width, esContext->height );
@@ -435,11 +576,17 @@ void Draw ( ESContext *esContext )
    // Clear the color buffer
    glClear ( GL_COLOR_BUFFER_BIT );
 
+   if ( userData->windowCount == 0 )
+   {
+      esFenceRingSubmit ( userData->frameFences );
+      return;
+   }
+
    // Use the program object
    glUseProgram ( userData->drawProgramObject );
 
    // Load the VBO and vertex attributes
-   SetupVertexAttributes ( esContext, userData->particleVBOs[ userData->curSrcIndex ] );
+   glBindVertexArray ( userData->drawVAO );
 
    // Set uniforms
    glUniform1f ( userData->drawTimeLoc, userData->time );
@@ -457,7 +604,22 @@ void Draw ( ESContext *esContext )
    // Set the sampler texture unit to 0
    glUniform1i ( userData->samplerLoc, 0 );
 
-   glDrawArrays ( GL_POINTS, 0, NUM_PARTICLES );
+   // Draw only the live window, in two parts when it wraps around the ring
+   start = userData->batches[userData->firstBatch].start;
+   first = userData->capacity - start;
+   first = userData->windowCount < first ? userData->windowCount : first;
+
+   glDrawArrays ( GL_POINTS, start, first );
+
+   if ( userData->windowCount > first )
+   {
+      glDrawArrays ( GL_POINTS, 0, userData->windowCount - first );
+   }
+
+   glBindVertexArray ( 0 );
+
+   // Fence this frame's emit and draw
+   esFenceRingSubmit ( userData->frameFences );
 }
 
 ///
@@ -469,12 +631,16 @@ void ShutDown ( ESContext *esContext )
 
    // Delete texture object
    glDeleteTextures ( 1, &userData->textureId );
+   glDeleteTextures ( 1, &userData->noiseTextureId );
 
    // Delete program object
    glDeleteProgram ( userData->drawProgramObject );
    glDeleteProgram ( userData->emitProgramObject );
 
-   glDeleteBuffers ( 2, &userData->particleVBOs[0] );
+   esFenceRingDestroy ( userData->frameFences );
+
+   glDeleteVertexArrays ( 1, &userData->drawVAO );
+   glDeleteBuffers ( 1, &userData->particleVBO );
 }
 
 
@@ -67,9 +67,15 @@ typedef struct
    GLuint cubePositionVBO;
    GLuint cubeIndicesIBO;
    
-   // Number of indices
+   // Number and type of indices
    int    groundNumIndices;
    int    cubeNumIndices;
+   GLenum groundIndexType;
+   GLenum cubeIndexType;
+
+   // Layout of the vertices, the same for both models
+   ESVertexAttrib position;
+   GLsizei        stride;
 
    // dimension of grid
    int    groundGridSize;
@@ -224,13 +230,23 @@ int InitShadowMap ( ESContext *esContext )
    return TRUE;
 }
 
+///
+// Wait for a program from esLoadProgramAsync that is no longer wanted, and delete it
+//
+void DiscardProgram ( ESProgramAsync *handle )
+{
+   glDeleteProgram ( esWaitProgram ( handle ) );
+}
+
 ///
 // Initialize the shader and program object
 //
 int Init ( ESContext *esContext )
 {
-   GLfloat *positions;
-   GLuint *indices;
+   ESVertexFormat format = { GL_HALF_FLOAT, GL_NONE, GL_NONE };
+   ESMesh mesh;
+   ESProgramAsync *shadowMapProgram;
+   ESProgramAsync *sceneProgram;
 
    UserData *userData = esContext->userData;
    const char vShadowMapShaderStr[] =  
@@ -299,53 +315,60 @@ int Init ( ESContext *esContext )
       "   outColor = v_color * sum;                                   \n"
       "}                                                              \n";
 
-   // Load the shaders and get a linked program object
-   userData->shadowMapProgramObject = esLoadProgram ( vShadowMapShaderStr, fShadowMapShaderStr );
-   userData->sceneProgramObject = esLoadProgram ( vSceneShaderStr, fSceneShaderStr );
+   // Start building both programs; the geometry below is set up while they compile
+   shadowMapProgram = esLoadProgramAsync ( esContext, vShadowMapShaderStr, fShadowMapShaderStr );
+   sceneProgram = esLoadProgramAsync ( esContext, vSceneShaderStr, fSceneShaderStr );
 
-   // Get the uniform locations
-   userData->sceneMvpLoc = glGetUniformLocation ( userData->sceneProgramObject, "u_mvpMatrix" );
-   userData->shadowMapMvpLoc = glGetUniformLocation ( userData->shadowMapProgramObject, "u_mvpMatrix" );
-   userData->sceneMvpLightLoc = glGetUniformLocation ( userData->sceneProgramObject, "u_mvpLightMatrix" );
-   userData->shadowMapMvpLightLoc = glGetUniformLocation ( userData->shadowMapProgramObject, "u_mvpLightMatrix" );
+   // Generate the vertex and index data for the ground; half float positions
+   // and 16-bit indices hold both models exactly
+   userData->groundGridSize = 3;
 
-   // Get the sampler location
-   userData->shadowMapSamplerLoc = glGetUniformLocation ( userData->sceneProgramObject, "s_shadowMap" );
+   if ( !esGenSquareGridMesh ( userData->groundGridSize, &format, &mesh ) )
+   {
+      DiscardProgram ( shadowMapProgram );
+      DiscardProgram ( sceneProgram );
+      return FALSE;
+   }
 
-   // Generate the vertex and index data for the ground
-   userData->groundGridSize = 3;
-   userData->groundNumIndices = esGenSquareGrid( userData->groundGridSize, &positions, &indices );
+   userData->groundNumIndices = mesh.numIndices;
+   userData->groundIndexType = mesh.indexType;
+   userData->position = mesh.position;
+   userData->stride = mesh.stride;
 
    // Index buffer object for the ground model
    glGenBuffers ( 1, &userData->groundIndicesIBO );
    glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->groundIndicesIBO );
-   glBufferData ( GL_ELEMENT_ARRAY_BUFFER, userData->groundNumIndices * sizeof( GLuint ), indices, GL_STATIC_DRAW );
+   glBufferData ( GL_ELEMENT_ARRAY_BUFFER, mesh.numIndices * mesh.indexSize, mesh.indices, GL_STATIC_DRAW );
    glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, 0 );
-   free( indices );
 
    // Position VBO for ground model
    glGenBuffers ( 1, &userData->groundPositionVBO );
    glBindBuffer ( GL_ARRAY_BUFFER, userData->groundPositionVBO );
-   glBufferData ( GL_ARRAY_BUFFER, userData->groundGridSize * userData->groundGridSize * sizeof( GLfloat ) * 3, 
-                  positions, GL_STATIC_DRAW );
-   free( positions );
+   glBufferData ( GL_ARRAY_BUFFER, mesh.numVertices * mesh.stride, mesh.vertices, GL_STATIC_DRAW );
+   esMeshFree ( &mesh );
 
    // Generate the vertex and index date for the cube model
-   userData->cubeNumIndices = esGenCube ( 1.0f, &positions,
-                                          NULL, NULL, &indices );
+   if ( !esGenCubeMesh ( 1.0f, &format, &mesh ) )
+   {
+      DiscardProgram ( shadowMapProgram );
+      DiscardProgram ( sceneProgram );
+      return FALSE;
+   }
+
+   userData->cubeNumIndices = mesh.numIndices;
+   userData->cubeIndexType = mesh.indexType;
 
    // Index buffer object for cube model
    glGenBuffers ( 1, &userData->cubeIndicesIBO );
    glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->cubeIndicesIBO );
-   glBufferData ( GL_ELEMENT_ARRAY_BUFFER, sizeof( GLuint ) * userData->cubeNumIndices, indices, GL_STATIC_DRAW );
+   glBufferData ( GL_ELEMENT_ARRAY_BUFFER, mesh.numIndices * mesh.indexSize, mesh.indices, GL_STATIC_DRAW );
    glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, 0 );
-   free( indices );
 
    // Position VBO for cube model
    glGenBuffers ( 1, &userData->cubePositionVBO );
    glBindBuffer ( GL_ARRAY_BUFFER, userData->cubePositionVBO );
-   glBufferData ( GL_ARRAY_BUFFER, 24 * sizeof( GLfloat ) * 3, positions, GL_STATIC_DRAW );
-   free( positions );
+   glBufferData ( GL_ARRAY_BUFFER, mesh.numVertices * mesh.stride, mesh.vertices, GL_STATIC_DRAW );
+   esMeshFree ( &mesh );
 
    // setup transformation matrices
    userData->eyePosition[0] = -5.0f;
@@ -358,9 +381,24 @@ int Init ( ESContext *esContext )
    // create depth texture
    if ( !InitShadowMap( esContext ) )
    {
+      DiscardProgram ( shadowMapProgram );
+      DiscardProgram ( sceneProgram );
       return FALSE;
    }
 
+   // Collect the linked program objects
+   userData->shadowMapProgramObject = esWaitProgram ( shadowMapProgram );
+   userData->sceneProgramObject = esWaitProgram ( sceneProgram );
+
+   // Get the uniform locations
+   userData->sceneMvpLoc = glGetUniformLocation ( userData->sceneProgramObject, "u_mvpMatrix" );
+   userData->shadowMapMvpLoc = glGetUniformLocation ( userData->shadowMapProgramObject, "u_mvpMatrix" );
+   userData->sceneMvpLightLoc = glGetUniformLocation ( userData->sceneProgramObject, "u_mvpLightMatrix" );
+   userData->shadowMapMvpLightLoc = glGetUniformLocation ( userData->shadowMapProgramObject, "u_mvpLightMatrix" );
+
+   // Get the sampler location
+   userData->shadowMapSamplerLoc = glGetUniformLocation ( userData->sceneProgramObject, "s_shadowMap" );
+
    glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
 
    // disable culling
@@ -384,8 +422,9 @@ void DrawScene ( ESContext *esContext,
    // Draw the ground
    // Load the vertex position
    glBindBuffer ( GL_ARRAY_BUFFER, userData->groundPositionVBO );
-   glVertexAttribPointer ( POSITION_LOC, 3, GL_FLOAT, 
-                           GL_FALSE, 3 * sizeof(GLfloat), (const void*)NULL );
+   glVertexAttribPointer ( POSITION_LOC, userData->position.size, userData->position.type,
+                           userData->position.normalized, userData->stride,
+                           (const void*)(GLintptr)userData->position.offset );
    glEnableVertexAttribArray ( POSITION_LOC );   
 
    // Bind the index buffer
@@ -398,13 +437,14 @@ void DrawScene ( ESContext *esContext,
    // Set the ground color to light gray
    glVertexAttrib4f ( COLOR_LOC, 0.9f, 0.9f, 0.9f, 1.0f );
 
-   glDrawElements ( GL_TRIANGLES, userData->groundNumIndices, GL_UNSIGNED_INT, (const void*)NULL );
+   glDrawElements ( GL_TRIANGLES, userData->groundNumIndices, userData->groundIndexType, (const void*)NULL );
 
    // Draw the cube
    // Load the vertex position
    glBindBuffer( GL_ARRAY_BUFFER, userData->cubePositionVBO );
-   glVertexAttribPointer ( POSITION_LOC, 3, GL_FLOAT, 
-                           GL_FALSE, 3 * sizeof(GLfloat), (const void*)NULL );
+   glVertexAttribPointer ( POSITION_LOC, userData->position.size, userData->position.type,
+                           userData->position.normalized, userData->stride,
+                           (const void*)(GLintptr)userData->position.offset );
    glEnableVertexAttribArray ( POSITION_LOC );   
 
    // Bind the index buffer
@@ -417,7 +457,7 @@ void DrawScene ( ESContext *esContext,
    // Set the cube color to red
    glVertexAttrib4f ( COLOR_LOC, 1.0f, 0.0f, 0.0f, 1.0f );
 
-   glDrawElements ( GL_TRIANGLES, userData->cubeNumIndices, GL_UNSIGNED_INT, (const void*)NULL );
+   glDrawElements ( GL_TRIANGLES, userData->cubeNumIndices, userData->cubeIndexType, (const void*)NULL );
 }
 
 void Draw ( ESContext *esContext )
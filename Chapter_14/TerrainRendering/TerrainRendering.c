@@ -39,6 +39,21 @@
 
 #define POSITION_LOC    0
 
+// Height field samples per side, one per height map texel plus the far edge,
+// and vertices per chunk side
+#define TERRAIN_SIZE    1025
+#define CHUNK_SIZE      33
+
+// Largest error allowed on screen, in pixels
+#define PIXEL_ERROR     4.0f
+
+// Tile file the terrain is streamed from, written from the height map on
+// the first run; delete it to rebuild.  Samples per tile side and layers of
+// the tile texture, 32 x 259 x 259 half floats.
+#define TILE_FILE       "TerrainRendering.tiles"
+#define TILE_SIZE       257
+#define CACHE_TILES     32
+
 typedef struct
 {
    // Handle to a program object
@@ -47,6 +62,8 @@ typedef struct
    // Uniform locations
    GLint  mvpLoc;
    GLint  lightDirectionLoc;
+   GLint  chunkLoc;
+   GLint  tileLoc;
 
    // Sampler location
    GLint samplerLoc;
@@ -54,58 +71,76 @@ typedef struct
    // Texture handle
    GLuint textureId;
 
-   // VBOs
-   GLuint positionVBO;
-   GLuint indicesIBO;
+   // Quadtree of terrain chunks
+   ESTerrain *terrain;
 
-   // Number of indices
-   int    numIndices;
+   // Height map on the CPU, for building the quadtree
+   GLubyte *heights;
+   int    heightsWidth;
+   int    heightsHeight;
 
-   // dimension of grid
-   int    gridSize;
-
-   // MVP matrix
+   // Matrices
+   ESMatrix  modelview;
+   ESMatrix  perspective;
    ESMatrix  mvpMatrix;
 } UserData;
 
 ///
-// Load texture from disk
+// Upload the height map already decoded for the quadtree
 //
-GLuint LoadTexture (  void *ioContext, char *fileName )
+GLuint LoadTexture ( UserData *userData )
 {
-   int width,
-       height;
-
-   char *buffer = esLoadTGA ( ioContext, fileName, &width, &height );
    GLuint texId;
 
-   if ( buffer == NULL )
-   {
-      esLogMessage ( "Error loading (%s) image.\n", fileName );
-      return 0;
-   }
-
    glGenTextures ( 1, &texId );
    glBindTexture ( GL_TEXTURE_2D, texId );
 
-   glTexImage2D ( GL_TEXTURE_2D, 0, GL_ALPHA, width, height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, buffer );
+   glTexImage2D ( GL_TEXTURE_2D, 0, GL_ALPHA, userData->heightsWidth, userData->heightsHeight, 0,
+                  GL_ALPHA, GL_UNSIGNED_BYTE, userData->heights );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 
-   free ( buffer );
-
    return texId;
 }
 
+///
+// Height of a terrain sample, filtered from the height map like the
+// vertex shader's texture lookup
+//
+GLfloat ESCALLBACK TerrainHeight ( void *arg, int x, int y )
+{
+   UserData *userData = arg;
+   float u = ( float ) x / ( TERRAIN_SIZE - 1 ) * userData->heightsWidth - 0.5f;
+   float v = ( float ) y / ( TERRAIN_SIZE - 1 ) * userData->heightsHeight - 0.5f;
+   int x0 = ( int ) floorf ( u );
+   int y0 = ( int ) floorf ( v );
+   float fu = u - x0;
+   float fv = v - y0;
+   int x1 = x0 + 1 < userData->heightsWidth ? x0 + 1 : userData->heightsWidth - 1;
+   int y1 = y0 + 1 < userData->heightsHeight ? y0 + 1 : userData->heightsHeight - 1;
+   const GLubyte *row0, *row1;
+   float h;
+
+   // Clamp to edge
+   x0 = x0 < 0 ? 0 : x0;
+   y0 = y0 < 0 ? 0 : y0;
+   row0 = &userData->heights[y0 * userData->heightsWidth];
+   row1 = &userData->heights[y1 * userData->heightsWidth];
+
+   h = ( row0[x0] * ( 1.0f - fu ) + row0[x1] * fu ) * ( 1.0f - fv ) +
+       ( row1[x0] * ( 1.0f - fu ) + row1[x1] * fu ) * fv;
+
+   // Same scale as the vertex shader
+   return h / 255.0f / 2.5f;
+}
+
 ///
 // Initialize the MVP matrix
 //
 int InitMVP ( ESContext *esContext )
 {
-   ESMatrix perspective;
-   ESMatrix modelview;
    float    aspect;
    UserData *userData = esContext->userData;
 
@@ -113,52 +148,97 @@ int InitMVP ( ESContext *esContext )
    aspect = ( GLfloat ) esContext->width / ( GLfloat ) esContext->height;
 
    // Generate a perspective matrix with a 60 degree FOV
-   esMatrixLoadIdentity ( &perspective );
-   esPerspective ( &perspective, 60.0f, aspect, 0.1f, 20.0f );
+   esMatrixLoadIdentity ( &userData->perspective );
+   esPerspective ( &userData->perspective, 60.0f, aspect, 0.1f, 20.0f );
 
    // Generate a model view matrix to rotate/translate the terrain
-   esMatrixLoadIdentity ( &modelview );
+   esMatrixLoadIdentity ( &userData->modelview );
 
    // Center the terrain
-   esTranslate ( &modelview, -0.5f, -0.5f, -0.7f );
+   esTranslate ( &userData->modelview, -0.5f, -0.5f, -0.7f );
 
    // Rotate
-   esRotate ( &modelview, 45.0f, 1.0, 0.0, 0.0 );
+   esRotate ( &userData->modelview, 45.0f, 1.0, 0.0, 0.0 );
 
    // Compute the final MVP by multiplying the
    // modelview and perspective matrices together
-   esMatrixMultiply ( &userData->mvpMatrix, &modelview, &perspective );
+   esMatrixMultiply ( &userData->mvpMatrix, &userData->modelview, &userData->perspective );
 
    return TRUE;
 }
 
+///
+// Create the terrain, streamed from the tile file if it can be opened or
+// written, otherwise built in memory from the height map
+//
+int InitTerrain ( ESContext *esContext )
+{
+   UserData *userData = esContext->userData;
+   ESThreadPool *pool;
+
+   userData->terrain = esTerrainOpenTiles ( esContext->platformData, TILE_FILE, 1.0f, CACHE_TILES );
+
+   if ( userData->terrain != NULL )
+   {
+      return TRUE;
+   }
+
+   // The quadtree measures its error against the same height map
+   userData->heights = ( GLubyte * ) esLoadTGA ( esContext->platformData, "heightmap.tga",
+                                                &userData->heightsWidth, &userData->heightsHeight );
+
+   if ( userData->heights == NULL )
+   {
+      return FALSE;
+   }
+
+   pool = esThreadPoolCreate ( 0 );
+
+   if ( esTerrainWriteTiles ( pool, TILE_FILE, TERRAIN_SIZE, CHUNK_SIZE, TILE_SIZE, TerrainHeight, userData ) )
+   {
+      userData->terrain = esTerrainOpenTiles ( esContext->platformData, TILE_FILE, 1.0f, CACHE_TILES );
+   }
+
+   if ( userData->terrain == NULL )
+   {
+      esLogMessage ( "Could not stream the terrain from %s, building it in memory\n", TILE_FILE );
+      userData->terrain = esTerrainCreate ( pool, TERRAIN_SIZE, CHUNK_SIZE, 1.0f, TerrainHeight, userData );
+   }
+
+   esThreadPoolDestroy ( pool );
+
+   return userData->terrain != NULL;
+}
+
 ///
 // Initialize the shader and program object
 //
 int Init ( ESContext *esContext )
 {
-   GLfloat *positions;
-   GLuint *indices;
-
    UserData *userData = esContext->userData;
    const char vShaderStr[] =
       "#version 300 es                                      \n"
       "uniform mat4 u_mvpMatrix;                            \n"
       "uniform vec3 u_lightDirection;                       \n"
-      "layout(location = 0) in vec4 a_position;             \n"
+      "uniform vec4 u_chunk;                                \n"
+      "layout(location = 0) in vec2 a_position;             \n"
       "uniform sampler2D s_texture;                         \n"
       "out vec4 v_color;                                    \n"
       "void main()                                          \n"
       "{                                                    \n"
+      "   // height map coordinate of the chunk vertex      \n"
+      "   vec2 uv = ( u_chunk.xy + a_position * u_chunk.z ) \n"
+      "             * u_chunk.w;                            \n"
+      "                                                     \n"
       "   // compute vertex normal from height map          \n"
       "   float hxl = textureOffset( s_texture,             \n"
-      "                  a_position.xy, ivec2(-1,  0) ).w;  \n"
+      "                  uv, ivec2(-1,  0) ).w;             \n"
       "   float hxr = textureOffset( s_texture,             \n"
-      "                  a_position.xy, ivec2( 1,  0) ).w;  \n"
+      "                  uv, ivec2( 1,  0) ).w;             \n"
       "   float hyl = textureOffset( s_texture,             \n"
-      "                  a_position.xy, ivec2( 0, -1) ).w;  \n"
+      "                  uv, ivec2( 0, -1) ).w;             \n"
       "   float hyr = textureOffset( s_texture,             \n"
-      "                  a_position.xy, ivec2( 0,  1) ).w;  \n"
+      "                  uv, ivec2( 0,  1) ).w;             \n"
       "   vec3 u = normalize( vec3(0.05, 0.0, hxr-hxl) );   \n"
       "   vec3 v = normalize( vec3(0.0, 0.05, hyr-hyl) );   \n"
       "   vec3 normal = cross( u, v );                      \n"
@@ -168,10 +248,54 @@ int Init ( ESContext *esContext )
       "   v_color = vec4( vec3(diffuse), 1.0 );             \n"
       "                                                     \n"
       "   // get vertex position from height map            \n"
-      "   float h = texture ( s_texture, a_position.xy ).w; \n"
-      "   vec4 v_position = vec4 ( a_position.xy,           \n"
-      "                            h/2.5,                   \n"
-      "                            a_position.w );          \n"
+      "   float h = texture ( s_texture, uv ).w;            \n"
+      "   vec4 v_position = vec4 ( uv, h/2.5, 1.0 );        \n"
+      "   gl_Position = u_mvpMatrix * v_position;           \n"
+      "}                                                    \n";
+
+   // Streamed terrain: heights come from the chunk's tile, already in
+   // world units, at the chunk's own sample spacing
+   const char vShaderTilesStr[] =
+      "#version 300 es                                      \n"
+      "uniform mat4 u_mvpMatrix;                            \n"
+      "uniform vec3 u_lightDirection;                       \n"
+      "uniform vec4 u_chunk;                                \n"
+      "uniform vec4 u_tile;                                 \n"
+      "layout(location = 0) in vec2 a_position;             \n"
+      "uniform highp sampler2DArray s_texture;              \n"
+      "out vec4 v_color;                                    \n"
+      "void main()                                          \n"
+      "{                                                    \n"
+      "   // height map coordinate of the chunk vertex      \n"
+      "   vec2 uv = ( u_chunk.xy + a_position * u_chunk.z ) \n"
+      "             * u_chunk.w;                            \n"
+      "   ivec3 texel = ivec3( ivec2( u_tile.xy +           \n"
+      "                   a_position ), int( u_tile.z ) );  \n"
+      "                                                     \n"
+      "   // compute vertex normal from the tile, with the  \n"
+      "   // slopes of the 1024 texel height map above      \n"
+      "   float hxl = texelFetch( s_texture,                \n"
+      "                  texel - ivec3(1, 0, 0), 0 ).r;     \n"
+      "   float hxr = texelFetch( s_texture,                \n"
+      "                  texel + ivec3(1, 0, 0), 0 ).r;     \n"
+      "   float hyl = texelFetch( s_texture,                \n"
+      "                  texel - ivec3(0, 1, 0), 0 ).r;     \n"
+      "   float hyr = texelFetch( s_texture,                \n"
+      "                  texel + ivec3(0, 1, 0), 0 ).r;     \n"
+      "   float run = 51.2 * u_chunk.z * u_chunk.w;         \n"
+      "   vec3 u = normalize( vec3(run, 0.0,                \n"
+      "                            2.5 * (hxr-hxl)) );      \n"
+      "   vec3 v = normalize( vec3(0.0, run,                \n"
+      "                            2.5 * (hyr-hyl)) );      \n"
+      "   vec3 normal = cross( u, v );                      \n"
+      "                                                     \n"
+      "   // compute diffuse lighting                       \n"
+      "   float diffuse = dot( normal, u_lightDirection );  \n"
+      "   v_color = vec4( vec3(diffuse), 1.0 );             \n"
+      "                                                     \n"
+      "   // get vertex position from the tile              \n"
+      "   float h = texelFetch( s_texture, texel, 0 ).r;    \n"
+      "   vec4 v_position = vec4 ( uv, h, 1.0 );            \n"
       "   gl_Position = u_mvpMatrix * v_position;           \n"
       "}                                                    \n";
 
@@ -185,59 +309,75 @@ int Init ( ESContext *esContext )
       "  outColor = v_color;                                \n"
       "}                                                    \n";
 
+   if ( !InitTerrain ( esContext ) )
+   {
+      return FALSE;
+   }
+
    // Load the shaders and get a linked program object
-   userData->programObject = esLoadProgram ( vShaderStr, fShaderStr );
+   if ( esTerrainGetTileCache ( userData->terrain ) != NULL )
+   {
+      userData->programObject = esLoadProgram ( vShaderTilesStr, fShaderStr );
+   }
+   else
+   {
+      userData->programObject = esLoadProgram ( vShaderStr, fShaderStr );
+   }
 
    // Get the uniform locations
    userData->mvpLoc = glGetUniformLocation ( userData->programObject, "u_mvpMatrix" );
    userData->lightDirectionLoc = glGetUniformLocation ( userData->programObject,
                                                         "u_lightDirection" );
+   userData->chunkLoc = glGetUniformLocation ( userData->programObject, "u_chunk" );
+   userData->tileLoc = glGetUniformLocation ( userData->programObject, "u_tile" );
 
    // Get the sampler location
    userData->samplerLoc = glGetUniformLocation ( userData->programObject, "s_texture" );
 
-   // Load the heightmap
-   userData->textureId = LoadTexture ( esContext->platformData, "heightmap.tga" );
-
-   if ( userData->textureId == 0 )
+   // A terrain built in memory samples the height map InitTerrain decoded
+   if ( esTerrainGetTileCache ( userData->terrain ) == NULL )
    {
-      return FALSE;
+      userData->textureId = LoadTexture ( userData );
    }
 
-   // Generate the position and indices of a square grid for the base terrain
-   userData->gridSize = 200;
-   userData->numIndices = esGenSquareGrid ( userData->gridSize, &positions, &indices );
-
-   // Index buffer for base terrain
-   glGenBuffers ( 1, &userData->indicesIBO );
-   glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->indicesIBO );
-   glBufferData ( GL_ELEMENT_ARRAY_BUFFER, userData->numIndices * sizeof ( GLuint ),
-                  indices, GL_STATIC_DRAW );
-   glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, 0 );
-   free ( indices );
-
-   // Position VBO for base terrain
-   glGenBuffers ( 1, &userData->positionVBO );
-   glBindBuffer ( GL_ARRAY_BUFFER, userData->positionVBO );
-   glBufferData ( GL_ARRAY_BUFFER,
-                  userData->gridSize * userData->gridSize * sizeof ( GLfloat ) * 3,
-                  positions, GL_STATIC_DRAW );
-   free ( positions );
-
    glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
 
+   // The terrain folds over itself, its triangles are not drawn back to front
+   glEnable ( GL_DEPTH_TEST );
+
    return TRUE;
 }
 
 ///
-// Draw a flat grid
+// Draw the terrain chunks the view needs
 //
 void Draw ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
+   const ESTerrainStats *stats;
 
    InitMVP ( esContext );
 
+   // Pick the chunks for this view
+   esTerrainSelect ( userData->terrain, &userData->modelview, &userData->perspective,
+                     esContext->height, PIXEL_ERROR );
+   stats = esTerrainGetStats ( userData->terrain );
+
+   if ( esContext->frameStats.frameCount == 0 )
+   {
+      esLogMessage ( "Terrain: %d chunks, %d culled, %d triangles, deepest level %d\n",
+                     stats->chunksDrawn, stats->chunksCulled, ( int ) stats->triangles, stats->maxLevel );
+
+      if ( esTerrainGetTileCache ( userData->terrain ) != NULL )
+      {
+         const ESTileCacheStats *tileStats = esTileCacheGetStats ( esTerrainGetTileCache ( userData->terrain ) );
+
+         esLogMessage ( "Tiles: %d of %d resident in %d layers, %d queued, %d chunks waiting for theirs\n",
+                        tileStats->residentTiles, tileStats->tileCount, tileStats->slotCount,
+                        tileStats->queuedTiles, stats->chunksPending );
+      }
+   }
+
    // Set the viewport
    glViewport ( 0, 0, esContext->width, esContext->height );
 
@@ -247,16 +387,7 @@ void Draw ( ESContext *esContext )
    // Use the program object
    glUseProgram ( userData->programObject );
 
-   // Load the vertex position
-   glBindBuffer ( GL_ARRAY_BUFFER, userData->positionVBO );
-   glVertexAttribPointer ( POSITION_LOC, 3, GL_FLOAT,
-                           GL_FALSE, 3 * sizeof ( GLfloat ), ( const void * ) NULL );
-   glEnableVertexAttribArray ( POSITION_LOC );
-
-   // Bind the index buffer
-   glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->indicesIBO );
-
-   // Bind the height map
+   // Bind the height map, a streamed terrain binds its tiles itself
    glActiveTexture ( GL_TEXTURE0 );
    glBindTexture ( GL_TEXTURE_2D, userData->textureId );
 
@@ -269,8 +400,8 @@ void Draw ( ESContext *esContext )
    // Set the height map sampler to texture unit to 0
    glUniform1i ( userData->samplerLoc, 0 );
 
-   // Draw the grid
-   glDrawElements ( GL_TRIANGLES, userData->numIndices, GL_UNSIGNED_INT, ( const void * ) NULL );
+   // Draw the chunks
+   esTerrainDraw ( userData->terrain, POSITION_LOC, userData->chunkLoc, userData->tileLoc );
 }
 
 ///
@@ -280,8 +411,8 @@ void Shutdown ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
-   glDeleteBuffers ( 1, &userData->positionVBO );
-   glDeleteBuffers ( 1, &userData->indicesIBO );
+   esTerrainDestroy ( userData->terrain );
+   free ( userData->heights );
 
    // Delete program object
    glDeleteProgram ( userData->programObject );
@@ -290,7 +421,7 @@ void Shutdown ( ESContext *esContext )
 
 int esMain ( ESContext *esContext )
 {
-   esContext->userData = malloc ( sizeof ( UserData ) );
+   esContext->userData = calloc ( 1, sizeof ( UserData ) );
 
    esCreateWindow ( esContext, "TerrainRendering", 640, 480, ES_WINDOW_RGB | ES_WINDOW_DEPTH );
 
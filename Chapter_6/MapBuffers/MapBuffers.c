@@ -31,7 +31,9 @@
 //
 // MapBuffers.c
 //
-//    This example demonstrates mapping buffer objects
+//    This example demonstrates mapping buffer objects.  The geometry is
+//    written every frame, as dynamic geometry would be, into stream
+//    buffers that are mapped without synchronizing with earlier draws.
 //
 #include "esUtil.h"
 #include <string.h>
@@ -41,8 +43,9 @@ typedef struct
    // Handle to a program object
    GLuint programObject;
 
-   // VertexBufferObject Ids
-   GLuint vboIds[2];
+   // Stream buffers for the vertex attributes and the element indices
+   ESStreamBuffer *vertexStream;
+   ESStreamBuffer *indexStream;
 
 } UserData;
 
@@ -53,6 +56,9 @@ typedef struct
 #define VERTEX_POS_INDX       0
 #define VERTEX_COLOR_INDX     1
 
+// Room for several frames of geometry in each stream buffer
+#define STREAM_BUFFER_SIZE    ( 64 * 1024 )
+
 
 int Init ( ESContext *esContext )
 {
@@ -91,8 +97,18 @@ int Init ( ESContext *esContext )
 
    // Store the program object
    userData->programObject = programObject;
-   userData->vboIds[0] = 0;
-   userData->vboIds[1] = 0;
+   userData->vertexStream = esStreamBufferCreate ( GL_ARRAY_BUFFER, STREAM_BUFFER_SIZE );
+   userData->indexStream = esStreamBufferCreate ( GL_ELEMENT_ARRAY_BUFFER, STREAM_BUFFER_SIZE );
+
+   if ( userData->vertexStream == NULL || userData->indexStream == NULL )
+   {
+      // Shutdown is not called when Init fails, destroy whichever was created
+      esStreamBufferDestroy ( userData->vertexStream );
+      esStreamBufferDestroy ( userData->indexStream );
+      userData->vertexStream = NULL;
+      userData->indexStream = NULL;
+      return GL_FALSE;
+   }
 
    glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
    return GL_TRUE;
@@ -106,86 +122,73 @@ void DrawPrimitiveWithVBOsMapBuffers ( ESContext *esContext,
                                        GLushort *indices )
 {
    UserData *userData = esContext->userData;
-   GLuint   offset = 0;
+   GLintptr vtxOffset;
+   GLintptr idxOffset;
+   GLfloat  *vtxMappedBuf;
+   GLushort *idxMappedBuf;
+
+   // Map the next free part of the vertex stream buffer.  Nothing the GPU is
+   // still reading is in it, so the map does not wait.
+   vtxMappedBuf = ( GLfloat * )
+                  esStreamBufferMap ( userData->vertexStream, vtxStride * numVertices,
+                                      sizeof ( GLfloat ), &vtxOffset );
+
+   if ( vtxMappedBuf == NULL )
+   {
+      esLogMessage ( "Error mapping vertex buffer object." );
+      return;
+   }
 
-   // vboIds[0] - used to store vertex attribute data
-   // vboIds[l] - used to store element indices
-   if ( userData->vboIds[0] == 0 && userData->vboIds[1] == 0 )
+   // Copy the data into the mapped buffer
+   memcpy ( vtxMappedBuf, vtxBuf, vtxStride * numVertices );
+
+   // Unmap the buffer
+   if ( esStreamBufferUnmap ( userData->vertexStream ) == GL_FALSE )
    {
-      GLfloat *vtxMappedBuf;
-      GLushort *idxMappedBuf;
-
-      // Only allocate on the first draw
-      glGenBuffers ( 2, userData->vboIds );
-
-      glBindBuffer ( GL_ARRAY_BUFFER, userData->vboIds[0] );
-      glBufferData ( GL_ARRAY_BUFFER, vtxStride * numVertices,
-                     NULL, GL_STATIC_DRAW );
-
-      vtxMappedBuf = ( GLfloat * )
-                     glMapBufferRange ( GL_ARRAY_BUFFER, 0, vtxStride * numVertices,
-                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
-
-      if ( vtxMappedBuf == NULL )
-      {
-         esLogMessage ( "Error mapping vertex buffer object." );
-         return;
-      }
-
-      // Copy the data into the mapped buffer
-      memcpy ( vtxMappedBuf, vtxBuf, vtxStride * numVertices );
-
-      // Unmap the buffer
-      if ( glUnmapBuffer ( GL_ARRAY_BUFFER ) == GL_FALSE )
-      {
-         esLogMessage ( "Error unmapping array buffer object." );
-         return;
-      }
-
-      // Map the index buffer
-      glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->vboIds[1] );
-      glBufferData ( GL_ELEMENT_ARRAY_BUFFER,
-                     sizeof ( GLushort ) * numIndices,
-                     NULL, GL_STATIC_DRAW );
-      idxMappedBuf = ( GLushort * )
-                     glMapBufferRange ( GL_ELEMENT_ARRAY_BUFFER, 0, sizeof ( GLushort ) * numIndices,
-                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
-
-      if ( idxMappedBuf == NULL )
-      {
-         esLogMessage ( "Error mapping element array buffer object." );
-         return;
-      }
-
-      // Copy the data into the mapped buffer
-      memcpy ( idxMappedBuf, indices, sizeof ( GLushort ) * numIndices );
-
-      // Unmap the buffer
-      if ( glUnmapBuffer ( GL_ELEMENT_ARRAY_BUFFER ) == GL_FALSE )
-      {
-         esLogMessage ( "Error unmapping element array buffer object." );
-         return;
-      }
+      esLogMessage ( "Error unmapping array buffer object." );
+      return;
    }
 
-   glBindBuffer ( GL_ARRAY_BUFFER, userData->vboIds[0] );
-   glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->vboIds[1] );
+   // Map the index buffer
+   idxMappedBuf = ( GLushort * )
+                  esStreamBufferMap ( userData->indexStream, sizeof ( GLushort ) * numIndices,
+                                      sizeof ( GLushort ), &idxOffset );
+
+   if ( idxMappedBuf == NULL )
+   {
+      esLogMessage ( "Error mapping element array buffer object." );
+      return;
+   }
+
+   // Copy the data into the mapped buffer
+   memcpy ( idxMappedBuf, indices, sizeof ( GLushort ) * numIndices );
+
+   // Unmap the buffer
+   if ( esStreamBufferUnmap ( userData->indexStream ) == GL_FALSE )
+   {
+      esLogMessage ( "Error unmapping element array buffer object." );
+      return;
+   }
+
+   glBindBuffer ( GL_ARRAY_BUFFER, esStreamBufferId ( userData->vertexStream ) );
+   glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, esStreamBufferId ( userData->indexStream ) );
 
    glEnableVertexAttribArray ( VERTEX_POS_INDX );
    glEnableVertexAttribArray ( VERTEX_COLOR_INDX );
 
+   // The attributes and indices start at the offsets of this frame's allocations
    glVertexAttribPointer ( VERTEX_POS_INDX, VERTEX_POS_SIZE,
                            GL_FLOAT, GL_FALSE, vtxStride,
-                           ( const void * ) offset );
+                           ( const void * ) vtxOffset );
 
-   offset += VERTEX_POS_SIZE * sizeof ( GLfloat );
+   vtxOffset += VERTEX_POS_SIZE * sizeof ( GLfloat );
    glVertexAttribPointer ( VERTEX_COLOR_INDX,
                            VERTEX_COLOR_SIZE,
                            GL_FLOAT, GL_FALSE, vtxStride,
-                           ( const void * ) offset );
+                           ( const void * ) vtxOffset );
 
    glDrawElements ( GL_TRIANGLES, numIndices, GL_UNSIGNED_SHORT,
-                    0 );
+                    ( const void * ) idxOffset );
 
    glDisableVertexAttribArray ( VERTEX_POS_INDX );
    glDisableVertexAttribArray ( VERTEX_COLOR_INDX );
@@ -218,6 +221,10 @@ void Draw ( ESContext *esContext )
    DrawPrimitiveWithVBOsMapBuffers ( esContext, 3, vertices,
                                      sizeof ( GLfloat ) * ( VERTEX_POS_SIZE + VERTEX_COLOR_SIZE ),
                                      3, indices );
+
+   // Mark this frame's data as in use until the draw has finished
+   esStreamBufferFence ( userData->vertexStream );
+   esStreamBufferFence ( userData->indexStream );
 }
 
 void Shutdown ( ESContext *esContext )
@@ -225,7 +232,8 @@ void Shutdown ( ESContext *esContext )
    UserData *userData = esContext->userData;
 
    glDeleteProgram ( userData->programObject );
-   glDeleteBuffers ( 2, userData->vboIds );
+   esStreamBufferDestroy ( userData->vertexStream );
+   esStreamBufferDestroy ( userData->indexStream );
 }
 
 int esMain ( ESContext *esContext )
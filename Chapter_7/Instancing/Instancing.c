@@ -32,7 +32,10 @@
 // Instancing.c
 //
 //    Demonstrates drawing multiple objects in a single draw call with
-//    geometry instancing
+//    geometry instancing.  Set ES_INSTANCES to draw a different number of
+//    cubes; their transforms are computed across a pool of worker threads.
+//    Each cube streams a position, scale and rotation quaternion rather
+//    than a full MVP, and the vertex shader applies the view projection.
 //
 #include <stdlib.h>
 #include <math.h>
@@ -44,30 +47,100 @@
 #endif
 
 
+// Instances drawn unless ES_INSTANCES says otherwise
 #define NUM_INSTANCES   100
 #define POSITION_LOC    0
 #define COLOR_LOC       1
-#define MVP_LOC         2
+#define TRANSFORM_LOC   2
+#define ROTATION_LOC    3
+
+// Frames of instance data the stream buffer holds
+#define INSTANCE_FRAMES 4
+
+#define PI              3.1415926535897932384626433832795f
+
+// Radius of the sphere around a cube of esGenCube ( 1.0f ), which contains
+// it however it is rotated
+#define CUBE_RADIUS     0.867f
+
+// Degrees a cube turns each second
+#define DEGREES_PER_SEC 40.0f
+
+// What is streamed for each instance that is drawn, 28 bytes against the
+// 68 of an MVP and color
+typedef struct
+{
+   GLfloat  position[3];
+   GLfloat  scale;
+
+   // Unit quaternion, x y z w as normalized shorts
+   GLshort  rotation[4];
+
+   GLubyte  color[4];
+} InstanceData;
 
 typedef struct
 {
    // Handle to a program object
    GLuint programObject;
 
+   // Uniform locations
+   GLint  viewProjLoc;
+
    // VBOs
    GLuint positionVBO;
-   GLuint colorVBO;
-   GLuint mvpVBO;
    GLuint indicesIBO;
 
+   // Instance data is streamed, instanceOffset is where this frame's starts
+   ESStreamBuffer *instanceStream;
+   GLintptr instanceOffset;
+
+   // Workers that compute the instance transforms
+   ESThreadPool *pool;
+
+   int       numInstances;
+
+   // Color of each instance
+   GLubyte ( *colors )[4];
+
+   // Bounding sphere of each instance in eye space, and the instances
+   // inside the view frustum this frame
+   GLfloat  *centerX;
+   GLfloat  *centerY;
+   GLfloat  *centerZ;
+   GLfloat  *radius;
+   GLuint   *visible;
+   int       numVisible;
+
    // Number of indices
    int       numIndices;
 
-   // Rotation angle
-   GLfloat   angle[NUM_INSTANCES];
+   // Size of each cube
+   GLfloat   scale;
+
+   // Rotation angle of each instance at time 0, and the time in seconds
+   // modulo one turn
+   GLfloat  *angle;
+   GLfloat   time;
+
+   // This frame's view projection, and where its instance data goes,
+   // written by the workers in UpdateInstances
+   ESMatrix      perspective;
+   InstanceData *instanceBuf;
 
 } UserData;
 
+///
+// GetInstanceCount()
+//
+static int GetInstanceCount ( void )
+{
+   const char *env = getenv ( "ES_INSTANCES" );
+   int count = env != NULL ? atoi ( env ) : 0;
+
+   return count > 0 ? count : NUM_INSTANCES;
+}
+
 ///
 // Initialize the shader and program object
 //
@@ -75,18 +148,28 @@ int Init ( ESContext *esContext )
 {
    GLfloat *positions;
    GLuint *indices;
+   int numRows;
+   int numColumns;
 
    UserData *userData = esContext->userData;
+
+   // Each vertex is scaled, rotated by the instance's quaternion and
+   // translated, then transformed by the shared view projection
    const char vShaderStr[] =
       "#version 300 es                             \n"
       "layout(location = 0) in vec4 a_position;    \n"
       "layout(location = 1) in vec4 a_color;       \n"
-      "layout(location = 2) in mat4 a_mvpMatrix;   \n"
+      "layout(location = 2) in vec4 a_transform;   \n"
+      "layout(location = 3) in vec4 a_rotation;    \n"
+      "uniform mat4 u_viewProjMatrix;              \n"
       "out vec4 v_color;                           \n"
       "void main()                                 \n"
       "{                                           \n"
-      "   v_color = a_color;                       \n"
-      "   gl_Position = a_mvpMatrix * a_position;  \n"
+      "   vec3 p = a_position.xyz * a_transform.w;                    \n"
+      "   vec3 t = cross ( a_rotation.xyz, p ) + a_rotation.w * p;    \n"
+      "   p += 2.0 * cross ( a_rotation.xyz, t ) + a_transform.xyz;   \n"
+      "   v_color = a_color;                                          \n"
+      "   gl_Position = u_viewProjMatrix * vec4 ( p, 1.0 );           \n"
       "}                                           \n";
 
    const char fShaderStr[] =
@@ -101,9 +184,16 @@ int Init ( ESContext *esContext )
 
    // Load the shaders and get a linked program object
    userData->programObject = esLoadProgram ( vShaderStr, fShaderStr );
+   userData->viewProjLoc = glGetUniformLocation ( userData->programObject, "u_viewProjMatrix" );
+
+   // Cubes are laid out in a square grid, sized to fit it
+   userData->numInstances = GetInstanceCount ( );
+   numRows = ( int ) ceilf ( sqrtf ( ( float ) userData->numInstances ) );
+   numColumns = numRows;
+   userData->scale = 1.0f / numRows;
 
-   // Generate the vertex data
-   userData->numIndices = esGenCube ( 0.1f, &positions,
+   // Generate the vertex data, a unit cube scaled per instance
+   userData->numIndices = esGenCube ( 1.0f, &positions,
                                       NULL, NULL, &indices );
 
    // Index buffer object
@@ -119,39 +209,61 @@ int Init ( ESContext *esContext )
    glBufferData ( GL_ARRAY_BUFFER, 24 * sizeof ( GLfloat ) * 3, positions, GL_STATIC_DRAW );
    free ( positions );
 
-   // Random color for each instance
+   userData->colors = malloc ( userData->numInstances * sizeof ( *userData->colors ) );
+   userData->centerX = malloc ( userData->numInstances * sizeof ( GLfloat ) );
+   userData->centerY = malloc ( userData->numInstances * sizeof ( GLfloat ) );
+   userData->centerZ = malloc ( userData->numInstances * sizeof ( GLfloat ) );
+   userData->radius = malloc ( userData->numInstances * sizeof ( GLfloat ) );
+   userData->visible = malloc ( userData->numInstances * sizeof ( GLuint ) );
+   userData->angle = malloc ( userData->numInstances * sizeof ( GLfloat ) );
+
+   if ( userData->colors == NULL || userData->centerX == NULL || userData->centerY == NULL ||
+        userData->centerZ == NULL || userData->radius == NULL || userData->visible == NULL ||
+        userData->angle == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   // A NULL pool computes the transforms on this thread
+   userData->pool = esThreadPoolCreate ( 0 );
+
+   // Random color for each instance, streamed with the visible instances' transforms
    {
-      GLubyte colors[NUM_INSTANCES][4];
       int instance;
 
       srandom ( 0 );
 
-      for ( instance = 0; instance < NUM_INSTANCES; instance++ )
+      for ( instance = 0; instance < userData->numInstances; instance++ )
       {
-         colors[instance][0] = random() % 255;
-         colors[instance][1] = random() % 255;
-         colors[instance][2] = random() % 255;
-         colors[instance][3] = 0;
+         userData->colors[instance][0] = random() % 255;
+         userData->colors[instance][1] = random() % 255;
+         userData->colors[instance][2] = random() % 255;
+         userData->colors[instance][3] = 0;
       }
-
-      glGenBuffers ( 1, &userData->colorVBO );
-      glBindBuffer ( GL_ARRAY_BUFFER, userData->colorVBO );
-      glBufferData ( GL_ARRAY_BUFFER, NUM_INSTANCES * 4, colors, GL_STATIC_DRAW );
    }
 
-   // Allocate storage to store MVP per instance
+   // Allocate storage to store the instance data
    {
       int instance;
 
-      // Random angle for each instance, compute the MVP later
-      for ( instance = 0; instance < NUM_INSTANCES; instance++ )
+      // Random angle for each instance, compute the transforms later
+      for ( instance = 0; instance < userData->numInstances; instance++ )
       {
          userData->angle[instance] = ( float ) ( random() % 32768 ) / 32767.0f * 360.0f;
+
+         // The cubes only rotate about their centers, so their bounds stay put
+         userData->centerX[instance] = ( ( float ) ( instance % numRows ) / ( float ) numRows ) * 2.0f - 1.0f;
+         userData->centerY[instance] = ( ( float ) ( instance / numColumns ) / ( float ) numColumns ) * 2.0f - 1.0f;
+         userData->centerZ[instance] = -2.0f;
+         userData->radius[instance] = CUBE_RADIUS * userData->scale;
       }
 
-      glGenBuffers ( 1, &userData->mvpVBO );
-      glBindBuffer ( GL_ARRAY_BUFFER, userData->mvpVBO );
-      glBufferData ( GL_ARRAY_BUFFER, NUM_INSTANCES * sizeof ( ESMatrix ), NULL, GL_DYNAMIC_DRAW );
+      userData->instanceStream = esStreamBufferCreate ( GL_ARRAY_BUFFER, INSTANCE_FRAMES * userData->numInstances * sizeof ( InstanceData ) );
+
+      if ( userData->instanceStream == NULL )
+      {
+         return GL_FALSE;
+      }
    }
    glBindBuffer ( GL_ARRAY_BUFFER, 0 );
 
@@ -161,62 +273,105 @@ int Init ( ESContext *esContext )
 
 
 ///
-// Update MVP matrix based on time
+// PackSnorm16()
+//
+static GLshort PackSnorm16 ( GLfloat value )
+{
+   return ( GLshort ) floorf ( value * 32767.0f + 0.5f );
+}
+
+///
+// UpdateInstances()
+//
+//    Compute the transform of the visible instances in [begin, end).  Runs
+//    on the worker threads, each writing its own range of the mapped buffer.
+//
+static void ESCALLBACK UpdateInstances ( void *arg, int begin, int end )
+{
+   UserData *userData = ( UserData * ) arg;
+   InstanceData *instanceBuf = userData->instanceBuf;
+   int i;
+
+   // Each instance rotates about the ( 1, 0, 1 ) axis by its own angle, in
+   // the same sense as esRotate, the opposite way to a right-handed turn
+   for ( i = begin; i < end; i++ )
+   {
+      int instance = userData->visible[i];
+      GLfloat angle = userData->angle[instance] + userData->time * DEGREES_PER_SEC;
+      GLfloat sinHalf = -sinf ( angle * PI / 360.0f ) * 0.70710678f;
+      GLfloat cosHalf = cosf ( angle * PI / 360.0f );
+
+      instanceBuf[i].position[0] = userData->centerX[instance];
+      instanceBuf[i].position[1] = userData->centerY[instance];
+      instanceBuf[i].position[2] = userData->centerZ[instance];
+      instanceBuf[i].scale = userData->scale;
+
+      instanceBuf[i].rotation[0] = PackSnorm16 ( sinHalf );
+      instanceBuf[i].rotation[1] = 0;
+      instanceBuf[i].rotation[2] = PackSnorm16 ( sinHalf );
+      instanceBuf[i].rotation[3] = PackSnorm16 ( cosHalf );
+
+      instanceBuf[i].color[0] = userData->colors[instance][0];
+      instanceBuf[i].color[1] = userData->colors[instance][1];
+      instanceBuf[i].color[2] = userData->colors[instance][2];
+      instanceBuf[i].color[3] = userData->colors[instance][3];
+   }
+}
+
+///
+// Update the instance transforms based on time
 //
 void Update ( ESContext *esContext, float deltaTime )
 {
    UserData *userData = ( UserData * ) esContext->userData;
-   ESMatrix *matrixBuf;
-   ESMatrix perspective;
+   ESFrustumPlanes frustum;
+   ESSphereArrays bounds;
    float    aspect;
-   int      instance = 0;
-   int      numRows;
-   int      numColumns;
 
 
    // Compute the window aspect ratio
    aspect = ( GLfloat ) esContext->width / ( GLfloat ) esContext->height;
 
    // Generate a perspective matrix with a 60 degree FOV
-   esMatrixLoadIdentity ( &perspective );
-   esPerspective ( &perspective, 60.0f, aspect, 1.0f, 20.0f );
+   esMatrixLoadIdentity ( &userData->perspective );
+   esPerspective ( &userData->perspective, 60.0f, aspect, 1.0f, 20.0f );
 
-   glBindBuffer ( GL_ARRAY_BUFFER, userData->mvpVBO );
-   matrixBuf = ( ESMatrix * ) glMapBufferRange ( GL_ARRAY_BUFFER, 0, sizeof ( ESMatrix ) * NUM_INSTANCES, GL_MAP_WRITE_BIT );
+   // Time to rotate the cubes by, kept within one turn
+   userData->time += deltaTime;
 
-   // Compute a per-instance MVP that translates and rotates each instance differnetly
-   numRows = ( int ) sqrtf ( NUM_INSTANCES );
-   numColumns = numRows;
-
-   for ( instance = 0; instance < NUM_INSTANCES; instance++ )
+   if ( userData->time >= 360.0f / DEGREES_PER_SEC )
    {
-      ESMatrix modelview;
-      float translateX = ( ( float ) ( instance % numRows ) / ( float ) numRows ) * 2.0f - 1.0f;
-      float translateY = ( ( float ) ( instance / numColumns ) / ( float ) numColumns ) * 2.0f - 1.0f;
-
-      // Generate a model view matrix to rotate/translate the cube
-      esMatrixLoadIdentity ( &modelview );
-
-      // Per-instance translation
-      esTranslate ( &modelview, translateX, translateY, -2.0f );
+      userData->time -= 360.0f / DEGREES_PER_SEC;
+   }
 
-      // Compute a rotation angle based on time to rotate the cube
-      userData->angle[instance] += ( deltaTime * 40.0f );
+   // Only the cubes whose bounds reach into the view are drawn
+   esExtractFrustumPlanes ( &frustum, &userData->perspective );
+   bounds.x = userData->centerX;
+   bounds.y = userData->centerY;
+   bounds.z = userData->centerZ;
+   bounds.radius = userData->radius;
+   userData->numVisible = esCullSpheres ( userData->pool, &frustum, &bounds, userData->numInstances, userData->visible );
 
-      if ( userData->angle[instance] >= 360.0f )
-      {
-         userData->angle[instance] -= 360.0f;
-      }
+   if ( userData->numVisible == 0 )
+   {
+      return;
+   }
 
-      // Rotate the cube
-      esRotate ( &modelview, userData->angle[instance], 1.0, 0.0, 1.0 );
+   // Write to a part of the stream buffer the GPU is not reading, so the map does not wait
+   userData->instanceBuf = ( InstanceData * ) esStreamBufferMap ( userData->instanceStream, sizeof ( InstanceData ) * userData->numVisible,
+                                                                  sizeof ( GLfloat ), &userData->instanceOffset );
 
-      // Compute the final MVP by multiplying the
-      // modevleiw and perspective matrices together
-      esMatrixMultiply ( &matrixBuf[instance], &modelview, &perspective );
+   if ( userData->instanceBuf == NULL )
+   {
+      userData->numVisible = 0;
+      return;
    }
 
-   glUnmapBuffer ( GL_ARRAY_BUFFER );
+   // The workers fill the mapped range directly
+   esParallelFor ( userData->pool, userData->numVisible, UpdateInstances, userData );
+
+   esStreamBufferUnmap ( userData->instanceStream );
+   userData->instanceBuf = NULL;
 }
 
 ///
@@ -241,38 +396,36 @@ void Draw ( ESContext *esContext )
                            GL_FALSE, 3 * sizeof ( GLfloat ), ( const void * ) NULL );
    glEnableVertexAttribArray ( POSITION_LOC );
 
-   // Load the instance color buffer
-   glBindBuffer ( GL_ARRAY_BUFFER, userData->colorVBO );
-   glVertexAttribPointer ( COLOR_LOC, 4, GL_UNSIGNED_BYTE,
-                           GL_TRUE, 4 * sizeof ( GLubyte ), ( const void * ) NULL );
+   // Load this frame's part of the instance stream buffer
+   glBindBuffer ( GL_ARRAY_BUFFER, esStreamBufferId ( userData->instanceStream ) );
+
+   // Load the instance position and scale, rotation and color
+   glVertexAttribPointer ( TRANSFORM_LOC, 4, GL_FLOAT, GL_FALSE, sizeof ( InstanceData ),
+                           ( const void * ) ( userData->instanceOffset ) );
+   glVertexAttribPointer ( ROTATION_LOC, 4, GL_SHORT, GL_TRUE, sizeof ( InstanceData ),
+                           ( const void * ) ( userData->instanceOffset + sizeof ( GLfloat ) * 4 ) );
+   glVertexAttribPointer ( COLOR_LOC, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof ( InstanceData ),
+                           ( const void * ) ( userData->instanceOffset + sizeof ( GLfloat ) * 4 + sizeof ( GLshort ) * 4 ) );
+   glEnableVertexAttribArray ( TRANSFORM_LOC );
+   glEnableVertexAttribArray ( ROTATION_LOC );
    glEnableVertexAttribArray ( COLOR_LOC );
-   glVertexAttribDivisor ( COLOR_LOC, 1 ); // One color per instance
-
 
-   // Load the instance MVP buffer
-   glBindBuffer ( GL_ARRAY_BUFFER, userData->mvpVBO );
+   // One of each per instance
+   glVertexAttribDivisor ( TRANSFORM_LOC, 1 );
+   glVertexAttribDivisor ( ROTATION_LOC, 1 );
+   glVertexAttribDivisor ( COLOR_LOC, 1 );
 
-   // Load each matrix row of the MVP.  Each row gets an increasing attribute location.
-   glVertexAttribPointer ( MVP_LOC + 0, 4, GL_FLOAT, GL_FALSE, sizeof ( ESMatrix ), ( const void * ) NULL );
-   glVertexAttribPointer ( MVP_LOC + 1, 4, GL_FLOAT, GL_FALSE, sizeof ( ESMatrix ), ( const void * ) ( sizeof ( GLfloat ) * 4 ) );
-   glVertexAttribPointer ( MVP_LOC + 2, 4, GL_FLOAT, GL_FALSE, sizeof ( ESMatrix ), ( const void * ) ( sizeof ( GLfloat ) * 8 ) );
-   glVertexAttribPointer ( MVP_LOC + 3, 4, GL_FLOAT, GL_FALSE, sizeof ( ESMatrix ), ( const void * ) ( sizeof ( GLfloat ) * 12 ) );
-   glEnableVertexAttribArray ( MVP_LOC + 0 );
-   glEnableVertexAttribArray ( MVP_LOC + 1 );
-   glEnableVertexAttribArray ( MVP_LOC + 2 );
-   glEnableVertexAttribArray ( MVP_LOC + 3 );
-
-   // One MVP per instance
-   glVertexAttribDivisor ( MVP_LOC + 0, 1 );
-   glVertexAttribDivisor ( MVP_LOC + 1, 1 );
-   glVertexAttribDivisor ( MVP_LOC + 2, 1 );
-   glVertexAttribDivisor ( MVP_LOC + 3, 1 );
+   // The view projection is shared by every instance
+   glUniformMatrix4fv ( userData->viewProjLoc, 1, GL_FALSE, ( GLfloat * ) &userData->perspective.m[0][0] );
 
    // Bind the index buffer
    glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, userData->indicesIBO );
 
    // Draw the cubes
-   glDrawElementsInstanced ( GL_TRIANGLES, userData->numIndices, GL_UNSIGNED_INT, ( const void * ) NULL, NUM_INSTANCES );
+   glDrawElementsInstanced ( GL_TRIANGLES, userData->numIndices, GL_UNSIGNED_INT, ( const void * ) NULL, userData->numVisible );
+
+   // Keep this frame's instance data until the draw has finished with it
+   esStreamBufferFence ( userData->instanceStream );
 }
 
 ///
@@ -283,18 +436,27 @@ void Shutdown ( ESContext *esContext )
    UserData *userData = esContext->userData;
 
    glDeleteBuffers ( 1, &userData->positionVBO );
-   glDeleteBuffers ( 1, &userData->colorVBO );
-   glDeleteBuffers ( 1, &userData->mvpVBO );
+   esStreamBufferDestroy ( userData->instanceStream );
    glDeleteBuffers ( 1, &userData->indicesIBO );
 
    // Delete program object
    glDeleteProgram ( userData->programObject );
+
+   esThreadPoolDestroy ( userData->pool );
+
+   free ( userData->colors );
+   free ( userData->centerX );
+   free ( userData->centerY );
+   free ( userData->centerZ );
+   free ( userData->radius );
+   free ( userData->visible );
+   free ( userData->angle );
 }
 
 
 int esMain ( ESContext *esContext )
 {
-   esContext->userData = malloc ( sizeof ( UserData ) );
+   esContext->userData = calloc ( 1, sizeof ( UserData ) );
 
    esCreateWindow ( esContext, "Instancing", 640, 480, ES_WINDOW_RGB | ES_WINDOW_DEPTH );
 
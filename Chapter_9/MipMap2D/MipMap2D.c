@@ -51,91 +51,22 @@ typedef struct
    // Texture handle
    GLuint textureId;
 
-} UserData;
-
-
-///
-//  From an RGB8 source image, generate the next level mipmap
-//
-GLboolean GenMipMap2D ( GLubyte *src, GLubyte **dst, int srcWidth, int srcHeight, int *dstWidth, int *dstHeight )
-{
-   int x,
-       y;
-   int texelSize = 3;
-
-   *dstWidth = srcWidth / 2;
-
-   if ( *dstWidth <= 0 )
-   {
-      *dstWidth = 1;
-   }
-
-   *dstHeight = srcHeight / 2;
-
-   if ( *dstHeight <= 0 )
-   {
-      *dstHeight = 1;
-   }
-
-   *dst = malloc ( sizeof ( GLubyte ) * texelSize * ( *dstWidth ) * ( *dstHeight ) );
-
-   if ( *dst == NULL )
-   {
-      return GL_FALSE;
-   }
-
-   for ( y = 0; y < *dstHeight; y++ )
-   {
-      for ( x = 0; x < *dstWidth; x++ )
-      {
-         int srcIndex[4];
-         float r = 0.0f,
-               g = 0.0f,
-               b = 0.0f;
-         int sample;
-
-         // Compute the offsets for 2x2 grid of pixels in previous
-         // image to perform box filter
-         srcIndex[0] =
-            ( ( ( y * 2 ) * srcWidth ) + ( x * 2 ) ) * texelSize;
-         srcIndex[1] =
-            ( ( ( y * 2 ) * srcWidth ) + ( x * 2 + 1 ) ) * texelSize;
-         srcIndex[2] =
-            ( ( ( ( y * 2 ) + 1 ) * srcWidth ) + ( x * 2 ) ) * texelSize;
-         srcIndex[3] =
-            ( ( ( ( y * 2 ) + 1 ) * srcWidth ) + ( x * 2 + 1 ) ) * texelSize;
-
-         // Sum all pixels
-         for ( sample = 0; sample < 4; sample++ )
-         {
-            r += src[srcIndex[sample]];
-            g += src[srcIndex[sample] + 1];
-            b += src[srcIndex[sample] + 2];
-         }
+   // Nearest and trilinear samplers
+   ESSamplerCache *samplerCache;
+   GLuint nearestSampler;
+   GLuint trilinearSampler;
 
-         // Average results
-         r /= 4.0;
-         g /= 4.0;
-         b /= 4.0;
+} UserData;
 
-         // Store resulting pixels
-         ( *dst ) [ ( y * ( *dstWidth ) + x ) * texelSize ] = ( GLubyte ) ( r );
-         ( *dst ) [ ( y * ( *dstWidth ) + x ) * texelSize + 1] = ( GLubyte ) ( g );
-         ( *dst ) [ ( y * ( *dstWidth ) + x ) * texelSize + 2] = ( GLubyte ) ( b );
-      }
-   }
-
-   return GL_TRUE;
-}
 
 ///
 //  Generate an RGB8 checkerboard image
 //
-GLubyte *GenCheckImage ( int width, int height, int checkSize )
+GLubyte *GenCheckImage ( ESArena *arena, int width, int height, int checkSize )
 {
    int x,
        y;
-   GLubyte *pixels = malloc ( width * height * 3 );
+   GLubyte *pixels = esArenaAlloc ( arena, width * height * 3 );
 
    if ( pixels == NULL )
    {
@@ -176,58 +107,42 @@ GLuint CreateMipMappedTexture2D( )
    GLuint textureId;
    int    width = 256,
           height = 256;
-   int    level;
    GLubyte *pixels;
-   GLubyte *prevImage;
-   GLubyte *newImage;
+   ESMipChain chain;
+   const ESArenaStats *stats;
 
-   pixels = GenCheckImage ( width, height, 8 );
+   // All levels come from one arena, released together once uploaded
+   ESArena *arena = esArenaCreate ( 0 );
 
-   if ( pixels == NULL )
+   if ( arena == NULL )
    {
       return 0;
    }
 
+   pixels = GenCheckImage ( arena, width, height, 8 );
+
+   // Generate the mipmap levels down to 1x1
+   if ( pixels == NULL ||
+        !esGenMipChain ( arena, NULL, pixels, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0, &chain ) )
+   {
+      esArenaDestroy ( arena );
+      return 0;
+   }
+
    // Generate a texture object
    glGenTextures ( 1, &textureId );
 
    // Bind the texture object
    glBindTexture ( GL_TEXTURE_2D, textureId );
 
-   // Load mipmap level 0
-   glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGB, width, height,
-                  0, GL_RGB, GL_UNSIGNED_BYTE, pixels );
-
-   level = 1;
-   prevImage = &pixels[0];
+   // Load all mipmap levels
+   esUploadMipChain ( &chain, GL_TEXTURE_2D, GL_RGB );
 
-   while ( width > 1 && height > 1 )
-   {
-      int newWidth,
-          newHeight;
-
-      // Generate the next mipmap level
-      GenMipMap2D ( prevImage, &newImage, width, height,
-                    &newWidth, &newHeight );
-
-      // Load the mipmap level
-      glTexImage2D ( GL_TEXTURE_2D, level, GL_RGB,
-                     newWidth, newHeight, 0, GL_RGB,
-                     GL_UNSIGNED_BYTE, newImage );
-
-      // Free the previous image
-      free ( prevImage );
-
-      // Set the previous image for the next iteration
-      prevImage = newImage;
-      level++;
-
-      // Half the width and height
-      width = newWidth;
-      height = newHeight;
-   }
+   stats = esArenaGetStats ( arena );
+   esLogMessage ( "Mipmap arena: %d allocations, %d KB peak in %d block(s)\n",
+                  ( int ) stats->allocations, ( int ) ( stats->peakBytesInUse / 1024 ), stats->blocks );
 
-   free ( newImage );
+   esArenaDestroy ( arena );
 
    // Set the filtering mode
    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST );
@@ -244,6 +159,7 @@ GLuint CreateMipMappedTexture2D( )
 int Init ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
+   ESSamplerDesc desc;
    char vShaderStr[] =
       "#version 300 es                            \n"
       "uniform float u_offset;                    \n"
@@ -280,6 +196,21 @@ int Init ( ESContext *esContext )
    // Load the texture
    userData->textureId = CreateMipMappedTexture2D ();
 
+   // Sample with sampler objects rather than changing the texture's filter between draws
+   userData->samplerCache = esSamplerCacheCreate ();
+
+   if ( userData->samplerCache == NULL )
+   {
+      return FALSE;
+   }
+
+   esSamplerDescInit ( &desc );
+   desc.minFilter = GL_NEAREST;
+   userData->nearestSampler = esGetSampler ( userData->samplerCache, &desc );
+
+   desc.minFilter = GL_LINEAR_MIPMAP_LINEAR;
+   userData->trilinearSampler = esGetSampler ( userData->samplerCache, &desc );
+
    glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
    return TRUE;
 }
@@ -328,12 +259,12 @@ void Draw ( ESContext *esContext )
    glUniform1i ( userData->samplerLoc, 0 );
 
    // Draw quad with nearest sampling
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+   glBindSampler ( 0, userData->nearestSampler );
    glUniform1f ( userData->offsetLoc, -0.6f );
    glDrawElements ( GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices );
 
    // Draw quad with trilinear filtering
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+   glBindSampler ( 0, userData->trilinearSampler );
    glUniform1f ( userData->offsetLoc, 0.6f );
    glDrawElements ( GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices );
 }
@@ -345,8 +276,9 @@ void ShutDown ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
-   // Delete texture object
+   // Delete texture and sampler objects
    glDeleteTextures ( 1, &userData->textureId );
+   esSamplerCacheDestroy ( userData->samplerCache );
 
    // Delete program object
    glDeleteProgram ( userData->programObject );
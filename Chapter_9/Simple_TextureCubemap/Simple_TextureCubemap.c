@@ -36,6 +36,9 @@
 #include <stdlib.h>
 #include "esUtil.h"
 
+// Slices of the sphere, esGenSphere makes half as many parallels
+#define NUM_SLICES   20
+
 typedef struct
 {
    // Handle to a program object
@@ -117,6 +120,40 @@ GLuint CreateSimpleTextureCubemap( )
 }
 
 
+///
+// Reorder the sphere's triangles for the post-transform vertex cache and
+// its vertices for fetch locality
+//
+int OptimizeSphere ( UserData *userData, int numVertices )
+{
+   ESMeshCacheStats before, after;
+   GLuint *remap = malloc ( sizeof ( GLuint ) * numVertices );
+   int result = FALSE;
+
+   if ( remap != NULL &&
+        esMeshAnalyzeVertexCache ( userData->indices, userData->numIndices, numVertices, 16, &before ) &&
+        esMeshOptimizeVertexCache ( userData->indices, userData->numIndices, numVertices ) &&
+        esMeshOptimizeOverdraw ( userData->indices, userData->numIndices, userData->vertices, 0,
+                                 numVertices, 16, 1.05f ) )
+   {
+      esMeshOptimizeVertexFetch ( userData->indices, userData->numIndices, numVertices, remap );
+
+      result = esMeshRemapVertices ( userData->vertices, numVertices, 3 * sizeof ( GLfloat ), remap ) &&
+               esMeshRemapVertices ( userData->normals, numVertices, 3 * sizeof ( GLfloat ), remap ) &&
+               esMeshAnalyzeVertexCache ( userData->indices, userData->numIndices, numVertices, 16, &after );
+
+      if ( result )
+      {
+         esLogMessage ( "Sphere ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+                        before.acmr, after.acmr, before.atvr, after.atvr );
+      }
+   }
+
+   free ( remap );
+
+   return result;
+}
+
 ///
 // Initialize the shader and program object
 //
@@ -155,9 +192,14 @@ int Init ( ESContext *esContext )
    userData->textureId = CreateSimpleTextureCubemap ();
 
    // Generate the vertex data
-   userData->numIndices = esGenSphere ( 20, 0.75f, &userData->vertices, &userData->normals,
+   userData->numIndices = esGenSphere ( NUM_SLICES, 0.75f, &userData->vertices, &userData->normals,
                                         NULL, &userData->indices );
 
+   // Reorder it for the vertex cache and fetch
+   if ( !OptimizeSphere ( userData, ( NUM_SLICES / 2 + 1 ) * ( NUM_SLICES + 1 ) ) )
+   {
+      return FALSE;
+   }
 
    glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
    return TRUE;
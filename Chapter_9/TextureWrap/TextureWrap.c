@@ -51,6 +51,10 @@ typedef struct
    // Texture handle
    GLuint textureId;
 
+   // Repeat, clamp to edge and mirrored repeat samplers
+   ESSamplerCache *samplerCache;
+   GLuint samplers[3];
+
 } UserData;
 
 ///
@@ -135,6 +139,9 @@ GLuint CreateTexture2D( )
 int Init ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
+   const GLenum wrapModes[3] = { GL_REPEAT, GL_CLAMP_TO_EDGE, GL_MIRRORED_REPEAT };
+   ESSamplerDesc desc;
+   int i;
    char vShaderStr[] =
       "#version 300 es                            \n"
       "uniform float u_offset;                    \n"
@@ -171,6 +178,25 @@ int Init ( ESContext *esContext )
    // Load the texture
    userData->textureId = CreateTexture2D ();
 
+   // One sampler per wrap mode, so drawing never changes the texture
+   userData->samplerCache = esSamplerCacheCreate ();
+
+   if ( userData->samplerCache == NULL )
+   {
+      return FALSE;
+   }
+
+   esSamplerDescInit ( &desc );
+   desc.minFilter = GL_LINEAR;
+   desc.magFilter = GL_LINEAR;
+
+   for ( i = 0; i < 3; i++ )
+   {
+      desc.wrapS = wrapModes[i];
+      desc.wrapT = wrapModes[i];
+      userData->samplers[i] = esGetSampler ( userData->samplerCache, &desc );
+   }
+
    glClearColor ( 1.0f, 1.0f, 1.0f, 0.0f );
    return TRUE;
 }
@@ -219,20 +245,17 @@ void Draw ( ESContext *esContext )
    glUniform1i ( userData->samplerLoc, 0 );
 
    // Draw quad with repeat wrap mode
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT );
+   glBindSampler ( 0, userData->samplers[0] );
    glUniform1f ( userData->offsetLoc, -0.7f );
    glDrawElements ( GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices );
 
    // Draw quad with clamp to edge wrap mode
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+   glBindSampler ( 0, userData->samplers[1] );
    glUniform1f ( userData->offsetLoc, 0.0f );
    glDrawElements ( GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices );
 
    // Draw quad with mirrored repeat
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT );
-   glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT );
+   glBindSampler ( 0, userData->samplers[2] );
    glUniform1f ( userData->offsetLoc, 0.7f );
    glDrawElements ( GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, indices );
 }
@@ -244,8 +267,9 @@ void ShutDown ( ESContext *esContext )
 {
    UserData *userData = esContext->userData;
 
-   // Delete texture object
+   // Delete texture and sampler objects
    glDeleteTextures ( 1, &userData->textureId );
+   esSamplerCacheDestroy ( userData->samplerCache );
 
    // Delete program object
    glDeleteProgram ( userData->programObject );
@@ -78,6 +78,23 @@ extern "C" {
 #define ES_WINDOW_STENCIL       4
 /// esCreateWindow flat - multi-sample buffer
 #define ES_WINDOW_MULTISAMPLE   8
+/// esCreateWindow flag - render offscreen to a pbuffer, no native window
+#define ES_WINDOW_HEADLESS      16
+
+
+/// log2 of the number of linear sub-buckets per power of two in an ESHistogram (~3% resolution)
+#define ES_HISTOGRAM_SUB_BITS   5
+/// Number of buckets in an ESHistogram, covering 0 ns to 2^32 ns
+#define ES_HISTOGRAM_BUCKETS    ( ( 32 - ES_HISTOGRAM_SUB_BITS + 1 ) << ES_HISTOGRAM_SUB_BITS )
+/// Number of most recent samples an ESHistogram keeps
+#define ES_HISTOGRAM_WINDOW     1024
+
+/// Most levels an ESMipChain can have, enough for a 32768x32768 image
+#define ES_MAX_MIP_LEVELS       16
+/// esGenMipChain flags: Kaiser windowed sinc instead of a box filter
+#define ES_MIP_KAISER           1
+/// esGenMipChain flags: 8-bit color is sRGB encoded, filter it in linear light
+#define ES_MIP_SRGB             2
 
 
 ///
@@ -95,6 +112,400 @@ typedef struct
    GLfloat   m[4][4];
 } ESMatrix;
 
+///
+/// Rolling log-linear (HDR-style) histogram of durations in nanoseconds.  Only the
+/// last ES_HISTOGRAM_WINDOW samples are counted; older samples drop out as new ones arrive.
+///
+typedef struct
+{
+   /// Samples per bucket over the current window
+   GLuint      counts[ES_HISTOGRAM_BUCKETS];
+
+   /// Ring of the raw samples in the current window
+   GLuint      samples[ES_HISTOGRAM_WINDOW];
+
+   /// Number of samples in the window and next ring slot
+   GLuint      count;
+   GLuint      next;
+
+   /// Sum of the samples in the window
+   GLuint64    sum;
+
+   /// Most recent sample and largest sample ever recorded
+   GLuint      last;
+   GLuint      max;
+} ESHistogram;
+
+///
+/// Per-frame timing collected by the platform main loop
+///
+typedef struct
+{
+   /// Time spent in the update callback
+   ESHistogram update;
+
+   /// Time spent in the draw callback
+   ESHistogram draw;
+
+   /// Time spent in eglSwapBuffers
+   ESHistogram swap;
+
+   /// Time from the start of one frame to the start of the next
+   ESHistogram frame;
+
+   /// Number of frames rendered
+   GLuint64    frameCount;
+
+   /// esGetTimeNs() at the start of the previous frame
+   GLuint64    lastFrameStart;
+} ESFrameStats;
+
+///
+/// Image returned by esLoadTGAImage.  Rows are stored bottom-up, as glTexImage2D expects, and
+/// channels keep the file's order (grey, BGR or BGRA).  pixels may point straight into a
+/// read-only mapping of the file, so it must not be written to or freed; use esReleaseImage.
+///
+typedef struct
+{
+   int            width;
+   int            height;
+
+   /// 1, 3 or 4
+   int            bytesPerPixel;
+
+   /// First (bottom) row of tightly packed pixel data
+   const unsigned char *pixels;
+
+   /// Private: file mapping and decode buffer owned by the image
+   void          *mapping;
+   size_t         mappingSize;
+   void          *mappingHandle;
+   unsigned char *allocation;
+} ESImage;
+
+///
+/// Pool of worker threads, see esThreadPoolCreate
+///
+typedef struct ESThreadPool ESThreadPool;
+
+/// Task run on an ESThreadPool worker
+typedef void ( ESCALLBACK *ESTaskFunc ) ( void *arg );
+
+/// Body of an esParallelFor, handles the items in [begin, end)
+typedef void ( ESCALLBACK *ESRangeFunc ) ( void *arg, int begin, int end );
+
+/// Height of sample (x, y) of a height field, see esTerrainCreate
+typedef GLfloat ( ESCALLBACK *ESHeightFunc ) ( void *arg, int x, int y );
+
+/// Fills the pixels of one tile of a tile file, see esTileFileWrite
+typedef void ( ESCALLBACK *ESTileFunc ) ( void *arg, int tile, void *pixels );
+
+///
+/// Background texture loader, see esAssetLoaderCreate
+///
+typedef struct ESAssetLoader ESAssetLoader;
+
+///
+/// Ring of fences for keeping several sets of resources in flight, see esFenceRingCreate
+///
+typedef struct ESFenceRing ESFenceRing;
+
+///
+/// Ring allocator for per-frame dynamic buffer data, see esStreamBufferCreate
+///
+typedef struct ESStreamBuffer ESStreamBuffer;
+
+///
+/// Shadow of the bound GL state that drops redundant calls, see esStateCacheCreate
+///
+typedef struct ESStateCache ESStateCache;
+
+///
+/// Chunked quadtree level of detail terrain, see esTerrainCreate
+///
+typedef struct ESTerrain ESTerrain;
+
+///
+/// Tiles of a file streamed into the layers of an array texture, see esTileCacheCreate
+///
+typedef struct ESTileCache ESTileCache;
+
+///
+/// Deduplicated sampler objects, see esGetSampler
+///
+typedef struct ESSamplerCache ESSamplerCache;
+
+///
+/// Parameters of a sampler object, see esGetSampler.  esSamplerDescInit sets the GL defaults.
+///
+typedef struct
+{
+   GLenum      minFilter;
+   GLenum      magFilter;
+   GLenum      wrapS;
+   GLenum      wrapT;
+   GLenum      wrapR;
+   GLfloat     minLod;
+   GLfloat     maxLod;
+
+   /// GL_NONE, or GL_COMPARE_REF_TO_TEXTURE for depth textures
+   GLenum      compareMode;
+   GLenum      compareFunc;
+} ESSamplerDesc;
+
+///
+/// Linear allocator for transient memory, see esArenaCreate
+///
+typedef struct ESArena ESArena;
+
+///
+/// Position in an ESArena to release back to, see esArenaGetMark.  The fields are private.
+///
+typedef struct
+{
+   void       *block;
+   size_t      offset;
+   size_t      bytesInUse;
+} ESArenaMark;
+
+///
+/// Counters kept by an ESArena, see esArenaGetStats
+///
+typedef struct
+{
+   /// esArenaAlloc calls, and the bytes they handed out (rounded up to the alignment)
+   GLuint64    allocations;
+   GLuint64    bytesAllocated;
+
+   /// Bytes handed out and not yet released, and the most there ever were at once
+   size_t      bytesInUse;
+   size_t      peakBytesInUse;
+
+   /// Bytes reserved from the heap, in this many blocks
+   size_t      capacity;
+   int         blocks;
+} ESArenaStats;
+
+///
+/// Counters kept by an ESStateCache, see esStateCacheGetStats
+///
+typedef struct
+{
+   /// Calls passed on to the GL
+   GLuint64    issued;
+
+   /// Calls dropped because they set the current value again
+   GLuint64    filtered;
+} ESStateCacheStats;
+
+///
+/// Post-transform vertex cache efficiency of an index list, see esMeshAnalyzeVertexCache
+///
+typedef struct
+{
+   /// Average cache miss ratio: vertices transformed per triangle, 0.5 at best for a
+   /// regular grid and 3 at worst
+   float       acmr;
+
+   /// Average transform to vertex ratio: vertices transformed per vertex used, 1 at best
+   float       atvr;
+} ESMeshCacheStats;
+
+///
+/// Where and how one attribute is stored in an ESMesh vertex, the arguments for
+/// glVertexAttribPointer.  size is 0 if the mesh does not have the attribute.
+///
+typedef struct
+{
+   GLint       size;
+   GLenum      type;
+   GLboolean   normalized;
+   GLsizei     offset;
+} ESVertexAttrib;
+
+///
+/// Encodings of the attributes in an ESMesh, see esMeshPack
+///
+typedef struct
+{
+   /// GL_FLOAT or GL_HALF_FLOAT
+   GLenum      positionType;
+
+   /// GL_NONE to leave normals out, GL_FLOAT, GL_HALF_FLOAT or GL_INT_2_10_10_10_REV
+   GLenum      normalType;
+
+   /// GL_NONE to leave texture coordinates out, GL_FLOAT, GL_HALF_FLOAT or GL_UNSIGNED_SHORT
+   /// (normalized, esMeshPack fails if a coordinate is outside [0, 1])
+   GLenum      texCoordType;
+} ESVertexFormat;
+
+///
+/// Interleaved vertices and indices in one allocation, see esMeshPack
+///
+typedef struct
+{
+   /// Vertex data, stride bytes per vertex
+   void          *vertices;
+   GLsizei        stride;
+   int            numVertices;
+
+   /// Index data for GL_TRIANGLES, GL_UNSIGNED_SHORT if there are few enough vertices
+   void          *indices;
+   GLenum         indexType;
+   GLsizei        indexSize;
+   int            numIndices;
+
+   ESVertexAttrib position;
+   ESVertexAttrib normal;
+   ESVertexAttrib texCoord;
+} ESMesh;
+
+///
+/// What the last esTerrainSelect chose, see esTerrainGetStats
+///
+typedef struct
+{
+   /// Quadtree nodes whose error was tested
+   int         nodesVisited;
+
+   /// Chunks in the draw list, and unsplit nodes left out as outside the frustum
+   int         chunksDrawn;
+   int         chunksCulled;
+
+   /// Streamed terrains: chunks left out because their tile was not resident
+   int         chunksPending;
+
+   /// Deepest quadtree level drawn, 0 being the root
+   int         maxLevel;
+
+   /// Triangles esTerrainDraw will draw
+   GLuint64    triangles;
+} ESTerrainStats;
+
+///
+/// State of an ESTileCache, see esTileCacheGetStats
+///
+typedef struct
+{
+   /// Tiles in the file, and layers of the array texture
+   int         tileCount;
+   int         slotCount;
+
+   /// Tiles in the texture, and tiles waiting for or being read by the loader thread
+   int         residentTiles;
+   int         queuedTiles;
+
+   /// Totals since the cache was created
+   GLuint64    tilesLoaded;
+   GLuint64    tilesEvicted;
+   GLuint64    bytesUploaded;
+} ESTileCacheStats;
+
+///
+/// Mipmap levels of an image, see esGenMipChain
+///
+typedef struct
+{
+   int            levelCount;
+   int            width[ES_MAX_MIP_LEVELS];
+   int            height[ES_MAX_MIP_LEVELS];
+
+   /// Tightly packed texels of each level.  Level 0 is the source image, not a copy.
+   const void    *pixels[ES_MAX_MIP_LEVELS];
+
+   GLenum         format;
+   GLenum         type;
+
+   /// Private, memory to free in esFreeMipChain
+   void          *allocation;
+} ESMipChain;
+
+///
+/// Counters kept by an ESFenceRing, see esFenceRingGetStats
+///
+typedef struct
+{
+   /// Successful esFenceRingAcquire calls
+   GLuint64    acquires;
+
+   /// Acquires that found the GPU still busy with the slot and blocked the CPU
+   GLuint64    waits;
+
+   /// Total time spent blocked, in nanoseconds
+   GLuint64    waitNs;
+
+   /// Acquires that gave up, the slot was still busy when the timeout ran out
+   GLuint64    busy;
+} ESFenceRingStats;
+
+///
+/// The six clip planes of a view frustum, see esExtractFrustumPlanes.  Each is (a, b, c, d) with
+/// a unit normal pointing inside: a point is inside the plane when ax + by + cz + d >= 0.
+///
+typedef struct
+{
+   GLfloat     planes[6][4];
+} ESFrustumPlanes;
+
+///
+/// Bounding spheres stored as a structure of arrays, see esCullSpheres
+///
+typedef struct
+{
+   /// Centers and radii, one float per sphere in each array
+   const GLfloat *x;
+   const GLfloat *y;
+   const GLfloat *z;
+   const GLfloat *radius;
+} ESSphereArrays;
+
+///
+/// Axis aligned bounding boxes stored as a structure of arrays, see esCullBoxes
+///
+typedef struct
+{
+   /// Centers and half sizes, one float per box in each array
+   const GLfloat *x;
+   const GLfloat *y;
+   const GLfloat *z;
+   const GLfloat *extentX;
+   const GLfloat *extentY;
+   const GLfloat *extentZ;
+} ESBoxArrays;
+
+///
+/// Particle source for an ESParticleSystem.  New particles get position +/- positionSpread,
+/// velocity +/- velocitySpread and a lifetime in [lifeMin, lifeMax] seconds, all uniform.
+///
+typedef struct
+{
+   GLfloat  position[3];
+   GLfloat  positionSpread[3];
+   GLfloat  velocity[3];
+   GLfloat  velocitySpread[3];
+   GLfloat  lifeMin;
+   GLfloat  lifeMax;
+
+   /// Particles emitted per second by esParticleSystemUpdate, 0 for bursts only
+   GLfloat  rate;
+} ESParticleEmitter;
+
+///
+/// Vertex written by esParticleSystemUpload
+///
+typedef struct
+{
+   GLfloat  position[3];
+
+   /// Fraction of the particle's lifetime used up, in [0, 1)
+   GLfloat  age;
+} ESParticleVertex;
+
+///
+/// CPU particle simulation, see esParticleSystemCreate
+///
+typedef struct ESParticleSystem ESParticleSystem;
+
 typedef struct ESContext ESContext;
 
 struct ESContext
@@ -111,6 +522,9 @@ struct ESContext
    /// Window height
    GLint       height;
 
+   /// Window creation flags passed to esCreateWindow
+   GLuint      flags;
+
 #ifndef __APPLE__
    /// Display handle
    EGLNativeDisplayType eglNativeDisplay;
@@ -128,6 +542,9 @@ struct ESContext
    EGLSurface  eglSurface;
 #endif
 
+   /// Frame timing histograms, updated every frame by the main loop
+   ESFrameStats frameStats;
+
    /// Callbacks
    void ( ESCALLBACK *drawFunc ) ( ESContext * );
    void ( ESCALLBACK *shutdownFunc ) ( ESContext * );
@@ -152,6 +569,8 @@ struct ESContext
 ///         ES_WINDOW_DEPTH   - specifies that a depth buffer should be created
 ///         ES_WINDOW_STENCIL - specifies that a stencil buffer should be created
 ///         ES_WINDOW_MULTISAMPLE - specifies that a multi-sample buffer should be created
+///         ES_WINDOW_HEADLESS - render to an offscreen pbuffer without creating a native window.
+///                              Also forced on by setting the ES_HEADLESS environment variable.
 /// \return GL_TRUE if window creation is succesful, GL_FALSE otherwise
 GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char *title, GLint width, GLint height, GLuint flags );
 
@@ -183,6 +602,46 @@ void ESUTIL_API esRegisterUpdateFunc ( ESContext *esContext, void ( ESCALLBACK *
 //
 void ESUTIL_API esRegisterKeyFunc ( ESContext *esContext,
                                     void ( ESCALLBACK *drawFunc ) ( ESContext *, unsigned char, int, int ) );
+//
+/// \brief Return the value of a monotonic clock in nanoseconds.  Only differences
+///        between two calls are meaningful.
+//
+GLuint64 ESUTIL_API esGetTimeNs ( void );
+
+//
+/// \brief Clear all samples from a histogram
+/// \param hist Histogram to reset
+//
+void ESUTIL_API esHistogramReset ( ESHistogram *hist );
+
+//
+/// \brief Add a duration to a histogram, evicting the oldest sample once the window is full
+/// \param hist Histogram to update
+/// \param ns Duration in nanoseconds, clamped to 2^32-1
+//
+void ESUTIL_API esHistogramRecord ( ESHistogram *hist, GLuint64 ns );
+
+//
+/// \brief Query a percentile of the samples in the window
+/// \param hist Histogram to query
+/// \param percentile Percentile in the range [0, 100], e.g. 50 for the median or 99 for p99
+/// \return Upper bound of the bucket holding the percentile in nanoseconds, 0 if the histogram is empty
+//
+GLuint64 ESUTIL_API esHistogramPercentile ( const ESHistogram *hist, float percentile );
+
+//
+/// \brief Mean of the samples in the window
+/// \param hist Histogram to query
+/// \return Mean duration in nanoseconds, 0 if the histogram is empty
+//
+GLuint64 ESUTIL_API esHistogramMean ( const ESHistogram *hist );
+
+//
+/// \brief Clear the frame timing histograms in esContext->frameStats
+/// \param esContext Application context
+//
+void ESUTIL_API esResetFrameStats ( ESContext *esContext );
+
 //
 /// \brief Log a message to the debug output for the platform
 /// \param formatStr Format string for error log.
@@ -208,6 +667,67 @@ GLuint ESUTIL_API esLoadShader ( GLenum type, const char *shaderSrc );
 //
 GLuint ESUTIL_API esLoadProgram ( const char *vertShaderSrc, const char *fragShaderSrc );
 
+//
+///
+/// \brief Same as esLoadProgram, but sets transform feedback varyings before the program is linked.
+/// \param vertShaderSrc Vertex shader source code
+/// \param fragShaderSrc Fragment shader source code
+/// \param varyingCount Number of transform feedback varyings, may be 0
+/// \param varyings Names of the varyings to capture
+/// \param bufferMode GL_INTERLEAVED_ATTRIBS or GL_SEPARATE_ATTRIBS
+/// \return A new program object linked with the vertex/fragment shader pair, 0 on failure
+//
+GLuint ESUTIL_API esLoadProgramFeedback ( const char *vertShaderSrc, const char *fragShaderSrc,
+                                          GLsizei varyingCount, const char *const *varyings, GLenum bufferMode );
+
+//
+///
+/// \brief Set the directory where esLoadProgram/esLoadProgramFeedback cache linked program
+///        binaries.  Entries are keyed by a hash of the shader sources, the transform feedback
+///        varyings and the GL vendor/renderer/version strings; a missing or rejected entry
+///        falls back to compiling from source.  Until this is called the ES_PROGRAM_CACHE_DIR
+///        environment variable is used; without either, caching is disabled.
+/// \param path Existing, writable directory, or NULL to disable the cache
+//
+void ESUTIL_API esSetProgramCacheDir ( const char *path );
+
+///
+//  Opaque handle for a program being built by esLoadProgramAsync
+//
+typedef struct ESProgramAsync ESProgramAsync;
+
+//
+///
+/// \brief Start building a program from a vertex and fragment shader without waiting for the
+///        compiler.  Uses GL_KHR_parallel_shader_compile when the driver exposes it, otherwise
+///        compiles on a worker thread with a context that shares objects with esContext.  If
+///        neither is available, the compile and link are issued immediately and only checked
+///        when the handle is polled.  The program cache (esSetProgramCacheDir) is honoured.
+/// \param esContext Application context, must be current on the calling thread
+/// \param vertShaderSrc Vertex shader source code
+/// \param fragShaderSrc Fragment shader source code
+/// \return Handle to pass to esPollProgram or esWaitProgram, NULL on failure
+//
+ESProgramAsync *ESUTIL_API esLoadProgramAsync ( ESContext *esContext, const char *vertShaderSrc, const char *fragShaderSrc );
+
+//
+///
+/// \brief Check whether a program started with esLoadProgramAsync is ready, without blocking.
+///        Once it returns GL_TRUE the handle has been freed and must not be used again.
+/// \param handle Handle returned by esLoadProgramAsync
+/// \param program Receives the linked program object, or 0 if compiling or linking failed
+/// \return GL_TRUE when the program is finished, GL_FALSE while it is still being built
+//
+GLboolean ESUTIL_API esPollProgram ( ESProgramAsync *handle, GLuint *program );
+
+//
+///
+/// \brief Block until a program started with esLoadProgramAsync is ready and free the handle.
+/// \param handle Handle returned by esLoadProgramAsync
+/// \return The linked program object, 0 on failure
+//
+GLuint ESUTIL_API esWaitProgram ( ESProgramAsync *handle );
+
 
 //
 /// \brief Generates geometry for a sphere.  Allocates memory for the vertex data and stores
@@ -215,7 +735,8 @@ GLuint ESUTIL_API esLoadProgram ( const char *vertShaderSrc, const char *fragSha
 /// \param numSlices The number of slices in the sphere
 /// \param vertices If not NULL, will contain array of float3 positions
 /// \param normals If not NULL, will contain array of float3 normals
-/// \param texCoords If not NULL, will contain array of float2 texCoords
+/// \param texCoords If not NULL, will contain array of float2 texCoords, V running from 1 at
+///        the top to 0 at the bottom
 /// \param indices If not NULL, will contain the array of indices for the triangle strip
 /// \return The number of indices required for rendering the buffers (the number of indices stored in the indices array
 ///         if it is not NULL ) as a GL_TRIANGLE_STRIP
@@ -223,6 +744,12 @@ GLuint ESUTIL_API esLoadProgram ( const char *vertShaderSrc, const char *fragSha
 int ESUTIL_API esGenSphere ( int numSlices, float radius, GLfloat **vertices, GLfloat **normals,
                              GLfloat **texCoords, GLuint **indices );
 
+//
+/// \brief esGenSphere allocating the arrays from an arena, or with malloc if arena is NULL
+//
+int ESUTIL_API esGenSphereArena ( ESArena *arena, int numSlices, float radius, GLfloat **vertices,
+                                  GLfloat **normals, GLfloat **texCoords, GLuint **indices );
+
 //
 /// \brief Generates geometry for a cube.  Allocates memory for the vertex data and stores
 ///        the results in the arrays.  Generate index list for a TRIANGLES
@@ -237,6 +764,12 @@ int ESUTIL_API esGenSphere ( int numSlices, float radius, GLfloat **vertices, GL
 int ESUTIL_API esGenCube ( float scale, GLfloat **vertices, GLfloat **normals,
                            GLfloat **texCoords, GLuint **indices );
 
+//
+/// \brief esGenCube allocating the arrays from an arena, or with malloc if arena is NULL
+//
+int ESUTIL_API esGenCubeArena ( ESArena *arena, float scale, GLfloat **vertices, GLfloat **normals,
+                                GLfloat **texCoords, GLuint **indices );
+
 //
 /// \brief Generates a square grid consisting of triangles.  Allocates memory for the vertex data and stores
 ///        the results in the arrays.  Generate index list as TRIANGLES.
@@ -249,46 +782,849 @@ int ESUTIL_API esGenCube ( float scale, GLfloat **vertices, GLfloat **normals,
 int ESUTIL_API esGenSquareGrid ( int size, GLfloat **vertices, GLuint **indices );
 
 //
-/// \brief Loads a 8-bit, 24-bit or 32-bit TGA image from a file
-/// \param ioContext Context related to IO facility on the platform
-/// \param fileName Name of the file on disk
-/// \param width Width of loaded image in pixels
-/// \param height Height of loaded image in pixels
-///  \return Pointer to loaded image.  NULL on failure.
+/// \brief esGenSquareGrid allocating the arrays from an arena, or with malloc if arena is NULL
 //
-char *ESUTIL_API esLoadTGA ( void *ioContext, const char *fileName, int *width, int *height );
+int ESUTIL_API esGenSquareGridArena ( ESArena *arena, int size, GLfloat **vertices, GLuint **indices );
 
+//
+/// \brief Simulate a FIFO post-transform vertex cache over a GL_TRIANGLES index list
+/// \param cacheSize Number of cache entries, 16 to 32 for most GPUs
+/// \param stats Receives the ACMR and ATVR
+/// \return GL_FALSE if the mesh is empty or out of memory
+//
+GLboolean ESUTIL_API esMeshAnalyzeVertexCache ( const GLuint *indices, int numIndices, int numVertices,
+                                                int cacheSize, ESMeshCacheStats *stats );
 
 //
-/// \brief Multiply matrix specified by result with a scaling matrix and return new matrix in result
-/// \param result Specifies the input matrix.  Scaled matrix is returned in result.
-/// \param sx, sy, sz Scale factors along the x, y and z axes respectively
+/// \brief Reorder the triangles of a GL_TRIANGLES index list so that vertices are reused while
+///        still in the post-transform cache.  The result does not depend on the cache size.
+/// \return GL_FALSE if the mesh is empty or out of memory
 //
-void ESUTIL_API esScale ( ESMatrix *result, GLfloat sx, GLfloat sy, GLfloat sz );
+GLboolean ESUTIL_API esMeshOptimizeVertexCache ( GLuint *indices, int numIndices, int numVertices );
 
 //
-/// \brief Multiply matrix specified by result with a translation matrix and return new matrix in result
-/// \param result Specifies the input matrix.  Translated matrix is returned in result.
-/// \param tx, ty, tz Scale factors along the x, y and z axes respectively
+/// \brief Reorder clusters of triangles from esMeshOptimizeVertexCache so that the outward facing
+///        ones are drawn first and hide more of the rest, lowering overdraw
+/// \param positions Vertex positions, three floats each
+/// \param stride Bytes between positions, 0 if tightly packed
+/// \param cacheSize Cache size the clusters are split for, as for esMeshAnalyzeVertexCache
+/// \param threshold How much the ACMR may grow, e.g. 1.05; higher gives smaller clusters and less overdraw
+/// \return GL_FALSE if the mesh is empty or out of memory
 //
-void ESUTIL_API esTranslate ( ESMatrix *result, GLfloat tx, GLfloat ty, GLfloat tz );
+GLboolean ESUTIL_API esMeshOptimizeOverdraw ( GLuint *indices, int numIndices, const GLfloat *positions,
+                                              GLsizei stride, int numVertices, int cacheSize, float threshold );
 
 //
-/// \brief Multiply matrix specified by result with a rotation matrix and return new matrix in result
-/// \param result Specifies the input matrix.  Rotated matrix is returned in result.
-/// \param angle Specifies the angle of rotation, in degrees.
-/// \param x, y, z Specify the x, y and z coordinates of a vector, respectively
+/// \brief Renumber vertices in the order the indices use them, so vertex fetches walk memory
+///        forward.  Rewrites the indices; apply remap to every vertex array with
+///        esMeshRemapVertices.  Unused vertices are moved to the end.
+/// \param remap Receives numVertices entries, the new index of each old vertex
+/// \return The number of vertices used by the indices
 //
-void ESUTIL_API esRotate ( ESMatrix *result, GLfloat angle, GLfloat x, GLfloat y, GLfloat z );
+int ESUTIL_API esMeshOptimizeVertexFetch ( GLuint *indices, int numIndices, int numVertices, GLuint *remap );
 
 //
-/// \brief Multiply matrix specified by result with a perspective matrix and return new matrix in result
-/// \param result Specifies the input matrix.  New matrix is returned in result.
-/// \param left, right Coordinates for the left and right vertical clipping planes
-/// \param bottom, top Coordinates for the bottom and top horizontal clipping planes
-/// \param nearZ, farZ Distances to the near and far depth clipping planes.  Both distances must be positive.
+/// \brief Move vertices to the positions given by a remap table from esMeshOptimizeVertexFetch
+/// \param vertices Vertex array, reordered in place
+/// \param vertexSize Size of one vertex in bytes
+/// \return GL_FALSE if out of memory
 //
-void ESUTIL_API esFrustum ( ESMatrix *result, float left, float right, float bottom, float top, float nearZ, float farZ );
+GLboolean ESUTIL_API esMeshRemapVertices ( void *vertices, int numVertices, int vertexSize, const GLuint *remap );
+
+//
+/// \brief Interleave vertex arrays into one buffer in a compact format, and narrow the indices to
+///        GL_UNSIGNED_SHORT if there are at most 65536 vertices.  Half float positions and
+///        GL_INT_2_10_10_10_REV normals take 20 bytes per vertex where floats take 32.
+/// \param format Attribute encodings; attributes whose array is NULL are left out
+/// \param positions Float3 positions, required
+/// \param normals Float3 normals, or NULL
+/// \param texCoords Float2 texture coordinates, or NULL
+/// \param mesh Receives the packed mesh, free it with esMeshFree
+/// \return GL_FALSE if the format is invalid, the texture coordinates do not fit it or out of memory
+//
+GLboolean ESUTIL_API esMeshPack ( const ESVertexFormat *format, const GLfloat *positions, const GLfloat *normals,
+                                  const GLfloat *texCoords, int numVertices, const GLuint *indices, int numIndices,
+                                  ESMesh *mesh );
+
+//
+/// \brief Free a mesh from esMeshPack or the esGen*Mesh functions
+//
+void ESUTIL_API esMeshFree ( ESMesh *mesh );
+
+//
+/// \brief Generate a sphere as with esGenSphere, packed into mesh as with esMeshPack
+//
+GLboolean ESUTIL_API esGenSphereMesh ( int numSlices, float radius, const ESVertexFormat *format, ESMesh *mesh );
+
+//
+/// \brief Generate a cube as with esGenCube, packed into mesh as with esMeshPack
+//
+GLboolean ESUTIL_API esGenCubeMesh ( float scale, const ESVertexFormat *format, ESMesh *mesh );
+
+//
+/// \brief Generate a grid as with esGenSquareGrid, packed into mesh as with esMeshPack.  The grid
+///        only has positions.
+//
+GLboolean ESUTIL_API esGenSquareGridMesh ( int size, const ESVertexFormat *format, ESMesh *mesh );
+
+//
+/// \brief Evaluate 3D gradient noise at a point.  Results lie roughly in [-1, 1] and are zero
+///        at integer lattice points.
+//
+float ESUTIL_API esNoise3D ( float x, float y, float z );
+
+//
+/// \brief Generate a cube of fractal (fBm) gradient noise, normalized to [0, 255].  Texel (x, y, z)
+///        holds the sum over octaves i of gain^i * esNoise3D ( p * frequency * lacunarity^i ) where
+///        p = ( x, y, z ) / size.  Rows are evaluated several texels at a time with SIMD and z slices
+///        are split across the pool.
+/// \param pool Thread pool to generate on, or NULL to use the calling thread only
+/// \param size Width, height and depth of the volume in texels
+/// \param frequency Lattice cells across the volume for the first octave
+/// \param octaves Number of octaves to sum, 1 for plain noise
+/// \param lacunarity Frequency multiplier between octaves, usually 2
+/// \param gain Amplitude multiplier between octaves, usually 0.5
+/// \return size^3 bytes, x fastest, to be freed with free().  NULL on failure.
+//
+GLubyte *ESUTIL_API esGenNoise3D ( ESThreadPool *pool, int size, float frequency, int octaves,
+                                   float lacunarity, float gain );
+
+//
+/// \brief Generate a noise volume with esGenNoise3D (lacunarity 2, gain 0.5) and upload it as a GL_R8
+///        3D texture with linear filtering and mirrored repeat wrapping
+/// \return The texture name, 0 on failure
+//
+GLuint ESUTIL_API esCreateNoise3DTexture ( ESThreadPool *pool, int size, float frequency, int octaves );
+
+//
+/// \brief esGenNoise3D taking the volume and its working memory from an arena.  The working
+///        memory is released before returning; the volume stays until the arena is released.
+///        With a NULL arena this is esGenNoise3D.
+//
+GLubyte *ESUTIL_API esGenNoise3DArena ( ESArena *arena, ESThreadPool *pool, int size, float frequency,
+                                        int octaves, float lacunarity, float gain );
+
+//
+/// \brief esCreateNoise3DTexture with its memory from an arena, released again after the upload
+//
+GLuint ESUTIL_API esCreateNoise3DTextureArena ( ESArena *arena, ESThreadPool *pool, int size,
+                                                float frequency, int octaves );
+
+//
+/// \brief Loads a 8-bit, 24-bit or 32-bit TGA image from a file
+/// \param ioContext Context related to IO facility on the platform
+/// \param fileName Name of the file on disk
+/// \param width Width of loaded image in pixels
+/// \param height Height of loaded image in pixels
+///  \return Pointer to loaded image.  NULL on failure.
+//
+char *ESUTIL_API esLoadTGA ( void *ioContext, const char *fileName, int *width, int *height );
+
+//
+/// \brief esLoadTGA returning the image in memory from an arena, which must not be freed
+//
+char *ESUTIL_API esLoadTGAArena ( ESArena *arena, void *ioContext, const char *fileName, int *width, int *height );
+
+//
+/// \brief Loads a TGA image without copying it when possible.  Uncompressed grey/true-colour
+///        images with a bottom-left origin are returned as a view into a memory mapping of the
+///        file; RLE (types 9, 10, 11), colour-mapped and top-left origin images are decoded
+///        into a single buffer.
+/// \param ioContext Context related to IO facility on the platform
+/// \param fileName Name of the file on disk
+/// \param image Receives the image, release it with esReleaseImage
+/// \return GL_TRUE on success, GL_FALSE on failure
+//
+GLboolean ESUTIL_API esLoadTGAImage ( void *ioContext, const char *fileName, ESImage *image );
+
+//
+/// \brief Release the mapping and/or memory held by an image from esLoadTGAImage
+/// \param image Image to release, may be zeroed
+//
+void ESUTIL_API esReleaseImage ( ESImage *image );
+
+//
+/// \brief Create a pool of worker threads
+/// \param threadCount Number of workers, 0 for one per processor
+/// \return The pool, NULL on failure
+//
+ESThreadPool *ESUTIL_API esThreadPoolCreate ( int threadCount );
+
+//
+/// \brief Run the tasks still queued, then stop the workers and free the pool
+/// \param pool Pool to destroy, may be NULL
+//
+void ESUTIL_API esThreadPoolDestroy ( ESThreadPool *pool );
+
+//
+/// \brief Number of worker threads in a pool
+//
+int ESUTIL_API esThreadPoolSize ( ESThreadPool *pool );
+
+//
+/// \brief Queue a task.  Tasks start in submission order but may finish in any order.
+/// \param pool Pool to run the task on
+/// \param func Task function, called on a worker thread
+/// \param arg Argument passed to func
+/// \return GL_TRUE on success, GL_FALSE if the task could not be queued
+//
+GLboolean ESUTIL_API esThreadPoolSubmit ( ESThreadPool *pool, ESTaskFunc func, void *arg );
+
+//
+/// \brief Block until every task queued on the pool has finished
+//
+void ESUTIL_API esThreadPoolWait ( ESThreadPool *pool );
+
+//
+/// \brief Run func over [0, count) split into chunks across the pool and the calling thread, and
+///        wait for all of them.  Must not be called from a task running on the same pool.
+/// \param pool Pool to use, or NULL to run everything on the calling thread
+/// \param count Number of items
+/// \param func Called with disjoint [begin, end) ranges, possibly concurrently
+/// \param arg Argument passed to func
+//
+void ESUTIL_API esParallelFor ( ESThreadPool *pool, int count, ESRangeFunc func, void *arg );
+
+//
+/// \brief Create a background texture loader.  Images are decoded on a thread pool and uploaded
+///        from the GL thread through a ring of pixel unpack buffers in esAssetLoaderUpdate.
+///        Must be called, like all esAssetLoader functions, on the thread that owns the context.
+/// \param pool Thread pool to decode on, or NULL to create one owned by the loader
+/// \param stagingBufferCount Number of pixel unpack buffers in the staging ring, 0 for the default (3)
+/// \param stagingBufferSize Size in bytes of each staging buffer, 0 for the default (1 MB).  Larger
+///        images are uploaded in strips of rows over several calls to esAssetLoaderUpdate.
+/// \return The loader, NULL on failure
+//
+ESAssetLoader *ESUTIL_API esAssetLoaderCreate ( ESThreadPool *pool, int stagingBufferCount, GLsizeiptr stagingBufferSize );
+
+//
+/// \brief Wait for outstanding decodes, then free the loader.  Textures already returned are
+///        not deleted; any that had not finished uploading are left incomplete.
+//
+void ESUTIL_API esAssetLoaderDestroy ( ESAssetLoader *loader );
+
+//
+/// \brief Start loading a TGA image into a new 2D texture.  The texture name is returned at once
+///        and is incomplete until the upload has finished; set its parameters as usual.
+/// \param loader Asset loader
+/// \param ioContext Context related to IO facility on the platform
+/// \param fileName Name of the file on disk
+/// \param internalFormat Internal format for glTexImage2D
+/// \param format Pixel format of the image data, e.g. GL_RGB for a 24-bit TGA.  Images whose bytes
+///        per pixel do not match format and internalFormat are logged and not uploaded.
+/// \return The texture name, 0 on failure
+//
+GLuint ESUTIL_API esAssetLoaderLoadTexture ( ESAssetLoader *loader, void *ioContext, const char *fileName,
+                                             GLenum internalFormat, GLenum format );
+
+//
+/// \brief Upload whatever has been decoded, as far as the staging ring allows without waiting.
+///        Call once per frame.
+/// \return Number of textures still loading
+//
+int ESUTIL_API esAssetLoaderUpdate ( ESAssetLoader *loader );
+
+//
+/// \brief Block until every requested texture has been uploaded
+//
+void ESUTIL_API esAssetLoaderFinish ( ESAssetLoader *loader );
+
+//
+/// \brief Create a ring of depth fence slots.  Use one set of resources per slot: call
+///        esFenceRingAcquire before reusing the slot's resources and esFenceRingSubmit after the
+///        commands that use them, so up to depth sets are in flight on the GPU at once.
+/// \param depth Number of slots, 3 or more to let the CPU run ahead of the GPU
+/// \return The ring, NULL on failure
+//
+ESFenceRing *ESUTIL_API esFenceRingCreate ( int depth );
+
+//
+/// \brief Free a fence ring and its fences
+//
+void ESUTIL_API esFenceRingDestroy ( ESFenceRing *ring );
+
+//
+/// \brief Number of slots in the ring
+//
+int ESUTIL_API esFenceRingDepth ( ESFenceRing *ring );
+
+//
+/// \brief Wait until the GPU has finished the commands submitted the last time round for the
+///        current slot.  The CPU only blocks when the ring has wrapped onto busy work.
+/// \param timeout Nanoseconds to wait: 0 only polls, GL_TIMEOUT_IGNORED waits as long as it takes
+/// \return Index of the current slot, or -1 if it is still busy after timeout
+//
+int ESUTIL_API esFenceRingAcquire ( ESFenceRing *ring, GLuint64 timeout );
+
+//
+/// \brief Insert a fence after the commands using the current slot and move to the next slot
+//
+void ESUTIL_API esFenceRingSubmit ( ESFenceRing *ring );
+
+//
+/// \brief Counters of how often esFenceRingAcquire blocked, since creation or the last reset
+//
+const ESFenceRingStats *ESUTIL_API esFenceRingGetStats ( ESFenceRing *ring );
+
+//
+/// \brief Zero the counters returned by esFenceRingGetStats
+//
+void ESUTIL_API esFenceRingResetStats ( ESFenceRing *ring );
+
+//
+/// \brief Create a buffer object for streaming dynamic data.  Every frame's data is suballocated
+///        after the previous frame's and mapped unsynchronized; fences mark when the GPU is done
+///        with each frame's part, so writes only wait if the buffer is too small for the frames
+///        in flight.  Size it for at least three frames of data.
+/// \param target Binding target used for mapping, e.g. GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER
+/// \param size Size of the buffer in bytes
+/// \return The stream buffer, NULL on failure
+//
+ESStreamBuffer *ESUTIL_API esStreamBufferCreate ( GLenum target, GLsizeiptr size );
+
+//
+/// \brief Free a stream buffer, its buffer object and fences
+//
+void ESUTIL_API esStreamBufferDestroy ( ESStreamBuffer *sb );
+
+//
+/// \brief The buffer object, for binding to other targets
+//
+GLuint ESUTIL_API esStreamBufferId ( ESStreamBuffer *sb );
+
+//
+/// \brief Allocate and map the next size bytes.  The buffer is left bound to its target.
+/// \param size Number of bytes to allocate
+/// \param alignment Alignment of the returned offset, e.g. the vertex or index size
+/// \param offset Receives the offset of the allocation, for glVertexAttribPointer or the
+///        indices argument of glDrawElements
+/// \return Pointer to write the data to, NULL if it does not fit or the map failed
+//
+void *ESUTIL_API esStreamBufferMap ( ESStreamBuffer *sb, GLsizeiptr size, GLsizeiptr alignment, GLintptr *offset );
+
+//
+/// \brief Unmap the allocation made by esStreamBufferMap
+/// \return GL_FALSE if the data was lost and must be written again
+//
+GLboolean ESUTIL_API esStreamBufferUnmap ( ESStreamBuffer *sb );
+
+//
+/// \brief Allocate size bytes and copy data into them
+/// \return Offset of the data, -1 on failure
+//
+GLintptr ESUTIL_API esStreamBufferWrite ( ESStreamBuffer *sb, const void *data, GLsizeiptr size, GLsizeiptr alignment );
+
+//
+/// \brief Fence everything written since the last call.  Call once per frame, after the draws that
+///        use the data.
+//
+void ESUTIL_API esStreamBufferFence ( ESStreamBuffer *sb );
+
+//
+/// \brief Create a cache of the GL state set through the esState functions.  Every state starts
+///        out unknown, so the first call setting it always goes through.  Keep one cache per
+///        context and route all changes of the cached state through it, including deleting
+///        bound objects with the esStateDelete functions, or call esStateCacheInvalidate after
+///        changing it directly.
+/// \return The cache, NULL if out of memory
+//
+ESStateCache *ESUTIL_API esStateCacheCreate ( void );
+
+//
+/// \brief Free a state cache
+//
+void ESUTIL_API esStateCacheDestroy ( ESStateCache *cache );
+
+//
+/// \brief Forget all cached state, including uniform values, e.g. after GL calls made without the cache
+//
+void ESUTIL_API esStateCacheInvalidate ( ESStateCache *cache );
+
+//
+/// \brief Number of calls issued and filtered, since creation or the last reset
+//
+const ESStateCacheStats *ESUTIL_API esStateCacheGetStats ( ESStateCache *cache );
+
+//
+/// \brief Zero the counters returned by esStateCacheGetStats
+//
+void ESUTIL_API esStateCacheResetStats ( ESStateCache *cache );
+
+//
+/// \brief glUseProgram through the cache.  Uniform values are cached per program and survive
+///        switching between programs.
+//
+void ESUTIL_API esStateUseProgram ( ESStateCache *cache, GLuint program );
+
+//
+/// \brief glDeleteProgram, dropping the cached uniform values so a reused name starts clean
+//
+void ESUTIL_API esStateDeleteProgram ( ESStateCache *cache, GLuint program );
+
+//
+/// \brief glBindVertexArray through the cache.  The element array buffer and enabled attribute
+///        arrays are part of the vertex array object, so they become unknown when it changes.
+//
+void ESUTIL_API esStateBindVertexArray ( ESStateCache *cache, GLuint vertexArray );
+
+//
+/// \brief glDeleteVertexArrays of one vertex array object.  GL binds the default vertex array
+///        object when the bound one is deleted, and the cache has to see that, or binding an
+///        object that reuses the name would be filtered out.
+//
+void ESUTIL_API esStateDeleteVertexArray ( ESStateCache *cache, GLuint vertexArray );
+
+//
+/// \brief glBindBuffer through the cache
+//
+void ESUTIL_API esStateBindBuffer ( ESStateCache *cache, GLenum target, GLuint buffer );
+
+//
+/// \brief glDeleteBuffers of one buffer, clearing the targets it was bound to as GL does
+//
+void ESUTIL_API esStateDeleteBuffer ( ESStateCache *cache, GLuint buffer );
+
+//
+/// \brief glEnableVertexAttribArray through the cache
+//
+void ESUTIL_API esStateEnableVertexAttribArray ( ESStateCache *cache, GLuint index );
+
+//
+/// \brief glDisableVertexAttribArray through the cache
+//
+void ESUTIL_API esStateDisableVertexAttribArray ( ESStateCache *cache, GLuint index );
+
+//
+/// \brief Bind a texture to a texture unit, switching the active texture unit only if it has to
+/// \param unit Texture unit index, 0 for GL_TEXTURE0
+//
+void ESUTIL_API esStateBindTexture ( ESStateCache *cache, GLuint unit, GLenum target, GLuint texture );
+
+//
+/// \brief glDeleteTextures of one texture, clearing the units it was bound to as GL does
+//
+void ESUTIL_API esStateDeleteTexture ( ESStateCache *cache, GLuint texture );
+
+//
+/// \brief glEnable through the cache
+//
+void ESUTIL_API esStateEnable ( ESStateCache *cache, GLenum cap );
+
+//
+/// \brief glDisable through the cache
+//
+void ESUTIL_API esStateDisable ( ESStateCache *cache, GLenum cap );
+
+//
+/// \brief glBlendFunc through the cache
+//
+void ESUTIL_API esStateBlendFunc ( ESStateCache *cache, GLenum sfactor, GLenum dfactor );
+
+//
+/// \brief glDepthFunc through the cache
+//
+void ESUTIL_API esStateDepthFunc ( ESStateCache *cache, GLenum func );
+
+//
+/// \brief glDepthMask through the cache
+//
+void ESUTIL_API esStateDepthMask ( ESStateCache *cache, GLboolean flag );
+
+//
+/// \brief Set a uniform of the program bound with esStateUseProgram, unless it already has the value
+//
+void ESUTIL_API esStateUniform1i ( ESStateCache *cache, GLint location, GLint x );
+void ESUTIL_API esStateUniform1f ( ESStateCache *cache, GLint location, GLfloat x );
+void ESUTIL_API esStateUniform2f ( ESStateCache *cache, GLint location, GLfloat x, GLfloat y );
+void ESUTIL_API esStateUniform3f ( ESStateCache *cache, GLint location, GLfloat x, GLfloat y, GLfloat z );
+void ESUTIL_API esStateUniform4f ( ESStateCache *cache, GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w );
+void ESUTIL_API esStateUniform4fv ( ESStateCache *cache, GLint location, const GLfloat *v );
+void ESUTIL_API esStateUniformMatrix4fv ( ESStateCache *cache, GLint location, const GLfloat *m );
+
+//
+/// \brief Create a linear allocator.  Allocation bumps a pointer, and memory is only given back
+///        all at once with esArenaRelease or esArenaReset, so loading code can make many short
+///        lived allocations without fragmenting the heap.  Not thread safe.
+/// \param blockSize Size of the blocks reserved from the heap, 0 for 1 MB; larger allocations
+///        get a block of their own
+/// \return The arena, NULL if out of memory
+//
+ESArena *ESUTIL_API esArenaCreate ( size_t blockSize );
+
+//
+/// \brief Free an arena and all memory allocated from it
+//
+void ESUTIL_API esArenaDestroy ( ESArena *arena );
+
+//
+/// \brief Allocate size bytes, aligned to 16 bytes
+/// \return The memory, NULL if out of memory.  Never free it.
+//
+void *ESUTIL_API esArenaAlloc ( ESArena *arena, size_t size );
+
+//
+/// \brief Mark the current position, to release everything allocated after it with esArenaRelease
+//
+ESArenaMark ESUTIL_API esArenaGetMark ( ESArena *arena );
+
+//
+/// \brief Release everything allocated since mark was taken.  The blocks are kept for reuse.
+//
+void ESUTIL_API esArenaRelease ( ESArena *arena, ESArenaMark mark );
+
+//
+/// \brief Release everything allocated from the arena.  The blocks are kept for reuse.
+//
+void ESUTIL_API esArenaReset ( ESArena *arena );
+
+//
+/// \brief Allocation counters and memory use, since creation or the last esArenaResetStats
+//
+const ESArenaStats *ESUTIL_API esArenaGetStats ( ESArena *arena );
+
+//
+/// \brief Zero the allocation counters and restart the peak from the current use
+//
+void ESUTIL_API esArenaResetStats ( ESArena *arena );
+
+//
+/// \brief Generate the full mipmap chain of an image, down to 1x1.  Each level is half the
+///        size of the one above, rounded down, and filtered from it with a separable kernel
+///        that weighs odd-sized edges correctly.
+/// \param arena Arena to allocate the levels from, or NULL for the heap
+/// \param pool Thread pool to split the rows of each level across, or NULL
+/// \param pixels Tightly packed source image, kept as level 0
+/// \param format GL_RED, GL_RG, GL_RGB or GL_RGBA
+/// \param type GL_UNSIGNED_BYTE or GL_HALF_FLOAT
+/// \param flags ES_MIP_KAISER for a sharper filter, ES_MIP_SRGB to filter 8-bit color in
+///        linear light; alpha is always linear
+/// \param chain Receives the levels, free it with esFreeMipChain
+/// \return GL_FALSE if the format is not supported or out of memory
+//
+GLboolean ESUTIL_API esGenMipChain ( ESArena *arena, ESThreadPool *pool, const void *pixels, int width, int height,
+                                     GLenum format, GLenum type, GLuint flags, ESMipChain *chain );
+
+//
+/// \brief Free the levels of a chain, unless they came from an arena
+//
+void ESUTIL_API esFreeMipChain ( ESMipChain *chain );
+
+//
+/// \brief Load every level of a chain into the bound texture with glTexImage2D
+//
+void ESUTIL_API esUploadMipChain ( const ESMipChain *chain, GLenum target, GLint internalFormat );
+
+//
+/// \brief Create an empty sampler cache for the current context
+/// \return The cache, NULL if out of memory
+//
+ESSamplerCache *ESUTIL_API esSamplerCacheCreate ( void );
+
+//
+/// \brief Delete every sampler object of the cache and free it
+//
+void ESUTIL_API esSamplerCacheDestroy ( ESSamplerCache *cache );
+
+//
+/// \brief Set desc to the GL defaults of a new sampler object
+//
+void ESUTIL_API esSamplerDescInit ( ESSamplerDesc *desc );
+
+//
+/// \brief Get the sampler object with the parameters in desc, created on first request and
+///        shared by every later request with the same parameters.  Bind it with glBindSampler
+///        instead of changing the parameters of the texture between draws.
+/// \return The sampler, owned by the cache, or 0 if out of memory
+//
+GLuint ESUTIL_API esGetSampler ( ESSamplerCache *cache, const ESSamplerDesc *desc );
+
+//
+/// \brief Build a chunked quadtree terrain over a height field.  Each node is drawn as one chunk
+///        of chunkSize x chunkSize vertices, so the leaves hold every sample and each level up
+///        halves the density.  Heights are read once here, to bound the nodes and measure the
+///        error of every level; drawing takes them from a height map texture.
+/// \param pool Thread pool to build the levels with, or NULL
+/// \param size Samples per side of the height field, (chunkSize - 1) * 2^n + 1 with n <= 10
+/// \param chunkSize Vertices per chunk side, 2^m + 1 up to 129 so indices fit in 16 bits
+/// \param extent World size of the terrain, which covers [0, extent] in x and y
+/// \param heightFunc Returns the world z of a sample, called from the pool's threads
+/// \return The terrain, NULL if the sizes are invalid or out of memory
+//
+ESTerrain *ESUTIL_API esTerrainCreate ( ESThreadPool *pool, int size, int chunkSize, GLfloat extent,
+                                        ESHeightFunc heightFunc, void *heightArg );
+
+//
+/// \brief Write a terrain to a tile file for esTerrainOpenTiles, for height fields too large to
+///        keep in memory.  Node bounds and errors are computed as in esTerrainCreate.  Every
+///        level gets a grid of half float height tiles at its own sample density, so a tile holds
+///        tileSize x tileSize samples plus a one sample border, and each chunk reads from one tile.
+/// \param pool Thread pool to build the levels and fill the tiles with, or NULL
+/// \param fileName Path of the file to create
+/// \param size Samples per side of the height field, as for esTerrainCreate
+/// \param chunkSize Vertices per chunk side, as for esTerrainCreate
+/// \param tileSize Samples per tile side, 2^k + 1 from chunkSize up to size
+/// \param heightFunc Returns the world z of a sample, called from the pool's threads
+/// \return GL_TRUE if the file was written
+//
+GLboolean ESUTIL_API esTerrainWriteTiles ( ESThreadPool *pool, const char *fileName, int size, int chunkSize,
+                                           int tileSize, ESHeightFunc heightFunc, void *heightArg );
+
+//
+/// \brief Open a terrain written by esTerrainWriteTiles.  Heights are streamed from the file
+///        into an array texture of cacheTiles layers as the views passed to esTerrainSelect need
+///        them, so GPU memory does not grow with the terrain.  A node is split only once the
+///        tiles around its children are resident; until then it is drawn coarser.
+/// \param ioContext Context related to IO facility on the platform
+/// \param fileName Name of the tile file
+/// \param extent World size of the terrain, which covers [0, extent] in x and y
+/// \param cacheTiles Layers of the height tile texture, at least 16
+/// \return The terrain, NULL if the file could not be mapped or is not a terrain tile file
+//
+ESTerrain *ESUTIL_API esTerrainOpenTiles ( void *ioContext, const char *fileName, GLfloat extent, int cacheTiles );
+
+//
+/// \brief Delete a terrain and its buffers
+//
+void ESUTIL_API esTerrainDestroy ( ESTerrain *terrain );
+
+//
+/// \brief Choose the chunks to draw for a view.  Nodes are split while their geometric error
+///        spans more than pixelError pixels on screen, nodes outside the frustum are dropped,
+///        and neighbours are kept within one level of each other.
+/// \param modelview Rigid transform from terrain to eye space
+/// \param projection Perspective projection
+/// \param viewportHeight Height of the viewport in pixels
+//
+void ESUTIL_API esTerrainSelect ( ESTerrain *terrain, const ESMatrix *modelview, const ESMatrix *projection,
+                                  int viewportHeight, GLfloat pixelError );
+
+//
+/// \brief Draw the chunks chosen by esTerrainSelect with the current program.  The program
+///        places the vertices itself: attribute positionLoc holds the column and row of the
+///        vertex in its chunk, and the vec4 uniform chunkLoc holds the chunk's first sample,
+///        its sample spacing and 1 / (size - 1), so that
+///        uv = ( chunk.xy + position.xy * chunk.z ) * chunk.w
+///        is the height map coordinate of the vertex and uv * extent its x and y.
+///        For a streamed terrain the height tile array texture is bound to the active texture
+///        unit, and the vec4 uniform tileLoc holds the texel of the chunk's first vertex in its
+///        tile and the tile's layer, so the vertex height is
+///        texelFetch ( tiles, ivec3 ( tile.xy + position.xy, tile.z ), 0 ).r
+///        Neighbouring texels are always inside the tile's border.
+/// \param tileLoc Location of the tile uniform, unused unless the terrain is streamed
+//
+void ESUTIL_API esTerrainDraw ( ESTerrain *terrain, GLuint positionLoc, GLint chunkLoc, GLint tileLoc );
+
+//
+/// \brief Counters of the last esTerrainSelect
+//
+const ESTerrainStats *ESUTIL_API esTerrainGetStats ( ESTerrain *terrain );
+
+//
+/// \brief Tile cache of a terrain from esTerrainOpenTiles, NULL for other terrains
+//
+ESTileCache *ESUTIL_API esTerrainGetTileCache ( ESTerrain *terrain );
+
+//
+/// \brief Write a tile file for esTileCacheCreate.  Tiles are stored one after the other, each
+///        starting on a page boundary, after a block of user data; everything is in the byte
+///        order of the machine writing the file.
+/// \param fileName Path of the file to create
+/// \param tileWidth Pixels per tile row
+/// \param tileHeight Rows per tile
+/// \param tileCount Number of tiles
+/// \param internalFormat, format, type Texture format of the tiles, as for glTexSubImage3D
+/// \param userData Block returned by esTileCacheGetUserData, copied as is
+/// \param userSize Size of userData in bytes
+/// \param tileFunc Called for each tile in order to fill its tightly packed pixels
+/// \return GL_TRUE if the file was written
+//
+GLboolean ESUTIL_API esTileFileWrite ( const char *fileName, int tileWidth, int tileHeight, int tileCount,
+                                       GLenum internalFormat, GLenum format, GLenum type,
+                                       const void *userData, GLsizeiptr userSize,
+                                       ESTileFunc tileFunc, void *tileArg );
+
+//
+/// \brief Map a tile file and create an array texture of slotCount layers to stream its tiles
+///        into.  A loader thread reads requested tiles from the mapping, and esTileCacheUpdate
+///        uploads them, replacing the least recently used tiles once every layer is taken.
+///        Must be called, like all esTileCache functions, on the thread that owns the context.
+/// \param ioContext Context related to IO facility on the platform
+/// \param fileName Name of a file from esTileFileWrite
+/// \param slotCount Layers of the texture, the most tiles resident at once
+/// \return The cache, NULL if the file could not be mapped or is not a tile file
+//
+ESTileCache *ESUTIL_API esTileCacheCreate ( void *ioContext, const char *fileName, int slotCount );
+
+//
+/// \brief Stop the loader thread, delete the texture and unmap the file
+//
+void ESUTIL_API esTileCacheDestroy ( ESTileCache *cache );
+
+//
+/// \brief The user block of the tile file, read in place from the mapping
+/// \param size Set to the size of the block in bytes, may be NULL
+//
+const void *ESUTIL_API esTileCacheGetUserData ( ESTileCache *cache, GLsizeiptr *size );
+
+//
+/// \brief Ask for a tile to be loaded.  Requests last until the next esTileCacheUpdate, which
+///        hands them to the loader lowest priority value first; tiles requested before but not
+///        again are dropped from the loader's queue.
+//
+void ESUTIL_API esTileCacheRequest ( ESTileCache *cache, int tile, int priority );
+
+//
+/// \brief Layer of a resident tile, marking it used this frame so it is not evicted
+/// \return The layer, -1 if the tile is not resident
+//
+int ESUTIL_API esTileCacheLookup ( ESTileCache *cache, int tile );
+
+//
+/// \brief Upload the tiles the loader has read, evicting tiles not looked up this frame as
+///        needed, then queue this frame's requests and start the next frame.  Call once per frame.
+/// \return Number of tiles uploaded
+//
+int ESUTIL_API esTileCacheUpdate ( ESTileCache *cache );
+
+//
+/// \brief Block until the requested tiles have been read and uploaded
+//
+void ESUTIL_API esTileCacheFinish ( ESTileCache *cache );
+
+//
+/// \brief The 2D array texture holding the resident tiles
+//
+GLuint ESUTIL_API esTileCacheGetTexture ( ESTileCache *cache );
+
+//
+/// \brief Counters of a tile cache
+//
+const ESTileCacheStats *ESUTIL_API esTileCacheGetStats ( ESTileCache *cache );
+
+//
+/// \brief Map a float to an unsigned key with the same order, for esRadixSort
+//
+GLuint ESUTIL_API esFloatSortKey ( GLfloat value );
+
+//
+/// \brief Sort 32-bit keys in ascending order with an LSD radix sort split across a thread pool
+/// \param pool Thread pool to use, or NULL to sort on the calling thread
+/// \param keys Keys to sort in place
+/// \param count Number of keys
+/// \param scratch count GLuints of working memory, or NULL to allocate it
+/// \return GL_FALSE if scratch could not be allocated
+//
+GLboolean ESUTIL_API esRadixSort ( ESThreadPool *pool, GLuint *keys, int count, GLuint *scratch );
+
+//
+/// \brief Stable sort of key indices: fills indices so that keys[indices[0]], keys[indices[1]], ...
+///        is in ascending order.  The keys are not modified, so the data they belong to can be
+///        gathered through indices instead of being moved by the sort.
+/// \param pool Thread pool to use, or NULL to sort on the calling thread
+/// \param keys Keys to sort by
+/// \param indices Receives count indices
+/// \param count Number of keys
+/// \param scratch 3 * count GLuints of working memory, or NULL to allocate it
+/// \return GL_FALSE if scratch could not be allocated
+//
+GLboolean ESUTIL_API esRadixSortIndices ( ESThreadPool *pool, const GLuint *keys, GLuint *indices, int count,
+                                          GLuint *scratch );
+
+//
+/// \brief Create a particle system.  Particles are stored as separate position, velocity and age
+///        streams and updated four at a time with SIMD; dead particles are compacted away during
+///        the update, so the live ones are always the first esParticleSystemCount entries.
+/// \param capacity Maximum number of live particles
+/// \param pool Thread pool to split the update and upload across, or NULL
+/// \return The particle system, NULL on failure
+//
+ESParticleSystem *ESUTIL_API esParticleSystemCreate ( int capacity, ESThreadPool *pool );
+
+//
+/// \brief Free a particle system and its vertex buffer
+//
+void ESUTIL_API esParticleSystemDestroy ( ESParticleSystem *ps );
+
+//
+/// \brief Add an emitter, copied from emitter
+/// \return Index of the emitter, -1 on failure
+//
+int ESUTIL_API esParticleSystemAddEmitter ( ESParticleSystem *ps, const ESParticleEmitter *emitter );
+
+//
+/// \brief Get an emitter so it can be moved or changed, NULL for an invalid index
+//
+ESParticleEmitter *ESUTIL_API esParticleSystemGetEmitter ( ESParticleSystem *ps, int emitter );
+
+//
+/// \brief Set the acceleration applied to every particle, (0, 0, 0) by default
+//
+void ESUTIL_API esParticleSystemSetGravity ( ESParticleSystem *ps, GLfloat x, GLfloat y, GLfloat z );
+
+//
+/// \brief Emit a burst of particles from an emitter
+/// \return Number of particles emitted, less than count when the system is full
+//
+int ESUTIL_API esParticleSystemEmit ( ESParticleSystem *ps, int emitter, int count );
+
+//
+/// \brief Advance the simulation, remove particles that reached the end of their lifetime and
+///        run the emitters' continuous emission
+/// \param deltaTime Time step in seconds
+//
+void ESUTIL_API esParticleSystemUpdate ( ESParticleSystem *ps, GLfloat deltaTime );
+
+//
+/// \brief Number of live particles
+//
+int ESUTIL_API esParticleSystemCount ( ESParticleSystem *ps );
+
+//
+/// \brief Have esParticleSystemUpload write the particles back to front, for alpha blending.
+///        Particles are ordered by decreasing distance along the direction, with a radix sort.
+/// \param x, y, z View direction, pointing away from the viewer.  (0, 0, 0) turns sorting off.
+/// \return GL_FALSE if the sort buffers could not be allocated
+//
+GLboolean ESUTIL_API esParticleSystemSetSortDirection ( ESParticleSystem *ps, GLfloat x, GLfloat y, GLfloat z );
+
+//
+/// \brief Write the live particles as ESParticleVertex to a vertex buffer owned by the system.
+///        The buffer is orphaned each call, so the previous frame's draw does not stall the write.
+/// \return The vertex buffer, left bound to GL_ARRAY_BUFFER
+//
+GLuint ESUTIL_API esParticleSystemUpload ( ESParticleSystem *ps );
+
+
+//
+/// \brief Multiply matrix specified by result with a scaling matrix and return new matrix in result
+/// \param result Specifies the input matrix.  Scaled matrix is returned in result.
+/// \param sx, sy, sz Scale factors along the x, y and z axes respectively
+//
+void ESUTIL_API esScale ( ESMatrix *result, GLfloat sx, GLfloat sy, GLfloat sz );
+
+//
+/// \brief Multiply matrix specified by result with a translation matrix and return new matrix in result
+/// \param result Specifies the input matrix.  Translated matrix is returned in result.
+/// \param tx, ty, tz Scale factors along the x, y and z axes respectively
+//
+void ESUTIL_API esTranslate ( ESMatrix *result, GLfloat tx, GLfloat ty, GLfloat tz );
+
+//
+/// \brief Multiply matrix specified by result with a rotation matrix and return new matrix in result
+/// \param result Specifies the input matrix.  Rotated matrix is returned in result.
+/// \param angle Specifies the angle of rotation, in degrees.
+/// \param x, y, z Specify the x, y and z coordinates of a vector, respectively
+//
+void ESUTIL_API esRotate ( ESMatrix *result, GLfloat angle, GLfloat x, GLfloat y, GLfloat z );
+
+//
+/// \brief Multiply matrix specified by result with a perspective matrix and return new matrix in result
+/// \param result Specifies the input matrix.  New matrix is returned in result.
+/// \param left, right Coordinates for the left and right vertical clipping planes
+/// \param bottom, top Coordinates for the bottom and top horizontal clipping planes
+/// \param nearZ, farZ Distances to the near and far depth clipping planes.  Both distances must be positive.
+//
+void ESUTIL_API esFrustum ( ESMatrix *result, float left, float right, float bottom, float top, float nearZ, float farZ );
 
 //
 /// \brief Multiply matrix specified by result with a perspective matrix and return new matrix in result
@@ -316,6 +1652,15 @@ void ESUTIL_API esOrtho ( ESMatrix *result, float left, float right, float botto
 //
 void ESUTIL_API esMatrixMultiply ( ESMatrix *result, ESMatrix *srcA, ESMatrix *srcB );
 
+//
+/// \brief Perform out[i] = a[i] * b[i] for count matrix pairs.  Uses the widest SIMD path
+///        available (AVX, SSE or NEON) and falls back to scalar code otherwise.
+/// \param out Returns count multiplied matrices, may alias a or b element-for-element
+/// \param a, b Arrays of count input matrices to be multiplied
+/// \param count Number of matrix pairs
+//
+void ESUTIL_API esMatrixMultiplyBatch ( ESMatrix *out, const ESMatrix *a, const ESMatrix *b, int count );
+
 //
 //// \brief Return an identity matrix
 //// \param result Returns identity matrix
@@ -335,6 +1680,35 @@ esMatrixLookAt ( ESMatrix *result,
                  float lookAtX, float lookAtY, float lookAtZ,
                  float upX,     float upY,     float upZ );
 
+//
+/// \brief Extract the view frustum planes of a transform, in the space the transform maps from
+/// \param frustum Returns the six normalized planes
+/// \param mvp Transform to clip space, e.g. a modelview times a projection for object space planes
+//
+void ESUTIL_API esExtractFrustumPlanes ( ESFrustumPlanes *frustum, const ESMatrix *mvp );
+
+//
+/// \brief Find the spheres that intersect a view frustum.  Spheres are tested four at a time,
+///        eight with AVX.  Spheres near a corner of the frustum, outside it but not wholly behind
+///        any one plane, are kept.
+/// \param pool Thread pool to split large batches across, or NULL for the calling thread
+/// \param frustum Planes from esExtractFrustumPlanes
+/// \param spheres Centers and radii
+/// \param count Number of spheres
+/// \param visible Returns the indices of the visible spheres in ascending order, room for count
+/// \return Number of visible spheres
+//
+int ESUTIL_API esCullSpheres ( ESThreadPool *pool, const ESFrustumPlanes *frustum, const ESSphereArrays *spheres,
+                               int count, GLuint *visible );
+
+//
+/// \brief Find the axis aligned boxes that intersect a view frustum, as esCullSpheres does for
+///        spheres
+/// \param boxes Centers and half sizes
+//
+int ESUTIL_API esCullBoxes ( ESThreadPool *pool, const ESFrustumPlanes *frustum, const ESBoxArrays *boxes,
+                             int count, GLuint *visible );
+
 #ifdef __cplusplus
 }
 #endif
@@ -65,6 +65,15 @@ extern "C" {
 //
 GLboolean WinCreate ( ESContext *esContext, const char *title );
 
+///
+//  esRenderFrame()
+//
+//      Run the update and draw callbacks and swap buffers for one frame,
+//      recording the time spent in each into esContext->frameStats.  Shared
+//      by the platform main loops; implemented in esUtil.c.
+//
+void esRenderFrame ( ESContext *esContext, float deltaTime );
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,8 +39,8 @@
 //
 #include <android/log.h>
 #include <android_native_app_glue.h>
-#include <time.h>
 #include "esUtil.h"
+#include "esUtil_win.h"
 
 #define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, "esUtil", __VA_ARGS__))
 
@@ -51,17 +51,6 @@
 //
 //
 
-///
-// GetCurrentTime()
-//
-static float GetCurrentTime()
-{
-   struct timespec clockRealTime;
-   clock_gettime ( CLOCK_MONOTONIC, &clockRealTime );
-   double curTimeInSeconds = clockRealTime.tv_sec + ( double ) clockRealTime.tv_nsec / 1e9;
-   return ( float ) curTimeInSeconds;
-}
-
 ///
 // HandleCommand()
 //
@@ -136,7 +125,7 @@ extern int esMain ( ESContext *esContext );
 void android_main ( struct android_app *pApp )
 {
    ESContext esContext;
-   float lastTime;
+   GLuint64 lastTime;
 
    // Make sure glue isn't stripped.
    app_dummy();
@@ -149,7 +138,7 @@ void android_main ( struct android_app *pApp )
    pApp->onAppCmd = HandleCommand;
    pApp->userData = &esContext;
 
-   lastTime = GetCurrentTime();
+   lastTime = esGetTimeNs();
 
    while ( 1 )
    {
@@ -177,19 +166,12 @@ void android_main ( struct android_app *pApp )
          continue;
       }
 
-      // Call app update function
-      if ( esContext.updateFunc != NULL )
+      // Call app update and draw functions
       {
-         float curTime = GetCurrentTime();
-         float deltaTime =  ( curTime - lastTime );
+         GLuint64 curTime = esGetTimeNs();
+         float deltaTime = ( float ) ( ( curTime - lastTime ) * 1e-9 );
          lastTime = curTime;
-         esContext.updateFunc ( &esContext, deltaTime );
-      }
-
-      if ( esContext.drawFunc != NULL )
-      {
-         esContext.drawFunc ( &esContext );
-         eglSwapBuffers ( esContext.eglDisplay, esContext.eglSurface );
+         esRenderFrame ( &esContext, deltaTime );
       }
    }
 }
@@ -20,8 +20,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
-#include <sys/time.h>
+#include <signal.h>
 #include "esUtil.h"
+#include "esUtil_win.h"
 
 #include  <X11/Xlib.h>
 #include  <X11/Xatom.h>
@@ -31,12 +32,58 @@
 static Display *x_display = NULL;
 static Atom s_wmDeleteMessage;
 
+// Set from the signal handler to stop a headless run
+static volatile sig_atomic_t s_headlessInterrupt = 0;
+
+// Benchmark mode defaults
+#define BENCH_WARMUP_FRAMES     30
+#define BENCH_MEASURED_FRAMES   300
+#define BENCH_DELTA_TIME        ( 1.0f / 60.0f )
+
 //////////////////////////////////////////////////////////////////
 //
 //  Private Functions
 //
 //
 
+///
+//  HeadlessSignal()
+//
+//      SIGINT/SIGTERM handler used in place of the X11 close event
+//
+static void HeadlessSignal ( int sig )
+{
+    ( void ) sig;
+    s_headlessInterrupt = 1;
+}
+
+///
+//  HeadlessLoop()
+//
+//      Frame loop for ES_WINDOW_HEADLESS contexts.  There is no X server to
+//      poll, so frames run back to back until a signal arrives or the frame
+//      count given by ES_HEADLESS_FRAMES (if set) has been rendered.
+//
+static void HeadlessLoop ( ESContext *esContext )
+{
+    GLuint64 t1, t2;
+    const char *framesEnv = getenv ( "ES_HEADLESS_FRAMES" );
+    long maxFrames = framesEnv != NULL ? atol ( framesEnv ) : 0;
+    long frame;
+
+    signal ( SIGINT, HeadlessSignal );
+    signal ( SIGTERM, HeadlessSignal );
+
+    t1 = esGetTimeNs ();
+
+    for ( frame = 0; !s_headlessInterrupt && ( maxFrames <= 0 || frame < maxFrames ); frame++ )
+    {
+        t2 = esGetTimeNs ();
+        esRenderFrame ( esContext, (float)((t2 - t1) * 1e-9) );
+        t1 = t2;
+    }
+}
+
 
 //////////////////////////////////////////////////////////////////
 //
@@ -49,7 +96,7 @@ static Atom s_wmDeleteMessage;
 //
 //      This function initialized the native X11 display and window for EGL
 //
-EGLBoolean WinCreate(ESContext *esContext, const char *title)
+GLboolean WinCreate(ESContext *esContext, const char *title)
 {
     Window root;
     XSetWindowAttributes swa;
@@ -159,25 +206,160 @@ GLboolean userInterrupt(ESContext *esContext)
 //
 void WinLoop ( ESContext *esContext )
 {
-    struct timeval t1, t2;
-    struct timezone tz;
-    float deltatime;
+    GLuint64 t1, t2;
 
-    gettimeofday ( &t1 , &tz );
+    if ( esContext->flags & ES_WINDOW_HEADLESS )
+    {
+        HeadlessLoop ( esContext );
+        return;
+    }
+
+    t1 = esGetTimeNs ();
 
     while(userInterrupt(esContext) == GL_FALSE)
     {
-        gettimeofday(&t2, &tz);
-        deltatime = (float)(t2.tv_sec - t1.tv_sec + (t2.tv_usec - t1.tv_usec) * 1e-6);
+        t2 = esGetTimeNs ();
+        esRenderFrame ( esContext, (float)((t2 - t1) * 1e-9) );
         t1 = t2;
+    }
+}
+
+///
+//  BenchCompare()
+//
+static int BenchCompare ( const void *a, const void *b )
+{
+    double da = *( const double * ) a;
+    double db = *( const double * ) b;
+    return ( da > db ) - ( da < db );
+}
+
+///
+//  BenchPrintStats()
+//
+//      Sort the samples and print min/median/p99 in milliseconds as a JSON object
+//
+static void BenchPrintStats ( const char *name, double *samples, int count )
+{
+    int p99 = ( int ) ( count * 0.99 + 0.999 ) - 1;
+
+    qsort ( samples, count, sizeof ( double ), BenchCompare );
+    printf ( "\"%s\":{\"min\":%.4f,\"median\":%.4f,\"p99\":%.4f}", name,
+             samples[0] * 1000.0, samples[count / 2] * 1000.0, samples[p99 < 0 ? 0 : p99] * 1000.0 );
+}
+
+///
+//  BenchLoop()
+//
+//      Run warmupFrames untimed frames followed by measuredFrames timed frames,
+//      all with a fixed deltaTime so every run animates identically.  CPU time
+//      covers update + draw; GPU-inclusive time additionally covers the swap and
+//      a glFinish() so queued GPU work is charged to the frame that issued it.
+//      Results are printed as a single line of JSON.
+//
+static int BenchLoop ( ESContext *esContext, const char *name, int warmupFrames, int measuredFrames )
+{
+    double *cpuTimes = malloc ( measuredFrames * sizeof ( double ) );
+    double *gpuTimes = malloc ( measuredFrames * sizeof ( double ) );
+    double total = 0.0;
+    int frame;
+
+    if ( cpuTimes == NULL || gpuTimes == NULL )
+    {
+        free ( cpuTimes );
+        free ( gpuTimes );
+        return GL_FALSE;
+    }
+
+    for ( frame = 0; frame < warmupFrames + measuredFrames; frame++ )
+    {
+        ESFrameStats *stats = &esContext->frameStats;
+        GLuint64 start, finished;
+
+        if ( !( esContext->flags & ES_WINDOW_HEADLESS ) && userInterrupt ( esContext ) )
+        {
+            break;
+        }
+
+        start = esGetTimeNs ();
+        esRenderFrame ( esContext, BENCH_DELTA_TIME );
+        glFinish ();
+        finished = esGetTimeNs ();
 
-        if (esContext->updateFunc != NULL)
-            esContext->updateFunc(esContext, deltatime);
-        if (esContext->drawFunc != NULL)
-            esContext->drawFunc(esContext);
+        if ( frame >= warmupFrames )
+        {
+            cpuTimes[frame - warmupFrames] = ( stats->update.last + stats->draw.last ) * 1e-9;
+            gpuTimes[frame - warmupFrames] = ( finished - start ) * 1e-9;
+            total += ( finished - start ) * 1e-9;
+        }
+    }
 
-        eglSwapBuffers(esContext->eglDisplay, esContext->eglSurface);        
+    if ( frame < warmupFrames + measuredFrames )
+    {
+        free ( cpuTimes );
+        free ( gpuTimes );
+        return GL_FALSE;
     }
+
+    printf ( "{\"sample\":\"%s\",\"width\":%d,\"height\":%d,\"headless\":%s,"
+             "\"warmup_frames\":%d,\"frames\":%d,\"delta_time\":%.6f,",
+             name, esContext->width, esContext->height,
+             ( esContext->flags & ES_WINDOW_HEADLESS ) ? "true" : "false",
+             warmupFrames, measuredFrames, BENCH_DELTA_TIME );
+    BenchPrintStats ( "cpu_ms", cpuTimes, measuredFrames );
+    printf ( "," );
+    BenchPrintStats ( "gpu_ms", gpuTimes, measuredFrames );
+    printf ( ",\"fps\":%.2f}\n", measuredFrames / total );
+    fflush ( stdout );
+
+    free ( cpuTimes );
+    free ( gpuTimes );
+    return GL_TRUE;
+}
+
+///
+//  ParseBenchOptions()
+//
+//      Benchmark mode is enabled by "--bench[=warmup,frames]" on the command
+//      line or by the ES_BENCH environment variable ("1" or "warmup,frames").
+//      Returns GL_TRUE if benchmark mode was requested.
+//
+static GLboolean ParseBenchOptions ( int argc, char *argv[], int *warmupFrames, int *measuredFrames )
+{
+    const char *spec = getenv ( "ES_BENCH" );
+    int i;
+
+    for ( i = 1; i < argc; i++ )
+    {
+        if ( strcmp ( argv[i], "--bench" ) == 0 )
+        {
+            spec = "";
+        }
+        else if ( strncmp ( argv[i], "--bench=", 8 ) == 0 )
+        {
+            spec = argv[i] + 8;
+        }
+    }
+
+    if ( spec == NULL )
+    {
+        return GL_FALSE;
+    }
+
+    *warmupFrames = BENCH_WARMUP_FRAMES;
+    *measuredFrames = BENCH_MEASURED_FRAMES;
+
+    if ( strchr ( spec, ',' ) != NULL )
+    {
+        sscanf ( spec, "%d,%d", warmupFrames, measuredFrames );
+    }
+
+    if ( *warmupFrames < 0 )
+        *warmupFrames = 0;
+    if ( *measuredFrames < 1 )
+        *measuredFrames = 1;
+
+    return GL_TRUE;
 }
 
 ///
@@ -194,6 +376,8 @@ extern int esMain( ESContext *esContext );
 int main ( int argc, char *argv[] )
 {
    ESContext esContext;
+   int warmupFrames, measuredFrames;
+   int result = 0;
    
    memset ( &esContext, 0, sizeof( esContext ) );
 
@@ -201,7 +385,17 @@ int main ( int argc, char *argv[] )
    if ( esMain ( &esContext ) != GL_TRUE )
       return 1;   
  
-   WinLoop ( &esContext );
+   if ( ParseBenchOptions ( argc, argv, &warmupFrames, &measuredFrames ) )
+   {
+      const char *name = strrchr ( argv[0], '/' );
+
+      if ( !BenchLoop ( &esContext, name != NULL ? name + 1 : argv[0], warmupFrames, measuredFrames ) )
+         result = 1;
+   }
+   else
+   {
+      WinLoop ( &esContext );
+   }
 
    if ( esContext.shutdownFunc != NULL )
 	   esContext.shutdownFunc ( &esContext );
@@ -209,5 +403,5 @@ int main ( int argc, char *argv[] )
    if ( esContext.userData != NULL )
 	   free ( esContext.userData );
 
-   return 0;
+   return result;
 }
@@ -41,6 +41,7 @@
 #include <windows.h>
 #include <stdlib.h>
 #include "esUtil.h"
+#include "esUtil_win.h"
 
 #ifdef _WIN64
 #define GWL_USERDATA GWLP_USERDATA
@@ -191,14 +192,11 @@ void WinLoop ( ESContext *esContext )
 {
    MSG msg = { 0 };
    int done = 0;
-   DWORD lastTime = GetTickCount();
+   GLuint64 lastTime = esGetTimeNs();
 
    while ( !done )
    {
       int gotMsg = ( PeekMessage ( &msg, NULL, 0, 0, PM_REMOVE ) != 0 );
-      DWORD curTime = GetTickCount();
-      float deltaTime = ( float ) ( curTime - lastTime ) / 1000.0f;
-      lastTime = curTime;
 
       if ( gotMsg )
       {
@@ -214,13 +212,12 @@ void WinLoop ( ESContext *esContext )
       }
       else
       {
-         SendMessage ( esContext->eglNativeWindow, WM_PAINT, 0, 0 );
-      }
+         GLuint64 curTime = esGetTimeNs();
+         float deltaTime = ( float ) ( ( curTime - lastTime ) * 1e-9 );
+         lastTime = curTime;
 
-      // Call update function if registered
-      if ( esContext->updateFunc != NULL )
-      {
-         esContext->updateFunc ( esContext, deltaTime );
+         // Update, draw and swap, recording frame timing
+         esRenderFrame ( esContext, deltaTime );
       }
    }
 }
@@ -0,0 +1,285 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esArena.c
+//
+//    Linear allocator for transient memory: allocations bump a pointer
+//    through a chain of large blocks and are released all at once, back to
+//    a mark or to the start.  Released blocks are kept for reuse.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include "esArena.h"
+#include <stdlib.h>
+#include <string.h>
+
+///
+//  Macros
+//
+#define ARENA_ALIGNMENT       16
+#define ARENA_DEFAULT_BLOCK   ( 1 << 20 )
+
+#define ARENA_ALIGN( size )   ( ( ( size ) + ARENA_ALIGNMENT - 1 ) & ~( size_t ) ( ARENA_ALIGNMENT - 1 ) )
+
+///
+//  Types
+//
+typedef struct ArenaBlock
+{
+   struct ArenaBlock *next;
+
+   // Usable bytes after the header
+   size_t             size;
+} ArenaBlock;
+
+struct ESArena
+{
+   ArenaBlock    *first;
+   ArenaBlock    *current;
+
+   // Next free byte in the current block
+   size_t         offset;
+
+   // Minimum size of new blocks
+   size_t         blockSize;
+
+   ESArenaStats   stats;
+};
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// BlockData()
+//
+static unsigned char *BlockData ( ArenaBlock *block )
+{
+   return ( unsigned char * ) block + ARENA_ALIGN ( sizeof ( ArenaBlock ) );
+}
+
+///
+// NewBlock()
+//
+static ArenaBlock *NewBlock ( ESArena *arena, size_t size )
+{
+   ArenaBlock *block = ( ArenaBlock * ) malloc ( ARENA_ALIGN ( sizeof ( ArenaBlock ) ) + size );
+
+   if ( block != NULL )
+   {
+      block->next = NULL;
+      block->size = size;
+      arena->stats.capacity += size;
+      arena->stats.blocks++;
+   }
+
+   return block;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esArenaCreate()
+//
+ESArena *ESUTIL_API esArenaCreate ( size_t blockSize )
+{
+   ESArena *arena = ( ESArena * ) calloc ( 1, sizeof ( ESArena ) );
+
+   if ( arena == NULL )
+   {
+      return NULL;
+   }
+
+   arena->blockSize = ARENA_ALIGN ( blockSize != 0 ? blockSize : ARENA_DEFAULT_BLOCK );
+   arena->first = NewBlock ( arena, arena->blockSize );
+
+   if ( arena->first == NULL )
+   {
+      free ( arena );
+      return NULL;
+   }
+
+   arena->current = arena->first;
+
+   return arena;
+}
+
+///
+// esArenaDestroy()
+//
+void ESUTIL_API esArenaDestroy ( ESArena *arena )
+{
+   ArenaBlock *block;
+
+   if ( arena == NULL )
+   {
+      return;
+   }
+
+   block = arena->first;
+
+   while ( block != NULL )
+   {
+      ArenaBlock *next = block->next;
+      free ( block );
+      block = next;
+   }
+
+   free ( arena );
+}
+
+///
+// esArenaAlloc()
+//
+void *ESUTIL_API esArenaAlloc ( ESArena *arena, size_t size )
+{
+   void *memory;
+
+   size = ARENA_ALIGN ( size );
+
+   if ( size > arena->current->size - arena->offset )
+   {
+      ArenaBlock *next = arena->current->next;
+
+      // Move on to the next block kept from before a release, or put a new
+      // one in front of it if it is too small
+      if ( next == NULL || next->size < size )
+      {
+         ArenaBlock *block = NewBlock ( arena, size > arena->blockSize ? size : arena->blockSize );
+
+         if ( block == NULL )
+         {
+            return NULL;
+         }
+
+         block->next = next;
+         arena->current->next = block;
+         next = block;
+      }
+
+      arena->current = next;
+      arena->offset = 0;
+   }
+
+   memory = BlockData ( arena->current ) + arena->offset;
+   arena->offset += size;
+
+   arena->stats.allocations++;
+   arena->stats.bytesAllocated += size;
+   arena->stats.bytesInUse += size;
+
+   if ( arena->stats.bytesInUse > arena->stats.peakBytesInUse )
+   {
+      arena->stats.peakBytesInUse = arena->stats.bytesInUse;
+   }
+
+   return memory;
+}
+
+///
+// esArenaGetMark()
+//
+ESArenaMark ESUTIL_API esArenaGetMark ( ESArena *arena )
+{
+   ESArenaMark mark;
+
+   mark.block = arena->current;
+   mark.offset = arena->offset;
+   mark.bytesInUse = arena->stats.bytesInUse;
+
+   return mark;
+}
+
+///
+// esArenaRelease()
+//
+void ESUTIL_API esArenaRelease ( ESArena *arena, ESArenaMark mark )
+{
+   arena->current = ( ArenaBlock * ) mark.block;
+   arena->offset = mark.offset;
+   arena->stats.bytesInUse = mark.bytesInUse;
+}
+
+///
+// esArenaReset()
+//
+void ESUTIL_API esArenaReset ( ESArena *arena )
+{
+   arena->current = arena->first;
+   arena->offset = 0;
+   arena->stats.bytesInUse = 0;
+}
+
+///
+// esArenaGetStats()
+//
+const ESArenaStats *ESUTIL_API esArenaGetStats ( ESArena *arena )
+{
+   return &arena->stats;
+}
+
+///
+// esArenaResetStats()
+//
+void ESUTIL_API esArenaResetStats ( ESArena *arena )
+{
+   arena->stats.allocations = 0;
+   arena->stats.bytesAllocated = 0;
+   arena->stats.peakBytesInUse = arena->stats.bytesInUse;
+}
+
+///
+// esArenaMalloc()
+//
+void *esArenaMalloc ( ESArena *arena, size_t size )
+{
+   return arena != NULL ? esArenaAlloc ( arena, size ) : malloc ( size );
+}
+
+///
+// esArenaFree()
+//
+void esArenaFree ( ESArena *arena, void *memory )
+{
+   if ( arena == NULL )
+   {
+      free ( memory );
+   }
+}
@@ -29,8 +29,32 @@
 // URLs:      http://www.opengles-book.com
 //            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
 //
-// Noise3D.h
+// esArena.h
 //
-// Generates a 3D noise
+//    Private helpers for Common functions that allocate either from an
+//    ESArena or, when none is given, from the heap.
 //
-unsigned int Create3DNoiseTexture ( int textureSize, float frequency );
+#ifndef ESARENA_H
+#define ESARENA_H
+
+///
+//  Includes
+//
+#include "esUtil.h"
+
+///
+//  Public Functions
+//
+
+///
+// Allocate from the arena, or with malloc if arena is NULL
+//
+void *esArenaMalloc ( ESArena *arena, size_t size );
+
+///
+// free() memory from esArenaMalloc if it came from the heap; arena memory is
+// left for the arena's release or reset
+//
+void esArenaFree ( ESArena *arena, void *memory );
+
+#endif // ESARENA_H
@@ -0,0 +1,593 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esAssetLoader.c
+//
+//    Loads textures without stalling the render thread.  Images are decoded
+//    on a thread pool, then copied into a ring of pixel unpack buffers and
+//    uploaded with glTexSubImage2D from the GL thread, a strip at a time.  An
+//    ESFenceRing over the staging buffers tells us when the GPU is done
+//    reading one, so the GL thread never waits on an upload.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include "esThread.h"
+#include <stdlib.h>
+#include <string.h>
+
+///
+//  Macros
+//
+#define DEFAULT_STAGING_BUFFER_COUNT   3
+#define DEFAULT_STAGING_BUFFER_SIZE    ( 1024 * 1024 )
+
+///
+//  Types
+//
+typedef struct AssetRequest
+{
+   ESAssetLoader *loader;
+
+   // Inputs, set on the GL thread
+   void          *ioContext;
+   char          *fileName;
+   GLuint         texture;
+   GLenum         internalFormat;
+   GLenum         format;
+
+   // Decoded on a worker
+   ESImage        image;
+   GLboolean      decoded;
+
+   // Next row to upload, GL thread only
+   int            nextRow;
+
+   struct AssetRequest *next;
+} AssetRequest;
+
+typedef struct
+{
+   GLuint         buffer;
+   GLsizeiptr     size;
+} StagingBuffer;
+
+struct ESAssetLoader
+{
+   ESThreadPool  *pool;
+   GLboolean      ownsPool;
+
+   ESMutex        mutex;
+   ESCond         cond;
+
+   // Requests the workers have finished with, oldest first (guarded by mutex)
+   AssetRequest  *decodedHead;
+   AssetRequest  *decodedTail;
+
+   // Requests still being decoded (guarded by mutex)
+   int            decoding;
+
+   // Requests waiting for or in the middle of their upload, GL thread only
+   AssetRequest  *uploadHead;
+   AssetRequest  *uploadTail;
+
+   // Textures requested but not yet fully uploaded, GL thread only
+   int            pending;
+
+   // Staging buffer i is guarded by slot i of the fence ring
+   StagingBuffer *staging;
+   int            stagingCount;
+   ESFenceRing   *stagingFences;
+};
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// PixelBytes()
+//
+//    Bytes per GL_UNSIGNED_BYTE pixel of a texture format, 0 if not supported
+//
+static int PixelBytes ( GLenum format )
+{
+   switch ( format )
+   {
+      case GL_ALPHA:
+      case GL_LUMINANCE:
+      case GL_RED:
+      case GL_R8:
+         return 1;
+
+      case GL_LUMINANCE_ALPHA:
+      case GL_RG:
+      case GL_RG8:
+         return 2;
+
+      case GL_RGB:
+      case GL_RGB8:
+      case GL_SRGB8:
+         return 3;
+
+      case GL_RGBA:
+      case GL_RGBA8:
+      case GL_SRGB8_ALPHA8:
+         return 4;
+
+      default:
+         return 0;
+   }
+}
+
+///
+// DecodeTask()
+//
+//    Runs on the thread pool
+//
+static void DecodeTask ( void *arg )
+{
+   AssetRequest *request = ( AssetRequest * ) arg;
+   ESAssetLoader *loader = request->loader;
+
+   request->decoded = esLoadTGAImage ( request->ioContext, request->fileName, &request->image );
+
+   // The upload reads width * PixelBytes ( format ) bytes per row of the image
+   if ( request->decoded && ( PixelBytes ( request->format ) != request->image.bytesPerPixel ||
+                              PixelBytes ( request->internalFormat ) != request->image.bytesPerPixel ) )
+   {
+      esLogMessage ( "esAssetLoader: %s has %d bytes per pixel, which does not match the requested format\n",
+                     request->fileName, request->image.bytesPerPixel );
+      esReleaseImage ( &request->image );
+      request->decoded = GL_FALSE;
+   }
+
+   esMutexLock ( &loader->mutex );
+
+   if ( loader->decodedTail != NULL )
+   {
+      loader->decodedTail->next = request;
+   }
+   else
+   {
+      loader->decodedHead = request;
+   }
+
+   loader->decodedTail = request;
+   loader->decoding--;
+
+   esCondBroadcast ( &loader->cond );
+   esMutexUnlock ( &loader->mutex );
+}
+
+///
+// FreeRequest()
+//
+static void FreeRequest ( AssetRequest *request )
+{
+   esReleaseImage ( &request->image );
+   free ( request->fileName );
+   free ( request );
+}
+
+///
+// CollectDecoded()
+//
+//    Move the requests the workers have finished onto the upload list
+//
+static void CollectDecoded ( ESAssetLoader *loader )
+{
+   AssetRequest *head;
+   AssetRequest *tail;
+
+   esMutexLock ( &loader->mutex );
+   head = loader->decodedHead;
+   tail = loader->decodedTail;
+   loader->decodedHead = NULL;
+   loader->decodedTail = NULL;
+   esMutexUnlock ( &loader->mutex );
+
+   if ( head == NULL )
+   {
+      return;
+   }
+
+   if ( loader->uploadTail != NULL )
+   {
+      loader->uploadTail->next = head;
+   }
+   else
+   {
+      loader->uploadHead = head;
+   }
+
+   loader->uploadTail = tail;
+}
+
+///
+// AcquireStaging()
+//
+//    Return the next staging buffer in the ring if the GPU has finished
+//    reading it, without waiting unless timeout is nonzero
+//
+static StagingBuffer *AcquireStaging ( ESAssetLoader *loader, GLuint64 timeout )
+{
+   int slot = esFenceRingAcquire ( loader->stagingFences, timeout );
+
+   return slot < 0 ? NULL : &loader->staging[slot];
+}
+
+///
+// UploadStrip()
+//
+//    Copy as many rows of the request's image as fit into staging and issue
+//    the glTexSubImage2D for them.  Returns GL_FALSE if the buffer could not
+//    be mapped.
+//
+static GLboolean UploadStrip ( AssetRequest *request, StagingBuffer *staging )
+{
+   ESImage *image = &request->image;
+   GLsizeiptr rowSize = ( GLsizeiptr ) image->width * image->bytesPerPixel;
+   GLsizeiptr rows;
+   void *dst;
+
+   if ( request->nextRow == 0 )
+   {
+      // Allocate the texture storage, sourcing nothing from the unpack buffer
+      glBindBuffer ( GL_PIXEL_UNPACK_BUFFER, 0 );
+      glBindTexture ( GL_TEXTURE_2D, request->texture );
+      glTexImage2D ( GL_TEXTURE_2D, 0, request->internalFormat, image->width, image->height, 0,
+                     request->format, GL_UNSIGNED_BYTE, NULL );
+   }
+
+   glBindBuffer ( GL_PIXEL_UNPACK_BUFFER, staging->buffer );
+
+   if ( staging->size < rowSize )
+   {
+      // A single row does not fit, grow this buffer
+      staging->size = rowSize;
+      glBufferData ( GL_PIXEL_UNPACK_BUFFER, staging->size, NULL, GL_STREAM_DRAW );
+   }
+
+   rows = staging->size / rowSize;
+
+   if ( rows > image->height - request->nextRow )
+   {
+      rows = image->height - request->nextRow;
+   }
+
+   // The fence has signalled, so nothing is reading this buffer any more
+   dst = glMapBufferRange ( GL_PIXEL_UNPACK_BUFFER, 0, rows * rowSize,
+                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT );
+
+   if ( dst == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   memcpy ( dst, image->pixels + request->nextRow * rowSize, rows * rowSize );
+   glUnmapBuffer ( GL_PIXEL_UNPACK_BUFFER );
+
+   glBindTexture ( GL_TEXTURE_2D, request->texture );
+   glTexSubImage2D ( GL_TEXTURE_2D, 0, 0, request->nextRow, image->width, ( GLsizei ) rows,
+                     request->format, GL_UNSIGNED_BYTE, ( const void * ) 0 );
+
+   request->nextRow += ( int ) rows;
+
+   return GL_TRUE;
+}
+
+///
+// PumpUploads()
+//
+//    Upload strips until the request list is empty or the staging ring is
+//    full.  Only waits for a staging buffer if timeout is nonzero.
+//
+static void PumpUploads ( ESAssetLoader *loader, GLuint64 timeout )
+{
+   GLint unpackBuffer;
+   GLint unpackAlignment;
+   GLint texture;
+
+   CollectDecoded ( loader );
+
+   if ( loader->uploadHead == NULL )
+   {
+      return;
+   }
+
+   glGetIntegerv ( GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer );
+   glGetIntegerv ( GL_UNPACK_ALIGNMENT, &unpackAlignment );
+   glGetIntegerv ( GL_TEXTURE_BINDING_2D, &texture );
+
+   // Staged rows are tightly packed
+   glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
+
+   while ( loader->uploadHead != NULL )
+   {
+      AssetRequest *request = loader->uploadHead;
+      StagingBuffer *staging;
+      GLboolean done = GL_TRUE;
+
+      if ( request->decoded )
+      {
+         staging = AcquireStaging ( loader, timeout );
+
+         if ( staging == NULL )
+         {
+            break;
+         }
+
+         if ( UploadStrip ( request, staging ) )
+         {
+            done = request->nextRow >= request->image.height;
+         }
+         else
+         {
+            esLogMessage ( "esAssetLoader: could not map a staging buffer for %s\n", request->fileName );
+         }
+
+         esFenceRingSubmit ( loader->stagingFences );
+      }
+      else
+      {
+         esLogMessage ( "esAssetLoader: could not load %s\n", request->fileName );
+      }
+
+      if ( done )
+      {
+         loader->uploadHead = request->next;
+
+         if ( loader->uploadHead == NULL )
+         {
+            loader->uploadTail = NULL;
+         }
+
+         loader->pending--;
+         FreeRequest ( request );
+      }
+   }
+
+   glPixelStorei ( GL_UNPACK_ALIGNMENT, unpackAlignment );
+   glBindTexture ( GL_TEXTURE_2D, ( GLuint ) texture );
+   glBindBuffer ( GL_PIXEL_UNPACK_BUFFER, ( GLuint ) unpackBuffer );
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esAssetLoaderCreate()
+//
+ESAssetLoader *ESUTIL_API esAssetLoaderCreate ( ESThreadPool *pool, int stagingBufferCount, GLsizeiptr stagingBufferSize )
+{
+   ESAssetLoader *loader;
+   int i;
+
+   if ( stagingBufferCount <= 0 )
+   {
+      stagingBufferCount = DEFAULT_STAGING_BUFFER_COUNT;
+   }
+
+   if ( stagingBufferSize <= 0 )
+   {
+      stagingBufferSize = DEFAULT_STAGING_BUFFER_SIZE;
+   }
+
+   loader = ( ESAssetLoader * ) calloc ( 1, sizeof ( ESAssetLoader ) );
+
+   if ( loader == NULL )
+   {
+      return NULL;
+   }
+
+   loader->staging = ( StagingBuffer * ) calloc ( stagingBufferCount, sizeof ( StagingBuffer ) );
+   loader->stagingFences = esFenceRingCreate ( stagingBufferCount );
+
+   if ( loader->staging == NULL || loader->stagingFences == NULL )
+   {
+      esFenceRingDestroy ( loader->stagingFences );
+      free ( loader->staging );
+      free ( loader );
+      return NULL;
+   }
+
+   loader->pool = pool;
+
+   if ( loader->pool == NULL )
+   {
+      loader->pool = esThreadPoolCreate ( 0 );
+      loader->ownsPool = GL_TRUE;
+
+      if ( loader->pool == NULL )
+      {
+         esFenceRingDestroy ( loader->stagingFences );
+         free ( loader->staging );
+         free ( loader );
+         return NULL;
+      }
+   }
+
+   esMutexInit ( &loader->mutex );
+   esCondInit ( &loader->cond );
+
+   loader->stagingCount = stagingBufferCount;
+
+   for ( i = 0; i < stagingBufferCount; i++ )
+   {
+      glGenBuffers ( 1, &loader->staging[i].buffer );
+      glBindBuffer ( GL_PIXEL_UNPACK_BUFFER, loader->staging[i].buffer );
+      glBufferData ( GL_PIXEL_UNPACK_BUFFER, stagingBufferSize, NULL, GL_STREAM_DRAW );
+      loader->staging[i].size = stagingBufferSize;
+   }
+
+   glBindBuffer ( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+   return loader;
+}
+
+///
+// esAssetLoaderDestroy()
+//
+void ESUTIL_API esAssetLoaderDestroy ( ESAssetLoader *loader )
+{
+   int i;
+
+   if ( loader == NULL )
+   {
+      return;
+   }
+
+   // Let the workers finish with the requests they hold
+   esMutexLock ( &loader->mutex );
+
+   while ( loader->decoding > 0 )
+   {
+      esCondWait ( &loader->cond, &loader->mutex );
+   }
+
+   esMutexUnlock ( &loader->mutex );
+
+   CollectDecoded ( loader );
+
+   while ( loader->uploadHead != NULL )
+   {
+      AssetRequest *request = loader->uploadHead;
+
+      loader->uploadHead = request->next;
+      FreeRequest ( request );
+   }
+
+   for ( i = 0; i < loader->stagingCount; i++ )
+   {
+      glDeleteBuffers ( 1, &loader->staging[i].buffer );
+   }
+
+   esFenceRingDestroy ( loader->stagingFences );
+
+   if ( loader->ownsPool )
+   {
+      esThreadPoolDestroy ( loader->pool );
+   }
+
+   esCondDestroy ( &loader->cond );
+   esMutexDestroy ( &loader->mutex );
+
+   free ( loader->staging );
+   free ( loader );
+}
+
+///
+// esAssetLoaderLoadTexture()
+//
+GLuint ESUTIL_API esAssetLoaderLoadTexture ( ESAssetLoader *loader, void *ioContext, const char *fileName,
+                                             GLenum internalFormat, GLenum format )
+{
+   AssetRequest *request = ( AssetRequest * ) calloc ( 1, sizeof ( AssetRequest ) );
+   size_t length = strlen ( fileName ) + 1;
+
+   if ( request == NULL )
+   {
+      return 0;
+   }
+
+   request->fileName = ( char * ) malloc ( length );
+
+   if ( request->fileName == NULL )
+   {
+      free ( request );
+      return 0;
+   }
+
+   memcpy ( request->fileName, fileName, length );
+   request->loader = loader;
+   request->ioContext = ioContext;
+   request->internalFormat = internalFormat;
+   request->format = format;
+
+   glGenTextures ( 1, &request->texture );
+
+   esMutexLock ( &loader->mutex );
+   loader->decoding++;
+   esMutexUnlock ( &loader->mutex );
+
+   if ( !esThreadPoolSubmit ( loader->pool, DecodeTask, request ) )
+   {
+      esMutexLock ( &loader->mutex );
+      loader->decoding--;
+      esMutexUnlock ( &loader->mutex );
+
+      glDeleteTextures ( 1, &request->texture );
+      FreeRequest ( request );
+      return 0;
+   }
+
+   loader->pending++;
+
+   return request->texture;
+}
+
+///
+// esAssetLoaderUpdate()
+//
+int ESUTIL_API esAssetLoaderUpdate ( ESAssetLoader *loader )
+{
+   PumpUploads ( loader, 0 );
+
+   return loader->pending;
+}
+
+///
+// esAssetLoaderFinish()
+//
+void ESUTIL_API esAssetLoaderFinish ( ESAssetLoader *loader )
+{
+   while ( loader->pending > 0 )
+   {
+      // Sleep until a worker hands something over if there is nothing to upload
+      esMutexLock ( &loader->mutex );
+
+      while ( loader->uploadHead == NULL && loader->decodedHead == NULL && loader->decoding > 0 )
+      {
+         esCondWait ( &loader->cond, &loader->mutex );
+      }
+
+      esMutexUnlock ( &loader->mutex );
+
+      PumpUploads ( loader, 1000000000 );
+   }
+}
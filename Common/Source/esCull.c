@@ -0,0 +1,425 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esCull.c
+//
+//    View frustum culling of bounding spheres and boxes on the CPU.  The
+//    volumes are kept as structures of arrays so four of them (eight with
+//    AVX) are tested against each plane at once; the smallest signed
+//    distance over the six planes decides, and the indices of the volumes
+//    that pass are written out contiguously without branches.  Large
+//    batches are split into blocks across a thread pool.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include "esSimd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+///
+//  Macros
+//
+
+// Volumes per esParallelFor item, each block compacts into its own range
+#define CULL_BLOCK_SIZE    4096
+
+///
+//  Types
+//
+typedef struct
+{
+   const ESFrustumPlanes *frustum;
+   const ESSphereArrays  *spheres;
+   const ESBoxArrays     *boxes;
+   int                    count;
+   GLuint                *visible;
+   int                   *blockVisible;
+} CullJob;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// EmitIndices()
+//
+//    Append base + i for each set bit i of a 4-bit mask.  Every index is
+//    stored and the count only advances past the visible ones.
+//
+static ES_INLINE int EmitIndices ( GLuint *visible, int n, int base, int mask )
+{
+   visible[n] = base;
+   n += mask & 1;
+   visible[n] = base + 1;
+   n += ( mask >> 1 ) & 1;
+   visible[n] = base + 2;
+   n += ( mask >> 2 ) & 1;
+   visible[n] = base + 3;
+   n += ( mask >> 3 ) & 1;
+
+   return n;
+}
+
+///
+// PlaneDistance()
+//
+//    Summed in the same order as the SIMD paths, so every path agrees on
+//    spheres and boxes that only just touch a plane
+//
+static ES_INLINE GLfloat PlaneDistance ( const GLfloat *plane, GLfloat x, GLfloat y, GLfloat z )
+{
+   return plane[0] * x + ( plane[1] * y + ( plane[2] * z + plane[3] ) );
+}
+
+///
+// CullSphereRange()
+//
+//    Indices of the spheres in [begin, end) that reach inside every plane,
+//    written to visible.  Returns how many.
+//
+static int CullSphereRange ( const ESFrustumPlanes *frustum, const ESSphereArrays *spheres,
+                             int begin, int end, GLuint *visible )
+{
+   const GLfloat ( *planes )[4] = frustum->planes;
+   esVec4 px[6], py[6], pz[6], pw[6];
+   int n = 0;
+   int i = begin;
+   int p;
+
+   for ( p = 0; p < 6; p++ )
+   {
+      px[p] = esVec4Splat ( planes[p][0] );
+      py[p] = esVec4Splat ( planes[p][1] );
+      pz[p] = esVec4Splat ( planes[p][2] );
+      pw[p] = esVec4Splat ( planes[p][3] );
+   }
+
+#ifdef ES_SIMD_AVX
+
+   for ( ; i + 8 <= end; i += 8 )
+   {
+      __m256 x = _mm256_loadu_ps ( &spheres->x[i] );
+      __m256 y = _mm256_loadu_ps ( &spheres->y[i] );
+      __m256 z = _mm256_loadu_ps ( &spheres->z[i] );
+      __m256 nearest = _mm256_set1_ps ( HUGE_VALF );
+      int mask;
+
+      for ( p = 0; p < 6; p++ )
+      {
+         __m256 d = _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( planes[p][2] ), z ), _mm256_set1_ps ( planes[p][3] ) );
+
+         d = _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( planes[p][1] ), y ), d );
+         d = _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( planes[p][0] ), x ), d );
+         nearest = _mm256_min_ps ( nearest, d );
+      }
+
+      // Outside when the nearest plane is further than the radius
+      nearest = _mm256_add_ps ( nearest, _mm256_loadu_ps ( &spheres->radius[i] ) );
+      mask = ~_mm256_movemask_ps ( _mm256_cmp_ps ( nearest, _mm256_setzero_ps (), _CMP_LT_OQ ) );
+      n = EmitIndices ( visible, n, i, mask & 15 );
+      n = EmitIndices ( visible, n, i + 4, ( mask >> 4 ) & 15 );
+   }
+
+#endif
+
+   for ( ; i + 4 <= end; i += 4 )
+   {
+      esVec4 x = esVec4Load ( &spheres->x[i] );
+      esVec4 y = esVec4Load ( &spheres->y[i] );
+      esVec4 z = esVec4Load ( &spheres->z[i] );
+      esVec4 nearest = esVec4Madd ( px[0], x, esVec4Madd ( py[0], y, esVec4Madd ( pz[0], z, pw[0] ) ) );
+
+      for ( p = 1; p < 6; p++ )
+      {
+         nearest = esVec4Min ( nearest, esVec4Madd ( px[p], x, esVec4Madd ( py[p], y, esVec4Madd ( pz[p], z, pw[p] ) ) ) );
+      }
+
+      nearest = esVec4Add ( nearest, esVec4Load ( &spheres->radius[i] ) );
+      n = EmitIndices ( visible, n, i, ~esVec4LessMask ( nearest, esVec4Zero () ) & 15 );
+   }
+
+   for ( ; i < end; i++ )
+   {
+      GLfloat nearest = PlaneDistance ( planes[0], spheres->x[i], spheres->y[i], spheres->z[i] );
+
+      for ( p = 1; p < 6; p++ )
+      {
+         GLfloat d = PlaneDistance ( planes[p], spheres->x[i], spheres->y[i], spheres->z[i] );
+
+         nearest = d < nearest ? d : nearest;
+      }
+
+      visible[n] = i;
+      n += !( nearest + spheres->radius[i] < 0.0f );
+   }
+
+   return n;
+}
+
+///
+// CullBoxRange()
+//
+//    Indices of the boxes in [begin, end) that reach inside every plane,
+//    written to visible.  Returns how many.  A box reaches a plane as far
+//    as its extents projected onto the plane normal.
+//
+static int CullBoxRange ( const ESFrustumPlanes *frustum, const ESBoxArrays *boxes,
+                          int begin, int end, GLuint *visible )
+{
+   const GLfloat ( *planes )[4] = frustum->planes;
+   esVec4 px[6], py[6], pz[6], pw[6];
+   esVec4 ax[6], ay[6], az[6];
+   int n = 0;
+   int i = begin;
+   int p;
+
+   for ( p = 0; p < 6; p++ )
+   {
+      px[p] = esVec4Splat ( planes[p][0] );
+      py[p] = esVec4Splat ( planes[p][1] );
+      pz[p] = esVec4Splat ( planes[p][2] );
+      pw[p] = esVec4Splat ( planes[p][3] );
+      ax[p] = esVec4Splat ( ( GLfloat ) fabs ( planes[p][0] ) );
+      ay[p] = esVec4Splat ( ( GLfloat ) fabs ( planes[p][1] ) );
+      az[p] = esVec4Splat ( ( GLfloat ) fabs ( planes[p][2] ) );
+   }
+
+#ifdef ES_SIMD_AVX
+
+   for ( ; i + 8 <= end; i += 8 )
+   {
+      __m256 x = _mm256_loadu_ps ( &boxes->x[i] );
+      __m256 y = _mm256_loadu_ps ( &boxes->y[i] );
+      __m256 z = _mm256_loadu_ps ( &boxes->z[i] );
+      __m256 ex = _mm256_loadu_ps ( &boxes->extentX[i] );
+      __m256 ey = _mm256_loadu_ps ( &boxes->extentY[i] );
+      __m256 ez = _mm256_loadu_ps ( &boxes->extentZ[i] );
+      __m256 nearest = _mm256_set1_ps ( HUGE_VALF );
+      int mask;
+
+      for ( p = 0; p < 6; p++ )
+      {
+         __m256 d = _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( planes[p][2] ), z ), _mm256_set1_ps ( planes[p][3] ) );
+
+         d = _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( planes[p][1] ), y ), d );
+         d = _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( planes[p][0] ), x ), d );
+         d = _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( ( GLfloat ) fabs ( planes[p][2] ) ), ez ), d );
+         d = _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( ( GLfloat ) fabs ( planes[p][1] ) ), ey ), d );
+         d = _mm256_add_ps ( _mm256_mul_ps ( _mm256_set1_ps ( ( GLfloat ) fabs ( planes[p][0] ) ), ex ), d );
+         nearest = _mm256_min_ps ( nearest, d );
+      }
+
+      mask = ~_mm256_movemask_ps ( _mm256_cmp_ps ( nearest, _mm256_setzero_ps (), _CMP_LT_OQ ) );
+      n = EmitIndices ( visible, n, i, mask & 15 );
+      n = EmitIndices ( visible, n, i + 4, ( mask >> 4 ) & 15 );
+   }
+
+#endif
+
+   for ( ; i + 4 <= end; i += 4 )
+   {
+      esVec4 x = esVec4Load ( &boxes->x[i] );
+      esVec4 y = esVec4Load ( &boxes->y[i] );
+      esVec4 z = esVec4Load ( &boxes->z[i] );
+      esVec4 ex = esVec4Load ( &boxes->extentX[i] );
+      esVec4 ey = esVec4Load ( &boxes->extentY[i] );
+      esVec4 ez = esVec4Load ( &boxes->extentZ[i] );
+      esVec4 nearest = esVec4Zero ();
+
+      for ( p = 0; p < 6; p++ )
+      {
+         esVec4 d = esVec4Madd ( px[p], x, esVec4Madd ( py[p], y, esVec4Madd ( pz[p], z, pw[p] ) ) );
+
+         d = esVec4Madd ( ax[p], ex, esVec4Madd ( ay[p], ey, esVec4Madd ( az[p], ez, d ) ) );
+         nearest = p == 0 ? d : esVec4Min ( nearest, d );
+      }
+
+      n = EmitIndices ( visible, n, i, ~esVec4LessMask ( nearest, esVec4Zero () ) & 15 );
+   }
+
+   for ( ; i < end; i++ )
+   {
+      int inside = TRUE;
+
+      for ( p = 0; p < 6; p++ )
+      {
+         GLfloat d = PlaneDistance ( planes[p], boxes->x[i], boxes->y[i], boxes->z[i] );
+
+         d = ( GLfloat ) fabs ( planes[p][0] ) * boxes->extentX[i] +
+             ( ( GLfloat ) fabs ( planes[p][1] ) * boxes->extentY[i] +
+               ( ( GLfloat ) fabs ( planes[p][2] ) * boxes->extentZ[i] + d ) );
+
+         inside &= !( d < 0.0f );
+      }
+
+      visible[n] = i;
+      n += inside;
+   }
+
+   return n;
+}
+
+///
+// CullBlocks()
+//
+//    esParallelFor body: cull blocks [begin, end), each compacting into the
+//    start of its own range of the output
+//
+static void ESCALLBACK CullBlocks ( void *arg, int begin, int end )
+{
+   CullJob *job = ( CullJob * ) arg;
+   int block;
+
+   for ( block = begin; block < end; block++ )
+   {
+      int first = block * CULL_BLOCK_SIZE;
+      int last = first + CULL_BLOCK_SIZE < job->count ? first + CULL_BLOCK_SIZE : job->count;
+
+      job->blockVisible[block] = job->spheres != NULL ?
+                                 CullSphereRange ( job->frustum, job->spheres, first, last, job->visible + first ) :
+                                 CullBoxRange ( job->frustum, job->boxes, first, last, job->visible + first );
+   }
+}
+
+///
+// Cull()
+//
+//    Run a cull on the calling thread or, for more than one block, across
+//    the pool, then close the gaps between the blocks' results
+//
+static int Cull ( ESThreadPool *pool, CullJob *job )
+{
+   int blockCount = ( job->count + CULL_BLOCK_SIZE - 1 ) / CULL_BLOCK_SIZE;
+   int visibleCount;
+   int block;
+
+   if ( pool == NULL || blockCount <= 1 ||
+        ( job->blockVisible = ( int * ) malloc ( sizeof ( int ) * blockCount ) ) == NULL )
+   {
+      return job->spheres != NULL ?
+             CullSphereRange ( job->frustum, job->spheres, 0, job->count, job->visible ) :
+             CullBoxRange ( job->frustum, job->boxes, 0, job->count, job->visible );
+   }
+
+   esParallelFor ( pool, blockCount, CullBlocks, job );
+
+   visibleCount = job->blockVisible[0];
+
+   for ( block = 1; block < blockCount; block++ )
+   {
+      memmove ( job->visible + visibleCount, job->visible + block * CULL_BLOCK_SIZE,
+                sizeof ( GLuint ) * job->blockVisible[block] );
+      visibleCount += job->blockVisible[block];
+   }
+
+   free ( job->blockVisible );
+
+   return visibleCount;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esExtractFrustumPlanes()
+//
+void ESUTIL_API esExtractFrustumPlanes ( ESFrustumPlanes *frustum, const ESMatrix *mvp )
+{
+   int p, k;
+
+   // Clip planes from the rows of the MVP, w + x >= 0, w - x >= 0 and so on
+   for ( p = 0; p < 6; p++ )
+   {
+      GLfloat sign = ( p & 1 ) ? -1.0f : 1.0f;
+      GLfloat length;
+
+      for ( k = 0; k < 4; k++ )
+      {
+         frustum->planes[p][k] = mvp->m[k][3] + sign * mvp->m[k][p / 2];
+      }
+
+      // Unit normals, so plane distances compare with radii
+      length = sqrtf ( frustum->planes[p][0] * frustum->planes[p][0] +
+                       frustum->planes[p][1] * frustum->planes[p][1] +
+                       frustum->planes[p][2] * frustum->planes[p][2] );
+
+      if ( length > 0.0f )
+      {
+         for ( k = 0; k < 4; k++ )
+         {
+            frustum->planes[p][k] /= length;
+         }
+      }
+   }
+}
+
+///
+// esCullSpheres()
+//
+int ESUTIL_API esCullSpheres ( ESThreadPool *pool, const ESFrustumPlanes *frustum, const ESSphereArrays *spheres,
+                               int count, GLuint *visible )
+{
+   CullJob job;
+
+   memset ( &job, 0, sizeof ( job ) );
+   job.frustum = frustum;
+   job.spheres = spheres;
+   job.count = count;
+   job.visible = visible;
+
+   return count > 0 ? Cull ( pool, &job ) : 0;
+}
+
+///
+// esCullBoxes()
+//
+int ESUTIL_API esCullBoxes ( ESThreadPool *pool, const ESFrustumPlanes *frustum, const ESBoxArrays *boxes,
+                             int count, GLuint *visible )
+{
+   CullJob job;
+
+   memset ( &job, 0, sizeof ( job ) );
+   job.frustum = frustum;
+   job.boxes = boxes;
+   job.count = count;
+   job.visible = visible;
+
+   return count > 0 ? Cull ( pool, &job ) : 0;
+}
@@ -0,0 +1,207 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esFenceRing.c
+//
+//    Ring of fences for pipelining GPU work over N sets of resources, such
+//    as staging buffers or per-frame data.  Each slot holds the fence that
+//    was inserted after the last commands using that slot's resources, so
+//    the CPU only waits when it comes back around to a slot the GPU is
+//    still working on.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdlib.h>
+
+///
+//  Types
+//
+struct ESFenceRing
+{
+   GLsync           *fences;
+   int               depth;
+
+   // Slot handed out by esFenceRingAcquire
+   int               current;
+
+   ESFenceRingStats  stats;
+};
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esFenceRingCreate()
+//
+ESFenceRing *ESUTIL_API esFenceRingCreate ( int depth )
+{
+   ESFenceRing *ring;
+
+   if ( depth <= 0 )
+   {
+      return NULL;
+   }
+
+   ring = ( ESFenceRing * ) calloc ( 1, sizeof ( ESFenceRing ) );
+
+   if ( ring == NULL )
+   {
+      return NULL;
+   }
+
+   ring->fences = ( GLsync * ) calloc ( depth, sizeof ( GLsync ) );
+
+   if ( ring->fences == NULL )
+   {
+      free ( ring );
+      return NULL;
+   }
+
+   ring->depth = depth;
+
+   return ring;
+}
+
+///
+// esFenceRingDestroy()
+//
+void ESUTIL_API esFenceRingDestroy ( ESFenceRing *ring )
+{
+   int i;
+
+   if ( ring == NULL )
+   {
+      return;
+   }
+
+   for ( i = 0; i < ring->depth; i++ )
+   {
+      if ( ring->fences[i] != 0 )
+      {
+         glDeleteSync ( ring->fences[i] );
+      }
+   }
+
+   free ( ring->fences );
+   free ( ring );
+}
+
+///
+// esFenceRingDepth()
+//
+int ESUTIL_API esFenceRingDepth ( ESFenceRing *ring )
+{
+   return ring->depth;
+}
+
+///
+// esFenceRingAcquire()
+//
+int ESUTIL_API esFenceRingAcquire ( ESFenceRing *ring, GLuint64 timeout )
+{
+   GLsync fence = ring->fences[ring->current];
+   GLenum status;
+
+   if ( fence != 0 )
+   {
+      // Poll first, so that only real waits are counted.  Flushing makes sure
+      // the fence reaches the GPU even if nothing else flushes, so a caller that
+      // only ever polls still gets the slot back.
+      status = glClientWaitSync ( fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+
+      if ( status == GL_TIMEOUT_EXPIRED && timeout != 0 )
+      {
+         GLuint64 start = esGetTimeNs ( );
+
+         do
+         {
+            status = glClientWaitSync ( fence, 0, timeout );
+         }
+         while ( status == GL_TIMEOUT_EXPIRED && timeout == GL_TIMEOUT_IGNORED );
+
+         ring->stats.waits++;
+         ring->stats.waitNs += esGetTimeNs ( ) - start;
+      }
+
+      if ( status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED )
+      {
+         ring->stats.busy++;
+         return -1;
+      }
+
+      glDeleteSync ( fence );
+      ring->fences[ring->current] = 0;
+   }
+
+   ring->stats.acquires++;
+
+   return ring->current;
+}
+
+///
+// esFenceRingSubmit()
+//
+void ESUTIL_API esFenceRingSubmit ( ESFenceRing *ring )
+{
+   if ( ring->fences[ring->current] != 0 )
+   {
+      // Submitted without a successful acquire, the new fence also covers the old one's work
+      glDeleteSync ( ring->fences[ring->current] );
+   }
+
+   ring->fences[ring->current] = glFenceSync ( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+   ring->current = ( ring->current + 1 ) % ring->depth;
+}
+
+///
+// esFenceRingGetStats()
+//
+const ESFenceRingStats *ESUTIL_API esFenceRingGetStats ( ESFenceRing *ring )
+{
+   return &ring->stats;
+}
+
+///
+// esFenceRingResetStats()
+//
+void ESUTIL_API esFenceRingResetStats ( ESFenceRing *ring )
+{
+   ring->stats.acquires = 0;
+   ring->stats.waits = 0;
+   ring->stats.waitNs = 0;
+   ring->stats.busy = 0;
+}
@@ -0,0 +1,156 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esHalf.h
+//
+//    Private conversions between 32-bit floats and half floats used by the
+//    Common library.
+//
+#ifndef ESHALF_H
+#define ESHALF_H
+
+///
+//  Includes
+//
+#include "esUtil.h"
+
+///
+//  Macros
+//
+#ifndef ES_INLINE
+#ifdef _MSC_VER
+#define ES_INLINE __inline
+#else
+#define ES_INLINE inline
+#endif
+#endif
+
+///
+//  Public Functions
+//
+
+///
+// Convert to a half float, rounding to nearest even
+//
+static ES_INLINE GLushort esFloatToHalf ( GLfloat value )
+{
+   union
+   {
+      GLfloat f;
+      GLuint  u;
+   } bits;
+   GLuint sign, abs, half, rest;
+
+   bits.f = value;
+   sign = ( bits.u >> 16 ) & 0x8000;
+   abs = bits.u & 0x7FFFFFFF;
+
+   if ( abs >= 0x7F800000 )
+   {
+      // Infinity or NaN
+      return ( GLushort ) ( sign | 0x7C00 | ( abs > 0x7F800000 ? 0x200 : 0 ) );
+   }
+
+   if ( abs >= 0x477FF000 )
+   {
+      // Rounds past the largest half, 65504
+      return ( GLushort ) ( sign | 0x7C00 );
+   }
+
+   if ( abs < 0x33000000 )
+   {
+      // Rounds to zero
+      return ( GLushort ) sign;
+   }
+
+   if ( abs < 0x38800000 )
+   {
+      // Denormal half, in units of 2^-24
+      GLuint mantissa = ( abs & 0x7FFFFF ) | 0x800000;
+      int shift = 126 - ( int ) ( abs >> 23 );
+
+      half = mantissa >> shift;
+      rest = mantissa & ( ( 1u << shift ) - 1 );
+
+      if ( rest > ( 1u << ( shift - 1 ) ) || ( rest == ( 1u << ( shift - 1 ) ) && ( half & 1 ) ) )
+      {
+         half++;
+      }
+
+      return ( GLushort ) ( sign | half );
+   }
+
+   // Rebias the exponent from 127 to 15 and drop 13 mantissa bits
+   half = ( abs - 0x38000000 ) >> 13;
+   rest = abs & 0x1FFF;
+
+   if ( rest > 0x1000 || ( rest == 0x1000 && ( half & 1 ) ) )
+   {
+      half++;
+   }
+
+   return ( GLushort ) ( sign | half );
+}
+
+///
+// Convert a half float to a float, exactly
+//
+static ES_INLINE GLfloat esHalfToFloat ( GLushort half )
+{
+   union
+   {
+      GLfloat f;
+      GLuint  u;
+   } bits;
+   GLuint sign = ( GLuint ) ( half & 0x8000 ) << 16;
+   GLuint exponent = ( half >> 10 ) & 0x1F;
+   GLuint mantissa = half & 0x3FF;
+
+   if ( exponent == 0x1F )
+   {
+      // Infinity or NaN
+      bits.u = sign | 0x7F800000 | ( mantissa << 13 );
+   }
+   else if ( exponent != 0 )
+   {
+      bits.u = sign | ( ( exponent + 112 ) << 23 ) | ( mantissa << 13 );
+   }
+   else
+   {
+      // Zero or denormal, mantissa * 2^-24
+      bits.f = ( GLfloat ) mantissa * ( 1.0f / 16777216.0f );
+      bits.u |= sign;
+   }
+
+   return bits.f;
+}
+
+#endif // ESHALF_H
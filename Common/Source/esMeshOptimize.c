@@ -0,0 +1,646 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esMeshOptimize.c
+//
+//    Reordering of indexed triangle lists for the GPU: triangles are sorted
+//    for the post-transform vertex cache (Forsyth's linear-speed algorithm)
+//    and, in clusters, for less overdraw (Sander, Nehab and Barczak), and
+//    vertices are renumbered in the order they are fetched.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+///
+//  Macros
+//
+
+// Size of the LRU cache modeled while optimizing
+#define CACHE_SIZE            32
+
+// Score of the vertices of the last triangle added, and the falloff for older ones
+#define LAST_TRIANGLE_SCORE   0.75f
+#define CACHE_DECAY_POWER     1.5f
+
+// Bonus for vertices with few triangles left, so none get stranded
+#define VALENCE_BOOST_SCALE   2.0f
+#define VALENCE_BOOST_POWER   0.5f
+#define MAX_VALENCE_SCORES    64
+
+///
+//  Types
+//
+typedef struct
+{
+   int         first;
+   int         count;
+   float       key;
+} Cluster;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// VertexScore()
+//
+//    Forsyth's score of a vertex from its LRU cache position (-1 if not
+//    cached) and the number of triangles still using it
+//
+static float VertexScore ( const float *cacheScores, const float *valenceScores, int cachePos, int remaining )
+{
+   float score;
+
+   if ( remaining == 0 )
+   {
+      // Nothing left to draw with this vertex
+      return -1.0f;
+   }
+
+   score = cachePos >= 0 ? cacheScores[cachePos] : 0.0f;
+
+   if ( remaining < MAX_VALENCE_SCORES )
+   {
+      score += valenceScores[remaining];
+   }
+   else
+   {
+      score += VALENCE_BOOST_SCALE * powf ( ( float ) remaining, -VALENCE_BOOST_POWER );
+   }
+
+   return score;
+}
+
+///
+// Position()
+//
+static const GLfloat *Position ( const GLfloat *positions, GLsizei stride, GLuint vertex )
+{
+   return ( const GLfloat * ) ( ( const char * ) positions + ( size_t ) vertex * stride );
+}
+
+///
+// CompareClusters()
+//
+//    Outward facing clusters first, the input order between equal keys
+//
+static int CompareClusters ( const void *a, const void *b )
+{
+   const Cluster *ca = ( const Cluster * ) a;
+   const Cluster *cb = ( const Cluster * ) b;
+
+   if ( ca->key != cb->key )
+   {
+      return ca->key > cb->key ? -1 : 1;
+   }
+
+   return ca->first - cb->first;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esMeshAnalyzeVertexCache()
+//
+GLboolean ESUTIL_API esMeshAnalyzeVertexCache ( const GLuint *indices, int numIndices, int numVertices,
+                                                int cacheSize, ESMeshCacheStats *stats )
+{
+   int *stamps;
+   int misses = 0;
+   int used = 0;
+   int i;
+
+   if ( numIndices < 3 || numVertices <= 0 || cacheSize <= 0 )
+   {
+      return GL_FALSE;
+   }
+
+   stamps = ( int * ) malloc ( sizeof ( int ) * numVertices );
+
+   if ( stamps == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   // A FIFO cache only changes on a miss, so a vertex is still cached if
+   // fewer than cacheSize misses happened since it was loaded
+   for ( i = 0; i < numVertices; i++ )
+   {
+      stamps[i] = -1 - cacheSize;
+   }
+
+   for ( i = 0; i < numIndices; i++ )
+   {
+      GLuint vertex = indices[i];
+
+      if ( misses - stamps[vertex] >= cacheSize )
+      {
+         if ( stamps[vertex] < -cacheSize )
+         {
+            used++;
+         }
+
+         stamps[vertex] = misses++;
+      }
+   }
+
+   free ( stamps );
+
+   stats->acmr = ( float ) misses / ( float ) ( numIndices / 3 );
+   stats->atvr = ( float ) misses / ( float ) used;
+
+   return GL_TRUE;
+}
+
+///
+// esMeshOptimizeVertexCache()
+//
+GLboolean ESUTIL_API esMeshOptimizeVertexCache ( GLuint *indices, int numIndices, int numVertices )
+{
+   int numTriangles = numIndices / 3;
+   float cacheScores[CACHE_SIZE];
+   float valenceScores[MAX_VALENCE_SCORES];
+   int cache[CACHE_SIZE + 3];
+   int newCache[CACHE_SIZE + 3];
+   int cacheCount = 0;
+   int *offsets, *remaining, *cachePos, *triangles;
+   float *vertexScores, *triangleScores;
+   unsigned char *added;
+   GLuint *output;
+   char *memory;
+   int best = -1;
+   int cursor = 0;
+   int i, j, k;
+
+   if ( numTriangles == 0 || numVertices <= 0 )
+   {
+      return GL_FALSE;
+   }
+
+   // Everything in one block
+   memory = ( char * ) malloc ( sizeof ( int ) * ( numVertices + 1 ) +
+                                sizeof ( int ) * numVertices * 2 +
+                                sizeof ( int ) * numTriangles * 3 +
+                                sizeof ( float ) * ( numVertices + numTriangles ) +
+                                sizeof ( GLuint ) * numTriangles * 3 +
+                                numTriangles );
+
+   if ( memory == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   offsets = ( int * ) memory;
+   remaining = offsets + numVertices + 1;
+   cachePos = remaining + numVertices;
+   triangles = cachePos + numVertices;
+   vertexScores = ( float * ) ( triangles + numTriangles * 3 );
+   triangleScores = vertexScores + numVertices;
+   output = ( GLuint * ) ( triangleScores + numTriangles );
+   added = ( unsigned char * ) ( output + numTriangles * 3 );
+
+   for ( i = 0; i < CACHE_SIZE; i++ )
+   {
+      cacheScores[i] = i < 3 ? LAST_TRIANGLE_SCORE :
+                       powf ( 1.0f - ( float ) ( i - 3 ) / ( float ) ( CACHE_SIZE - 3 ), CACHE_DECAY_POWER );
+   }
+
+   valenceScores[0] = 0.0f;
+
+   for ( i = 1; i < MAX_VALENCE_SCORES; i++ )
+   {
+      valenceScores[i] = VALENCE_BOOST_SCALE * powf ( ( float ) i, -VALENCE_BOOST_POWER );
+   }
+
+   // Triangles using each vertex; the first remaining[v] of a vertex's list
+   // are the ones not added yet
+   memset ( remaining, 0, sizeof ( int ) * numVertices );
+
+   for ( i = 0; i < numTriangles * 3; i++ )
+   {
+      remaining[indices[i]]++;
+   }
+
+   offsets[0] = 0;
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      offsets[i + 1] = offsets[i] + remaining[i];
+      remaining[i] = 0;
+      cachePos[i] = -1;
+   }
+
+   for ( i = 0; i < numTriangles * 3; i++ )
+   {
+      GLuint vertex = indices[i];
+      triangles[offsets[vertex] + remaining[vertex]++] = i / 3;
+   }
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      vertexScores[i] = VertexScore ( cacheScores, valenceScores, -1, remaining[i] );
+   }
+
+   for ( i = 0; i < numTriangles; i++ )
+   {
+      triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] +
+                          vertexScores[indices[i * 3 + 2]];
+      added[i] = 0;
+
+      if ( best < 0 || triangleScores[i] > triangleScores[best] )
+      {
+         best = i;
+      }
+   }
+
+   for ( i = 0; i < numTriangles; i++ )
+   {
+      const GLuint *triangle;
+      int newCount = 0;
+      float bestScore = -1.0f;
+
+      if ( best < 0 )
+      {
+         // Nothing in the cache has triangles left, start over from the
+         // next triangle in input order
+         while ( added[cursor] )
+         {
+            cursor++;
+         }
+
+         best = cursor;
+      }
+
+      triangle = &indices[best * 3];
+      output[i * 3 + 0] = triangle[0];
+      output[i * 3 + 1] = triangle[1];
+      output[i * 3 + 2] = triangle[2];
+      added[best] = 1;
+
+      // Take the triangle off its vertices' lists and put them in front of the cache
+      for ( j = 0; j < 3; j++ )
+      {
+         int vertex = triangle[j];
+         int *list = &triangles[offsets[vertex]];
+
+         for ( k = 0; k < remaining[vertex]; k++ )
+         {
+            if ( list[k] == best )
+            {
+               list[k] = list[--remaining[vertex]];
+               list[remaining[vertex]] = best;
+               break;
+            }
+         }
+
+         for ( k = 0; k < newCount; k++ )
+         {
+            if ( newCache[k] == vertex )
+            {
+               break;
+            }
+         }
+
+         if ( k == newCount )
+         {
+            newCache[newCount++] = vertex;
+         }
+      }
+
+      for ( j = 0; j < cacheCount; j++ )
+      {
+         int vertex = cache[j];
+
+         if ( vertex != ( int ) triangle[0] && vertex != ( int ) triangle[1] && vertex != ( int ) triangle[2] )
+         {
+            newCache[newCount++] = vertex;
+         }
+      }
+
+      // Rescore the vertices that moved or dropped out of the cache
+      for ( j = 0; j < newCount; j++ )
+      {
+         int vertex = newCache[j];
+
+         cachePos[vertex] = j < CACHE_SIZE ? j : -1;
+         vertexScores[vertex] = VertexScore ( cacheScores, valenceScores, cachePos[vertex], remaining[vertex] );
+      }
+
+      // and the triangles using them, picking the best of these as the next one
+      best = -1;
+
+      for ( j = 0; j < newCount; j++ )
+      {
+         int vertex = newCache[j];
+         const int *list = &triangles[offsets[vertex]];
+
+         for ( k = 0; k < remaining[vertex]; k++ )
+         {
+            int t = list[k];
+            float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] +
+                          vertexScores[indices[t * 3 + 2]];
+
+            triangleScores[t] = score;
+
+            if ( score > bestScore )
+            {
+               best = t;
+               bestScore = score;
+            }
+         }
+      }
+
+      cacheCount = newCount < CACHE_SIZE ? newCount : CACHE_SIZE;
+      memcpy ( cache, newCache, sizeof ( int ) * cacheCount );
+   }
+
+   memcpy ( indices, output, sizeof ( GLuint ) * numTriangles * 3 );
+   free ( memory );
+
+   return GL_TRUE;
+}
+
+///
+// esMeshOptimizeOverdraw()
+//
+GLboolean ESUTIL_API esMeshOptimizeOverdraw ( GLuint *indices, int numIndices, const GLfloat *positions,
+                                              GLsizei stride, int numVertices, int cacheSize, float threshold )
+{
+   int numTriangles = numIndices / 3;
+   ESMeshCacheStats stats;
+   Cluster *clusters;
+   GLuint *output;
+   int *stamps;
+   int numClusters = 0;
+   int clusterMisses = 0;
+   int misses = 0;
+   float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+   float meshArea = 0.0f;
+   int i, j;
+
+   if ( stride == 0 )
+   {
+      stride = 3 * sizeof ( GLfloat );
+   }
+
+   if ( !esMeshAnalyzeVertexCache ( indices, numIndices, numVertices, cacheSize, &stats ) )
+   {
+      return GL_FALSE;
+   }
+
+   clusters = ( Cluster * ) malloc ( sizeof ( Cluster ) * numTriangles );
+   output = ( GLuint * ) malloc ( sizeof ( GLuint ) * numTriangles * 3 );
+   stamps = ( int * ) malloc ( sizeof ( int ) * numVertices );
+
+   if ( clusters == NULL || output == NULL || stamps == NULL )
+   {
+      free ( clusters );
+      free ( output );
+      free ( stamps );
+      return GL_FALSE;
+   }
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      stamps[i] = -1 - cacheSize;
+   }
+
+   // Split where the cache starts over (a triangle missing on all of its
+   // vertices) once the current cluster has a good enough hit rate, so
+   // the reordering below costs little cache efficiency
+   for ( i = 0; i < numTriangles; i++ )
+   {
+      int triangleMisses = 0;
+
+      for ( j = 0; j < 3; j++ )
+      {
+         GLuint vertex = indices[i * 3 + j];
+
+         if ( misses - stamps[vertex] >= cacheSize )
+         {
+            stamps[vertex] = misses++;
+            triangleMisses++;
+         }
+      }
+
+      if ( numClusters == 0 ||
+           ( triangleMisses == 3 &&
+             ( float ) clusterMisses <= threshold * stats.acmr * ( float ) clusters[numClusters - 1].count ) )
+      {
+         clusters[numClusters].first = i;
+         clusters[numClusters].count = 0;
+         numClusters++;
+         clusterMisses = 0;
+      }
+
+      clusters[numClusters - 1].count++;
+      clusterMisses += triangleMisses;
+   }
+
+   // Area weighted centroid of the mesh
+   for ( i = 0; i < numTriangles; i++ )
+   {
+      const GLfloat *a = Position ( positions, stride, indices[i * 3 + 0] );
+      const GLfloat *b = Position ( positions, stride, indices[i * 3 + 1] );
+      const GLfloat *c = Position ( positions, stride, indices[i * 3 + 2] );
+      float e0[3], e1[3], n[3], area;
+
+      for ( j = 0; j < 3; j++ )
+      {
+         e0[j] = b[j] - a[j];
+         e1[j] = c[j] - a[j];
+      }
+
+      n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+      n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+      n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+      area = sqrtf ( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+
+      for ( j = 0; j < 3; j++ )
+      {
+         meshCenter[j] += area * ( a[j] + b[j] + c[j] ) / 3.0f;
+      }
+
+      meshArea += area;
+   }
+
+   if ( meshArea > 0.0f )
+   {
+      for ( j = 0; j < 3; j++ )
+      {
+         meshCenter[j] /= meshArea;
+      }
+   }
+
+   // Clusters facing away from the center are more likely to hide others,
+   // draw them first
+   for ( i = 0; i < numClusters; i++ )
+   {
+      Cluster *cluster = &clusters[i];
+      float center[3] = { 0.0f, 0.0f, 0.0f };
+      float normal[3] = { 0.0f, 0.0f, 0.0f };
+      float area = 0.0f;
+      float length;
+      int t;
+
+      for ( t = cluster->first; t < cluster->first + cluster->count; t++ )
+      {
+         const GLfloat *a = Position ( positions, stride, indices[t * 3 + 0] );
+         const GLfloat *b = Position ( positions, stride, indices[t * 3 + 1] );
+         const GLfloat *c = Position ( positions, stride, indices[t * 3 + 2] );
+         float e0[3], e1[3], n[3], triangleArea;
+
+         for ( j = 0; j < 3; j++ )
+         {
+            e0[j] = b[j] - a[j];
+            e1[j] = c[j] - a[j];
+         }
+
+         n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+         n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+         n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+         triangleArea = sqrtf ( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+
+         for ( j = 0; j < 3; j++ )
+         {
+            center[j] += triangleArea * ( a[j] + b[j] + c[j] ) / 3.0f;
+            normal[j] += n[j];
+         }
+
+         area += triangleArea;
+      }
+
+      length = sqrtf ( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+      cluster->key = 0.0f;
+
+      if ( area > 0.0f && length > 0.0f )
+      {
+         for ( j = 0; j < 3; j++ )
+         {
+            cluster->key += ( center[j] / area - meshCenter[j] ) * normal[j] / length;
+         }
+      }
+   }
+
+   qsort ( clusters, numClusters, sizeof ( Cluster ), CompareClusters );
+
+   for ( i = 0, j = 0; i < numClusters; i++ )
+   {
+      memcpy ( &output[j], &indices[clusters[i].first * 3], sizeof ( GLuint ) * clusters[i].count * 3 );
+      j += clusters[i].count * 3;
+   }
+
+   memcpy ( indices, output, sizeof ( GLuint ) * numTriangles * 3 );
+
+   free ( clusters );
+   free ( output );
+   free ( stamps );
+
+   return GL_TRUE;
+}
+
+///
+// esMeshOptimizeVertexFetch()
+//
+int ESUTIL_API esMeshOptimizeVertexFetch ( GLuint *indices, int numIndices, int numVertices, GLuint *remap )
+{
+   GLuint next = 0;
+   int used;
+   int i;
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      remap[i] = 0xFFFFFFFFu;
+   }
+
+   // Number the vertices in the order the indices first use them
+   for ( i = 0; i < numIndices; i++ )
+   {
+      GLuint vertex = indices[i];
+
+      if ( remap[vertex] == 0xFFFFFFFFu )
+      {
+         remap[vertex] = next++;
+      }
+
+      indices[i] = remap[vertex];
+   }
+
+   used = ( int ) next;
+
+   // Unused vertices go to the end, in their old order
+   for ( i = 0; i < numVertices; i++ )
+   {
+      if ( remap[i] == 0xFFFFFFFFu )
+      {
+         remap[i] = next++;
+      }
+   }
+
+   return used;
+}
+
+///
+// esMeshRemapVertices()
+//
+GLboolean ESUTIL_API esMeshRemapVertices ( void *vertices, int numVertices, int vertexSize, const GLuint *remap )
+{
+   char *copy = ( char * ) malloc ( ( size_t ) numVertices * vertexSize );
+   int i;
+
+   if ( copy == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   memcpy ( copy, vertices, ( size_t ) numVertices * vertexSize );
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      memcpy ( ( char * ) vertices + ( size_t ) remap[i] * vertexSize, copy + ( size_t ) i * vertexSize, vertexSize );
+   }
+
+   free ( copy );
+
+   return GL_TRUE;
+}
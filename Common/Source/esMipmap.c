@@ -0,0 +1,686 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esMipmap.c
+//
+//    Mipmap chain generation for 8-bit and half float images with one to
+//    four channels.  Each level is filtered from the one above with a
+//    separable kernel, box or Kaiser windowed sinc, optionally in linear
+//    light for sRGB images.  Rows of a level are split across a thread
+//    pool and the vertical pass runs four floats at a time; exact halving
+//    of linear 8-bit images takes an integer 2x2 average instead.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include "esArena.h"
+#include "esHalf.h"
+#include "esSimd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+///
+//  Macros
+//
+
+// Kaiser windowed sinc, radius in destination texels
+#define KAISER_RADIUS      3.0
+#define KAISER_ALPHA       4.0
+
+// Entries of the linear to sRGB table
+#define SRGB_ENCODE_SIZE   16384
+
+#define MIP_ALIGN( size )  ( ( ( size ) + 15 ) & ~( size_t ) 15 )
+
+///
+//  Types
+//
+
+// Source texels and weights of each destination texel along one axis
+typedef struct
+{
+   int         count;
+   int        *index;
+   float      *weight;
+} FilterTaps;
+
+typedef struct
+{
+   const GLubyte *src;
+   GLubyte       *dst;
+   int            srcWidth;
+   int            dstWidth;
+   int            channels;
+   size_t         channelSize;
+   GLenum         type;
+   FilterTaps     x;
+   FilterTaps     y;
+
+   // Set if any channel is sRGB, and per channel the 8-bit to float table
+   // and the float to 8-bit sRGB table (NULL if linear)
+   int            srgb;
+   const float   *decode[4];
+   const GLubyte *encode[4];
+
+   // Set by a worker that ran out of memory
+   volatile int   failed;
+} LevelJob;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// BesselI0()
+//
+//    Modified Bessel function of the first kind, order 0
+//
+static double BesselI0 ( double x )
+{
+   double sum = 1.0;
+   double term = 1.0;
+   double k;
+
+   for ( k = 1.0; term > sum * 1e-12; k += 1.0 )
+   {
+      term *= ( x * 0.5 / k ) * ( x * 0.5 / k );
+      sum += term;
+   }
+
+   return sum;
+}
+
+///
+// KaiserWeight()
+//
+//    Windowed sinc at distance d, in destination texels
+//
+static double KaiserWeight ( double d )
+{
+   double t = d / KAISER_RADIUS;
+   double sinc = 1.0;
+
+   if ( t <= -1.0 || t >= 1.0 )
+   {
+      return 0.0;
+   }
+
+   if ( d != 0.0 )
+   {
+      sinc = sin ( 3.14159265358979 * d ) / ( 3.14159265358979 * d );
+   }
+
+   return sinc * BesselI0 ( KAISER_ALPHA * sqrt ( 1.0 - t * t ) ) / BesselI0 ( KAISER_ALPHA );
+}
+
+///
+// BuildTaps()
+//
+//    Filter taps to reduce n texels to m along one axis.  The box filter
+//    weighs every source texel by its overlap with the destination texel,
+//    which also covers odd sizes; Kaiser reaches further and clamps to the
+//    edge.  taps must hold m * TapCount() entries.
+//
+static void BuildTaps ( FilterTaps *taps, int n, int m, int kaiser )
+{
+   double scale = ( double ) n / ( double ) m;
+   int i, j, t;
+
+   for ( i = 0; i < m; i++ )
+   {
+      int *index = &taps->index[i * taps->count];
+      float *weight = &taps->weight[i * taps->count];
+      double sum = 0.0;
+
+      for ( t = 0; t < taps->count; t++ )
+      {
+         index[t] = 0;
+         weight[t] = 0.0f;
+      }
+
+      t = 0;
+
+      if ( !kaiser )
+      {
+         double lo = i * scale;
+         double hi = ( i + 1 ) * scale;
+
+         for ( j = ( int ) floor ( lo ); j < hi && j < n && t < taps->count; j++ )
+         {
+            double overlap = ( j + 1 < hi ? j + 1 : hi ) - ( j > lo ? j : lo );
+
+            if ( overlap > 0.0 )
+            {
+               index[t] = j;
+               weight[t++] = ( float ) overlap;
+               sum += overlap;
+            }
+         }
+      }
+      else
+      {
+         double center = ( i + 0.5 ) * scale;
+         double support = KAISER_RADIUS * scale;
+
+         for ( j = ( int ) floor ( center - support ); j <= ( int ) ceil ( center + support ) && t < taps->count; j++ )
+         {
+            double w = KaiserWeight ( ( j + 0.5 - center ) / scale );
+
+            if ( w != 0.0 )
+            {
+               index[t] = j < 0 ? 0 : ( j >= n ? n - 1 : j );
+               weight[t++] = ( float ) w;
+               sum += w;
+            }
+         }
+      }
+
+      for ( t = 0; t < taps->count; t++ )
+      {
+         weight[t] = ( float ) ( weight[t] / sum );
+      }
+   }
+}
+
+///
+// TapCount()
+//
+static int TapCount ( int n, int m, int kaiser )
+{
+   double scale = ( double ) n / ( double ) m;
+
+   if ( kaiser )
+   {
+      return ( int ) ceil ( 2.0 * KAISER_RADIUS * scale ) + 2;
+   }
+
+   // Exact halving takes 2 texels, anything else may straddle one more
+   return n % m == 0 ? n / m : ( int ) ceil ( scale ) + 1;
+}
+
+///
+// LoadRow()
+//
+//    Convert source row y to floats
+//
+static void LoadRow ( const LevelJob *job, int y, float *out )
+{
+   size_t rowLength = ( size_t ) job->srcWidth * job->channels;
+   int x, c;
+
+   if ( job->type == GL_HALF_FLOAT )
+   {
+      const GLushort *row = ( const GLushort * ) job->src + rowLength * y;
+      size_t i;
+
+      for ( i = 0; i < rowLength; i++ )
+      {
+         out[i] = esHalfToFloat ( row[i] );
+      }
+   }
+   else if ( !job->srgb )
+   {
+      const GLubyte *row = job->src + rowLength * y;
+      size_t i;
+
+      for ( i = 0; i < rowLength; i++ )
+      {
+         out[i] = row[i] * ( 1.0f / 255.0f );
+      }
+   }
+   else
+   {
+      const GLubyte *row = job->src + rowLength * y;
+
+      for ( x = 0; x < job->srcWidth; x++ )
+      {
+         for ( c = 0; c < job->channels; c++ )
+         {
+            out[x * job->channels + c] = job->decode[c][row[x * job->channels + c]];
+         }
+      }
+   }
+}
+
+///
+// StoreTexel()
+//
+static void StoreTexel ( const LevelJob *job, GLubyte *dst, const float *value )
+{
+   int c;
+
+   for ( c = 0; c < job->channels; c++ )
+   {
+      float v = value[c];
+
+      if ( job->type == GL_HALF_FLOAT )
+      {
+         ( ( GLushort * ) dst ) [c] = esFloatToHalf ( v );
+         continue;
+      }
+
+      // Kaiser lobes can overshoot
+      v = v < 0.0f ? 0.0f : ( v > 1.0f ? 1.0f : v );
+
+      if ( job->encode[c] != NULL )
+      {
+         dst[c] = job->encode[c][( int ) ( v * ( SRGB_ENCODE_SIZE - 1 ) + 0.5f )];
+      }
+      else
+      {
+         dst[c] = ( GLubyte ) ( v * 255.0f + 0.5f );
+      }
+   }
+}
+
+///
+// FilterRows()
+//
+//    esParallelFor body: filter destination rows [begin, end)
+//
+static void ESCALLBACK FilterRows ( void *arg, int begin, int end )
+{
+   LevelJob *job = ( LevelJob * ) arg;
+   int channels = job->channels;
+   int rowLength = job->srcWidth * channels;
+   int padded = ( rowLength + 3 ) & ~3;
+   size_t texelSize = channels * job->channelSize;
+   int cacheRows = job->y.count;
+   float *column = ( float * ) calloc ( ( size_t ) padded * ( cacheRows + 1 ), sizeof ( float ) );
+   int *cached = ( int * ) malloc ( sizeof ( int ) * cacheRows );
+   int x, y, t, k, c;
+
+   if ( column == NULL || cached == NULL )
+   {
+      free ( column );
+      free ( cached );
+      job->failed = 1;
+      return;
+   }
+
+   // Converted source rows, slot i holds row cached[i].  The taps of
+   // consecutive destination rows slide over the source, so a window of
+   // y.count rows keyed by row modulo y.count never collides.
+   for ( t = 0; t < cacheRows; t++ )
+   {
+      cached[t] = -1;
+   }
+
+   for ( y = begin; y < end; y++ )
+   {
+      const int *yIndex = &job->y.index[y * job->y.count];
+      const float *yWeight = &job->y.weight[y * job->y.count];
+      GLubyte *dst = job->dst + ( size_t ) y * job->dstWidth * texelSize;
+
+      // Vertical pass: weighted sum of the source rows
+      memset ( column, 0, sizeof ( float ) * padded );
+
+      for ( t = 0; t < job->y.count; t++ )
+      {
+         int slot = yIndex[t] % cacheRows;
+         float *row = column + padded * ( slot + 1 );
+         esVec4 w;
+
+         if ( yWeight[t] == 0.0f )
+         {
+            continue;
+         }
+
+         if ( cached[slot] != yIndex[t] )
+         {
+            LoadRow ( job, yIndex[t], row );
+            cached[slot] = yIndex[t];
+         }
+
+         w = esVec4Splat ( yWeight[t] );
+
+         for ( k = 0; k < padded; k += 4 )
+         {
+            esVec4Store ( &column[k], esVec4Madd ( esVec4Load ( &row[k] ), w, esVec4Load ( &column[k] ) ) );
+         }
+      }
+
+      // Horizontal pass
+      for ( x = 0; x < job->dstWidth; x++ )
+      {
+         const int *xIndex = &job->x.index[x * job->x.count];
+         const float *xWeight = &job->x.weight[x * job->x.count];
+         float texel[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+         if ( channels == 4 )
+         {
+            esVec4 sum = esVec4Zero ( );
+
+            for ( t = 0; t < job->x.count; t++ )
+            {
+               sum = esVec4Madd ( esVec4Load ( &column[xIndex[t] * 4] ), esVec4Splat ( xWeight[t] ), sum );
+            }
+
+            esVec4Store ( texel, sum );
+         }
+         else
+         {
+            for ( t = 0; t < job->x.count; t++ )
+            {
+               for ( c = 0; c < channels; c++ )
+               {
+                  texel[c] += column[xIndex[t] * channels + c] * xWeight[t];
+               }
+            }
+         }
+
+         StoreTexel ( job, dst + x * texelSize, texel );
+      }
+   }
+
+   free ( column );
+   free ( cached );
+}
+
+///
+// HalveRows()
+//
+//    esParallelFor body: 2x2 box filter of 8-bit texels for destination
+//    rows [begin, end), rounding to nearest
+//
+static void ESCALLBACK HalveRows ( void *arg, int begin, int end )
+{
+   LevelJob *job = ( LevelJob * ) arg;
+   int channels = job->channels;
+   size_t srcPitch = ( size_t ) job->srcWidth * channels;
+   size_t dstPitch = ( size_t ) job->dstWidth * channels;
+   int x, y, c;
+
+   for ( y = begin; y < end; y++ )
+   {
+      const GLubyte *src0 = job->src + srcPitch * y * 2;
+      const GLubyte *src1 = src0 + srcPitch;
+      GLubyte *dst = job->dst + dstPitch * y;
+
+      for ( x = 0; x < job->dstWidth; x++ )
+      {
+         for ( c = 0; c < channels; c++ )
+         {
+            dst[c] = ( GLubyte ) ( ( src0[c] + src0[c + channels] + src1[c] + src1[c + channels] + 2 ) >> 2 );
+         }
+
+         src0 += channels * 2;
+         src1 += channels * 2;
+         dst += channels;
+      }
+   }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esGenMipChain()
+//
+GLboolean ESUTIL_API esGenMipChain ( ESArena *arena, ESThreadPool *pool, const void *pixels, int width, int height,
+                                     GLenum format, GLenum type, GLuint flags, ESMipChain *chain )
+{
+   int channels;
+   size_t channelSize, texelSize, size;
+   ESArenaMark mark = { NULL, 0, 0 };
+   float *decode = NULL;
+   GLubyte *encode = NULL;
+   GLubyte *data;
+   int kaiser = ( flags & ES_MIP_KAISER ) != 0;
+   GLboolean ok = GL_TRUE;
+   int level, i;
+
+   memset ( chain, 0, sizeof ( ESMipChain ) );
+
+   switch ( format )
+   {
+      case GL_RED:
+         channels = 1;
+         break;
+      case GL_RG:
+         channels = 2;
+         break;
+      case GL_RGB:
+         channels = 3;
+         break;
+      case GL_RGBA:
+         channels = 4;
+         break;
+      default:
+         return GL_FALSE;
+   }
+
+   if ( type == GL_UNSIGNED_BYTE )
+   {
+      channelSize = 1;
+   }
+   else if ( type == GL_HALF_FLOAT )
+   {
+      channelSize = 2;
+   }
+   else
+   {
+      return GL_FALSE;
+   }
+
+   if ( width <= 0 || height <= 0 || width >= ( 1 << ES_MAX_MIP_LEVELS ) || height >= ( 1 << ES_MAX_MIP_LEVELS ) )
+   {
+      return GL_FALSE;
+   }
+
+   texelSize = channels * channelSize;
+   chain->format = format;
+   chain->type = type;
+   chain->width[0] = width;
+   chain->height[0] = height;
+   chain->pixels[0] = pixels;
+   chain->levelCount = 1;
+   size = 0;
+
+   // Halve each level, rounding down, until 1x1
+   while ( width > 1 || height > 1 )
+   {
+      width = width > 1 ? width / 2 : 1;
+      height = height > 1 ? height / 2 : 1;
+      chain->width[chain->levelCount] = width;
+      chain->height[chain->levelCount] = height;
+      chain->levelCount++;
+      size += MIP_ALIGN ( ( size_t ) width * height * texelSize );
+   }
+
+   if ( chain->levelCount == 1 )
+   {
+      return GL_TRUE;
+   }
+
+   // One allocation for every level below the source
+   data = ( GLubyte * ) esArenaMalloc ( arena, size );
+
+   if ( data == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   chain->allocation = arena != NULL ? NULL : data;
+
+   for ( level = 1; level < chain->levelCount; level++ )
+   {
+      chain->pixels[level] = data;
+      data += MIP_ALIGN ( ( size_t ) chain->width[level] * chain->height[level] * texelSize );
+   }
+
+   // Working memory from here on is released at the end
+   if ( arena != NULL )
+   {
+      mark = esArenaGetMark ( arena );
+   }
+
+   if ( type == GL_UNSIGNED_BYTE )
+   {
+      decode = ( float * ) esArenaMalloc ( arena, sizeof ( float ) * 512 );
+      encode = ( GLubyte * ) esArenaMalloc ( arena, SRGB_ENCODE_SIZE );
+
+      if ( decode == NULL || encode == NULL )
+      {
+         ok = GL_FALSE;
+      }
+      else
+      {
+         for ( i = 0; i < 256; i++ )
+         {
+            float s = i / 255.0f;
+
+            decode[i] = s;
+            decode[256 + i] = s <= 0.04045f ? s / 12.92f : powf ( ( s + 0.055f ) / 1.055f, 2.4f );
+         }
+
+         for ( i = 0; i < SRGB_ENCODE_SIZE && ( flags & ES_MIP_SRGB ); i++ )
+         {
+            float l = ( float ) i / ( SRGB_ENCODE_SIZE - 1 );
+            float s = l <= 0.0031308f ? l * 12.92f : 1.055f * powf ( l, 1.0f / 2.4f ) - 0.055f;
+
+            encode[i] = ( GLubyte ) ( s * 255.0f + 0.5f );
+         }
+      }
+   }
+
+   for ( level = 1; ok && level < chain->levelCount; level++ )
+   {
+      int srcWidth = chain->width[level - 1];
+      int srcHeight = chain->height[level - 1];
+      LevelJob job;
+
+      memset ( &job, 0, sizeof ( LevelJob ) );
+      job.src = ( const GLubyte * ) chain->pixels[level - 1];
+      job.dst = ( GLubyte * ) chain->pixels[level];
+      job.srcWidth = srcWidth;
+      job.dstWidth = chain->width[level];
+      job.channels = channels;
+      job.channelSize = channelSize;
+      job.type = type;
+      job.x.count = TapCount ( srcWidth, job.dstWidth, kaiser );
+      job.y.count = TapCount ( srcHeight, chain->height[level], kaiser );
+
+      // Gamma only applies to color, alpha is always linear
+      for ( i = 0; decode != NULL && i < channels; i++ )
+      {
+         int srgb = ( flags & ES_MIP_SRGB ) && i < 3;
+
+         job.srgb |= srgb;
+         job.decode[i] = srgb ? decode + 256 : decode;
+         job.encode[i] = srgb ? encode : NULL;
+      }
+
+      // Exact halving of linear 8-bit texels is a plain 2x2 average
+      if ( type == GL_UNSIGNED_BYTE && !job.srgb && !kaiser &&
+           srcWidth == 2 * job.dstWidth && srcHeight == 2 * chain->height[level] )
+      {
+         esParallelFor ( pool, chain->height[level], HalveRows, &job );
+         continue;
+      }
+
+      job.x.index = ( int * ) esArenaMalloc ( arena, sizeof ( int ) * job.x.count * job.dstWidth );
+      job.x.weight = ( float * ) esArenaMalloc ( arena, sizeof ( float ) * job.x.count * job.dstWidth );
+      job.y.index = ( int * ) esArenaMalloc ( arena, sizeof ( int ) * job.y.count * chain->height[level] );
+      job.y.weight = ( float * ) esArenaMalloc ( arena, sizeof ( float ) * job.y.count * chain->height[level] );
+
+      if ( job.x.index != NULL && job.x.weight != NULL && job.y.index != NULL && job.y.weight != NULL )
+      {
+         BuildTaps ( &job.x, srcWidth, job.dstWidth, kaiser );
+         BuildTaps ( &job.y, srcHeight, chain->height[level], kaiser );
+
+         esParallelFor ( pool, chain->height[level], FilterRows, &job );
+         ok = !job.failed;
+      }
+      else
+      {
+         ok = GL_FALSE;
+      }
+
+      esArenaFree ( arena, job.x.index );
+      esArenaFree ( arena, job.x.weight );
+      esArenaFree ( arena, job.y.index );
+      esArenaFree ( arena, job.y.weight );
+   }
+
+   esArenaFree ( arena, decode );
+   esArenaFree ( arena, encode );
+
+   if ( arena != NULL )
+   {
+      esArenaRelease ( arena, mark );
+   }
+
+   if ( !ok )
+   {
+      esFreeMipChain ( chain );
+   }
+
+   return ok;
+}
+
+///
+// esFreeMipChain()
+//
+void ESUTIL_API esFreeMipChain ( ESMipChain *chain )
+{
+   free ( chain->allocation );
+   memset ( chain, 0, sizeof ( ESMipChain ) );
+}
+
+///
+// esUploadMipChain()
+//
+void ESUTIL_API esUploadMipChain ( const ESMipChain *chain, GLenum target, GLint internalFormat )
+{
+   GLint alignment;
+   int level;
+
+   // Rows are tightly packed
+   glGetIntegerv ( GL_UNPACK_ALIGNMENT, &alignment );
+   glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
+
+   for ( level = 0; level < chain->levelCount; level++ )
+   {
+      glTexImage2D ( target, level, internalFormat, chain->width[level], chain->height[level], 0,
+                     chain->format, chain->type, chain->pixels[level] );
+   }
+
+   glPixelStorei ( GL_UNPACK_ALIGNMENT, alignment );
+}
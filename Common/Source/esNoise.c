@@ -0,0 +1,720 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esNoise.c
+//
+//    3D gradient noise and noise volume generation.  The volume generator
+//    evaluates a whole row of texels at a time: every texel in a row shares
+//    its y/z lattice cell, so the y/z hashing is done once per row and only
+//    the x lookups remain per texel.  Those are evaluated eight at a time
+//    with the SIMD helpers, rows are split across a thread pool by z slice,
+//    and the min/max needed to normalize the result is gathered while the
+//    values are generated.
+//
+
+///
+//  Includes
+//
+#define _USE_MATH_DEFINES
+#include "esUtil.h"
+#include "esArena.h"
+#include "esSimd.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+///
+//  Macros
+//
+#define NOISE_TABLE_MASK   255
+
+#define FLOOR(x)           ((int)(x) - ((x) < 0 && (x) != (int)(x)))
+#define smoothstep(t)      ( t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f ) )
+#define lerp(t, a, b)      ( a + t * (b - a) )
+
+// Texels evaluated per iteration of the row kernel
+#define NOISE_BLOCK        8
+
+#ifdef _WIN32
+#define srandom srand
+#define random rand
+#endif
+
+///
+//  Types
+//
+
+// Per-column lattice coordinates for one octave, shared by every row
+typedef struct
+{
+   int   *ix;
+   float *fx0;
+   float *wx;
+} NoiseColumns;
+
+typedef struct
+{
+   int           size;
+   int           rowLength;    // size rounded up to NOISE_BLOCK
+   int           octaves;
+   float        *frequencies;
+   float        *amplitudes;
+   NoiseColumns *columns;
+
+   // Generation output
+   float        *values;
+   float        *sliceMin;
+   float        *sliceMax;
+   GLboolean    *sliceOk;     // GL_FALSE where a slice could not be generated
+
+   // Normalization
+   float         min;
+   float         scale;
+   GLubyte      *texels;
+} NoiseVolume;
+
+///
+//  Globals
+//
+
+// lattice gradients 3D noise, one array per component
+static float gradientX[256];
+static float gradientY[256];
+static float gradientZ[256];
+static int   noiseTableReady = 0;
+
+// permTable describes a random permutatin of 8-bit values from 0 to 255.
+static const unsigned char permTable[256] =
+{
+   0xE1, 0x9B, 0xD2, 0x6C, 0xAF, 0xC7, 0xDD, 0x90, 0xCB, 0x74, 0x46, 0xD5, 0x45, 0x9E, 0x21, 0xFC,
+   0x05, 0x52, 0xAD, 0x85, 0xDE, 0x8B, 0xAE, 0x1B, 0x09, 0x47, 0x5A, 0xF6, 0x4B, 0x82, 0x5B, 0xBF,
+   0xA9, 0x8A, 0x02, 0x97, 0xC2, 0xEB, 0x51, 0x07, 0x19, 0x71, 0xE4, 0x9F, 0xCD, 0xFD, 0x86, 0x8E,
+   0xF8, 0x41, 0xE0, 0xD9, 0x16, 0x79, 0xE5, 0x3F, 0x59, 0x67, 0x60, 0x68, 0x9C, 0x11, 0xC9, 0x81,
+   0x24, 0x08, 0xA5, 0x6E, 0xED, 0x75, 0xE7, 0x38, 0x84, 0xD3, 0x98, 0x14, 0xB5, 0x6F, 0xEF, 0xDA,
+   0xAA, 0xA3, 0x33, 0xAC, 0x9D, 0x2F, 0x50, 0xD4, 0xB0, 0xFA, 0x57, 0x31, 0x63, 0xF2, 0x88, 0xBD,
+   0xA2, 0x73, 0x2C, 0x2B, 0x7C, 0x5E, 0x96, 0x10, 0x8D, 0xF7, 0x20, 0x0A, 0xC6, 0xDF, 0xFF, 0x48,
+   0x35, 0x83, 0x54, 0x39, 0xDC, 0xC5, 0x3A, 0x32, 0xD0, 0x0B, 0xF1, 0x1C, 0x03, 0xC0, 0x3E, 0xCA,
+   0x12, 0xD7, 0x99, 0x18, 0x4C, 0x29, 0x0F, 0xB3, 0x27, 0x2E, 0x37, 0x06, 0x80, 0xA7, 0x17, 0xBC,
+   0x6A, 0x22, 0xBB, 0x8C, 0xA4, 0x49, 0x70, 0xB6, 0xF4, 0xC3, 0xE3, 0x0D, 0x23, 0x4D, 0xC4, 0xB9,
+   0x1A, 0xC8, 0xE2, 0x77, 0x1F, 0x7B, 0xA8, 0x7D, 0xF9, 0x44, 0xB7, 0xE6, 0xB1, 0x87, 0xA0, 0xB4,
+   0x0C, 0x01, 0xF3, 0x94, 0x66, 0xA6, 0x26, 0xEE, 0xFB, 0x25, 0xF0, 0x7E, 0x40, 0x4A, 0xA1, 0x28,
+   0xB8, 0x95, 0xAB, 0xB2, 0x65, 0x42, 0x1D, 0x3B, 0x92, 0x3D, 0xFE, 0x6B, 0x2A, 0x56, 0x9A, 0x04,
+   0xEC, 0xE8, 0x78, 0x15, 0xE9, 0xD1, 0x2D, 0x62, 0xC1, 0x72, 0x4E, 0x13, 0xCE, 0x0E, 0x76, 0x7F,
+   0x30, 0x4F, 0x93, 0x55, 0x1E, 0xCF, 0xDB, 0x36, 0x58, 0xEA, 0xBE, 0x7A, 0x5F, 0x43, 0x8F, 0x6D,
+   0x89, 0xD6, 0x91, 0x5D, 0x5C, 0x64, 0xF5, 0x00, 0xD8, 0xBA, 0x3C, 0x53, 0x69, 0x61, 0xCC, 0x34,
+};
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// InitNoiseTable()
+//
+//    Build the gradient table.  Uses the same seed and construction as the
+//    original Noise3D sample so the generated volumes are unchanged.
+//
+static void InitNoiseTable ( void )
+{
+   int            i;
+   float          a;
+   float          x, y, z, r, theta;
+   float          gradients[256 * 3];
+
+   if ( noiseTableReady )
+   {
+      return;
+   }
+
+   srandom ( 0 );
+
+   // build gradient table for 3D noise
+   for ( i = 0; i < 256; i++ )
+   {
+      /*
+      * calculate 1 - 2 * random number
+      */
+      a = ( random() % 32768 ) / 32768.0f;
+      z = ( 1.0f - 2.0f * a );
+
+      r = sqrtf ( 1.0f - z * z ); // r is radius of circle
+
+      a = ( random() % 32768 ) / 32768.0f;
+      theta = ( 2.0f * ( float ) M_PI * a );
+      x = ( r * cosf ( a ) );
+      y = ( r * sinf ( a ) );
+      ( void ) theta;
+
+      gradients[i * 3] = x;
+      gradients[i * 3 + 1] = y;
+      gradients[i * 3 + 2] = z;
+   }
+
+   // use the index in the permutation table to load the
+   // gradient values from gradients to the gradient tables
+   for ( i = 0; i < 256; i++ )
+   {
+      int indx = permTable[i];
+      gradientX[i] = gradients[indx * 3];
+      gradientY[i] = gradients[indx * 3 + 1];
+      gradientZ[i] = gradients[indx * 3 + 2];
+   }
+
+   noiseTableReady = 1;
+}
+
+///
+// glattice3D()
+//
+//    generate the value of gradient noise for a given lattice point
+//
+//    (ix, iy, iz) specifies the 3D lattice position
+//    (fx, fy, fz) specifies the fractional part
+//
+static float glattice3D ( int ix, int iy, int iz, float fx, float fy, float fz )
+{
+   int   indx, y, z;
+
+   z = permTable[iz & NOISE_TABLE_MASK];
+   y = permTable[ ( iy + z ) & NOISE_TABLE_MASK];
+   indx = ( ix + y ) & NOISE_TABLE_MASK;
+
+   return ( gradientX[indx] * fx + gradientY[indx] * fy + gradientZ[indx] * fz );
+}
+
+///
+// LatticeBlock()
+//
+//    Gradient dot products for four consecutive columns at one lattice
+//    corner.  hash is the permuted y/z part of the corner's index.
+//
+static ES_INLINE esVec4 LatticeBlock ( const int *ix, int dx, int hash, esVec4 fx, esVec4 fy, esVec4 fz )
+{
+   float gx[4], gy[4], gz[4];
+   int lane;
+
+   for ( lane = 0; lane < 4; lane++ )
+   {
+      int indx = ( ix[lane] + dx + hash ) & NOISE_TABLE_MASK;
+
+      gx[lane] = gradientX[indx];
+      gy[lane] = gradientY[indx];
+      gz[lane] = gradientZ[indx];
+   }
+
+   return esVec4Add ( esVec4Add ( esVec4Mul ( esVec4Load ( gx ), fx ),
+                                  esVec4Mul ( esVec4Load ( gy ), fy ) ),
+                      esVec4Mul ( esVec4Load ( gz ), fz ) );
+}
+
+#define esVec4Lerp( t, a, b )   esVec4Madd ( t, esVec4Sub ( b, a ), a )
+
+///
+// NoiseBlock()
+//
+//    Noise for four consecutive columns of a row
+//
+static ES_INLINE esVec4 NoiseBlock ( const NoiseColumns *columns, int x, const int hash[4],
+                                     esVec4 fy0, esVec4 fy1, esVec4 wy,
+                                     esVec4 fz0, esVec4 fz1, esVec4 wz )
+{
+   const int *ix = &columns->ix[x];
+   esVec4 fx0 = esVec4Load ( &columns->fx0[x] );
+   esVec4 fx1 = esVec4Sub ( fx0, esVec4Splat ( 1.0f ) );
+   esVec4 wx = esVec4Load ( &columns->wx[x] );
+   esVec4 vx0, vx1, vy0, vy1, vz0, vz1;
+
+   vx0 = LatticeBlock ( ix, 0, hash[0], fx0, fy0, fz0 );
+   vx1 = LatticeBlock ( ix, 1, hash[0], fx1, fy0, fz0 );
+   vy0 = esVec4Lerp ( wx, vx0, vx1 );
+   vx0 = LatticeBlock ( ix, 0, hash[1], fx0, fy1, fz0 );
+   vx1 = LatticeBlock ( ix, 1, hash[1], fx1, fy1, fz0 );
+   vy1 = esVec4Lerp ( wx, vx0, vx1 );
+   vz0 = esVec4Lerp ( wy, vy0, vy1 );
+
+   vx0 = LatticeBlock ( ix, 0, hash[2], fx0, fy0, fz1 );
+   vx1 = LatticeBlock ( ix, 1, hash[2], fx1, fy0, fz1 );
+   vy0 = esVec4Lerp ( wx, vx0, vx1 );
+   vx0 = LatticeBlock ( ix, 0, hash[3], fx0, fy1, fz1 );
+   vx1 = LatticeBlock ( ix, 1, hash[3], fx1, fy1, fz1 );
+   vy1 = esVec4Lerp ( wx, vx0, vx1 );
+   vz1 = esVec4Lerp ( wy, vy0, vy1 );
+
+   return esVec4Lerp ( wz, vz0, vz1 );
+}
+
+///
+// NoiseRow()
+//
+//    Accumulate amplitude * noise for one row into row[], NOISE_BLOCK
+//    columns per iteration
+//
+static void NoiseRow ( const NoiseColumns *columns, int rowLength, float py, float pz,
+                       float amplitude, float *row )
+{
+   int   iy = FLOOR ( py );
+   int   iz = FLOOR ( pz );
+   float fy0 = py - iy;
+   float fz0 = pz - iz;
+   float wy = smoothstep ( fy0 );
+   float wz = smoothstep ( fz0 );
+   esVec4 fy0v = esVec4Splat ( fy0 );
+   esVec4 fy1v = esVec4Splat ( fy0 - 1 );
+   esVec4 wyv = esVec4Splat ( wy );
+   esVec4 fz0v = esVec4Splat ( fz0 );
+   esVec4 fz1v = esVec4Splat ( fz0 - 1 );
+   esVec4 wzv = esVec4Splat ( wz );
+   esVec4 amp = esVec4Splat ( amplitude );
+   int hash[4];
+   int dy, dz, x;
+
+   // The y/z half of the lattice hash is the same for the whole row, one
+   // entry per ( dy, dz ) corner offset
+   for ( dz = 0; dz < 2; dz++ )
+   {
+      int z = permTable[( iz + dz ) & NOISE_TABLE_MASK];
+
+      for ( dy = 0; dy < 2; dy++ )
+      {
+         hash[dy + dz * 2] = permTable[( iy + dy + z ) & NOISE_TABLE_MASK];
+      }
+   }
+
+   for ( x = 0; x < rowLength; x += NOISE_BLOCK )
+   {
+      esVec4 n0 = NoiseBlock ( columns, x, hash, fy0v, fy1v, wyv, fz0v, fz1v, wzv );
+      esVec4 n1 = NoiseBlock ( columns, x + 4, hash, fy0v, fy1v, wyv, fz0v, fz1v, wzv );
+
+      esVec4Store ( &row[x], esVec4Madd ( n0, amp, esVec4Load ( &row[x] ) ) );
+      esVec4Store ( &row[x + 4], esVec4Madd ( n1, amp, esVec4Load ( &row[x + 4] ) ) );
+   }
+}
+
+///
+// GenerateSlices()
+//
+//    esParallelFor body: fill z slices [begin, end) and record their range
+//    and status
+//
+static void ESCALLBACK GenerateSlices ( void *arg, int begin, int end )
+{
+   NoiseVolume *volume = ( NoiseVolume * ) arg;
+   int size = volume->size;
+   float *row = ( float * ) malloc ( sizeof ( float ) * volume->rowLength );
+   int y, z, octave;
+
+   for ( z = begin; z < end; z++ )
+   {
+      volume->sliceOk[z] = row != NULL;
+   }
+
+   if ( row == NULL )
+   {
+      return;
+   }
+
+   for ( z = begin; z < end; z++ )
+   {
+      float *slice = &volume->values[( size_t ) z * size * size];
+      esVec4 minv = esVec4Splat ( 1000.0f );
+      esVec4 maxv = esVec4Splat ( -1000.0f );
+      float sliceMin, sliceMax;
+      float range[4];
+      int lane;
+
+      for ( y = 0; y < size; y++ )
+      {
+         float *dst = &slice[y * size];
+         int x = 0;
+
+         memset ( row, 0, sizeof ( float ) * volume->rowLength );
+
+         for ( octave = 0; octave < volume->octaves; octave++ )
+         {
+            float frequency = volume->frequencies[octave];
+            float py = ( float ) y / ( float ) size * frequency;
+            float pz = ( float ) z / ( float ) size * frequency;
+
+            NoiseRow ( &volume->columns[octave], volume->rowLength, py, pz, volume->amplitudes[octave], row );
+         }
+
+         // Copy out the real columns, tracking the range as we go
+         for ( ; x + 4 <= size; x += 4 )
+         {
+            esVec4 v = esVec4Load ( &row[x] );
+
+            minv = esVec4Min ( minv, v );
+            maxv = esVec4Max ( maxv, v );
+            esVec4Store ( &dst[x], v );
+         }
+
+         for ( ; x < size; x++ )
+         {
+            esVec4 v = esVec4Splat ( row[x] );
+
+            minv = esVec4Min ( minv, v );
+            maxv = esVec4Max ( maxv, v );
+            dst[x] = row[x];
+         }
+      }
+
+      esVec4Store ( range, minv );
+      sliceMin = range[0];
+
+      for ( lane = 1; lane < 4; lane++ )
+      {
+         sliceMin = range[lane] < sliceMin ? range[lane] : sliceMin;
+      }
+
+      esVec4Store ( range, maxv );
+      sliceMax = range[0];
+
+      for ( lane = 1; lane < 4; lane++ )
+      {
+         sliceMax = range[lane] > sliceMax ? range[lane] : sliceMax;
+      }
+
+      volume->sliceMin[z] = sliceMin;
+      volume->sliceMax[z] = sliceMax;
+   }
+
+   free ( row );
+}
+
+///
+// NormalizeSlices()
+//
+//    esParallelFor body: map z slices [begin, end) to [0, 255]
+//
+static void ESCALLBACK NormalizeSlices ( void *arg, int begin, int end )
+{
+   NoiseVolume *volume = ( NoiseVolume * ) arg;
+   size_t sliceSize = ( size_t ) volume->size * volume->size;
+   size_t i = ( size_t ) begin * sliceSize;
+   size_t last = ( size_t ) end * sliceSize;
+   float min = volume->min;
+   float scale = volume->scale;
+
+   for ( ; i < last; i++ )
+   {
+      volume->texels[i] = ( GLubyte ) ( ( volume->values[i] - min ) * scale );
+   }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esNoise3D()
+//
+//    generate the 3D noise value for the position (x, y, z)
+//
+float ESUTIL_API esNoise3D ( float x, float y, float z )
+{
+   int   ix, iy, iz;
+   float fx0, fx1, fy0, fy1, fz0, fz1;
+   float wx, wy, wz;
+   float vx0, vx1, vy0, vy1, vz0, vz1;
+
+   InitNoiseTable ( );
+
+   ix = FLOOR ( x );
+   fx0 = x - ix;
+   fx1 = fx0 - 1;
+   wx = smoothstep ( fx0 );
+
+   iy = FLOOR ( y );
+   fy0 = y - iy;
+   fy1 = fy0 - 1;
+   wy = smoothstep ( fy0 );
+
+   iz = FLOOR ( z );
+   fz0 = z - iz;
+   fz1 = fz0 - 1;
+   wz = smoothstep ( fz0 );
+
+   vx0 = glattice3D ( ix, iy, iz, fx0, fy0, fz0 );
+   vx1 = glattice3D ( ix + 1, iy, iz, fx1, fy0, fz0 );
+   vy0 = lerp ( wx, vx0, vx1 );
+   vx0 = glattice3D ( ix, iy + 1, iz, fx0, fy1, fz0 );
+   vx1 = glattice3D ( ix + 1, iy + 1, iz, fx1, fy1, fz0 );
+   vy1 = lerp ( wx, vx0, vx1 );
+   vz0 = lerp ( wy, vy0, vy1 );
+
+   vx0 = glattice3D ( ix, iy, iz + 1, fx0, fy0, fz1 );
+   vx1 = glattice3D ( ix + 1, iy, iz + 1, fx1, fy0, fz1 );
+   vy0 = lerp ( wx, vx0, vx1 );
+   vx0 = glattice3D ( ix, iy + 1, iz + 1, fx0, fy1, fz1 );
+   vx1 = glattice3D ( ix + 1, iy + 1, iz + 1, fx1, fy1, fz1 );
+   vy1 = lerp ( wx, vx0, vx1 );
+   vz1 = lerp ( wy, vy0, vy1 );
+
+   return lerp ( wz, vz0, vz1 );
+}
+
+///
+// esGenNoise3DArena()
+//
+//    Generate a size^3 volume of fBm noise normalized to [0, 255], with all
+//    memory from an arena, or the heap if arena is NULL
+//
+GLubyte *ESUTIL_API esGenNoise3DArena ( ESArena *arena, ESThreadPool *pool, int size, float frequency,
+                                        int octaves, float lacunarity, float gain )
+{
+   NoiseVolume volume;
+   ESArenaMark start = { NULL, 0, 0 };
+   ESArenaMark scratch = start;
+   size_t texelCount;
+   float max;
+   int octave, x, z;
+   int ok = GL_TRUE;
+
+   if ( size <= 0 )
+   {
+      return NULL;
+   }
+
+   if ( octaves < 1 )
+   {
+      octaves = 1;
+   }
+
+   InitNoiseTable ( );
+
+   memset ( &volume, 0, sizeof ( NoiseVolume ) );
+   texelCount = ( size_t ) size * size * size;
+   volume.size = size;
+   volume.rowLength = ( size + NOISE_BLOCK - 1 ) / NOISE_BLOCK * NOISE_BLOCK;
+   volume.octaves = octaves;
+
+   if ( arena != NULL )
+   {
+      start = esArenaGetMark ( arena );
+   }
+
+   // The texels are returned, everything after them is released at the end
+   volume.texels = ( GLubyte * ) esArenaMalloc ( arena, sizeof ( GLubyte ) * texelCount );
+
+   if ( arena != NULL )
+   {
+      scratch = esArenaGetMark ( arena );
+   }
+
+   volume.frequencies = ( float * ) esArenaMalloc ( arena, sizeof ( float ) * octaves );
+   volume.amplitudes = ( float * ) esArenaMalloc ( arena, sizeof ( float ) * octaves );
+   volume.columns = ( NoiseColumns * ) esArenaMalloc ( arena, sizeof ( NoiseColumns ) * octaves );
+   volume.values = ( float * ) esArenaMalloc ( arena, sizeof ( float ) * texelCount );
+   volume.sliceMin = ( float * ) esArenaMalloc ( arena, sizeof ( float ) * size );
+   volume.sliceMax = ( float * ) esArenaMalloc ( arena, sizeof ( float ) * size );
+   volume.sliceOk = ( GLboolean * ) esArenaMalloc ( arena, sizeof ( GLboolean ) * size );
+
+   if ( volume.columns != NULL )
+   {
+      memset ( volume.columns, 0, sizeof ( NoiseColumns ) * octaves );
+   }
+
+   if ( !volume.frequencies || !volume.amplitudes || !volume.columns || !volume.values ||
+        !volume.sliceMin || !volume.sliceMax || !volume.sliceOk || !volume.texels )
+   {
+      ok = GL_FALSE;
+   }
+
+   // Lattice coordinates of every column, per octave
+   for ( octave = 0; ok && octave < octaves; octave++ )
+   {
+      NoiseColumns *columns = &volume.columns[octave];
+
+      volume.frequencies[octave] = frequency * powf ( lacunarity, ( float ) octave );
+      volume.amplitudes[octave] = powf ( gain, ( float ) octave );
+
+      columns->ix = ( int * ) esArenaMalloc ( arena, sizeof ( int ) * volume.rowLength );
+      columns->fx0 = ( float * ) esArenaMalloc ( arena, sizeof ( float ) * volume.rowLength );
+      columns->wx = ( float * ) esArenaMalloc ( arena, sizeof ( float ) * volume.rowLength );
+
+      if ( !columns->ix || !columns->fx0 || !columns->wx )
+      {
+         ok = GL_FALSE;
+         break;
+      }
+
+      for ( x = 0; x < volume.rowLength; x++ )
+      {
+         float px = ( float ) x / ( float ) size * volume.frequencies[octave];
+
+         columns->ix[x] = FLOOR ( px );
+         columns->fx0[x] = px - columns->ix[x];
+         columns->wx[x] = smoothstep ( columns->fx0[x] );
+      }
+   }
+
+   if ( ok )
+   {
+      esParallelFor ( pool, size, GenerateSlices, &volume );
+
+      for ( z = 0; z < size; z++ )
+      {
+         ok = ok && volume.sliceOk[z];
+      }
+   }
+
+   if ( ok )
+   {
+      volume.min = volume.sliceMin[0];
+      max = volume.sliceMax[0];
+
+      for ( z = 1; z < size; z++ )
+      {
+         volume.min = volume.sliceMin[z] < volume.min ? volume.sliceMin[z] : volume.min;
+         max = volume.sliceMax[z] > max ? volume.sliceMax[z] : max;
+      }
+
+      // Normalize to the [0, 255] range
+      volume.scale = max > volume.min ? 255.0f / ( max - volume.min ) : 0.0f;
+      esParallelFor ( pool, size, NormalizeSlices, &volume );
+   }
+
+   if ( arena != NULL )
+   {
+      esArenaRelease ( arena, ok ? scratch : start );
+      return ok ? volume.texels : NULL;
+   }
+
+   for ( octave = 0; volume.columns != NULL && octave < octaves; octave++ )
+   {
+      free ( volume.columns[octave].ix );
+      free ( volume.columns[octave].fx0 );
+      free ( volume.columns[octave].wx );
+   }
+
+   free ( volume.columns );
+   free ( volume.frequencies );
+   free ( volume.amplitudes );
+   free ( volume.values );
+   free ( volume.sliceMin );
+   free ( volume.sliceMax );
+   free ( volume.sliceOk );
+
+   if ( !ok )
+   {
+      free ( volume.texels );
+      return NULL;
+   }
+
+   return volume.texels;
+}
+
+///
+// esGenNoise3D()
+//
+//    Generate a size^3 volume of fBm noise normalized to [0, 255]
+//
+GLubyte *ESUTIL_API esGenNoise3D ( ESThreadPool *pool, int size, float frequency, int octaves,
+                                   float lacunarity, float gain )
+{
+   return esGenNoise3DArena ( NULL, pool, size, frequency, octaves, lacunarity, gain );
+}
+
+///
+// esCreateNoise3DTextureArena()
+//
+//    Generate a noise volume and upload it as a GL_R8 3D texture, using
+//    memory from an arena, or the heap if arena is NULL
+//
+GLuint ESUTIL_API esCreateNoise3DTextureArena ( ESArena *arena, ESThreadPool *pool, int size,
+                                                float frequency, int octaves )
+{
+   GLuint textureId;
+   ESArenaMark mark = { NULL, 0, 0 };
+   GLubyte *texels;
+   GLint unpackAlignment;
+
+   if ( arena != NULL )
+   {
+      mark = esArenaGetMark ( arena );
+   }
+
+   texels = esGenNoise3DArena ( arena, pool, size, frequency, octaves, 2.0f, 0.5f );
+
+   if ( texels == NULL )
+   {
+      return 0;
+   }
+
+   // Rows of one byte texels are tightly packed, whatever the size
+   glGetIntegerv ( GL_UNPACK_ALIGNMENT, &unpackAlignment );
+   glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
+
+   glGenTextures ( 1, &textureId );
+   glBindTexture ( GL_TEXTURE_3D, textureId );
+   glTexImage3D ( GL_TEXTURE_3D, 0, GL_R8, size, size, size, 0,
+                  GL_RED, GL_UNSIGNED_BYTE, texels );
+
+   glPixelStorei ( GL_UNPACK_ALIGNMENT, unpackAlignment );
+
+   glTexParameteri ( GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+   glTexParameteri ( GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+   glTexParameteri ( GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT );
+   glTexParameteri ( GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT );
+   glTexParameteri ( GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_MIRRORED_REPEAT );
+
+   glBindTexture ( GL_TEXTURE_3D, 0 );
+
+   if ( arena != NULL )
+   {
+      // Give back the texels, everything else is released already
+      esArenaRelease ( arena, mark );
+   }
+   else
+   {
+      free ( texels );
+   }
+
+   return textureId;
+}
+
+///
+// esCreateNoise3DTexture()
+//
+//    Generate a noise volume and upload it as a GL_R8 3D texture
+//
+GLuint ESUTIL_API esCreateNoise3DTexture ( ESThreadPool *pool, int size, float frequency, int octaves )
+{
+   return esCreateNoise3DTextureArena ( NULL, pool, size, frequency, octaves );
+}
@@ -0,0 +1,664 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esParticles.c
+//
+//    CPU particle simulation.  Particles are kept as structure-of-arrays
+//    streams so the update runs four particles per SIMD instruction.  Dead
+//    particles are dropped by compacting the survivors into a second set
+//    of streams while integrating, so there is no free list to maintain
+//    and the live particles are always the first count entries.  Both the
+//    update and the vertex buffer fill are split into blocks across an
+//    optional thread pool.  For alpha blending the fill can gather the
+//    particles back to front, through indices from a radix sort of their
+//    depths, so the sort never moves the particle data itself.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include "esSimd.h"
+#include <stdlib.h>
+#include <string.h>
+
+///
+//  Macros
+//
+
+// Particles per block of the parallel update, a multiple of 4
+#define PARTICLE_BLOCK        8192
+
+// Shortest lifetime an emitter may hand out, keeps 1 / life finite
+#define PARTICLE_MIN_LIFE     0.0001f
+
+///
+//  Types
+//
+
+// One set of particle streams
+typedef struct
+{
+   GLfloat *px, *py, *pz;
+   GLfloat *vx, *vy, *vz;
+
+   // Normalized age in [0, 1) and how fast it advances ( 1 / lifetime )
+   GLfloat *age;
+   GLfloat *ageRate;
+
+   // Single allocation holding all of the above
+   GLfloat *storage;
+} ParticleStreams;
+
+struct ESParticleSystem
+{
+   ESThreadPool     *pool;
+
+   int               capacity;
+   int               count;
+
+   // Live particles are in streams[current], the other set is the compaction target
+   ParticleStreams   streams[2];
+   int               current;
+
+   // Per block survivor counts, then output offsets, for the update
+   int              *blockAlive;
+   int               blockCount;
+
+   ESParticleEmitter *emitters;
+   GLfloat          *emitterCarry;
+   int               emitterCount;
+
+   GLfloat           gravity[3];
+   GLfloat           deltaTime;
+   unsigned int      seed;
+
+   // Vertex buffer filled by esParticleSystemUpload
+   GLuint            vbo;
+   ESParticleVertex *mapped;
+
+   // Depth sort, enabled by a nonzero direction
+   GLfloat           sortDirection[3];
+   GLboolean         sort;
+   GLuint           *sortKeys;
+   GLuint           *sortIndices;
+   GLuint           *sortScratch;
+};
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// AllocStreams()
+//
+static GLboolean AllocStreams ( ParticleStreams *streams, int capacity )
+{
+   GLfloat *p = ( GLfloat * ) calloc ( ( size_t ) capacity * 8, sizeof ( GLfloat ) );
+
+   if ( p == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   streams->storage = p;
+   streams->px = p;
+   streams->py = p + ( size_t ) capacity;
+   streams->pz = p + ( size_t ) capacity * 2;
+   streams->vx = p + ( size_t ) capacity * 3;
+   streams->vy = p + ( size_t ) capacity * 4;
+   streams->vz = p + ( size_t ) capacity * 5;
+   streams->age = p + ( size_t ) capacity * 6;
+   streams->ageRate = p + ( size_t ) capacity * 7;
+
+   return GL_TRUE;
+}
+
+///
+// Random()
+//
+//    Uniform float in [0, 1) from a xorshift generator
+//
+static GLfloat Random ( unsigned int *seed )
+{
+   unsigned int x = *seed;
+
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   *seed = x;
+
+   return ( GLfloat ) ( x >> 8 ) * ( 1.0f / 16777216.0f );
+}
+
+///
+// CountSurvivors()
+//
+//    esParallelFor body: count the particles in blocks [begin, end) that
+//    are still alive after this step
+//
+static void ESCALLBACK CountSurvivors ( void *arg, int begin, int end )
+{
+   ESParticleSystem *ps = ( ESParticleSystem * ) arg;
+   const ParticleStreams *src = &ps->streams[ps->current];
+   esVec4 dt = esVec4Splat ( ps->deltaTime );
+   esVec4 one = esVec4Splat ( 1.0f );
+   int block;
+
+   for ( block = begin; block < end; block++ )
+   {
+      int first = block * PARTICLE_BLOCK;
+      int last = first + PARTICLE_BLOCK < ps->count ? first + PARTICLE_BLOCK : ps->count;
+      int alive = 0;
+      int i;
+
+      for ( i = first; i < last; i += 4 )
+      {
+         esVec4 age = esVec4Madd ( esVec4Load ( &src->ageRate[i] ), dt, esVec4Load ( &src->age[i] ) );
+         int mask = esVec4LessMask ( age, one );
+
+         if ( last - i < 4 )
+         {
+            // Lanes past the end of the live particles
+            mask &= ( 1 << ( last - i ) ) - 1;
+         }
+
+         alive += ( mask & 1 ) + ( ( mask >> 1 ) & 1 ) + ( ( mask >> 2 ) & 1 ) + ( ( mask >> 3 ) & 1 );
+      }
+
+      ps->blockAlive[block] = alive;
+   }
+}
+
+///
+// IntegrateBlocks()
+//
+//    esParallelFor body: advance the particles in blocks [begin, end) and
+//    write the survivors to the other stream set, starting at the block's
+//    output offset
+//
+static void ESCALLBACK IntegrateBlocks ( void *arg, int begin, int end )
+{
+   ESParticleSystem *ps = ( ESParticleSystem * ) arg;
+   const ParticleStreams *src = &ps->streams[ps->current];
+   const ParticleStreams *dst = &ps->streams[ps->current ^ 1];
+   esVec4 dt = esVec4Splat ( ps->deltaTime );
+   esVec4 one = esVec4Splat ( 1.0f );
+   esVec4 gx = esVec4Splat ( ps->gravity[0] * ps->deltaTime );
+   esVec4 gy = esVec4Splat ( ps->gravity[1] * ps->deltaTime );
+   esVec4 gz = esVec4Splat ( ps->gravity[2] * ps->deltaTime );
+   int block;
+
+   for ( block = begin; block < end; block++ )
+   {
+      int first = block * PARTICLE_BLOCK;
+      int last = first + PARTICLE_BLOCK < ps->count ? first + PARTICLE_BLOCK : ps->count;
+      int out = ps->blockAlive[block];
+      int i;
+
+      for ( i = first; i < last; i += 4 )
+      {
+         GLfloat p[3][4], v[3][4], age[4];
+         esVec4 vx, vy, vz;
+         esVec4 a = esVec4Madd ( esVec4Load ( &src->ageRate[i] ), dt, esVec4Load ( &src->age[i] ) );
+         int mask = esVec4LessMask ( a, one );
+         int lane;
+
+         if ( last - i < 4 )
+         {
+            mask &= ( 1 << ( last - i ) ) - 1;
+         }
+
+         if ( mask == 0 )
+         {
+            continue;
+         }
+
+         // Semi-implicit Euler: v += g * dt, p += v * dt
+         vx = esVec4Add ( esVec4Load ( &src->vx[i] ), gx );
+         vy = esVec4Add ( esVec4Load ( &src->vy[i] ), gy );
+         vz = esVec4Add ( esVec4Load ( &src->vz[i] ), gz );
+
+         if ( mask == 0xF )
+         {
+            // Common case, all four survive and are stored as they are
+            esVec4Store ( &dst->px[out], esVec4Madd ( vx, dt, esVec4Load ( &src->px[i] ) ) );
+            esVec4Store ( &dst->py[out], esVec4Madd ( vy, dt, esVec4Load ( &src->py[i] ) ) );
+            esVec4Store ( &dst->pz[out], esVec4Madd ( vz, dt, esVec4Load ( &src->pz[i] ) ) );
+            esVec4Store ( &dst->vx[out], vx );
+            esVec4Store ( &dst->vy[out], vy );
+            esVec4Store ( &dst->vz[out], vz );
+            esVec4Store ( &dst->age[out], a );
+            esVec4Store ( &dst->ageRate[out], esVec4Load ( &src->ageRate[i] ) );
+            out += 4;
+            continue;
+         }
+
+         esVec4Store ( p[0], esVec4Madd ( vx, dt, esVec4Load ( &src->px[i] ) ) );
+         esVec4Store ( p[1], esVec4Madd ( vy, dt, esVec4Load ( &src->py[i] ) ) );
+         esVec4Store ( p[2], esVec4Madd ( vz, dt, esVec4Load ( &src->pz[i] ) ) );
+         esVec4Store ( v[0], vx );
+         esVec4Store ( v[1], vy );
+         esVec4Store ( v[2], vz );
+         esVec4Store ( age, a );
+
+         // Only write survivors, a write past the last one would land in the
+         // next block's output range
+         for ( lane = 0; lane < 4; lane++ )
+         {
+            if ( mask & ( 1 << lane ) )
+            {
+               dst->px[out] = p[0][lane];
+               dst->py[out] = p[1][lane];
+               dst->pz[out] = p[2][lane];
+               dst->vx[out] = v[0][lane];
+               dst->vy[out] = v[1][lane];
+               dst->vz[out] = v[2][lane];
+               dst->age[out] = age[lane];
+               dst->ageRate[out] = src->ageRate[i + lane];
+               out++;
+            }
+         }
+      }
+   }
+}
+
+///
+// ComputeSortKeys()
+//
+//    esParallelFor body: keys for particles [begin, end) that sort the
+//    farthest first
+//
+static void ESCALLBACK ComputeSortKeys ( void *arg, int begin, int end )
+{
+   ESParticleSystem *ps = ( ESParticleSystem * ) arg;
+   const ParticleStreams *src = &ps->streams[ps->current];
+   GLfloat dx = ps->sortDirection[0];
+   GLfloat dy = ps->sortDirection[1];
+   GLfloat dz = ps->sortDirection[2];
+   int i;
+
+   for ( i = begin; i < end; i++ )
+   {
+      GLfloat depth = src->px[i] * dx + src->py[i] * dy + src->pz[i] * dz;
+
+      // Inverted for descending order
+      ps->sortKeys[i] = ~esFloatSortKey ( depth );
+   }
+}
+
+///
+// FillVertices()
+//
+//    esParallelFor body: write vertices [begin, end) of the mapped buffer
+//
+static void ESCALLBACK FillVertices ( void *arg, int begin, int end )
+{
+   ESParticleSystem *ps = ( ESParticleSystem * ) arg;
+   const ParticleStreams *src = &ps->streams[ps->current];
+   ESParticleVertex *vertex = ps->mapped + begin;
+   int i;
+
+   if ( ps->sort )
+   {
+      for ( i = begin; i < end; i++, vertex++ )
+      {
+         GLuint j = ps->sortIndices[i];
+
+         vertex->position[0] = src->px[j];
+         vertex->position[1] = src->py[j];
+         vertex->position[2] = src->pz[j];
+         vertex->age = src->age[j];
+      }
+
+      return;
+   }
+
+   for ( i = begin; i < end; i++, vertex++ )
+   {
+      vertex->position[0] = src->px[i];
+      vertex->position[1] = src->py[i];
+      vertex->position[2] = src->pz[i];
+      vertex->age = src->age[i];
+   }
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esParticleSystemCreate()
+//
+ESParticleSystem *ESUTIL_API esParticleSystemCreate ( int capacity, ESThreadPool *pool )
+{
+   ESParticleSystem *ps;
+   int padded;
+
+   if ( capacity <= 0 )
+   {
+      return NULL;
+   }
+
+   ps = ( ESParticleSystem * ) calloc ( 1, sizeof ( ESParticleSystem ) );
+
+   if ( ps == NULL )
+   {
+      return NULL;
+   }
+
+   // Room for the loads of the last partial group of four
+   padded = ( capacity + 3 ) / 4 * 4;
+
+   ps->pool = pool;
+   ps->capacity = capacity;
+   ps->blockCount = ( capacity + PARTICLE_BLOCK - 1 ) / PARTICLE_BLOCK;
+   ps->blockAlive = ( int * ) calloc ( ps->blockCount, sizeof ( int ) );
+   ps->seed = 0x9E3779B9u;
+
+   if ( ps->blockAlive == NULL || !AllocStreams ( &ps->streams[0], padded ) ||
+        !AllocStreams ( &ps->streams[1], padded ) )
+   {
+      esParticleSystemDestroy ( ps );
+      return NULL;
+   }
+
+   return ps;
+}
+
+///
+// esParticleSystemDestroy()
+//
+void ESUTIL_API esParticleSystemDestroy ( ESParticleSystem *ps )
+{
+   if ( ps == NULL )
+   {
+      return;
+   }
+
+   if ( ps->vbo != 0 )
+   {
+      glDeleteBuffers ( 1, &ps->vbo );
+   }
+
+   free ( ps->streams[0].storage );
+   free ( ps->streams[1].storage );
+   free ( ps->blockAlive );
+   free ( ps->emitters );
+   free ( ps->emitterCarry );
+   free ( ps->sortKeys );
+   free ( ps->sortIndices );
+   free ( ps->sortScratch );
+   free ( ps );
+}
+
+///
+// esParticleSystemAddEmitter()
+//
+int ESUTIL_API esParticleSystemAddEmitter ( ESParticleSystem *ps, const ESParticleEmitter *emitter )
+{
+   ESParticleEmitter *emitters;
+   GLfloat *carry;
+   int count = ps->emitterCount + 1;
+
+   emitters = ( ESParticleEmitter * ) realloc ( ps->emitters, sizeof ( ESParticleEmitter ) * count );
+
+   if ( emitters == NULL )
+   {
+      return -1;
+   }
+
+   ps->emitters = emitters;
+   carry = ( GLfloat * ) realloc ( ps->emitterCarry, sizeof ( GLfloat ) * count );
+
+   if ( carry == NULL )
+   {
+      return -1;
+   }
+
+   ps->emitterCarry = carry;
+   ps->emitters[ps->emitterCount] = *emitter;
+   ps->emitterCarry[ps->emitterCount] = 0.0f;
+
+   return ps->emitterCount++;
+}
+
+///
+// esParticleSystemGetEmitter()
+//
+ESParticleEmitter *ESUTIL_API esParticleSystemGetEmitter ( ESParticleSystem *ps, int emitter )
+{
+   if ( emitter < 0 || emitter >= ps->emitterCount )
+   {
+      return NULL;
+   }
+
+   return &ps->emitters[emitter];
+}
+
+///
+// esParticleSystemSetGravity()
+//
+void ESUTIL_API esParticleSystemSetGravity ( ESParticleSystem *ps, GLfloat x, GLfloat y, GLfloat z )
+{
+   ps->gravity[0] = x;
+   ps->gravity[1] = y;
+   ps->gravity[2] = z;
+}
+
+///
+// esParticleSystemEmit()
+//
+int ESUTIL_API esParticleSystemEmit ( ESParticleSystem *ps, int emitter, int count )
+{
+   const ESParticleEmitter *e = esParticleSystemGetEmitter ( ps, emitter );
+   ParticleStreams *streams = &ps->streams[ps->current];
+   GLfloat lifeRange;
+   int i;
+
+   if ( e == NULL )
+   {
+      return 0;
+   }
+
+   if ( count > ps->capacity - ps->count )
+   {
+      count = ps->capacity - ps->count;
+   }
+
+   lifeRange = e->lifeMax - e->lifeMin;
+
+   for ( i = ps->count; i < ps->count + count; i++ )
+   {
+      GLfloat life = e->lifeMin + lifeRange * Random ( &ps->seed );
+
+      streams->px[i] = e->position[0] + e->positionSpread[0] * ( 2.0f * Random ( &ps->seed ) - 1.0f );
+      streams->py[i] = e->position[1] + e->positionSpread[1] * ( 2.0f * Random ( &ps->seed ) - 1.0f );
+      streams->pz[i] = e->position[2] + e->positionSpread[2] * ( 2.0f * Random ( &ps->seed ) - 1.0f );
+      streams->vx[i] = e->velocity[0] + e->velocitySpread[0] * ( 2.0f * Random ( &ps->seed ) - 1.0f );
+      streams->vy[i] = e->velocity[1] + e->velocitySpread[1] * ( 2.0f * Random ( &ps->seed ) - 1.0f );
+      streams->vz[i] = e->velocity[2] + e->velocitySpread[2] * ( 2.0f * Random ( &ps->seed ) - 1.0f );
+      streams->age[i] = 0.0f;
+      streams->ageRate[i] = 1.0f / ( life > PARTICLE_MIN_LIFE ? life : PARTICLE_MIN_LIFE );
+   }
+
+   ps->count += count;
+
+   return count;
+}
+
+///
+// esParticleSystemUpdate()
+//
+void ESUTIL_API esParticleSystemUpdate ( ESParticleSystem *ps, GLfloat deltaTime )
+{
+   int blocks = ( ps->count + PARTICLE_BLOCK - 1 ) / PARTICLE_BLOCK;
+   int offset = 0;
+   int block;
+   int i;
+
+   ps->deltaTime = deltaTime;
+
+   if ( blocks > 0 )
+   {
+      // Count survivors per block, turn the counts into output offsets, then
+      // integrate and compact every block straight to its place
+      esParallelFor ( ps->pool, blocks, CountSurvivors, ps );
+
+      for ( block = 0; block < blocks; block++ )
+      {
+         int alive = ps->blockAlive[block];
+
+         ps->blockAlive[block] = offset;
+         offset += alive;
+      }
+
+      esParallelFor ( ps->pool, blocks, IntegrateBlocks, ps );
+
+      ps->current ^= 1;
+      ps->count = offset;
+   }
+
+   // Continuous emitters
+   for ( i = 0; i < ps->emitterCount; i++ )
+   {
+      int count;
+
+      ps->emitterCarry[i] += ps->emitters[i].rate * deltaTime;
+      count = ( int ) ps->emitterCarry[i];
+      ps->emitterCarry[i] -= ( GLfloat ) count;
+
+      if ( count > 0 )
+      {
+         esParticleSystemEmit ( ps, i, count );
+      }
+   }
+}
+
+///
+// esParticleSystemCount()
+//
+int ESUTIL_API esParticleSystemCount ( ESParticleSystem *ps )
+{
+   return ps->count;
+}
+
+///
+// esParticleSystemSetSortDirection()
+//
+GLboolean ESUTIL_API esParticleSystemSetSortDirection ( ESParticleSystem *ps, GLfloat x, GLfloat y, GLfloat z )
+{
+   ps->sortDirection[0] = x;
+   ps->sortDirection[1] = y;
+   ps->sortDirection[2] = z;
+   ps->sort = x != 0.0f || y != 0.0f || z != 0.0f;
+
+   if ( ps->sort && ps->sortKeys == NULL )
+   {
+      ps->sortKeys = ( GLuint * ) malloc ( sizeof ( GLuint ) * ps->capacity );
+      ps->sortIndices = ( GLuint * ) malloc ( sizeof ( GLuint ) * ps->capacity );
+      ps->sortScratch = ( GLuint * ) malloc ( sizeof ( GLuint ) * 3 * ( size_t ) ps->capacity );
+
+      if ( ps->sortKeys == NULL || ps->sortIndices == NULL || ps->sortScratch == NULL )
+      {
+         free ( ps->sortKeys );
+         free ( ps->sortIndices );
+         free ( ps->sortScratch );
+         ps->sortKeys = ps->sortIndices = ps->sortScratch = NULL;
+         ps->sort = GL_FALSE;
+         return GL_FALSE;
+      }
+   }
+
+   return GL_TRUE;
+}
+
+///
+// esParticleSystemUpload()
+//
+GLuint ESUTIL_API esParticleSystemUpload ( ESParticleSystem *ps )
+{
+   GLsizeiptr size = ( GLsizeiptr ) ps->count * sizeof ( ESParticleVertex );
+
+   if ( ps->vbo == 0 )
+   {
+      glGenBuffers ( 1, &ps->vbo );
+      glBindBuffer ( GL_ARRAY_BUFFER, ps->vbo );
+      glBufferData ( GL_ARRAY_BUFFER, ( GLsizeiptr ) ps->capacity * sizeof ( ESParticleVertex ), NULL, GL_STREAM_DRAW );
+   }
+   else
+   {
+      glBindBuffer ( GL_ARRAY_BUFFER, ps->vbo );
+   }
+
+   if ( size == 0 )
+   {
+      return ps->vbo;
+   }
+
+   // Sort before mapping, so the buffer is mapped only for the copy
+   if ( ps->sort )
+   {
+      esParallelFor ( ps->pool, ps->count, ComputeSortKeys, ps );
+
+      // If the sort could not allocate its histograms, draw unsorted
+      if ( !esRadixSortIndices ( ps->pool, ps->sortKeys, ps->sortIndices, ps->count, ps->sortScratch ) )
+      {
+         int i;
+
+         for ( i = 0; i < ps->count; i++ )
+         {
+            ps->sortIndices[i] = i;
+         }
+      }
+   }
+
+   // Invalidating lets the driver hand out fresh storage instead of waiting
+   // for the previous frame's draw to finish reading
+   ps->mapped = ( ESParticleVertex * ) glMapBufferRange ( GL_ARRAY_BUFFER, 0, size,
+                                                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+
+   if ( ps->mapped == NULL )
+   {
+      return ps->vbo;
+   }
+
+   esParallelFor ( ps->pool, ps->count, FillVertices, ps );
+
+   glUnmapBuffer ( GL_ARRAY_BUFFER );
+   ps->mapped = NULL;
+
+   return ps->vbo;
+}
@@ -0,0 +1,186 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esSampler.c
+//
+//    Cache of sampler objects keyed by their full parameter set, so every
+//    distinct combination of filter, wrap, LOD and compare state is created
+//    once and shared.  Binding a sampler with glBindSampler replaces
+//    rewriting the parameters of the texture between draws, which many
+//    drivers answer by revalidating the texture.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdlib.h>
+#include <string.h>
+
+///
+//  Types
+//
+typedef struct
+{
+   ESSamplerDesc  desc;
+   GLuint         sampler;
+} SamplerEntry;
+
+struct ESSamplerCache
+{
+   SamplerEntry  *entries;
+   int            count;
+   int            capacity;
+};
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// DescEqual()
+//
+static int DescEqual ( const ESSamplerDesc *a, const ESSamplerDesc *b )
+{
+   return a->minFilter == b->minFilter && a->magFilter == b->magFilter &&
+          a->wrapS == b->wrapS && a->wrapT == b->wrapT && a->wrapR == b->wrapR &&
+          a->minLod == b->minLod && a->maxLod == b->maxLod &&
+          a->compareMode == b->compareMode && a->compareFunc == b->compareFunc;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esSamplerDescInit()
+//
+void ESUTIL_API esSamplerDescInit ( ESSamplerDesc *desc )
+{
+   // The defaults of a new sampler or texture object
+   desc->minFilter = GL_NEAREST_MIPMAP_LINEAR;
+   desc->magFilter = GL_LINEAR;
+   desc->wrapS = GL_REPEAT;
+   desc->wrapT = GL_REPEAT;
+   desc->wrapR = GL_REPEAT;
+   desc->minLod = -1000.0f;
+   desc->maxLod = 1000.0f;
+   desc->compareMode = GL_NONE;
+   desc->compareFunc = GL_LEQUAL;
+}
+
+///
+// esSamplerCacheCreate()
+//
+ESSamplerCache *ESUTIL_API esSamplerCacheCreate ( void )
+{
+   return ( ESSamplerCache * ) calloc ( 1, sizeof ( ESSamplerCache ) );
+}
+
+///
+// esSamplerCacheDestroy()
+//
+void ESUTIL_API esSamplerCacheDestroy ( ESSamplerCache *cache )
+{
+   int i;
+
+   if ( cache == NULL )
+   {
+      return;
+   }
+
+   for ( i = 0; i < cache->count; i++ )
+   {
+      glDeleteSamplers ( 1, &cache->entries[i].sampler );
+   }
+
+   free ( cache->entries );
+   free ( cache );
+}
+
+///
+// esGetSampler()
+//
+GLuint ESUTIL_API esGetSampler ( ESSamplerCache *cache, const ESSamplerDesc *desc )
+{
+   SamplerEntry *entry;
+   int i;
+
+   // Programs use a handful of samplers, a linear search is enough
+   for ( i = 0; i < cache->count; i++ )
+   {
+      if ( DescEqual ( &cache->entries[i].desc, desc ) )
+      {
+         return cache->entries[i].sampler;
+      }
+   }
+
+   if ( cache->count == cache->capacity )
+   {
+      int capacity = cache->capacity > 0 ? cache->capacity * 2 : 8;
+      SamplerEntry *entries = ( SamplerEntry * ) realloc ( cache->entries, sizeof ( SamplerEntry ) * capacity );
+
+      if ( entries == NULL )
+      {
+         return 0;
+      }
+
+      cache->entries = entries;
+      cache->capacity = capacity;
+   }
+
+   entry = &cache->entries[cache->count];
+   entry->desc = *desc;
+   glGenSamplers ( 1, &entry->sampler );
+
+   if ( entry->sampler == 0 )
+   {
+      return 0;
+   }
+
+   glSamplerParameteri ( entry->sampler, GL_TEXTURE_MIN_FILTER, desc->minFilter );
+   glSamplerParameteri ( entry->sampler, GL_TEXTURE_MAG_FILTER, desc->magFilter );
+   glSamplerParameteri ( entry->sampler, GL_TEXTURE_WRAP_S, desc->wrapS );
+   glSamplerParameteri ( entry->sampler, GL_TEXTURE_WRAP_T, desc->wrapT );
+   glSamplerParameteri ( entry->sampler, GL_TEXTURE_WRAP_R, desc->wrapR );
+   glSamplerParameterf ( entry->sampler, GL_TEXTURE_MIN_LOD, desc->minLod );
+   glSamplerParameterf ( entry->sampler, GL_TEXTURE_MAX_LOD, desc->maxLod );
+   glSamplerParameteri ( entry->sampler, GL_TEXTURE_COMPARE_MODE, desc->compareMode );
+   glSamplerParameteri ( entry->sampler, GL_TEXTURE_COMPARE_FUNC, desc->compareFunc );
+
+   cache->count++;
+
+   return entry->sampler;
+}
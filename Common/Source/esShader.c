@@ -38,7 +38,97 @@
 //  Includes
 //
 #include "esUtil.h"
+#include "esThread.h"
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+///
+//  Macros
+//
+#define PROGRAM_CACHE_MAGIC     0x42505345   // "ESPB"
+#define PROGRAM_CACHE_VERSION   1
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+// GL_KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR   0x91B1
+#endif
+
+typedef void ( GL_APIENTRY *ESMAXSHADERCOMPILERTHREADSKHRPROC ) ( GLuint count );
+
+///
+//  Types
+//
+typedef struct
+{
+   GLuint   magic;
+   GLuint   version;
+   GLuint64 key;
+   GLenum   binaryFormat;
+   GLuint   length;
+} ProgramCacheHeader;
+
+typedef enum
+{
+   ASYNC_MODE_UNKNOWN = 0,
+   ASYNC_MODE_PARALLEL,   // GL_KHR_parallel_shader_compile, poll GL_COMPLETION_STATUS_KHR
+   ASYNC_MODE_WORKER,     // compile on a worker thread with a shared context
+   ASYNC_MODE_DEFERRED    // issue everything now, only query the status when polled
+} AsyncMode;
+
+struct ESProgramAsync
+{
+   AsyncMode   mode;
+
+   // Objects for programs compiled on the calling thread
+   GLuint      vertexShader;
+   GLuint      fragmentShader;
+   GLuint      programObject;
+
+   // Program cache entry to fill in once linked, cacheDir is NULL if caching is off
+   const char *cacheDir;
+   GLuint64    cacheKey;
+
+   // Sources copied for the worker thread, and its result (guarded by the worker mutex)
+   char       *vertShaderSrc;
+   char       *fragShaderSrc;
+   int         done;
+
+   struct ESProgramAsync *next;
+};
+
+typedef struct
+{
+   ESThread    thread;
+   ESMutex     mutex;
+   ESCond      cond;
+
+   // Pending jobs, oldest first
+   ESProgramAsync *head;
+   ESProgramAsync *tail;
+
+#ifndef __APPLE__
+   EGLDisplay  display;
+   EGLContext  context;
+   EGLSurface  surface;
+#endif
+
+   // Set by the worker once it has made its context current (1) or failed to (-1)
+   int         state;
+} AsyncWorker;
+
+///
+//  Local variables
+//
+static char s_programCacheDir[512];
+static int  s_programCacheDirSet = 0;
+
+static AsyncMode   s_asyncMode = ASYNC_MODE_UNKNOWN;
+static AsyncWorker s_asyncWorker;
 
 //////////////////////////////////////////////////////////////////
 //
@@ -46,7 +136,583 @@
 //
 //
 
+///
+// CheckShaderCompiled()
+//
+//    Query the compile status, logging the info log on failure
+//
+static GLint CheckShaderCompiled ( GLuint shader )
+{
+   GLint compiled;
+
+   glGetShaderiv ( shader, GL_COMPILE_STATUS, &compiled );
+
+   if ( !compiled )
+   {
+      GLint infoLen = 0;
+
+      glGetShaderiv ( shader, GL_INFO_LOG_LENGTH, &infoLen );
+
+      if ( infoLen > 1 )
+      {
+         char *infoLog = malloc ( sizeof ( char ) * infoLen );
+
+         glGetShaderInfoLog ( shader, infoLen, NULL, infoLog );
+         esLogMessage ( "Error compiling shader:\n%s\n", infoLog );
+
+         free ( infoLog );
+      }
+   }
+
+   return compiled;
+}
+
+///
+// CheckProgramLinked()
+//
+//    Query the link status, logging the info log on failure
+//
+static GLint CheckProgramLinked ( GLuint programObject )
+{
+   GLint linked;
+
+   glGetProgramiv ( programObject, GL_LINK_STATUS, &linked );
+
+   if ( !linked )
+   {
+      GLint infoLen = 0;
+
+      glGetProgramiv ( programObject, GL_INFO_LOG_LENGTH, &infoLen );
+
+      if ( infoLen > 1 )
+      {
+         char *infoLog = malloc ( sizeof ( char ) * infoLen );
+
+         glGetProgramInfoLog ( programObject, infoLen, NULL, infoLog );
+         esLogMessage ( "Error linking program:\n%s\n", infoLog );
+
+         free ( infoLog );
+      }
+   }
+
+   return linked;
+}
+
+///
+// HashBytes()
+//
+//    64-bit FNV-1a, chained through 'hash' so several strings can be combined
+//
+static GLuint64 HashBytes ( GLuint64 hash, const void *data, size_t length )
+{
+   const unsigned char *bytes = ( const unsigned char * ) data;
+   size_t i;
+
+   for ( i = 0; i < length; i++ )
+   {
+      hash ^= bytes[i];
+      hash *= 1099511628211ULL;
+   }
+
+   return hash;
+}
+
+///
+// HashString()
+//
+//    Hash a string including its terminator so that "ab"+"c" != "a"+"bc"
+//
+static GLuint64 HashString ( GLuint64 hash, const char *str )
+{
+   if ( str == NULL )
+   {
+      str = "";
+   }
+
+   return HashBytes ( hash, str, strlen ( str ) + 1 );
+}
+
+///
+// GetProgramCacheDir()
+//
+//    Directory holding cached program binaries, NULL if caching is disabled
+//
+static const char *GetProgramCacheDir ( void )
+{
+   if ( !s_programCacheDirSet )
+   {
+      const char *env = getenv ( "ES_PROGRAM_CACHE_DIR" );
+      return ( env != NULL && env[0] != '\0' ) ? env : NULL;
+   }
+
+   return s_programCacheDir[0] != '\0' ? s_programCacheDir : NULL;
+}
+
+///
+// ProgramCacheKey()
+//
+//    Key a program by everything that affects its binary: both sources, the
+//    transform feedback setup and the driver that produced it
+//
+static GLuint64 ProgramCacheKey ( const char *vertShaderSrc, const char *fragShaderSrc,
+                                  GLsizei varyingCount, const char *const *varyings, GLenum bufferMode )
+{
+   GLuint64 key = 14695981039346656037ULL;
+   GLsizei i;
+
+   key = HashString ( key, vertShaderSrc );
+   key = HashString ( key, fragShaderSrc );
+
+   for ( i = 0; i < varyingCount; i++ )
+   {
+      key = HashString ( key, varyings[i] );
+   }
+
+   key = HashBytes ( key, &varyingCount, sizeof ( varyingCount ) );
+   key = HashBytes ( key, &bufferMode, sizeof ( bufferMode ) );
+   key = HashString ( key, ( const char * ) glGetString ( GL_VENDOR ) );
+   key = HashString ( key, ( const char * ) glGetString ( GL_RENDERER ) );
+   key = HashString ( key, ( const char * ) glGetString ( GL_VERSION ) );
+
+   return key;
+}
+
+///
+// ProgramCachePath()
+//
+static void ProgramCachePath ( char *path, size_t size, const char *dir, GLuint64 key )
+{
+   snprintf ( path, size, "%s/%08x%08x.esprog", dir,
+              ( unsigned int ) ( key >> 32 ), ( unsigned int ) key );
+}
+
+///
+// IsBinaryFormatSupported()
+//
+//    glProgramBinary raises GL_INVALID_ENUM for a format the driver no
+//    longer lists, so entries in such formats are skipped before the call
+//
+static GLboolean IsBinaryFormatSupported ( GLenum binaryFormat )
+{
+   GLint numBinaryFormats = 0;
+   GLint *binaryFormats;
+   GLboolean supported = GL_FALSE;
+   GLint i;
+
+   glGetIntegerv ( GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats );
+
+   if ( numBinaryFormats <= 0 )
+   {
+      return GL_FALSE;
+   }
+
+   binaryFormats = malloc ( sizeof ( GLint ) * numBinaryFormats );
+
+   if ( binaryFormats == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   glGetIntegerv ( GL_PROGRAM_BINARY_FORMATS, binaryFormats );
+
+   for ( i = 0; i < numBinaryFormats && !supported; i++ )
+   {
+      supported = ( GLenum ) binaryFormats[i] == binaryFormat;
+   }
+
+   free ( binaryFormats );
+   return supported;
+}
+
+///
+// LoadCachedProgram()
+//
+//    Create a program from a cached binary.  Returns 0 if there is no cache
+//    entry or the driver rejects it (e.g. after a driver update), in which
+//    case the caller compiles from source and rewrites the entry.
+//
+static GLuint LoadCachedProgram ( const char *dir, GLuint64 key )
+{
+   char path[600];
+   ProgramCacheHeader header;
+   GLuint programObject = 0;
+   GLint linked = 0;
+   void *binary;
+   FILE *fp;
+
+   ProgramCachePath ( path, sizeof ( path ), dir, key );
+   fp = fopen ( path, "rb" );
+
+   if ( fp == NULL )
+   {
+      return 0;
+   }
+
+   if ( fread ( &header, sizeof ( header ), 1, fp ) != 1 ||
+        header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION ||
+        header.key != key || header.length == 0 || !IsBinaryFormatSupported ( header.binaryFormat ) )
+   {
+      fclose ( fp );
+      return 0;
+   }
+
+   binary = malloc ( header.length );
+
+   if ( binary != NULL && fread ( binary, header.length, 1, fp ) == 1 )
+   {
+      programObject = glCreateProgram ( );
+
+      if ( programObject != 0 )
+      {
+         // A binary the driver rejects fails to link without raising an error
+         glProgramBinary ( programObject, header.binaryFormat, binary, header.length );
+         glGetProgramiv ( programObject, GL_LINK_STATUS, &linked );
+
+         if ( !linked )
+         {
+            glDeleteProgram ( programObject );
+            programObject = 0;
+         }
+      }
+   }
+
+   free ( binary );
+   fclose ( fp );
+
+   return programObject;
+}
+
+///
+// StoreCachedProgram()
+//
+//    Write the binary of a freshly linked program to the cache.  The file is
+//    written under a temporary name and renamed so that concurrent launches
+//    never see a partial entry.
+//
+static void StoreCachedProgram ( const char *dir, GLuint64 key, GLuint programObject )
+{
+   char path[600];
+   char tmpPath[620];
+   ProgramCacheHeader header;
+   GLint length = 0;
+   GLsizei written = 0;
+   void *binary;
+   FILE *fp;
+
+   glGetProgramiv ( programObject, GL_PROGRAM_BINARY_LENGTH, &length );
+
+   if ( length <= 0 )
+   {
+      return;
+   }
+
+   binary = malloc ( length );
+
+   if ( binary == NULL )
+   {
+      return;
+   }
+
+   memset ( &header, 0, sizeof ( header ) );
+   glGetProgramBinary ( programObject, length, &written, &header.binaryFormat, binary );
+
+   // Nothing is written if the call fails, so written stays 0
+   if ( written > 0 && written <= length )
+   {
+      header.magic = PROGRAM_CACHE_MAGIC;
+      header.version = PROGRAM_CACHE_VERSION;
+      header.key = key;
+      header.length = ( GLuint ) written;
+
+      ProgramCachePath ( path, sizeof ( path ), dir, key );
+      snprintf ( tmpPath, sizeof ( tmpPath ), "%s.tmp", path );
+      fp = fopen ( tmpPath, "wb" );
+
+      if ( fp != NULL )
+      {
+         int ok = fwrite ( &header, sizeof ( header ), 1, fp ) == 1 &&
+                  fwrite ( binary, written, 1, fp ) == 1;
+
+         ok = ( fclose ( fp ) == 0 ) && ok;
+
+#ifdef _WIN32
+         remove ( path );
+#endif
+
+         if ( !ok || rename ( tmpPath, path ) != 0 )
+         {
+            remove ( tmpPath );
+         }
+      }
+   }
+
+   free ( binary );
+}
+
+///
+// ProgramCacheLookup()
+//
+//    Return the cache directory and key for a program, or NULL when caching
+//    is disabled or the driver cannot hand out program binaries
+//
+static const char *ProgramCacheLookup ( const char *vertShaderSrc, const char *fragShaderSrc,
+                                        GLsizei varyingCount, const char *const *varyings, GLenum bufferMode,
+                                        GLuint64 *cacheKey )
+{
+   const char *cacheDir = GetProgramCacheDir ( );
+   GLint numBinaryFormats = 0;
+
+   if ( cacheDir == NULL )
+   {
+      return NULL;
+   }
+
+   glGetIntegerv ( GL_NUM_PROGRAM_BINARY_FORMATS, &numBinaryFormats );
+
+   if ( numBinaryFormats <= 0 )
+   {
+      return NULL;
+   }
+
+   *cacheKey = ProgramCacheKey ( vertShaderSrc, fragShaderSrc, varyingCount, varyings, bufferMode );
+   return cacheDir;
+}
+
+///
+// CopyString()
+//
+static char *CopyString ( const char *str )
+{
+   size_t length = strlen ( str ) + 1;
+   char *copy = malloc ( length );
+
+   if ( copy != NULL )
+   {
+      memcpy ( copy, str, length );
+   }
+
+   return copy;
+}
+
+///
+// AsyncWorkerMain()
+//
+//    Worker thread: make the shared context current, then compile and link
+//    queued programs.  glFinish() makes the finished program visible to the
+//    application's context before the job is marked done.
+//
+static void AsyncWorkerMain ( void *arg )
+{
+   AsyncWorker *worker = ( AsyncWorker * ) arg;
+   int ok = GL_TRUE;
+
+#ifndef __APPLE__
+   ok = eglMakeCurrent ( worker->display, worker->surface, worker->surface, worker->context );
+#endif
 
+   esMutexLock ( &worker->mutex );
+   worker->state = ok ? 1 : -1;
+   esCondBroadcast ( &worker->cond );
+   esMutexUnlock ( &worker->mutex );
+
+   if ( !ok )
+   {
+      return;
+   }
+
+   for ( ;; )
+   {
+      ESProgramAsync *job;
+      GLuint programObject;
+
+      esMutexLock ( &worker->mutex );
+
+      while ( worker->head == NULL )
+      {
+         esCondWait ( &worker->cond, &worker->mutex );
+      }
+
+      job = worker->head;
+      worker->head = job->next;
+
+      if ( worker->head == NULL )
+      {
+         worker->tail = NULL;
+      }
+
+      esMutexUnlock ( &worker->mutex );
+
+      programObject = esLoadProgram ( job->vertShaderSrc, job->fragShaderSrc );
+      glFinish ( );
+
+      esMutexLock ( &worker->mutex );
+      job->programObject = programObject;
+      job->done = 1;
+      esCondBroadcast ( &worker->cond );
+      esMutexUnlock ( &worker->mutex );
+   }
+}
+
+///
+// StartAsyncWorker()
+//
+//    Create a context sharing objects with the application's context and a
+//    thread to compile on it.  The worker lives for the rest of the process.
+//
+static GLboolean StartAsyncWorker ( ESContext *esContext )
+{
+#ifdef __APPLE__
+   return GL_FALSE;
+#else
+   AsyncWorker *worker = &s_asyncWorker;
+   EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+   EGLint configId = 0;
+   EGLint numConfigs = 0;
+   EGLConfig config;
+   const char *extensions;
+
+   if ( esContext == NULL || esContext->eglContext == EGL_NO_CONTEXT )
+   {
+      return GL_FALSE;
+   }
+
+   memset ( worker, 0, sizeof ( AsyncWorker ) );
+   worker->display = esContext->eglDisplay;
+
+   // Use the same config as the application's context
+   eglQueryContext ( worker->display, esContext->eglContext, EGL_CONFIG_ID, &configId );
+
+   {
+      EGLint configAttribs[] = { EGL_CONFIG_ID, configId, EGL_NONE };
+
+      if ( !eglChooseConfig ( worker->display, configAttribs, &config, 1, &numConfigs ) || numConfigs < 1 )
+      {
+         return GL_FALSE;
+      }
+   }
+
+   worker->context = eglCreateContext ( worker->display, config, esContext->eglContext, contextAttribs );
+
+   if ( worker->context == EGL_NO_CONTEXT )
+   {
+      return GL_FALSE;
+   }
+
+   // The worker never draws, so it does not need a surface if the driver allows that
+   extensions = eglQueryString ( worker->display, EGL_EXTENSIONS );
+   worker->surface = EGL_NO_SURFACE;
+
+   if ( extensions == NULL || strstr ( extensions, "EGL_KHR_surfaceless_context" ) == NULL )
+   {
+      EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+
+      worker->surface = eglCreatePbufferSurface ( worker->display, config, pbufferAttribs );
+
+      if ( worker->surface == EGL_NO_SURFACE )
+      {
+         eglDestroyContext ( worker->display, worker->context );
+         return GL_FALSE;
+      }
+   }
+
+   esMutexInit ( &worker->mutex );
+   esCondInit ( &worker->cond );
+
+   if ( !esThreadCreate ( &worker->thread, AsyncWorkerMain, worker ) )
+   {
+      worker->state = -1;
+   }
+   else
+   {
+      esMutexLock ( &worker->mutex );
+
+      while ( worker->state == 0 )
+      {
+         esCondWait ( &worker->cond, &worker->mutex );
+      }
+
+      esMutexUnlock ( &worker->mutex );
+   }
+
+   if ( worker->state < 0 )
+   {
+      if ( worker->surface != EGL_NO_SURFACE )
+      {
+         eglDestroySurface ( worker->display, worker->surface );
+      }
+
+      eglDestroyContext ( worker->display, worker->context );
+      return GL_FALSE;
+   }
+
+   return GL_TRUE;
+#endif
+}
+
+///
+// GetAsyncMode()
+//
+//    Pick the async strategy the first time it is needed
+//
+static AsyncMode GetAsyncMode ( ESContext *esContext )
+{
+   if ( s_asyncMode == ASYNC_MODE_UNKNOWN )
+   {
+      const char *extensions = ( const char * ) glGetString ( GL_EXTENSIONS );
+
+      s_asyncMode = ASYNC_MODE_DEFERRED;
+
+#ifndef __APPLE__
+      if ( extensions != NULL && strstr ( extensions, "GL_KHR_parallel_shader_compile" ) )
+      {
+         ESMAXSHADERCOMPILERTHREADSKHRPROC maxShaderCompilerThreads =
+            ( ESMAXSHADERCOMPILERTHREADSKHRPROC ) eglGetProcAddress ( "glMaxShaderCompilerThreadsKHR" );
+
+         if ( maxShaderCompilerThreads != NULL )
+         {
+            // Let the driver use as many threads as it likes
+            maxShaderCompilerThreads ( 0xFFFFFFFF );
+         }
+
+         s_asyncMode = ASYNC_MODE_PARALLEL;
+      }
+      else if ( StartAsyncWorker ( esContext ) )
+      {
+         s_asyncMode = ASYNC_MODE_WORKER;
+      }
+#endif
+   }
+
+   return s_asyncMode;
+}
+
+///
+// FinishAsyncProgram()
+//
+//    Check the results of a program compiled on the calling thread, release
+//    the shaders and store the binary in the program cache
+//
+static GLuint FinishAsyncProgram ( ESProgramAsync *handle )
+{
+   GLuint programObject = handle->programObject;
+   GLint vertexCompiled = CheckShaderCompiled ( handle->vertexShader );
+   GLint fragmentCompiled = CheckShaderCompiled ( handle->fragmentShader );
+
+   if ( !vertexCompiled || !fragmentCompiled || !CheckProgramLinked ( programObject ) )
+   {
+      glDeleteProgram ( programObject );
+      programObject = 0;
+   }
+   else if ( handle->cacheDir != NULL )
+   {
+      StoreCachedProgram ( handle->cacheDir, handle->cacheKey, programObject );
+   }
+
+   glDeleteShader ( handle->vertexShader );
+   glDeleteShader ( handle->fragmentShader );
+
+   return programObject;
+}
 
 //////////////////////////////////////////////////////////////////
 //
@@ -81,24 +747,10 @@ GLuint ESUTIL_API esLoadShader ( GLenum type, const char *shaderSrc )
    glCompileShader ( shader );
 
    // Check the compile status
-   glGetShaderiv ( shader, GL_COMPILE_STATUS, &compiled );
+   compiled = CheckShaderCompiled ( shader );
 
    if ( !compiled )
    {
-      GLint infoLen = 0;
-
-      glGetShaderiv ( shader, GL_INFO_LOG_LENGTH, &infoLen );
-
-      if ( infoLen > 1 )
-      {
-         char *infoLog = malloc ( sizeof ( char ) * infoLen );
-
-         glGetShaderInfoLog ( shader, infoLen, NULL, infoLog );
-         esLogMessage ( "Error compiling shader:\n%s\n", infoLog );
-
-         free ( infoLog );
-      }
-
       glDeleteShader ( shader );
       return 0;
    }
@@ -117,11 +769,36 @@ GLuint ESUTIL_API esLoadShader ( GLenum type, const char *shaderSrc )
 /// \return A new program object linked with the vertex/fragment shader pair, 0 on failure
 //
 GLuint ESUTIL_API esLoadProgram ( const char *vertShaderSrc, const char *fragShaderSrc )
+{
+   return esLoadProgramFeedback ( vertShaderSrc, fragShaderSrc, 0, NULL, GL_INTERLEAVED_ATTRIBS );
+}
+
+//
+///
+/// \brief Load a vertex and fragment shader, set the transform feedback varyings, create a
+///        program object and link it.  When a program cache directory is configured the
+///        linked binary is reused across launches.  Errors output to log.
+//
+GLuint ESUTIL_API esLoadProgramFeedback ( const char *vertShaderSrc, const char *fragShaderSrc,
+                                          GLsizei varyingCount, const char *const *varyings, GLenum bufferMode )
 {
    GLuint vertexShader;
    GLuint fragmentShader;
    GLuint programObject;
    GLint linked;
+   GLuint64 cacheKey = 0;
+   const char *cacheDir = ProgramCacheLookup ( vertShaderSrc, fragShaderSrc, varyingCount, varyings,
+                                               bufferMode, &cacheKey );
+
+   if ( cacheDir != NULL )
+   {
+      programObject = LoadCachedProgram ( cacheDir, cacheKey );
+
+      if ( programObject != 0 )
+      {
+         return programObject;
+      }
+   }
 
    // Load the vertex/fragment shaders
    vertexShader = esLoadShader ( GL_VERTEX_SHADER, vertShaderSrc );
@@ -144,41 +821,231 @@ GLuint ESUTIL_API esLoadProgram ( const char *vertShaderSrc, const char *fragSha
 
    if ( programObject == 0 )
    {
+      glDeleteShader ( vertexShader );
+      glDeleteShader ( fragmentShader );
       return 0;
    }
 
    glAttachShader ( programObject, vertexShader );
    glAttachShader ( programObject, fragmentShader );
 
+   // Transform feedback varyings must be set before linking
+   if ( varyingCount > 0 )
+   {
+      glTransformFeedbackVaryings ( programObject, varyingCount, varyings, bufferMode );
+   }
+
+   if ( cacheDir != NULL )
+   {
+      glProgramParameteri ( programObject, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+   }
+
    // Link the program
    glLinkProgram ( programObject );
 
    // Check the link status
-   glGetProgramiv ( programObject, GL_LINK_STATUS, &linked );
+   linked = CheckProgramLinked ( programObject );
 
    if ( !linked )
    {
-      GLint infoLen = 0;
+      glDeleteProgram ( programObject );
+      return 0;
+   }
 
-      glGetProgramiv ( programObject, GL_INFO_LOG_LENGTH, &infoLen );
+   // Free up no longer needed shader resources
+   glDeleteShader ( vertexShader );
+   glDeleteShader ( fragmentShader );
 
-      if ( infoLen > 1 )
+   if ( cacheDir != NULL )
+   {
+      StoreCachedProgram ( cacheDir, cacheKey, programObject );
+   }
+
+   return programObject;
+}
+
+//
+///
+/// \brief Set the directory used to cache linked program binaries
+//
+void ESUTIL_API esSetProgramCacheDir ( const char *path )
+{
+   s_programCacheDirSet = 1;
+   s_programCacheDir[0] = '\0';
+
+   if ( path != NULL )
+   {
+      strncpy ( s_programCacheDir, path, sizeof ( s_programCacheDir ) - 1 );
+      s_programCacheDir[sizeof ( s_programCacheDir ) - 1] = '\0';
+   }
+}
+
+//
+///
+/// \brief Start building a program without waiting for the compiler
+//
+ESProgramAsync *ESUTIL_API esLoadProgramAsync ( ESContext *esContext, const char *vertShaderSrc, const char *fragShaderSrc )
+{
+   ESProgramAsync *handle = calloc ( 1, sizeof ( ESProgramAsync ) );
+
+   if ( handle == NULL )
+   {
+      return NULL;
+   }
+
+   handle->mode = GetAsyncMode ( esContext );
+
+   if ( handle->mode == ASYNC_MODE_WORKER )
+   {
+      AsyncWorker *worker = &s_asyncWorker;
+
+      handle->vertShaderSrc = CopyString ( vertShaderSrc );
+      handle->fragShaderSrc = CopyString ( fragShaderSrc );
+
+      if ( handle->vertShaderSrc == NULL || handle->fragShaderSrc == NULL )
       {
-         char *infoLog = malloc ( sizeof ( char ) * infoLen );
+         free ( handle->vertShaderSrc );
+         free ( handle->fragShaderSrc );
+         free ( handle );
+         return NULL;
+      }
 
-         glGetProgramInfoLog ( programObject, infoLen, NULL, infoLog );
-         esLogMessage ( "Error linking program:\n%s\n", infoLog );
+      esMutexLock ( &worker->mutex );
 
-         free ( infoLog );
+      if ( worker->tail != NULL )
+      {
+         worker->tail->next = handle;
+      }
+      else
+      {
+         worker->head = handle;
       }
 
-      glDeleteProgram ( programObject );
-      return 0;
+      worker->tail = handle;
+      esCondBroadcast ( &worker->cond );
+      esMutexUnlock ( &worker->mutex );
+
+      return handle;
    }
 
-   // Free up no longer needed shader resources
-   glDeleteShader ( vertexShader );
-   glDeleteShader ( fragmentShader );
+   handle->cacheDir = ProgramCacheLookup ( vertShaderSrc, fragShaderSrc, 0, NULL, GL_INTERLEAVED_ATTRIBS,
+                                           &handle->cacheKey );
 
-   return programObject;
-}
\ No newline at end of file
+   if ( handle->cacheDir != NULL )
+   {
+      handle->programObject = LoadCachedProgram ( handle->cacheDir, handle->cacheKey );
+
+      if ( handle->programObject != 0 )
+      {
+         // Nothing left to compile
+         handle->done = 1;
+         return handle;
+      }
+   }
+
+   // Issue both compiles and the link back to back; nothing below waits on the compiler
+   handle->vertexShader = glCreateShader ( GL_VERTEX_SHADER );
+   handle->fragmentShader = glCreateShader ( GL_FRAGMENT_SHADER );
+   handle->programObject = glCreateProgram ( );
+
+   glShaderSource ( handle->vertexShader, 1, &vertShaderSrc, NULL );
+   glShaderSource ( handle->fragmentShader, 1, &fragShaderSrc, NULL );
+   glCompileShader ( handle->vertexShader );
+   glCompileShader ( handle->fragmentShader );
+
+   glAttachShader ( handle->programObject, handle->vertexShader );
+   glAttachShader ( handle->programObject, handle->fragmentShader );
+
+   if ( handle->cacheDir != NULL )
+   {
+      glProgramParameteri ( handle->programObject, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE );
+   }
+
+   glLinkProgram ( handle->programObject );
+
+   return handle;
+}
+
+//
+///
+/// \brief Check whether a program started with esLoadProgramAsync is ready
+//
+GLboolean ESUTIL_API esPollProgram ( ESProgramAsync *handle, GLuint *program )
+{
+   if ( handle == NULL )
+   {
+      *program = 0;
+      return GL_TRUE;
+   }
+
+   if ( handle->mode == ASYNC_MODE_WORKER )
+   {
+      int done;
+
+      esMutexLock ( &s_asyncWorker.mutex );
+      done = handle->done;
+      esMutexUnlock ( &s_asyncWorker.mutex );
+
+      if ( !done )
+      {
+         return GL_FALSE;
+      }
+
+      *program = handle->programObject;
+      free ( handle->vertShaderSrc );
+      free ( handle->fragShaderSrc );
+   }
+   else if ( handle->done )
+   {
+      // Restored from the program cache
+      *program = handle->programObject;
+   }
+   else
+   {
+      if ( handle->mode == ASYNC_MODE_PARALLEL )
+      {
+         GLint complete = GL_FALSE;
+
+         glGetProgramiv ( handle->programObject, GL_COMPLETION_STATUS_KHR, &complete );
+
+         if ( !complete )
+         {
+            return GL_FALSE;
+         }
+      }
+
+      *program = FinishAsyncProgram ( handle );
+   }
+
+   free ( handle );
+   return GL_TRUE;
+}
+
+//
+///
+/// \brief Block until a program started with esLoadProgramAsync is ready
+//
+GLuint ESUTIL_API esWaitProgram ( ESProgramAsync *handle )
+{
+   GLuint program = 0;
+
+   if ( handle != NULL && handle->mode == ASYNC_MODE_WORKER )
+   {
+      esMutexLock ( &s_asyncWorker.mutex );
+
+      while ( !handle->done )
+      {
+         esCondWait ( &s_asyncWorker.cond, &s_asyncWorker.mutex );
+      }
+
+      esMutexUnlock ( &s_asyncWorker.mutex );
+   }
+   else if ( handle != NULL && handle->mode == ASYNC_MODE_PARALLEL && !handle->done )
+   {
+      // Querying the link status blocks until the driver is done
+      handle->mode = ASYNC_MODE_DEFERRED;
+   }
+
+   esPollProgram ( handle, &program );
+   return program;
+}
@@ -38,6 +38,8 @@
 //  Includes
 //
 #include "esUtil.h"
+#include "esArena.h"
+#include "esHalf.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -53,7 +55,107 @@
 //
 //
 
+///
+// Clamp()
+//
+static GLfloat Clamp ( GLfloat value, GLfloat min, GLfloat max )
+{
+   return value < min ? min : ( value > max ? max : value );
+}
+
+///
+// PackSnorm10()
+//
+//    Signed normalized 10-bit field of a GL_INT_2_10_10_10_REV value
+//
+static GLuint PackSnorm10 ( GLfloat value )
+{
+   return ( GLuint ) ( ( GLint ) floorf ( Clamp ( value, -1.0f, 1.0f ) * 511.0f + 0.5f ) ) & 0x3FF;
+}
+
+///
+// AttribSize()
+//
+//    Bytes taken by an attribute of count components stored as type,
+//    padded to 4 bytes.  Sets up attrib, 0 if the type is GL_NONE.
+//
+static GLsizei AttribSize ( ESVertexAttrib *attrib, GLenum type, GLint count, GLsizei offset )
+{
+   GLsizei size;
+
+   attrib->size = count;
+   attrib->type = type;
+   attrib->normalized = GL_FALSE;
+   attrib->offset = offset;
+
+   switch ( type )
+   {
+      case GL_FLOAT:
+         size = count * sizeof ( GLfloat );
+         break;
+
+      case GL_HALF_FLOAT:
+         size = count * sizeof ( GLushort );
+         break;
+
+      case GL_UNSIGNED_SHORT:
+         attrib->normalized = GL_TRUE;
+         size = count * sizeof ( GLushort );
+         break;
+
+      case GL_INT_2_10_10_10_REV:
+         attrib->normalized = GL_TRUE;
+         attrib->size = 4;
+         size = sizeof ( GLuint );
+         break;
+
+      default:
+         attrib->size = 0;
+         attrib->type = GL_NONE;
+         return 0;
+   }
+
+   return ( size + 3 ) & ~3;
+}
+
+///
+// PackAttrib()
+//
+//    Encode count floats of one vertex into the attribute's format
+//
+static void PackAttrib ( const ESVertexAttrib *attrib, GLubyte *vertex, const GLfloat *values, GLint count )
+{
+   void *dst = vertex + attrib->offset;
+   GLint i;
+
+   switch ( attrib->type )
+   {
+      case GL_FLOAT:
+         memcpy ( dst, values, sizeof ( GLfloat ) * count );
+         break;
+
+      case GL_HALF_FLOAT:
+         for ( i = 0; i < count; i++ )
+         {
+            ( ( GLushort * ) dst ) [i] = esFloatToHalf ( values[i] );
+         }
+
+         break;
+
+      case GL_UNSIGNED_SHORT:
+         for ( i = 0; i < count; i++ )
+         {
+            ( ( GLushort * ) dst ) [i] = ( GLushort ) floorf ( Clamp ( values[i], 0.0f, 1.0f ) * 65535.0f + 0.5f );
+         }
 
+         break;
+
+      case GL_INT_2_10_10_10_REV:
+         * ( GLuint * ) dst = PackSnorm10 ( values[0] ) | ( PackSnorm10 ( values[1] ) << 10 ) |
+                              ( PackSnorm10 ( values[2] ) << 20 );
+         break;
+   }
+}
 
 //////////////////////////////////////////////////////////////////
 //
@@ -64,6 +166,7 @@
 //
 /// \brief Generates geometry for a sphere.  Allocates memory for the vertex data and stores
 ///        the results in the arrays.  Generate index list for a TRIANGLE_STRIP
+/// \param arena Arena to allocate the arrays from, or NULL to malloc them
 /// \param numSlices The number of slices in the sphere
 /// \param vertices If not NULL, will contain array of float3 positions
 /// \param normals If not NULL, will contain array of float3 normals
@@ -72,8 +175,8 @@
 /// \return The number of indices required for rendering the buffers (the number of indices stored in the indices array
 ///         if it is not NULL ) as a GL_TRIANGLE_STRIP
 //
-int ESUTIL_API esGenSphere ( int numSlices, float radius, GLfloat **vertices, GLfloat **normals,
-                             GLfloat **texCoords, GLuint **indices )
+int ESUTIL_API esGenSphereArena ( ESArena *arena, int numSlices, float radius, GLfloat **vertices,
+                                  GLfloat **normals, GLfloat **texCoords, GLuint **indices )
 {
    int i;
    int j;
@@ -85,22 +188,22 @@ int ESUTIL_API esGenSphere ( int numSlices, float radius, GLfloat **vertices, GL
    // Allocate memory for buffers
    if ( vertices != NULL )
    {
-      *vertices = malloc ( sizeof ( GLfloat ) * 3 * numVertices );
+      *vertices = esArenaMalloc ( arena, sizeof ( GLfloat ) * 3 * numVertices );
    }
 
    if ( normals != NULL )
    {
-      *normals = malloc ( sizeof ( GLfloat ) * 3 * numVertices );
+      *normals = esArenaMalloc ( arena, sizeof ( GLfloat ) * 3 * numVertices );
    }
 
    if ( texCoords != NULL )
    {
-      *texCoords = malloc ( sizeof ( GLfloat ) * 2 * numVertices );
+      *texCoords = esArenaMalloc ( arena, sizeof ( GLfloat ) * 2 * numVertices );
    }
 
    if ( indices != NULL )
    {
-      *indices = malloc ( sizeof ( GLuint ) * numIndices );
+      *indices = esArenaMalloc ( arena, sizeof ( GLuint ) * numIndices );
    }
 
    for ( i = 0; i < numParallels + 1; i++ )
@@ -129,7 +232,8 @@ int ESUTIL_API esGenSphere ( int numSlices, float radius, GLfloat **vertices, GL
          {
             int texIndex = ( i * ( numSlices + 1 ) + j ) * 2;
             ( *texCoords ) [texIndex + 0] = ( float ) j / ( float ) numSlices;
-            ( *texCoords ) [texIndex + 1] = ( 1.0f - ( float ) i ) / ( float ) ( numParallels - 1 );
+            // V runs from 1 at the top to 0 at the bottom
+            ( *texCoords ) [texIndex + 1] = 1.0f - ( float ) i / ( float ) numParallels;
          }
       }
    }
@@ -160,6 +264,7 @@ int ESUTIL_API esGenSphere ( int numSlices, float radius, GLfloat **vertices, GL
 //
 /// \brief Generates geometry for a cube.  Allocates memory for the vertex data and stores
 ///        the results in the arrays.  Generate index list for a TRIANGLES
+/// \param arena Arena to allocate the arrays from, or NULL to malloc them
 /// \param scale The size of the cube, use 1.0 for a unit cube.
 /// \param vertices If not NULL, will contain array of float3 positions
 /// \param normals If not NULL, will contain array of float3 normals
@@ -168,8 +273,8 @@ int ESUTIL_API esGenSphere ( int numSlices, float radius, GLfloat **vertices, GL
 /// \return The number of indices required for rendering the buffers (the number of indices stored in the indices array
 ///         if it is not NULL ) as a GL_TRIANGLE_STRIP
 //
-int ESUTIL_API esGenCube ( float scale, GLfloat **vertices, GLfloat **normals,
-                           GLfloat **texCoords, GLuint **indices )
+int ESUTIL_API esGenCubeArena ( ESArena *arena, float scale, GLfloat **vertices, GLfloat **normals,
+                                GLfloat **texCoords, GLuint **indices )
 {
    int i;
    int numVertices = 24;
@@ -262,7 +367,7 @@ int ESUTIL_API esGenCube ( float scale, GLfloat **vertices, GLfloat **normals,
    // Allocate memory for buffers
    if ( vertices != NULL )
    {
-      *vertices = malloc ( sizeof ( GLfloat ) * 3 * numVertices );
+      *vertices = esArenaMalloc ( arena, sizeof ( GLfloat ) * 3 * numVertices );
       memcpy ( *vertices, cubeVerts, sizeof ( cubeVerts ) );
 
       for ( i = 0; i < numVertices * 3; i++ )
@@ -273,13 +378,13 @@ int ESUTIL_API esGenCube ( float scale, GLfloat **vertices, GLfloat **normals,
 
    if ( normals != NULL )
    {
-      *normals = malloc ( sizeof ( GLfloat ) * 3 * numVertices );
+      *normals = esArenaMalloc ( arena, sizeof ( GLfloat ) * 3 * numVertices );
       memcpy ( *normals, cubeNormals, sizeof ( cubeNormals ) );
    }
 
    if ( texCoords != NULL )
    {
-      *texCoords = malloc ( sizeof ( GLfloat ) * 2 * numVertices );
+      *texCoords = esArenaMalloc ( arena, sizeof ( GLfloat ) * 2 * numVertices );
       memcpy ( *texCoords, cubeTex, sizeof ( cubeTex ) ) ;
    }
 
@@ -303,7 +408,7 @@ int ESUTIL_API esGenCube ( float scale, GLfloat **vertices, GLfloat **normals,
          20, 22, 21
       };
 
-      *indices = malloc ( sizeof ( GLuint ) * numIndices );
+      *indices = esArenaMalloc ( arena, sizeof ( GLuint ) * numIndices );
       memcpy ( *indices, cubeIndices, sizeof ( cubeIndices ) );
    }
 
@@ -313,13 +418,14 @@ int ESUTIL_API esGenCube ( float scale, GLfloat **vertices, GLfloat **normals,
 //
 /// \brief Generates a square grid consisting of triangles.  Allocates memory for the vertex data and stores
 ///        the results in the arrays.  Generate index list as TRIANGLES.
+/// \param arena Arena to allocate the arrays from, or NULL to malloc them
 /// \param size create a grid of size by size (number of triangles = (size-1)*(size-1)*2)
 /// \param vertices If not NULL, will contain array of float3 positions
 /// \param indices If not NULL, will contain the array of indices for the triangle strip
 /// \return The number of indices required for rendering the buffers (the number of indices stored in the indices array
 ///         if it is not NULL ) as a GL_TRIANGLES
 //
-int ESUTIL_API esGenSquareGrid ( int size, GLfloat **vertices, GLuint **indices )
+int ESUTIL_API esGenSquareGridArena ( ESArena *arena, int size, GLfloat **vertices, GLuint **indices )
 {
    int i, j;
    int numIndices = ( size - 1 ) * ( size - 1 ) * 2 * 3;
@@ -329,7 +435,7 @@ int ESUTIL_API esGenSquareGrid ( int size, GLfloat **vertices, GLuint **indices
    {
       int numVertices = size * size;
       float stepSize = ( float ) size - 1;
-      *vertices = malloc ( sizeof ( GLfloat ) * 3 * numVertices );
+      *vertices = esArenaMalloc ( arena, sizeof ( GLfloat ) * 3 * numVertices );
 
       for ( i = 0; i < size; ++i ) // row
       {
@@ -345,7 +451,7 @@ int ESUTIL_API esGenSquareGrid ( int size, GLfloat **vertices, GLuint **indices
    // Generate the indices
    if ( indices != NULL )
    {
-      *indices = malloc ( sizeof ( GLuint ) * numIndices );
+      *indices = esArenaMalloc ( arena, sizeof ( GLuint ) * numIndices );
 
       for ( i = 0; i < size - 1; ++i )
       {
@@ -365,3 +471,188 @@ int ESUTIL_API esGenSquareGrid ( int size, GLfloat **vertices, GLuint **indices
 
    return numIndices;
 }
+
+//
+/// \brief esGenSphereArena with the arrays allocated by malloc
+//
+int ESUTIL_API esGenSphere ( int numSlices, float radius, GLfloat **vertices, GLfloat **normals,
+                             GLfloat **texCoords, GLuint **indices )
+{
+   return esGenSphereArena ( NULL, numSlices, radius, vertices, normals, texCoords, indices );
+}
+
+//
+/// \brief esGenCubeArena with the arrays allocated by malloc
+//
+int ESUTIL_API esGenCube ( float scale, GLfloat **vertices, GLfloat **normals,
+                           GLfloat **texCoords, GLuint **indices )
+{
+   return esGenCubeArena ( NULL, scale, vertices, normals, texCoords, indices );
+}
+
+//
+/// \brief esGenSquareGridArena with the arrays allocated by malloc
+//
+int ESUTIL_API esGenSquareGrid ( int size, GLfloat **vertices, GLuint **indices )
+{
+   return esGenSquareGridArena ( NULL, size, vertices, indices );
+}
+
+//
+/// \brief Pack separate float arrays into one interleaved vertex buffer in the given format
+//
+GLboolean ESUTIL_API esMeshPack ( const ESVertexFormat *format, const GLfloat *positions, const GLfloat *normals,
+                                  const GLfloat *texCoords, int numVertices, const GLuint *indices, int numIndices,
+                                  ESMesh *mesh )
+{
+   GLsizei verticesSize;
+   GLubyte *memory;
+   int i;
+
+   memset ( mesh, 0, sizeof ( ESMesh ) );
+
+   if ( positions == NULL || numVertices <= 0 )
+   {
+      return GL_FALSE;
+   }
+
+   // Position, normal and texture coordinates, each 4 byte aligned
+   mesh->stride = AttribSize ( &mesh->position, format->positionType, 3, 0 );
+
+   if ( mesh->stride == 0 )
+   {
+      return GL_FALSE;
+   }
+
+   mesh->stride += AttribSize ( &mesh->normal, normals != NULL ? format->normalType : GL_NONE, 3, mesh->stride );
+   mesh->stride += AttribSize ( &mesh->texCoord, texCoords != NULL ? format->texCoordType : GL_NONE, 2, mesh->stride );
+
+   // Normalized shorts can only hold texture coordinates within [0, 1]
+   if ( mesh->texCoord.type == GL_UNSIGNED_SHORT )
+   {
+      for ( i = 0; i < numVertices * 2; i++ )
+      {
+         if ( !( texCoords[i] >= 0.0f && texCoords[i] <= 1.0f ) )
+         {
+            return GL_FALSE;
+         }
+      }
+   }
+
+   // 16-bit indices whenever they can address every vertex
+   mesh->indexType = numVertices <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+   mesh->indexSize = mesh->indexType == GL_UNSIGNED_SHORT ? sizeof ( GLushort ) : sizeof ( GLuint );
+
+   // Vertices and indices share one allocation
+   verticesSize = mesh->stride * numVertices;
+   memory = ( GLubyte * ) malloc ( verticesSize + mesh->indexSize * numIndices );
+
+   if ( memory == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   mesh->vertices = memory;
+   mesh->numVertices = numVertices;
+   mesh->indices = memory + verticesSize;
+   mesh->numIndices = numIndices;
+
+   for ( i = 0; i < numVertices; i++ )
+   {
+      GLubyte *vertex = memory + mesh->stride * i;
+
+      // Zero the padding
+      memset ( vertex, 0, mesh->stride );
+
+      PackAttrib ( &mesh->position, vertex, &positions[i * 3], 3 );
+
+      if ( mesh->normal.size != 0 )
+      {
+         PackAttrib ( &mesh->normal, vertex, &normals[i * 3], 3 );
+      }
+
+      if ( mesh->texCoord.size != 0 )
+      {
+         PackAttrib ( &mesh->texCoord, vertex, &texCoords[i * 2], 2 );
+      }
+   }
+
+   if ( mesh->indexType == GL_UNSIGNED_SHORT )
+   {
+      for ( i = 0; i < numIndices; i++ )
+      {
+         ( ( GLushort * ) mesh->indices ) [i] = ( GLushort ) indices[i];
+      }
+   }
+   else
+   {
+      memcpy ( mesh->indices, indices, sizeof ( GLuint ) * numIndices );
+   }
+
+   return GL_TRUE;
+}
+
+//
+/// \brief Free the buffers of a mesh from esMeshPack or the esGen*Mesh functions
+//
+void ESUTIL_API esMeshFree ( ESMesh *mesh )
+{
+   free ( mesh->vertices );
+   memset ( mesh, 0, sizeof ( ESMesh ) );
+}
+
+//
+/// \brief esGenSphere into an interleaved mesh
+//
+GLboolean ESUTIL_API esGenSphereMesh ( int numSlices, float radius, const ESVertexFormat *format, ESMesh *mesh )
+{
+   GLfloat *positions, *normals, *texCoords;
+   GLuint *indices;
+   int numIndices = esGenSphere ( numSlices, radius, &positions, &normals, &texCoords, &indices );
+   int numParallels = numSlices / 2;
+   int numVertices = ( numParallels + 1 ) * ( numSlices + 1 );
+   GLboolean result;
+
+   result = esMeshPack ( format, positions, normals, texCoords, numVertices, indices, numIndices, mesh );
+
+   free ( positions );
+   free ( normals );
+   free ( texCoords );
+   free ( indices );
+
+   return result;
+}
+
+//
+/// \brief esGenCube into an interleaved mesh
+//
+GLboolean ESUTIL_API esGenCubeMesh ( float scale, const ESVertexFormat *format, ESMesh *mesh )
+{
+   GLfloat *positions, *normals, *texCoords;
+   GLuint *indices;
+   int numIndices = esGenCube ( scale, &positions, &normals, &texCoords, &indices );
+   GLboolean result = esMeshPack ( format, positions, normals, texCoords, 24, indices, numIndices, mesh );
+
+   free ( positions );
+   free ( normals );
+   free ( texCoords );
+   free ( indices );
+
+   return result;
+}
+
+//
+/// \brief esGenSquareGrid into an interleaved mesh
+//
+GLboolean ESUTIL_API esGenSquareGridMesh ( int size, const ESVertexFormat *format, ESMesh *mesh )
+{
+   GLfloat *positions;
+   GLuint *indices;
+   int numIndices = esGenSquareGrid ( size, &positions, &indices );
+   GLboolean result = esMeshPack ( format, positions, NULL, NULL, size * size, indices, numIndices, mesh );
+
+   free ( positions );
+   free ( indices );
+
+   return result;
+}
@@ -0,0 +1,201 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esSimd.h
+//
+//    Private 4-wide float vector abstraction used by the Common library.
+//    Maps onto SSE on x86, NEON on ARM and plain C everywhere else so
+//    that the math routines only have to be written once.
+//
+#ifndef ESSIMD_H
+#define ESSIMD_H
+
+///
+//  Macros
+//
+#ifdef _MSC_VER
+#define ES_INLINE __inline
+#else
+#define ES_INLINE inline
+#endif
+
+#if defined(__SSE__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 1 )
+#define ES_SIMD_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ES_SIMD_NEON 1
+#else
+#define ES_SIMD_SCALAR 1
+#endif
+
+// AVX is only used where a routine has a dedicated 8-wide path
+#if defined(ES_SIMD_SSE) && defined(__AVX__)
+#define ES_SIMD_AVX 1
+#endif
+
+#if defined(ES_SIMD_AVX)
+#define ES_SIMD_NAME "avx"
+#elif defined(ES_SIMD_SSE)
+#define ES_SIMD_NAME "sse"
+#elif defined(ES_SIMD_NEON)
+#define ES_SIMD_NAME "neon"
+#else
+#define ES_SIMD_NAME "scalar"
+#endif
+
+///
+//  Types
+//
+#if defined(ES_SIMD_SSE)
+
+#include <xmmintrin.h>
+#ifdef ES_SIMD_AVX
+#include <immintrin.h>
+#endif
+
+typedef __m128 esVec4;
+
+#define esVec4Load( p )            _mm_loadu_ps ( p )
+#define esVec4Store( p, v )        _mm_storeu_ps ( p, v )
+#define esVec4Splat( s )           _mm_set1_ps ( s )
+#define esVec4Zero()               _mm_setzero_ps ()
+#define esVec4Add( a, b )          _mm_add_ps ( a, b )
+#define esVec4Sub( a, b )          _mm_sub_ps ( a, b )
+#define esVec4Mul( a, b )          _mm_mul_ps ( a, b )
+#define esVec4Madd( a, b, c )      _mm_add_ps ( _mm_mul_ps ( a, b ), c )
+#define esVec4Min( a, b )          _mm_min_ps ( a, b )
+#define esVec4Max( a, b )          _mm_max_ps ( a, b )
+#define esVec4Lane( v, i )         _mm_shuffle_ps ( v, v, _MM_SHUFFLE ( i, i, i, i ) )
+
+// Bit i of the result is set when lane i of a is less than lane i of b
+#define esVec4LessMask( a, b )     _mm_movemask_ps ( _mm_cmplt_ps ( a, b ) )
+
+#elif defined(ES_SIMD_NEON)
+
+#include <arm_neon.h>
+
+typedef float32x4_t esVec4;
+
+#define esVec4Load( p )            vld1q_f32 ( p )
+#define esVec4Store( p, v )        vst1q_f32 ( p, v )
+#define esVec4Splat( s )           vdupq_n_f32 ( s )
+#define esVec4Zero()               vdupq_n_f32 ( 0.0f )
+#define esVec4Add( a, b )          vaddq_f32 ( a, b )
+#define esVec4Sub( a, b )          vsubq_f32 ( a, b )
+#define esVec4Mul( a, b )          vmulq_f32 ( a, b )
+#define esVec4Madd( a, b, c )      vmlaq_f32 ( c, a, b )
+#define esVec4Min( a, b )          vminq_f32 ( a, b )
+#define esVec4Max( a, b )          vmaxq_f32 ( a, b )
+#define esVec4Lane( v, i )         vdupq_lane_f32 ( ( i ) < 2 ? vget_low_f32 ( v ) : vget_high_f32 ( v ), ( i ) & 1 )
+
+// Bit i of the result is set when lane i of a is less than lane i of b
+static ES_INLINE int esVec4LessMask ( esVec4 a, esVec4 b )
+{
+   static const uint32_t bits[4] = { 1, 2, 4, 8 };
+   uint32x4_t mask = vandq_u32 ( vcltq_f32 ( a, b ), vld1q_u32 ( bits ) );
+   uint32x2_t sum = vadd_u32 ( vget_low_u32 ( mask ), vget_high_u32 ( mask ) );
+
+   return ( int ) vget_lane_u32 ( vpadd_u32 ( sum, sum ), 0 );
+}
+
+#else
+
+typedef struct
+{
+   float v[4];
+} esVec4;
+
+static ES_INLINE esVec4 esVec4Load ( const float *p )
+{
+   esVec4 r;
+   r.v[0] = p[0];
+   r.v[1] = p[1];
+   r.v[2] = p[2];
+   r.v[3] = p[3];
+   return r;
+}
+
+static ES_INLINE void esVec4Store ( float *p, esVec4 a )
+{
+   p[0] = a.v[0];
+   p[1] = a.v[1];
+   p[2] = a.v[2];
+   p[3] = a.v[3];
+}
+
+static ES_INLINE esVec4 esVec4Splat ( float s )
+{
+   esVec4 r;
+   r.v[0] = r.v[1] = r.v[2] = r.v[3] = s;
+   return r;
+}
+
+static ES_INLINE esVec4 esVec4Zero ( void )
+{
+   return esVec4Splat ( 0.0f );
+}
+
+#define ES_VEC4_BINARY_OP( name, expr )                    \
+   static ES_INLINE esVec4 name ( esVec4 a, esVec4 b )     \
+   {                                                       \
+      esVec4 r;                                            \
+      int i;                                               \
+      for ( i = 0; i < 4; i++ )                            \
+      {                                                    \
+         r.v[i] = ( expr );                                \
+      }                                                    \
+      return r;                                            \
+   }
+
+ES_VEC4_BINARY_OP ( esVec4Add, a.v[i] + b.v[i] )
+ES_VEC4_BINARY_OP ( esVec4Sub, a.v[i] - b.v[i] )
+ES_VEC4_BINARY_OP ( esVec4Mul, a.v[i] * b.v[i] )
+ES_VEC4_BINARY_OP ( esVec4Min, a.v[i] < b.v[i] ? a.v[i] : b.v[i] )
+ES_VEC4_BINARY_OP ( esVec4Max, a.v[i] > b.v[i] ? a.v[i] : b.v[i] )
+
+static ES_INLINE esVec4 esVec4Madd ( esVec4 a, esVec4 b, esVec4 c )
+{
+   return esVec4Add ( esVec4Mul ( a, b ), c );
+}
+
+static ES_INLINE esVec4 esVec4Lane ( esVec4 a, int i )
+{
+   return esVec4Splat ( a.v[i] );
+}
+
+// Bit i of the result is set when lane i of a is less than lane i of b
+static ES_INLINE int esVec4LessMask ( esVec4 a, esVec4 b )
+{
+   return ( a.v[0] < b.v[0] ) | ( a.v[1] < b.v[1] ) << 1 | ( a.v[2] < b.v[2] ) << 2 | ( a.v[3] < b.v[3] ) << 3;
+}
+
+#endif
+
+#endif // ESSIMD_H
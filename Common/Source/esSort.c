@@ -0,0 +1,371 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esSort.c
+//
+//    Parallel LSD radix sort of 32-bit keys, eight bits per pass.  Every
+//    pass splits the input into one chunk per thread: the chunks count
+//    their digits in parallel, a prefix sum over (digit, chunk) gives each
+//    chunk its own output offsets, and the chunks then scatter in parallel.
+//    Writing in chunk order keeps every pass stable.  Passes where all keys
+//    share the same digit are skipped.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdlib.h>
+#include <string.h>
+
+///
+//  Macros
+//
+#define RADIX_BITS        8
+#define RADIX_SIZE        ( 1 << RADIX_BITS )
+#define RADIX_PASSES      ( 32 / RADIX_BITS )
+
+// Fewest keys worth handing to another thread
+#define RADIX_MIN_CHUNK   16384
+
+///
+//  Types
+//
+typedef struct
+{
+   const GLuint *srcKeys;
+   GLuint       *dstKeys;
+
+   // Payload moved along with the keys, NULL for a keys only sort.  When
+   // identity is set the source payload is the key's index.
+   const GLuint *srcValues;
+   GLuint       *dstValues;
+   GLboolean     identity;
+
+   int           count;
+   int           chunkSize;
+   int           shift;
+
+   // RADIX_SIZE counts per chunk, turned into output offsets before the scatter
+   GLuint       *histograms;
+} RadixPass;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// RadixHistogram()
+//
+//    esParallelFor body: count the digits of chunks [begin, end)
+//
+static void ESCALLBACK RadixHistogram ( void *arg, int begin, int end )
+{
+   RadixPass *pass = ( RadixPass * ) arg;
+   int chunk;
+
+   for ( chunk = begin; chunk < end; chunk++ )
+   {
+      GLuint *histogram = pass->histograms + chunk * RADIX_SIZE;
+      int first = chunk * pass->chunkSize;
+      int last = first + pass->chunkSize < pass->count ? first + pass->chunkSize : pass->count;
+      int i;
+
+      memset ( histogram, 0, RADIX_SIZE * sizeof ( GLuint ) );
+
+      for ( i = first; i < last; i++ )
+      {
+         histogram[( pass->srcKeys[i] >> pass->shift ) & ( RADIX_SIZE - 1 )]++;
+      }
+   }
+}
+
+///
+// RadixScatter()
+//
+//    esParallelFor body: move the keys of chunks [begin, end) to their
+//    places for this digit
+//
+static void ESCALLBACK RadixScatter ( void *arg, int begin, int end )
+{
+   RadixPass *pass = ( RadixPass * ) arg;
+   int chunk;
+
+   for ( chunk = begin; chunk < end; chunk++ )
+   {
+      GLuint *offsets = pass->histograms + chunk * RADIX_SIZE;
+      int first = chunk * pass->chunkSize;
+      int last = first + pass->chunkSize < pass->count ? first + pass->chunkSize : pass->count;
+      int i;
+
+      if ( pass->dstValues == NULL )
+      {
+         for ( i = first; i < last; i++ )
+         {
+            GLuint key = pass->srcKeys[i];
+
+            pass->dstKeys[offsets[( key >> pass->shift ) & ( RADIX_SIZE - 1 )]++] = key;
+         }
+      }
+      else if ( pass->identity )
+      {
+         for ( i = first; i < last; i++ )
+         {
+            GLuint key = pass->srcKeys[i];
+            GLuint out = offsets[( key >> pass->shift ) & ( RADIX_SIZE - 1 )]++;
+
+            pass->dstKeys[out] = key;
+            pass->dstValues[out] = ( GLuint ) i;
+         }
+      }
+      else
+      {
+         for ( i = first; i < last; i++ )
+         {
+            GLuint key = pass->srcKeys[i];
+            GLuint out = offsets[( key >> pass->shift ) & ( RADIX_SIZE - 1 )]++;
+
+            pass->dstKeys[out] = key;
+            pass->dstValues[out] = pass->srcValues[i];
+         }
+      }
+   }
+}
+
+///
+// RadixSort()
+//
+//    Sort keys, and values with them if dstValues is given, ping-ponging
+//    between the two key and value buffers.  Returns the number of passes
+//    that moved data; the result is in the buffers written last.
+//
+static int RadixSort ( ESThreadPool *pool, RadixPass *pass, GLuint *keyBuffers[2], GLuint *valueBuffers[2],
+                       const GLuint *keys, int count )
+{
+   int chunkCount = 1;
+   int moved = 0;
+   int digit;
+   int chunk;
+
+   if ( pool != NULL )
+   {
+      chunkCount = esThreadPoolSize ( pool ) + 1;
+
+      if ( chunkCount > ( count + RADIX_MIN_CHUNK - 1 ) / RADIX_MIN_CHUNK )
+      {
+         chunkCount = ( count + RADIX_MIN_CHUNK - 1 ) / RADIX_MIN_CHUNK;
+      }
+   }
+
+   pass->histograms = ( GLuint * ) malloc ( sizeof ( GLuint ) * RADIX_SIZE * chunkCount );
+
+   if ( pass->histograms == NULL )
+   {
+      return -1;
+   }
+
+   pass->count = count;
+   pass->chunkSize = ( count + chunkCount - 1 ) / chunkCount;
+   pass->srcKeys = keys;
+
+   for ( pass->shift = 0; pass->shift < 32; pass->shift += RADIX_BITS )
+   {
+      GLuint offset = 0;
+
+      esParallelFor ( pool, chunkCount, RadixHistogram, pass );
+
+      // Exclusive prefix sum, digit major so that chunks keep their order
+      for ( digit = 0; digit < RADIX_SIZE; digit++ )
+      {
+         GLuint total = 0;
+
+         for ( chunk = 0; chunk < chunkCount; chunk++ )
+         {
+            GLuint *slot = &pass->histograms[chunk * RADIX_SIZE + digit];
+            GLuint n = *slot;
+
+            *slot = offset + total;
+            total += n;
+         }
+
+         if ( total == ( GLuint ) count )
+         {
+            break;
+         }
+
+         offset += total;
+      }
+
+      if ( digit < RADIX_SIZE )
+      {
+         // Every key has this digit, the pass would not move anything
+         continue;
+      }
+
+      pass->dstKeys = keyBuffers[moved & 1];
+
+      if ( valueBuffers != NULL )
+      {
+         pass->dstValues = valueBuffers[moved & 1];
+      }
+
+      esParallelFor ( pool, chunkCount, RadixScatter, pass );
+
+      pass->srcKeys = pass->dstKeys;
+      pass->srcValues = pass->dstValues;
+      pass->identity = GL_FALSE;
+      moved++;
+   }
+
+   free ( pass->histograms );
+
+   return moved;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esFloatSortKey()
+//
+GLuint ESUTIL_API esFloatSortKey ( GLfloat value )
+{
+   GLuint bits;
+
+   memcpy ( &bits, &value, sizeof ( bits ) );
+
+   // Negative floats sort backwards, so flip all their bits; flip only the
+   // sign bit of positive ones to put them above the negatives
+   return bits ^ ( ( GLuint ) ( -( GLint ) ( bits >> 31 ) ) | 0x80000000u );
+}
+
+///
+// esRadixSort()
+//
+GLboolean ESUTIL_API esRadixSort ( ESThreadPool *pool, GLuint *keys, int count, GLuint *scratch )
+{
+   RadixPass pass;
+   GLuint *keyBuffers[2];
+   GLuint *allocated = NULL;
+   int moved;
+
+   if ( count <= 1 )
+   {
+      return GL_TRUE;
+   }
+
+   if ( scratch == NULL )
+   {
+      scratch = allocated = ( GLuint * ) malloc ( sizeof ( GLuint ) * count );
+
+      if ( scratch == NULL )
+      {
+         return GL_FALSE;
+      }
+   }
+
+   memset ( &pass, 0, sizeof ( pass ) );
+   keyBuffers[0] = scratch;
+   keyBuffers[1] = keys;
+
+   moved = RadixSort ( pool, &pass, keyBuffers, NULL, keys, count );
+
+   if ( moved > 0 && ( moved & 1 ) )
+   {
+      // Odd number of passes, the result is in scratch
+      memcpy ( keys, scratch, sizeof ( GLuint ) * count );
+   }
+
+   free ( allocated );
+
+   return moved >= 0;
+}
+
+///
+// esRadixSortIndices()
+//
+GLboolean ESUTIL_API esRadixSortIndices ( ESThreadPool *pool, const GLuint *keys, GLuint *indices, int count,
+                                          GLuint *scratch )
+{
+   RadixPass pass;
+   GLuint *keyBuffers[2];
+   GLuint *valueBuffers[2];
+   GLuint *allocated = NULL;
+   int moved;
+   int i;
+
+   if ( count <= 0 )
+   {
+      return GL_TRUE;
+   }
+
+   if ( scratch == NULL )
+   {
+      scratch = allocated = ( GLuint * ) malloc ( sizeof ( GLuint ) * 3 * ( size_t ) count );
+
+      if ( scratch == NULL )
+      {
+         return GL_FALSE;
+      }
+   }
+
+   // The keys are only read, so both key buffers come out of scratch
+   memset ( &pass, 0, sizeof ( pass ) );
+   pass.identity = GL_TRUE;
+   keyBuffers[0] = scratch;
+   keyBuffers[1] = scratch + count;
+   valueBuffers[0] = indices;
+   valueBuffers[1] = scratch + 2 * ( size_t ) count;
+
+   moved = RadixSort ( pool, &pass, keyBuffers, valueBuffers, keys, count );
+
+   if ( moved == 0 )
+   {
+      // Already in order as far as the keys can tell
+      for ( i = 0; i < count; i++ )
+      {
+         indices[i] = i;
+      }
+   }
+   else if ( moved > 0 && !( moved & 1 ) )
+   {
+      memcpy ( indices, valueBuffers[1], sizeof ( GLuint ) * count );
+   }
+
+   free ( allocated );
+
+   return moved >= 0;
+}
@@ -0,0 +1,778 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esStateCache.c
+//
+//    Shadow copy of the GL state a renderer changes most often, so that
+//    calls setting a value that is already current never reach the driver.
+//    State starts out unknown, and goes back to unknown on
+//    esStateCacheInvalidate, so the first call after either always goes
+//    through.  Uniform values are cached per program and location.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdlib.h>
+#include <string.h>
+
+///
+//  Macros
+//
+
+// Value of a name or enum not known to the cache
+#define STATE_UNKNOWN            0xFFFFFFFFu
+
+#define STATE_MAX_TEXTURE_UNITS  32
+#define STATE_MAX_ATTRIBS        32
+
+// Largest uniform cached, a mat4
+#define STATE_UNIFORM_WORDS      16
+
+// Buffer binding targets
+enum
+{
+   BUFFER_ARRAY,
+   BUFFER_ELEMENT_ARRAY,
+   BUFFER_PIXEL_PACK,
+   BUFFER_PIXEL_UNPACK,
+   BUFFER_UNIFORM,
+   BUFFER_COPY_READ,
+   BUFFER_COPY_WRITE,
+   BUFFER_TRANSFORM_FEEDBACK,
+   NUM_BUFFER_TARGETS
+};
+
+// Texture binding targets
+enum
+{
+   TEXTURE_2D,
+   TEXTURE_3D,
+   TEXTURE_CUBE_MAP,
+   TEXTURE_2D_ARRAY,
+   NUM_TEXTURE_TARGETS
+};
+
+// Capabilities for glEnable / glDisable
+enum
+{
+   CAP_BLEND,
+   CAP_CULL_FACE,
+   CAP_DEPTH_TEST,
+   CAP_POLYGON_OFFSET_FILL,
+   CAP_RASTERIZER_DISCARD,
+   CAP_SCISSOR_TEST,
+   CAP_STENCIL_TEST,
+   NUM_CAPS
+};
+
+///
+//  Types
+//
+typedef struct
+{
+   // Number of 32-bit words stored, 0 if the value is unknown
+   GLint          words;
+   GLuint         data[STATE_UNIFORM_WORDS];
+} UniformValue;
+
+typedef struct
+{
+   GLuint         program;
+   GLint          count;
+   UniformValue  *values;
+} ProgramUniforms;
+
+struct ESStateCache
+{
+   GLuint            program;
+   GLuint            vertexArray;
+   GLuint            buffers[NUM_BUFFER_TARGETS];
+
+   // Vertex attribute arrays of the bound vertex array object
+   GLuint            attribKnown;
+   GLuint            attribEnabled;
+
+   GLuint            activeTexture;
+   GLuint            textures[STATE_MAX_TEXTURE_UNITS][NUM_TEXTURE_TARGETS];
+
+   GLuint            caps[NUM_CAPS];
+   GLuint            blendSrc;
+   GLuint            blendDst;
+   GLuint            depthFunc;
+   GLuint            depthMask;
+
+   // Uniform values of every program seen, and the bound program's entry
+   ProgramUniforms  *uniforms;
+   int               uniformsCount;
+   ProgramUniforms  *current;
+
+   ESStateCacheStats stats;
+};
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// Filter()
+//
+//    Count a call, returns GL_TRUE if it has to be issued
+//
+static GLboolean Filter ( ESStateCache *cache, GLuint *shadow, GLuint value )
+{
+   if ( *shadow == value )
+   {
+      cache->stats.filtered++;
+      return GL_FALSE;
+   }
+
+   *shadow = value;
+   cache->stats.issued++;
+
+   return GL_TRUE;
+}
+
+///
+// BufferIndex()
+//
+static int BufferIndex ( GLenum target )
+{
+   switch ( target )
+   {
+      case GL_ARRAY_BUFFER:
+         return BUFFER_ARRAY;
+      case GL_ELEMENT_ARRAY_BUFFER:
+         return BUFFER_ELEMENT_ARRAY;
+      case GL_PIXEL_PACK_BUFFER:
+         return BUFFER_PIXEL_PACK;
+      case GL_PIXEL_UNPACK_BUFFER:
+         return BUFFER_PIXEL_UNPACK;
+      case GL_UNIFORM_BUFFER:
+         return BUFFER_UNIFORM;
+      case GL_COPY_READ_BUFFER:
+         return BUFFER_COPY_READ;
+      case GL_COPY_WRITE_BUFFER:
+         return BUFFER_COPY_WRITE;
+      case GL_TRANSFORM_FEEDBACK_BUFFER:
+         return BUFFER_TRANSFORM_FEEDBACK;
+      default:
+         return -1;
+   }
+}
+
+///
+// TextureIndex()
+//
+static int TextureIndex ( GLenum target )
+{
+   switch ( target )
+   {
+      case GL_TEXTURE_2D:
+         return TEXTURE_2D;
+      case GL_TEXTURE_3D:
+         return TEXTURE_3D;
+      case GL_TEXTURE_CUBE_MAP:
+         return TEXTURE_CUBE_MAP;
+      case GL_TEXTURE_2D_ARRAY:
+         return TEXTURE_2D_ARRAY;
+      default:
+         return -1;
+   }
+}
+
+///
+// CapIndex()
+//
+static int CapIndex ( GLenum cap )
+{
+   switch ( cap )
+   {
+      case GL_BLEND:
+         return CAP_BLEND;
+      case GL_CULL_FACE:
+         return CAP_CULL_FACE;
+      case GL_DEPTH_TEST:
+         return CAP_DEPTH_TEST;
+      case GL_POLYGON_OFFSET_FILL:
+         return CAP_POLYGON_OFFSET_FILL;
+      case GL_RASTERIZER_DISCARD:
+         return CAP_RASTERIZER_DISCARD;
+      case GL_SCISSOR_TEST:
+         return CAP_SCISSOR_TEST;
+      case GL_STENCIL_TEST:
+         return CAP_STENCIL_TEST;
+      default:
+         return -1;
+   }
+}
+
+///
+// ForgetUniforms()
+//
+static void ForgetUniforms ( ESStateCache *cache )
+{
+   int i;
+
+   for ( i = 0; i < cache->uniformsCount; i++ )
+   {
+      free ( cache->uniforms[i].values );
+   }
+
+   free ( cache->uniforms );
+   cache->uniforms = NULL;
+   cache->uniformsCount = 0;
+   cache->current = NULL;
+}
+
+///
+// FindUniforms()
+//
+//    Uniform cache of a program, created on first use.  NULL if out of memory.
+//
+static ProgramUniforms *FindUniforms ( ESStateCache *cache, GLuint program )
+{
+   ProgramUniforms *uniforms;
+   int i;
+
+   for ( i = 0; i < cache->uniformsCount; i++ )
+   {
+      if ( cache->uniforms[i].program == program )
+      {
+         return &cache->uniforms[i];
+      }
+   }
+
+   uniforms = ( ProgramUniforms * ) realloc ( cache->uniforms, sizeof ( ProgramUniforms ) * ( cache->uniformsCount + 1 ) );
+
+   if ( uniforms == NULL )
+   {
+      return NULL;
+   }
+
+   cache->uniforms = uniforms;
+   uniforms = &cache->uniforms[cache->uniformsCount++];
+   uniforms->program = program;
+   uniforms->count = 0;
+   uniforms->values = NULL;
+
+   return uniforms;
+}
+
+///
+// UniformChanged()
+//
+//    Compare a uniform value of the bound program with the cached one and
+//    remember it.  Returns GL_TRUE if it has to be uploaded.
+//
+static GLboolean UniformChanged ( ESStateCache *cache, GLint location, const void *data, GLint words )
+{
+   ProgramUniforms *uniforms = cache->current;
+   UniformValue *value;
+
+   if ( uniforms == NULL || location < 0 )
+   {
+      // No known program, or a location the GL ignores anyway
+      cache->stats.issued++;
+      return GL_TRUE;
+   }
+
+   if ( location >= uniforms->count )
+   {
+      GLint count = location + 1;
+      UniformValue *values = ( UniformValue * ) realloc ( uniforms->values, sizeof ( UniformValue ) * count );
+
+      if ( values == NULL )
+      {
+         cache->stats.issued++;
+         return GL_TRUE;
+      }
+
+      memset ( values + uniforms->count, 0, sizeof ( UniformValue ) * ( count - uniforms->count ) );
+      uniforms->values = values;
+      uniforms->count = count;
+   }
+
+   value = &uniforms->values[location];
+
+   if ( value->words == words && memcmp ( value->data, data, words * sizeof ( GLuint ) ) == 0 )
+   {
+      cache->stats.filtered++;
+      return GL_FALSE;
+   }
+
+   value->words = words;
+   memcpy ( value->data, data, words * sizeof ( GLuint ) );
+   cache->stats.issued++;
+
+   return GL_TRUE;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esStateCacheCreate()
+//
+ESStateCache *ESUTIL_API esStateCacheCreate ( void )
+{
+   ESStateCache *cache = ( ESStateCache * ) calloc ( 1, sizeof ( ESStateCache ) );
+
+   if ( cache != NULL )
+   {
+      esStateCacheInvalidate ( cache );
+   }
+
+   return cache;
+}
+
+///
+// esStateCacheDestroy()
+//
+void ESUTIL_API esStateCacheDestroy ( ESStateCache *cache )
+{
+   if ( cache == NULL )
+   {
+      return;
+   }
+
+   ForgetUniforms ( cache );
+   free ( cache );
+}
+
+///
+// esStateCacheInvalidate()
+//
+void ESUTIL_API esStateCacheInvalidate ( ESStateCache *cache )
+{
+   ForgetUniforms ( cache );
+
+   cache->program = STATE_UNKNOWN;
+   cache->vertexArray = STATE_UNKNOWN;
+   memset ( cache->buffers, 0xFF, sizeof ( cache->buffers ) );
+   cache->attribKnown = 0;
+   cache->attribEnabled = 0;
+   cache->activeTexture = STATE_UNKNOWN;
+   memset ( cache->textures, 0xFF, sizeof ( cache->textures ) );
+   memset ( cache->caps, 0xFF, sizeof ( cache->caps ) );
+   cache->blendSrc = STATE_UNKNOWN;
+   cache->blendDst = STATE_UNKNOWN;
+   cache->depthFunc = STATE_UNKNOWN;
+   cache->depthMask = STATE_UNKNOWN;
+}
+
+///
+// esStateCacheGetStats()
+//
+const ESStateCacheStats *ESUTIL_API esStateCacheGetStats ( ESStateCache *cache )
+{
+   return &cache->stats;
+}
+
+///
+// esStateCacheResetStats()
+//
+void ESUTIL_API esStateCacheResetStats ( ESStateCache *cache )
+{
+   cache->stats.issued = 0;
+   cache->stats.filtered = 0;
+}
+
+///
+// esStateUseProgram()
+//
+void ESUTIL_API esStateUseProgram ( ESStateCache *cache, GLuint program )
+{
+   if ( Filter ( cache, &cache->program, program ) )
+   {
+      glUseProgram ( program );
+      cache->current = program != 0 ? FindUniforms ( cache, program ) : NULL;
+   }
+}
+
+///
+// esStateDeleteProgram()
+//
+void ESUTIL_API esStateDeleteProgram ( ESStateCache *cache, GLuint program )
+{
+   int i;
+
+   for ( i = 0; i < cache->uniformsCount; i++ )
+   {
+      if ( cache->uniforms[i].program == program )
+      {
+         free ( cache->uniforms[i].values );
+         cache->uniforms[i] = cache->uniforms[--cache->uniformsCount];
+         break;
+      }
+   }
+
+   // The array may have been reordered
+   cache->current = NULL;
+
+   if ( cache->program == program )
+   {
+      // A deleted program stays in use until another is bound
+      cache->program = STATE_UNKNOWN;
+   }
+   else if ( cache->program != STATE_UNKNOWN && cache->program != 0 )
+   {
+      cache->current = FindUniforms ( cache, cache->program );
+   }
+
+   glDeleteProgram ( program );
+}
+
+///
+// esStateBindVertexArray()
+//
+void ESUTIL_API esStateBindVertexArray ( ESStateCache *cache, GLuint vertexArray )
+{
+   if ( Filter ( cache, &cache->vertexArray, vertexArray ) )
+   {
+      glBindVertexArray ( vertexArray );
+
+      // The element array buffer and attribute arrays belong to the vertex array object
+      cache->buffers[BUFFER_ELEMENT_ARRAY] = STATE_UNKNOWN;
+      cache->attribKnown = 0;
+   }
+}
+
+///
+// esStateDeleteVertexArray()
+//
+void ESUTIL_API esStateDeleteVertexArray ( ESStateCache *cache, GLuint vertexArray )
+{
+   // Deleting the bound vertex array object binds the default one
+   if ( vertexArray != 0 && cache->vertexArray == vertexArray )
+   {
+      cache->vertexArray = 0;
+      cache->buffers[BUFFER_ELEMENT_ARRAY] = STATE_UNKNOWN;
+      cache->attribKnown = 0;
+   }
+
+   glDeleteVertexArrays ( 1, &vertexArray );
+}
+
+///
+// esStateBindBuffer()
+//
+void ESUTIL_API esStateBindBuffer ( ESStateCache *cache, GLenum target, GLuint buffer )
+{
+   int index = BufferIndex ( target );
+
+   if ( index < 0 )
+   {
+      cache->stats.issued++;
+      glBindBuffer ( target, buffer );
+   }
+   else if ( Filter ( cache, &cache->buffers[index], buffer ) )
+   {
+      glBindBuffer ( target, buffer );
+   }
+}
+
+///
+// esStateDeleteBuffer()
+//
+void ESUTIL_API esStateDeleteBuffer ( ESStateCache *cache, GLuint buffer )
+{
+   int i;
+
+   // GL unbinds a deleted buffer from every target it is bound to
+   for ( i = 0; i < NUM_BUFFER_TARGETS && buffer != 0; i++ )
+   {
+      if ( cache->buffers[i] == buffer )
+      {
+         cache->buffers[i] = 0;
+      }
+   }
+
+   glDeleteBuffers ( 1, &buffer );
+}
+
+///
+// esStateEnableVertexAttribArray()
+//
+void ESUTIL_API esStateEnableVertexAttribArray ( ESStateCache *cache, GLuint index )
+{
+   GLuint bit = index < STATE_MAX_ATTRIBS ? 1u << index : 0;
+
+   if ( ( cache->attribKnown & bit ) && ( cache->attribEnabled & bit ) )
+   {
+      cache->stats.filtered++;
+      return;
+   }
+
+   cache->attribKnown |= bit;
+   cache->attribEnabled |= bit;
+   cache->stats.issued++;
+   glEnableVertexAttribArray ( index );
+}
+
+///
+// esStateDisableVertexAttribArray()
+//
+void ESUTIL_API esStateDisableVertexAttribArray ( ESStateCache *cache, GLuint index )
+{
+   GLuint bit = index < STATE_MAX_ATTRIBS ? 1u << index : 0;
+
+   if ( ( cache->attribKnown & bit ) && !( cache->attribEnabled & bit ) )
+   {
+      cache->stats.filtered++;
+      return;
+   }
+
+   cache->attribKnown |= bit;
+   cache->attribEnabled &= ~bit;
+   cache->stats.issued++;
+   glDisableVertexAttribArray ( index );
+}
+
+///
+// esStateBindTexture()
+//
+void ESUTIL_API esStateBindTexture ( ESStateCache *cache, GLuint unit, GLenum target, GLuint texture )
+{
+   int index = TextureIndex ( target );
+
+   if ( index < 0 || unit >= STATE_MAX_TEXTURE_UNITS )
+   {
+      if ( Filter ( cache, &cache->activeTexture, unit ) )
+      {
+         glActiveTexture ( GL_TEXTURE0 + unit );
+      }
+
+      cache->stats.issued++;
+      glBindTexture ( target, texture );
+      return;
+   }
+
+   if ( cache->textures[unit][index] == texture )
+   {
+      cache->stats.filtered++;
+      return;
+   }
+
+   if ( Filter ( cache, &cache->activeTexture, unit ) )
+   {
+      glActiveTexture ( GL_TEXTURE0 + unit );
+   }
+
+   Filter ( cache, &cache->textures[unit][index], texture );
+   glBindTexture ( target, texture );
+}
+
+///
+// esStateDeleteTexture()
+//
+void ESUTIL_API esStateDeleteTexture ( ESStateCache *cache, GLuint texture )
+{
+   int unit, i;
+
+   // GL unbinds a deleted texture from every unit it is bound to
+   for ( unit = 0; unit < STATE_MAX_TEXTURE_UNITS && texture != 0; unit++ )
+   {
+      for ( i = 0; i < NUM_TEXTURE_TARGETS; i++ )
+      {
+         if ( cache->textures[unit][i] == texture )
+         {
+            cache->textures[unit][i] = 0;
+         }
+      }
+   }
+
+   glDeleteTextures ( 1, &texture );
+}
+
+///
+// esStateEnable()
+//
+void ESUTIL_API esStateEnable ( ESStateCache *cache, GLenum cap )
+{
+   int index = CapIndex ( cap );
+
+   if ( index < 0 )
+   {
+      cache->stats.issued++;
+      glEnable ( cap );
+   }
+   else if ( Filter ( cache, &cache->caps[index], GL_TRUE ) )
+   {
+      glEnable ( cap );
+   }
+}
+
+///
+// esStateDisable()
+//
+void ESUTIL_API esStateDisable ( ESStateCache *cache, GLenum cap )
+{
+   int index = CapIndex ( cap );
+
+   if ( index < 0 )
+   {
+      cache->stats.issued++;
+      glDisable ( cap );
+   }
+   else if ( Filter ( cache, &cache->caps[index], GL_FALSE ) )
+   {
+      glDisable ( cap );
+   }
+}
+
+///
+// esStateBlendFunc()
+//
+void ESUTIL_API esStateBlendFunc ( ESStateCache *cache, GLenum sfactor, GLenum dfactor )
+{
+   if ( cache->blendSrc == sfactor && cache->blendDst == dfactor )
+   {
+      cache->stats.filtered++;
+      return;
+   }
+
+   cache->blendSrc = sfactor;
+   cache->blendDst = dfactor;
+   cache->stats.issued++;
+   glBlendFunc ( sfactor, dfactor );
+}
+
+///
+// esStateDepthFunc()
+//
+void ESUTIL_API esStateDepthFunc ( ESStateCache *cache, GLenum func )
+{
+   if ( Filter ( cache, &cache->depthFunc, func ) )
+   {
+      glDepthFunc ( func );
+   }
+}
+
+///
+// esStateDepthMask()
+//
+void ESUTIL_API esStateDepthMask ( ESStateCache *cache, GLboolean flag )
+{
+   if ( Filter ( cache, &cache->depthMask, flag ? GL_TRUE : GL_FALSE ) )
+   {
+      glDepthMask ( flag );
+   }
+}
+
+///
+// esStateUniform1i()
+//
+void ESUTIL_API esStateUniform1i ( ESStateCache *cache, GLint location, GLint x )
+{
+   if ( UniformChanged ( cache, location, &x, 1 ) )
+   {
+      glUniform1i ( location, x );
+   }
+}
+
+///
+// esStateUniform1f()
+//
+void ESUTIL_API esStateUniform1f ( ESStateCache *cache, GLint location, GLfloat x )
+{
+   if ( UniformChanged ( cache, location, &x, 1 ) )
+   {
+      glUniform1f ( location, x );
+   }
+}
+
+///
+// esStateUniform2f()
+//
+void ESUTIL_API esStateUniform2f ( ESStateCache *cache, GLint location, GLfloat x, GLfloat y )
+{
+   GLfloat v[2] = { x, y };
+
+   if ( UniformChanged ( cache, location, v, 2 ) )
+   {
+      glUniform2fv ( location, 1, v );
+   }
+}
+
+///
+// esStateUniform3f()
+//
+void ESUTIL_API esStateUniform3f ( ESStateCache *cache, GLint location, GLfloat x, GLfloat y, GLfloat z )
+{
+   GLfloat v[3] = { x, y, z };
+
+   if ( UniformChanged ( cache, location, v, 3 ) )
+   {
+      glUniform3fv ( location, 1, v );
+   }
+}
+
+///
+// esStateUniform4f()
+//
+void ESUTIL_API esStateUniform4f ( ESStateCache *cache, GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w )
+{
+   GLfloat v[4] = { x, y, z, w };
+
+   if ( UniformChanged ( cache, location, v, 4 ) )
+   {
+      glUniform4fv ( location, 1, v );
+   }
+}
+
+///
+// esStateUniform4fv()
+//
+void ESUTIL_API esStateUniform4fv ( ESStateCache *cache, GLint location, const GLfloat *v )
+{
+   if ( UniformChanged ( cache, location, v, 4 ) )
+   {
+      glUniform4fv ( location, 1, v );
+   }
+}
+
+///
+// esStateUniformMatrix4fv()
+//
+void ESUTIL_API esStateUniformMatrix4fv ( ESStateCache *cache, GLint location, const GLfloat *m )
+{
+   if ( UniformChanged ( cache, location, m, 16 ) )
+   {
+      glUniformMatrix4fv ( location, 1, GL_FALSE, m );
+   }
+}
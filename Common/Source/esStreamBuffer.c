@@ -0,0 +1,351 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esStreamBuffer.c
+//
+//    Ring allocator for per-frame dynamic data.  Each allocation is the
+//    next piece of one large buffer object, mapped with
+//    GL_MAP_UNSYNCHRONIZED_BIT so the driver never waits for earlier draws.
+//    Instead, esStreamBufferFence puts a fence after the commands that use
+//    the data written since the previous fence, and an allocation only
+//    waits if it would overwrite a region whose fence has not signalled.
+//    With a buffer a few frames deep that never happens in steady state.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include <stdlib.h>
+#include <string.h>
+
+///
+//  Macros
+//
+
+// Fenced regions tracked before the oldest is waited for early
+#define MAX_STREAM_REGIONS    64
+
+///
+//  Types
+//
+
+// Data the GPU may still be reading, never wraps around the end of the buffer
+typedef struct
+{
+   GLintptr    start;
+   GLintptr    end;
+   GLsync      fence;
+} StreamRegion;
+
+struct ESStreamBuffer
+{
+   GLenum         target;
+   GLuint         buffer;
+   GLsizeiptr     size;
+
+   // Next free byte
+   GLintptr       head;
+
+   // Start of the data written since the last fence
+   GLintptr       pendingStart;
+
+   // Set once the allocator wraps around between two fences, along with the
+   // data written before it did
+   GLboolean      wrapped;
+   GLintptr       wrapStart;
+   GLintptr       wrapEnd;
+
+   // Fenced regions, oldest first
+   StreamRegion   regions[MAX_STREAM_REGIONS];
+   int            firstRegion;
+   int            numRegions;
+
+   GLboolean      mapped;
+};
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// RetireRegions()
+//
+//    Wait for the fence of region last (an offset from the oldest) and
+//    release it with every older region
+//
+static void RetireRegions ( ESStreamBuffer *sb, int last )
+{
+   StreamRegion *region = &sb->regions[( sb->firstRegion + last ) % MAX_STREAM_REGIONS];
+   int i;
+
+   // Fences signal in order, so the newest one covers all the older regions
+   while ( glClientWaitSync ( region->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000 ) == GL_TIMEOUT_EXPIRED )
+   {
+   }
+
+   for ( i = 0; i <= last; i++ )
+   {
+      glDeleteSync ( sb->regions[sb->firstRegion].fence );
+      sb->firstRegion = ( sb->firstRegion + 1 ) % MAX_STREAM_REGIONS;
+      sb->numRegions--;
+   }
+}
+
+///
+// ReserveRange()
+//
+//    Make [start, end) safe to overwrite
+//
+static void ReserveRange ( ESStreamBuffer *sb, GLintptr start, GLintptr end )
+{
+   int last = -1;
+   int i;
+
+   for ( i = 0; i < sb->numRegions; i++ )
+   {
+      StreamRegion *region = &sb->regions[( sb->firstRegion + i ) % MAX_STREAM_REGIONS];
+
+      if ( region->start < end && start < region->end )
+      {
+         last = i;
+      }
+   }
+
+   if ( last >= 0 )
+   {
+      RetireRegions ( sb, last );
+   }
+}
+
+///
+// PushRegion()
+//
+//    Fence [start, end) as the newest region
+//
+static void PushRegion ( ESStreamBuffer *sb, GLintptr start, GLintptr end )
+{
+   StreamRegion *region;
+
+   if ( sb->numRegions == MAX_STREAM_REGIONS )
+   {
+      RetireRegions ( sb, 0 );
+   }
+
+   region = &sb->regions[( sb->firstRegion + sb->numRegions ) % MAX_STREAM_REGIONS];
+   region->start = start;
+   region->end = end;
+   region->fence = glFenceSync ( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+   sb->numRegions++;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esStreamBufferCreate()
+//
+ESStreamBuffer *ESUTIL_API esStreamBufferCreate ( GLenum target, GLsizeiptr size )
+{
+   ESStreamBuffer *sb;
+
+   if ( size <= 0 )
+   {
+      return NULL;
+   }
+
+   sb = ( ESStreamBuffer * ) calloc ( 1, sizeof ( ESStreamBuffer ) );
+
+   if ( sb == NULL )
+   {
+      return NULL;
+   }
+
+   sb->target = target;
+   sb->size = size;
+
+   glGenBuffers ( 1, &sb->buffer );
+   glBindBuffer ( target, sb->buffer );
+   glBufferData ( target, size, NULL, GL_STREAM_DRAW );
+
+   return sb;
+}
+
+///
+// esStreamBufferDestroy()
+//
+void ESUTIL_API esStreamBufferDestroy ( ESStreamBuffer *sb )
+{
+   if ( sb == NULL )
+   {
+      return;
+   }
+
+   while ( sb->numRegions > 0 )
+   {
+      glDeleteSync ( sb->regions[sb->firstRegion].fence );
+      sb->firstRegion = ( sb->firstRegion + 1 ) % MAX_STREAM_REGIONS;
+      sb->numRegions--;
+   }
+
+   glDeleteBuffers ( 1, &sb->buffer );
+   free ( sb );
+}
+
+///
+// esStreamBufferId()
+//
+GLuint ESUTIL_API esStreamBufferId ( ESStreamBuffer *sb )
+{
+   return sb->buffer;
+}
+
+///
+// esStreamBufferMap()
+//
+void *ESUTIL_API esStreamBufferMap ( ESStreamBuffer *sb, GLsizeiptr size, GLsizeiptr alignment, GLintptr *offset )
+{
+   GLintptr start;
+   void *ptr;
+
+   if ( sb->mapped || size <= 0 || size > sb->size )
+   {
+      return NULL;
+   }
+
+   if ( alignment < 1 )
+   {
+      alignment = 1;
+   }
+
+   start = ( sb->head + alignment - 1 ) / alignment * alignment;
+
+   if ( start + size > sb->size )
+   {
+      if ( sb->wrapped )
+      {
+         // Wrapped before since the last fence, this would overwrite data not yet drawn
+         return NULL;
+      }
+
+      // Wrap around, keeping what was written at the end as a separate region
+      // so that regions never wrap
+      sb->wrapped = GL_TRUE;
+      sb->wrapStart = sb->pendingStart;
+      sb->wrapEnd = sb->head;
+      sb->pendingStart = 0;
+      start = 0;
+   }
+
+   if ( sb->wrapEnd > sb->wrapStart && start + size > sb->wrapStart )
+   {
+      // More data between two fences than the buffer holds
+      return NULL;
+   }
+
+   ReserveRange ( sb, start, start + size );
+
+   glBindBuffer ( sb->target, sb->buffer );
+
+   // Nothing the GPU still needs is in this range, so there is nothing to synchronize with
+   ptr = glMapBufferRange ( sb->target, start, size,
+                            GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT );
+
+   if ( ptr == NULL )
+   {
+      return NULL;
+   }
+
+   sb->head = start + size;
+   sb->mapped = GL_TRUE;
+   *offset = start;
+
+   return ptr;
+}
+
+///
+// esStreamBufferUnmap()
+//
+GLboolean ESUTIL_API esStreamBufferUnmap ( ESStreamBuffer *sb )
+{
+   if ( !sb->mapped )
+   {
+      return GL_FALSE;
+   }
+
+   sb->mapped = GL_FALSE;
+   glBindBuffer ( sb->target, sb->buffer );
+
+   return glUnmapBuffer ( sb->target );
+}
+
+///
+// esStreamBufferWrite()
+//
+GLintptr ESUTIL_API esStreamBufferWrite ( ESStreamBuffer *sb, const void *data, GLsizeiptr size, GLsizeiptr alignment )
+{
+   GLintptr offset;
+   void *ptr = esStreamBufferMap ( sb, size, alignment, &offset );
+
+   if ( ptr == NULL )
+   {
+      return -1;
+   }
+
+   memcpy ( ptr, data, size );
+
+   return esStreamBufferUnmap ( sb ) ? offset : -1;
+}
+
+///
+// esStreamBufferFence()
+//
+void ESUTIL_API esStreamBufferFence ( ESStreamBuffer *sb )
+{
+   if ( sb->wrapEnd > sb->wrapStart )
+   {
+      PushRegion ( sb, sb->wrapStart, sb->wrapEnd );
+   }
+
+   if ( sb->head > sb->pendingStart )
+   {
+      PushRegion ( sb, sb->pendingStart, sb->head );
+   }
+
+   sb->wrapped = GL_FALSE;
+   sb->wrapStart = sb->wrapEnd = 0;
+   sb->pendingStart = sb->head;
+}
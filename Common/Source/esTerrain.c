@@ -0,0 +1,1224 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esTerrain.c
+//
+//    Chunked quadtree level of detail for height field terrain.  Every
+//    node of the quadtree is drawn with the same grid of chunkSize x
+//    chunkSize vertices, stretched over the node's area, so a node one
+//    level down has twice the sample density.  Each frame the tree is
+//    refined where a node's geometric error projects to more than the
+//    allowed number of pixels, nodes outside the view frustum are skipped,
+//    and the selection is balanced so neighbours differ by at most one
+//    level.  Edges against a coarser neighbour use one of 16 precomputed
+//    index variants that fold every other edge vertex onto its neighbour,
+//    which closes the cracks.  All chunks share one vertex buffer and one
+//    16-bit index buffer.
+//
+//    A terrain too large for memory can be written to a tile file once and
+//    streamed from it.  The file holds the node bounds and errors, and for
+//    every level a grid of height tiles at that level's sample density, so
+//    a chunk reads all its heights from one tile.  Tiles are paged into an
+//    ESTileCache as the view needs them, and a node is only split once the
+//    tiles of its children and their surroundings are resident.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include "esHalf.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+///
+//  Macros
+//
+
+// Deepest quadtree supported, 4^10 leaves
+#define TERRAIN_MAX_DEPTH     10
+
+// Index variants, one per combination of coarser neighbours
+#define TERRAIN_VARIANTS      16
+
+// Edge bits of a variant: the neighbour on that side is one level coarser
+#define EDGE_LEFT             1
+#define EDGE_RIGHT            2
+#define EDGE_BOTTOM           4
+#define EDGE_TOP              8
+
+// Samples around each tile beyond its share of the level, for normals
+#define TILE_BORDER           1
+
+// Nodes around a node's children whose tiles must be resident before it is
+// split, enough for the splits the balancing pass forces on neighbours
+#define TILE_MARGIN           4
+
+// Tile cache layers, at least enough for the root and its surroundings
+#define MIN_CACHE_TILES       16
+
+///
+//  Types
+//
+typedef struct
+{
+   int            level;
+   int            x;
+   int            y;
+   int            variant;
+
+   // Streamed terrains: the layer holding the chunk's heights, and the
+   // texel of its first vertex
+   int            layer;
+   int            texelX;
+   int            texelY;
+} TerrainChunk;
+
+struct ESTerrain
+{
+   // Samples per side, vertices per chunk side, and levels below the root
+   int            size;
+   int            chunkSize;
+   int            depth;
+   GLfloat        extent;
+
+   ESHeightFunc   heightFunc;
+   void          *heightArg;
+
+   // Per node, level by level from the root: height bounds, geometric
+   // error, and this frame's selection
+   int            nodeCount;
+   GLfloat       *minHeight;
+   GLfloat       *maxHeight;
+   GLfloat       *error;
+   GLubyte       *split;
+
+   // View of the current selection
+   ESFrustumPlanes frustum;
+   GLfloat        eye[3];
+   GLfloat        pixelScale;
+   GLfloat        pixelError;
+
+   // Chunks to draw
+   TerrainChunk  *chunks;
+   int            chunkCount;
+
+   GLuint         vertexBuffer;
+   GLuint         indexBuffer;
+   GLsizei        variantOffset[TERRAIN_VARIANTS];
+   GLsizei        variantCount[TERRAIN_VARIANTS];
+
+   // Streamed terrains: the tiles of every level, and the samples per tile
+   // side not counting the border
+   ESTileCache   *tiles;
+   int            tileQuads;
+   int            tileOffset[TERRAIN_MAX_DEPTH + 1];
+   int            tileSide[TERRAIN_MAX_DEPTH + 1];
+
+   ESTerrainStats stats;
+};
+
+// Start of the user block of a terrain tile file, followed by the minimum
+// heights, maximum heights and errors of all nodes
+typedef struct
+{
+   GLuint         size;
+   GLuint         chunkSize;
+   GLuint         tileSize;
+   GLuint         nodeCount;
+} TerrainFileHeader;
+
+// esParallelFor argument for building one level of the tree
+typedef struct
+{
+   ESTerrain     *terrain;
+   int            level;
+} BuildJob;
+
+// esTileFileWrite tile callback and esParallelFor argument for filling a tile
+typedef struct
+{
+   ESTerrain     *terrain;
+   ESThreadPool  *pool;
+   GLushort      *pixels;
+   int            level;
+   int            x0;
+   int            y0;
+} TileJob;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// NodeIndex()
+//
+//    Index of node (x, y) of a level, levels are stored root first
+//
+static int NodeIndex ( int level, int x, int y )
+{
+   return ( ( 1 << ( 2 * level ) ) - 1 ) / 3 + ( y << level ) + x;
+}
+
+///
+// NodeSpacing()
+//
+//    Samples between the vertices of a node of a level
+//
+static int NodeSpacing ( const ESTerrain *terrain, int level )
+{
+   return 1 << ( terrain->depth - level );
+}
+
+///
+// BuildLeaves()
+//
+//    esParallelFor body: height bounds of leaf rows [begin, end)
+//
+static void ESCALLBACK BuildLeaves ( void *arg, int begin, int end )
+{
+   BuildJob *job = ( BuildJob * ) arg;
+   ESTerrain *terrain = job->terrain;
+   int quads = terrain->chunkSize - 1;
+   int x, y, i, j;
+
+   for ( y = begin; y < end; y++ )
+   {
+      for ( x = 0; x < ( 1 << job->level ); x++ )
+      {
+         int node = NodeIndex ( job->level, x, y );
+         GLfloat lo = terrain->heightFunc ( terrain->heightArg, x * quads, y * quads );
+         GLfloat hi = lo;
+
+         for ( j = 0; j <= quads; j++ )
+         {
+            for ( i = 0; i <= quads; i++ )
+            {
+               GLfloat h = terrain->heightFunc ( terrain->heightArg, x * quads + i, y * quads + j );
+
+               lo = h < lo ? h : lo;
+               hi = h > hi ? h : hi;
+            }
+         }
+
+         terrain->minHeight[node] = lo;
+         terrain->maxHeight[node] = hi;
+         terrain->error[node] = 0.0f;
+      }
+   }
+}
+
+///
+// BuildNodes()
+//
+//    esParallelFor body: bounds and error of interior node rows [begin, end).
+//    The error is how far the heights at the children's vertex density
+//    stray from the node's triangles, plus the worst error of the children.
+//
+static void ESCALLBACK BuildNodes ( void *arg, int begin, int end )
+{
+   BuildJob *job = ( BuildJob * ) arg;
+   ESTerrain *terrain = job->terrain;
+   int quads = terrain->chunkSize - 1;
+   int spacing = NodeSpacing ( terrain, job->level );
+   int half = spacing / 2;
+   int x, y, i, j, c;
+
+   for ( y = begin; y < end; y++ )
+   {
+      for ( x = 0; x < ( 1 << job->level ); x++ )
+      {
+         int node = NodeIndex ( job->level, x, y );
+         int x0 = x * quads * spacing;
+         int y0 = y * quads * spacing;
+         GLfloat delta = 0.0f;
+         GLfloat childError = 0.0f;
+
+         terrain->minHeight[node] = terrain->minHeight[NodeIndex ( job->level + 1, x * 2, y * 2 )];
+         terrain->maxHeight[node] = terrain->maxHeight[NodeIndex ( job->level + 1, x * 2, y * 2 )];
+
+         for ( c = 0; c < 4; c++ )
+         {
+            int child = NodeIndex ( job->level + 1, x * 2 + ( c & 1 ), y * 2 + ( c >> 1 ) );
+
+            terrain->minHeight[node] = terrain->minHeight[child] < terrain->minHeight[node] ?
+                                       terrain->minHeight[child] : terrain->minHeight[node];
+            terrain->maxHeight[node] = terrain->maxHeight[child] > terrain->maxHeight[node] ?
+                                       terrain->maxHeight[child] : terrain->maxHeight[node];
+            childError = terrain->error[child] > childError ? terrain->error[child] : childError;
+         }
+
+         // Cells are split along the diagonal from (1, 0) to (0, 1), so the
+         // cell center interpolates those two corners
+         for ( j = 0; j <= quads; j++ )
+         {
+            for ( i = 0; i <= quads; i++ )
+            {
+               int sx = x0 + i * spacing;
+               int sy = y0 + j * spacing;
+               GLfloat a = terrain->heightFunc ( terrain->heightArg, sx, sy );
+               GLfloat b = i < quads ? terrain->heightFunc ( terrain->heightArg, sx + spacing, sy ) : a;
+               GLfloat c = j < quads ? terrain->heightFunc ( terrain->heightArg, sx, sy + spacing ) : a;
+               GLfloat d;
+
+               if ( i < quads )
+               {
+                  d = ( GLfloat ) fabs ( terrain->heightFunc ( terrain->heightArg, sx + half, sy ) - ( a + b ) * 0.5f );
+                  delta = d > delta ? d : delta;
+               }
+
+               if ( j < quads )
+               {
+                  d = ( GLfloat ) fabs ( terrain->heightFunc ( terrain->heightArg, sx, sy + half ) - ( a + c ) * 0.5f );
+                  delta = d > delta ? d : delta;
+               }
+
+               if ( i < quads && j < quads )
+               {
+                  d = ( GLfloat ) fabs ( terrain->heightFunc ( terrain->heightArg, sx + half, sy + half ) - ( b + c ) * 0.5f );
+                  delta = d > delta ? d : delta;
+               }
+            }
+         }
+
+         terrain->error[node] = childError + delta;
+      }
+   }
+}
+
+///
+// TerrainDepth()
+//
+//    Levels below the root for a height field of size samples drawn in
+//    chunks of chunkSize, or -1 if the sizes do not fit a quadtree.
+//    chunkSize is 2^m + 1 and small enough for 16-bit indices, size spans
+//    2^depth chunks.
+//
+static int TerrainDepth ( int size, int chunkSize )
+{
+   int depth = 0;
+
+   if ( chunkSize < 3 || chunkSize > 129 || ( ( chunkSize - 1 ) & ( chunkSize - 2 ) ) != 0 ||
+        size < chunkSize || ( size - 1 ) % ( chunkSize - 1 ) != 0 )
+   {
+      return -1;
+   }
+
+   while ( ( chunkSize - 1 ) << depth < size - 1 )
+   {
+      depth++;
+   }
+
+   if ( ( chunkSize - 1 ) << depth != size - 1 || depth > TERRAIN_MAX_DEPTH )
+   {
+      return -1;
+   }
+
+   return depth;
+}
+
+///
+// BuildTree()
+//
+//    Allocate the node arrays and fill in bounds and errors, from the
+//    leaves up
+//
+static GLboolean BuildTree ( ESTerrain *terrain, ESThreadPool *pool )
+{
+   int level;
+
+   terrain->minHeight = ( GLfloat * ) malloc ( sizeof ( GLfloat ) * terrain->nodeCount );
+   terrain->maxHeight = ( GLfloat * ) malloc ( sizeof ( GLfloat ) * terrain->nodeCount );
+   terrain->error = ( GLfloat * ) malloc ( sizeof ( GLfloat ) * terrain->nodeCount );
+
+   if ( terrain->minHeight == NULL || terrain->maxHeight == NULL || terrain->error == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   for ( level = terrain->depth; level >= 0; level-- )
+   {
+      BuildJob job;
+
+      job.terrain = terrain;
+      job.level = level;
+      esParallelFor ( pool, 1 << level, level == terrain->depth ? BuildLeaves : BuildNodes, &job );
+   }
+
+   return GL_TRUE;
+}
+
+///
+// TileLayout()
+//
+//    Tiles per side of every level and where each level's tiles start,
+//    coarsest level first.  Returns the number of tiles, or -1 if
+//    tileSize is not 2^m + 1 between chunkSize and size.
+//
+static int TileLayout ( ESTerrain *terrain, int tileSize )
+{
+   int quads = terrain->chunkSize - 1;
+   int count = 0;
+   int level;
+
+   terrain->tileQuads = tileSize - 1;
+
+   if ( tileSize < terrain->chunkSize || tileSize > terrain->size ||
+        ( terrain->tileQuads & ( terrain->tileQuads - 1 ) ) != 0 )
+   {
+      return -1;
+   }
+
+   for ( level = 0; level <= terrain->depth; level++ )
+   {
+      int side = ( quads << level ) / terrain->tileQuads;
+
+      terrain->tileSide[level] = side > 1 ? side : 1;
+      terrain->tileOffset[level] = count;
+      count += terrain->tileSide[level] * terrain->tileSide[level];
+   }
+
+   return count;
+}
+
+///
+// NodeTile()
+//
+//    Tile holding the heights of a node, and optionally the texel of the
+//    node's first vertex in it
+//
+static int NodeTile ( const ESTerrain *terrain, int level, int x, int y, int *texelX, int *texelY )
+{
+   int quads = terrain->chunkSize - 1;
+   int tx = x * quads / terrain->tileQuads;
+   int ty = y * quads / terrain->tileQuads;
+
+   if ( texelX != NULL )
+   {
+      *texelX = x * quads - tx * terrain->tileQuads + TILE_BORDER;
+      *texelY = y * quads - ty * terrain->tileQuads + TILE_BORDER;
+   }
+
+   return terrain->tileOffset[level] + ty * terrain->tileSide[level] + tx;
+}
+
+///
+// FillTileRows()
+//
+//    esParallelFor body: half float heights of tile rows [begin, end),
+//    clamping samples beyond the height field to its edge
+//
+static void ESCALLBACK FillTileRows ( void *arg, int begin, int end )
+{
+   TileJob *job = ( TileJob * ) arg;
+   ESTerrain *terrain = job->terrain;
+   int width = terrain->tileQuads + 1 + 2 * TILE_BORDER;
+   int spacing = NodeSpacing ( terrain, job->level );
+   int last = terrain->size - 1;
+   int i, j;
+
+   for ( j = begin; j < end; j++ )
+   {
+      int sy = ( job->y0 + j - TILE_BORDER ) * spacing;
+
+      sy = sy < 0 ? 0 : ( sy > last ? last : sy );
+
+      for ( i = 0; i < width; i++ )
+      {
+         int sx = ( job->x0 + i - TILE_BORDER ) * spacing;
+
+         sx = sx < 0 ? 0 : ( sx > last ? last : sx );
+         job->pixels[j * width + i] = esFloatToHalf ( terrain->heightFunc ( terrain->heightArg, sx, sy ) );
+      }
+   }
+}
+
+///
+// WriteTile()
+//
+//    esTileFileWrite callback: heights of one tile at its level's density
+//
+static void ESCALLBACK WriteTile ( void *arg, int tile, void *pixels )
+{
+   TileJob *job = ( TileJob * ) arg;
+   ESTerrain *terrain = job->terrain;
+   int level = terrain->depth;
+
+   while ( terrain->tileOffset[level] > tile )
+   {
+      level--;
+   }
+
+   tile -= terrain->tileOffset[level];
+   job->pixels = ( GLushort * ) pixels;
+   job->level = level;
+   job->x0 = tile % terrain->tileSide[level] * terrain->tileQuads;
+   job->y0 = tile / terrain->tileSide[level] * terrain->tileQuads;
+
+   esParallelFor ( job->pool, terrain->tileQuads + 1 + 2 * TILE_BORDER, FillTileRows, job );
+}
+
+///
+// BuildIndices()
+//
+//    Triangle lists of the 16 edge variants of the chunk grid, packed one
+//    after the other.  Returns the number of indices, writing them if
+//    indices is not NULL.
+//
+static int BuildIndices ( ESTerrain *terrain, GLuint *indices )
+{
+   int n = terrain->chunkSize;
+   int count = 0;
+   int variant, i, j, t, k;
+
+   for ( variant = 0; variant < TERRAIN_VARIANTS; variant++ )
+   {
+      terrain->variantOffset[variant] = count * sizeof ( GLushort );
+
+      for ( j = 0; j < n - 1; j++ )
+      {
+         for ( i = 0; i < n - 1; i++ )
+         {
+            // Corners a (i, j), b (i + 1, j), c (i, j + 1), d (i + 1, j + 1)
+            int cx[4] = { i, i + 1, i, i + 1 };
+            int cy[4] = { j, j, j + 1, j + 1 };
+            int v[4];
+            static const int tris[2][3] = { { 0, 1, 2 }, { 1, 3, 2 } };
+
+            // Fold odd vertices on coarser edges onto the even vertex before them
+            for ( k = 0; k < 4; k++ )
+            {
+               if ( ( ( variant & EDGE_LEFT ) && cx[k] == 0 ) || ( ( variant & EDGE_RIGHT ) && cx[k] == n - 1 ) )
+               {
+                  cy[k] &= ~1;
+               }
+
+               if ( ( ( variant & EDGE_BOTTOM ) && cy[k] == 0 ) || ( ( variant & EDGE_TOP ) && cy[k] == n - 1 ) )
+               {
+                  cx[k] &= ~1;
+               }
+
+               v[k] = cy[k] * n + cx[k];
+            }
+
+            for ( t = 0; t < 2; t++ )
+            {
+               int v0 = v[tris[t][0]];
+               int v1 = v[tris[t][1]];
+               int v2 = v[tris[t][2]];
+
+               if ( v0 == v1 || v1 == v2 || v0 == v2 )
+               {
+                  continue;
+               }
+
+               if ( indices != NULL )
+               {
+                  indices[count] = v0;
+                  indices[count + 1] = v1;
+                  indices[count + 2] = v2;
+               }
+
+               count += 3;
+            }
+         }
+      }
+
+      terrain->variantCount[variant] = count - terrain->variantOffset[variant] / sizeof ( GLushort );
+   }
+
+   return count;
+}
+
+///
+// NodeBounds()
+//
+//    World space box of a node
+//
+static void NodeBounds ( const ESTerrain *terrain, int level, int x, int y, GLfloat lo[3], GLfloat hi[3] )
+{
+   int node = NodeIndex ( level, x, y );
+   GLfloat nodeSize = terrain->extent / ( 1 << level );
+
+   lo[0] = x * nodeSize;
+   lo[1] = y * nodeSize;
+   lo[2] = terrain->minHeight[node];
+   hi[0] = lo[0] + nodeSize;
+   hi[1] = lo[1] + nodeSize;
+   hi[2] = terrain->maxHeight[node];
+}
+
+///
+// NodeVisible()
+//
+//    Whether any of a node's box is inside every frustum plane
+//
+static int NodeVisible ( const ESTerrain *terrain, int level, int x, int y )
+{
+   GLfloat lo[3], hi[3];
+   int p;
+
+   NodeBounds ( terrain, level, x, y, lo, hi );
+
+   for ( p = 0; p < 6; p++ )
+   {
+      const GLfloat *plane = terrain->frustum.planes[p];
+
+      // The corner furthest along the plane normal
+      GLfloat d = plane[0] * ( plane[0] > 0.0f ? hi[0] : lo[0] ) +
+                  plane[1] * ( plane[1] > 0.0f ? hi[1] : lo[1] ) +
+                  plane[2] * ( plane[2] > 0.0f ? hi[2] : lo[2] ) + plane[3];
+
+      if ( d < 0.0f )
+      {
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+///
+// NodeDistance()
+//
+//    Distance from the eye to the closest point of a node's box
+//
+static GLfloat NodeDistance ( const ESTerrain *terrain, int level, int x, int y )
+{
+   GLfloat lo[3], hi[3];
+   GLfloat distance = 0.0f;
+   int k;
+
+   NodeBounds ( terrain, level, x, y, lo, hi );
+
+   for ( k = 0; k < 3; k++ )
+   {
+      GLfloat d = terrain->eye[k] < lo[k] ? lo[k] - terrain->eye[k] :
+                  ( terrain->eye[k] > hi[k] ? terrain->eye[k] - hi[k] : 0.0f );
+
+      distance += d * d;
+   }
+
+   return sqrtf ( distance );
+}
+
+///
+// ChildrenReady()
+//
+//    Whether the tiles of a node's children, and of the nodes within
+//    TILE_MARGIN of them, are resident.  Requests the ones that are not.
+//
+static int ChildrenReady ( ESTerrain *terrain, int level, int x, int y, int priority )
+{
+   int quads = terrain->chunkSize - 1;
+   int last = ( 2 << level ) - 1;
+   int x0 = x * 2 - TILE_MARGIN < 0 ? 0 : x * 2 - TILE_MARGIN;
+   int y0 = y * 2 - TILE_MARGIN < 0 ? 0 : y * 2 - TILE_MARGIN;
+   int x1 = x * 2 + 1 + TILE_MARGIN > last ? last : x * 2 + 1 + TILE_MARGIN;
+   int y1 = y * 2 + 1 + TILE_MARGIN > last ? last : y * 2 + 1 + TILE_MARGIN;
+   int ready = TRUE;
+   int tx, ty;
+
+   for ( ty = y0 * quads / terrain->tileQuads; ty <= y1 * quads / terrain->tileQuads; ty++ )
+   {
+      for ( tx = x0 * quads / terrain->tileQuads; tx <= x1 * quads / terrain->tileQuads; tx++ )
+      {
+         int tile = terrain->tileOffset[level + 1] + ty * terrain->tileSide[level + 1] + tx;
+
+         if ( esTileCacheLookup ( terrain->tiles, tile ) < 0 )
+         {
+            esTileCacheRequest ( terrain->tiles, tile, priority );
+            ready = FALSE;
+         }
+      }
+   }
+
+   return ready;
+}
+
+///
+// Refine()
+//
+//    Split a node if its error covers more than the allowed pixels from the
+//    closest point of its box, and recurse.  Streamed terrains also fetch
+//    the tiles a node will need if the eye comes twice as close, including
+//    nodes just out of view, and only split nodes whose tiles are in.
+//
+static void Refine ( ESTerrain *terrain, int level, int x, int y )
+{
+   GLfloat distance;
+   GLfloat error;
+   int node = NodeIndex ( level, x, y );
+   int prefetch = terrain->depth + 1 + level;
+   int k;
+
+   terrain->stats.nodesVisited++;
+
+   if ( level == terrain->depth )
+   {
+      return;
+   }
+
+   distance = NodeDistance ( terrain, level, x, y );
+   error = terrain->error[node] * terrain->pixelScale;
+
+   if ( !NodeVisible ( terrain, level, x, y ) || error <= terrain->pixelError * distance )
+   {
+      if ( terrain->tiles != NULL && error > terrain->pixelError * distance * 0.5f )
+      {
+         ChildrenReady ( terrain, level, x, y, prefetch );
+      }
+
+      return;
+   }
+
+   if ( terrain->tiles != NULL && !ChildrenReady ( terrain, level, x, y, level ) )
+   {
+      return;
+   }
+
+   terrain->split[node] = 1;
+
+   for ( k = 0; k < 4; k++ )
+   {
+      Refine ( terrain, level + 1, x * 2 + ( k & 1 ), y * 2 + ( k >> 1 ) );
+   }
+}
+
+///
+// ForceSplit()
+//
+//    Split a node and all its ancestors
+//
+static void ForceSplit ( ESTerrain *terrain, int level, int x, int y )
+{
+   for ( ; level >= 0; level--, x >>= 1, y >>= 1 )
+   {
+      int node = NodeIndex ( level, x, y );
+
+      if ( terrain->split[node] )
+      {
+         return;
+      }
+
+      terrain->split[node] = 1;
+   }
+}
+
+///
+// Balance()
+//
+//    Split nodes until neighbouring chunks are at most one level apart.
+//    A split node with a split child has chunks two levels down, so its
+//    neighbours at the same level must be split too.  Splitting only adds
+//    that condition to shallower levels, so one pass from the bottom up is
+//    enough.
+//
+static void Balance ( ESTerrain *terrain )
+{
+   static const int dx[4] = { -1, 1, 0, 0 };
+   static const int dy[4] = { 0, 0, -1, 1 };
+   int level, x, y, k;
+
+   for ( level = terrain->depth - 2; level >= 0; level-- )
+   {
+      int side = 1 << level;
+
+      for ( y = 0; y < side; y++ )
+      {
+         for ( x = 0; x < side; x++ )
+         {
+            int node = NodeIndex ( level, x, y );
+            int deep = 0;
+
+            if ( !terrain->split[node] )
+            {
+               continue;
+            }
+
+            for ( k = 0; k < 4; k++ )
+            {
+               deep |= terrain->split[NodeIndex ( level + 1, x * 2 + ( k & 1 ), y * 2 + ( k >> 1 ) )];
+            }
+
+            for ( k = 0; k < 4 && deep; k++ )
+            {
+               int nx = x + dx[k];
+               int ny = y + dy[k];
+
+               if ( nx >= 0 && ny >= 0 && nx < side && ny < side )
+               {
+                  ForceSplit ( terrain, level, nx, ny );
+               }
+            }
+         }
+      }
+   }
+}
+
+///
+// NodePresent()
+//
+//    Whether a node is part of the selected tree: its parent is split
+//
+static int NodePresent ( const ESTerrain *terrain, int level, int x, int y )
+{
+   return level == 0 || terrain->split[NodeIndex ( level - 1, x >> 1, y >> 1 )];
+}
+
+///
+// Collect()
+//
+//    Add the visible unsplit nodes under a node to the draw list, with the
+//    index variant for their coarser neighbours
+//
+static void Collect ( ESTerrain *terrain, int level, int x, int y )
+{
+   int side = 1 << level;
+   TerrainChunk *chunk;
+   int k;
+
+   if ( terrain->split[NodeIndex ( level, x, y )] )
+   {
+      for ( k = 0; k < 4; k++ )
+      {
+         Collect ( terrain, level + 1, x * 2 + ( k & 1 ), y * 2 + ( k >> 1 ) );
+      }
+
+      return;
+   }
+
+   if ( !NodeVisible ( terrain, level, x, y ) )
+   {
+      terrain->stats.chunksCulled++;
+      return;
+   }
+
+   chunk = &terrain->chunks[terrain->chunkCount];
+   chunk->level = level;
+   chunk->x = x;
+   chunk->y = y;
+   chunk->variant = 0;
+
+   if ( terrain->tiles != NULL )
+   {
+      int tile = NodeTile ( terrain, level, x, y, &chunk->texelX, &chunk->texelY );
+
+      chunk->layer = esTileCacheLookup ( terrain->tiles, tile );
+
+      if ( chunk->layer < 0 )
+      {
+         esTileCacheRequest ( terrain->tiles, tile, level );
+         terrain->stats.chunksPending++;
+         return;
+      }
+   }
+
+   terrain->chunkCount++;
+
+   if ( x > 0 && !NodePresent ( terrain, level, x - 1, y ) )
+   {
+      chunk->variant |= EDGE_LEFT;
+   }
+
+   if ( x < side - 1 && !NodePresent ( terrain, level, x + 1, y ) )
+   {
+      chunk->variant |= EDGE_RIGHT;
+   }
+
+   if ( y > 0 && !NodePresent ( terrain, level, x, y - 1 ) )
+   {
+      chunk->variant |= EDGE_BOTTOM;
+   }
+
+   if ( y < side - 1 && !NodePresent ( terrain, level, x, y + 1 ) )
+   {
+      chunk->variant |= EDGE_TOP;
+   }
+
+   terrain->stats.chunksDrawn++;
+   terrain->stats.triangles += terrain->variantCount[chunk->variant] / 3;
+   terrain->stats.maxLevel = level > terrain->stats.maxLevel ? level : terrain->stats.maxLevel;
+}
+
+///
+// CreateDrawData()
+//
+//    Selection arrays, and the vertex and index buffers shared by all chunks
+//
+static GLboolean CreateDrawData ( ESTerrain *terrain )
+{
+   int chunkSize = terrain->chunkSize;
+   GLushort *vertices;
+   GLuint *indices;
+   GLushort *shortIndices;
+   int numIndices;
+   int i, j;
+
+   terrain->split = ( GLubyte * ) calloc ( terrain->nodeCount, 1 );
+   terrain->chunks = ( TerrainChunk * ) malloc ( sizeof ( TerrainChunk ) << ( 2 * terrain->depth ) );
+
+   numIndices = BuildIndices ( terrain, NULL );
+   vertices = ( GLushort * ) malloc ( sizeof ( GLushort ) * 2 * chunkSize * chunkSize );
+   indices = ( GLuint * ) malloc ( sizeof ( GLuint ) * numIndices );
+
+   if ( terrain->split == NULL || terrain->chunks == NULL || vertices == NULL || indices == NULL )
+   {
+      free ( vertices );
+      free ( indices );
+      return GL_FALSE;
+   }
+
+   // Vertices hold their column and row in the chunk, the shader places them
+   for ( j = 0; j < chunkSize; j++ )
+   {
+      for ( i = 0; i < chunkSize; i++ )
+      {
+         vertices[( j * chunkSize + i ) * 2] = ( GLushort ) i;
+         vertices[( j * chunkSize + i ) * 2 + 1] = ( GLushort ) j;
+      }
+   }
+
+   BuildIndices ( terrain, indices );
+
+   // Every chunk draws the same few thousand triangles, order them for the
+   // vertex cache, then narrow to 16 bits in place
+   for ( i = 0; i < TERRAIN_VARIANTS; i++ )
+   {
+      esMeshOptimizeVertexCache ( indices + terrain->variantOffset[i] / sizeof ( GLushort ),
+                                  terrain->variantCount[i], chunkSize * chunkSize );
+   }
+
+   shortIndices = ( GLushort * ) indices;
+
+   for ( i = 0; i < numIndices; i++ )
+   {
+      shortIndices[i] = ( GLushort ) indices[i];
+   }
+
+   glGenBuffers ( 1, &terrain->vertexBuffer );
+   glBindBuffer ( GL_ARRAY_BUFFER, terrain->vertexBuffer );
+   glBufferData ( GL_ARRAY_BUFFER, sizeof ( GLushort ) * 2 * chunkSize * chunkSize, vertices, GL_STATIC_DRAW );
+
+   glGenBuffers ( 1, &terrain->indexBuffer );
+   glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, terrain->indexBuffer );
+   glBufferData ( GL_ELEMENT_ARRAY_BUFFER, sizeof ( GLushort ) * numIndices, shortIndices, GL_STATIC_DRAW );
+   glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+   free ( vertices );
+   free ( indices );
+
+   return GL_TRUE;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esTerrainCreate()
+//
+ESTerrain *ESUTIL_API esTerrainCreate ( ESThreadPool *pool, int size, int chunkSize, GLfloat extent,
+                                        ESHeightFunc heightFunc, void *heightArg )
+{
+   ESTerrain *terrain;
+   int depth = TerrainDepth ( size, chunkSize );
+
+   if ( depth < 0 || heightFunc == NULL )
+   {
+      return NULL;
+   }
+
+   terrain = ( ESTerrain * ) calloc ( 1, sizeof ( ESTerrain ) );
+
+   if ( terrain == NULL )
+   {
+      return NULL;
+   }
+
+   terrain->size = size;
+   terrain->chunkSize = chunkSize;
+   terrain->depth = depth;
+   terrain->extent = extent;
+   terrain->heightFunc = heightFunc;
+   terrain->heightArg = heightArg;
+   terrain->nodeCount = NodeIndex ( depth + 1, 0, 0 );
+
+   if ( !BuildTree ( terrain, pool ) || !CreateDrawData ( terrain ) )
+   {
+      esTerrainDestroy ( terrain );
+      return NULL;
+   }
+
+   return terrain;
+}
+
+///
+// esTerrainWriteTiles()
+//
+GLboolean ESUTIL_API esTerrainWriteTiles ( ESThreadPool *pool, const char *fileName, int size, int chunkSize,
+                                           int tileSize, ESHeightFunc heightFunc, void *heightArg )
+{
+   ESTerrain terrain;
+   TerrainFileHeader *header;
+   TileJob job;
+   size_t nodeBytes;
+   int tileCount;
+   GLboolean ok = GL_FALSE;
+
+   memset ( &terrain, 0, sizeof ( ESTerrain ) );
+   terrain.size = size;
+   terrain.chunkSize = chunkSize;
+   terrain.depth = TerrainDepth ( size, chunkSize );
+   terrain.heightFunc = heightFunc;
+   terrain.heightArg = heightArg;
+   terrain.nodeCount = NodeIndex ( terrain.depth + 1, 0, 0 );
+
+   if ( terrain.depth < 0 || heightFunc == NULL || ( tileCount = TileLayout ( &terrain, tileSize ) ) < 0 )
+   {
+      return GL_FALSE;
+   }
+
+   // The user block is the header and the three node arrays
+   nodeBytes = sizeof ( GLfloat ) * terrain.nodeCount;
+   header = ( TerrainFileHeader * ) malloc ( sizeof ( TerrainFileHeader ) + 3 * nodeBytes );
+
+   if ( header != NULL && BuildTree ( &terrain, pool ) )
+   {
+      header->size = size;
+      header->chunkSize = chunkSize;
+      header->tileSize = tileSize;
+      header->nodeCount = terrain.nodeCount;
+      memcpy ( header + 1, terrain.minHeight, nodeBytes );
+      memcpy ( ( char * ) ( header + 1 ) + nodeBytes, terrain.maxHeight, nodeBytes );
+      memcpy ( ( char * ) ( header + 1 ) + 2 * nodeBytes, terrain.error, nodeBytes );
+
+      job.terrain = &terrain;
+      job.pool = pool;
+      ok = esTileFileWrite ( fileName, tileSize + 2 * TILE_BORDER, tileSize + 2 * TILE_BORDER, tileCount,
+                             GL_R16F, GL_RED, GL_HALF_FLOAT, header, sizeof ( TerrainFileHeader ) + 3 * nodeBytes,
+                             WriteTile, &job );
+   }
+
+   free ( terrain.minHeight );
+   free ( terrain.maxHeight );
+   free ( terrain.error );
+   free ( header );
+
+   return ok;
+}
+
+///
+// esTerrainOpenTiles()
+//
+ESTerrain *ESUTIL_API esTerrainOpenTiles ( void *ioContext, const char *fileName, GLfloat extent, int cacheTiles )
+{
+   ESTerrain *terrain;
+   const TerrainFileHeader *header;
+   GLsizeiptr userSize;
+
+   terrain = ( ESTerrain * ) calloc ( 1, sizeof ( ESTerrain ) );
+
+   if ( terrain == NULL )
+   {
+      return NULL;
+   }
+
+   terrain->tiles = esTileCacheCreate ( ioContext, fileName, cacheTiles > MIN_CACHE_TILES ? cacheTiles : MIN_CACHE_TILES );
+
+   if ( terrain->tiles == NULL )
+   {
+      free ( terrain );
+      return NULL;
+   }
+
+   header = ( const TerrainFileHeader * ) esTileCacheGetUserData ( terrain->tiles, &userSize );
+
+   if ( userSize >= ( GLsizeiptr ) sizeof ( TerrainFileHeader ) )
+   {
+      terrain->size = header->size;
+      terrain->chunkSize = header->chunkSize;
+      terrain->depth = TerrainDepth ( terrain->size, terrain->chunkSize );
+      terrain->extent = extent;
+      terrain->nodeCount = terrain->depth < 0 ? 0 : NodeIndex ( terrain->depth + 1, 0, 0 );
+   }
+
+   if ( terrain->depth < 0 || terrain->nodeCount == 0 || header->nodeCount != ( GLuint ) terrain->nodeCount ||
+        userSize != ( GLsizeiptr ) ( sizeof ( TerrainFileHeader ) + 3 * sizeof ( GLfloat ) * terrain->nodeCount ) ||
+        TileLayout ( terrain, header->tileSize ) != esTileCacheGetStats ( terrain->tiles )->tileCount )
+   {
+      esLogMessage ( "esTerrainOpenTiles: %s is not a terrain tile file\n", fileName );
+      esTerrainDestroy ( terrain );
+      return NULL;
+   }
+
+   // Node data is read in place from the mapping, paged in as selection visits it
+   terrain->minHeight = ( GLfloat * ) ( header + 1 );
+   terrain->maxHeight = terrain->minHeight + terrain->nodeCount;
+   terrain->error = terrain->maxHeight + terrain->nodeCount;
+
+   if ( !CreateDrawData ( terrain ) )
+   {
+      esTerrainDestroy ( terrain );
+      return NULL;
+   }
+
+   // Every selection starts from the root, have its tile in before the first
+   esTileCacheRequest ( terrain->tiles, NodeTile ( terrain, 0, 0, 0, NULL, NULL ), 0 );
+   esTileCacheFinish ( terrain->tiles );
+
+   return terrain;
+}
+
+///
+// esTerrainDestroy()
+//
+void ESUTIL_API esTerrainDestroy ( ESTerrain *terrain )
+{
+   if ( terrain == NULL )
+   {
+      return;
+   }
+
+   glDeleteBuffers ( 1, &terrain->vertexBuffer );
+   glDeleteBuffers ( 1, &terrain->indexBuffer );
+
+   // A streamed terrain's node data belongs to the tile file mapping
+   if ( terrain->tiles == NULL )
+   {
+      free ( terrain->minHeight );
+      free ( terrain->maxHeight );
+      free ( terrain->error );
+   }
+
+   esTileCacheDestroy ( terrain->tiles );
+   free ( terrain->split );
+   free ( terrain->chunks );
+   free ( terrain );
+}
+
+///
+// esTerrainSelect()
+//
+void ESUTIL_API esTerrainSelect ( ESTerrain *terrain, const ESMatrix *modelview, const ESMatrix *projection,
+                                  int viewportHeight, GLfloat pixelError )
+{
+   ESMatrix mvp;
+   int k;
+
+   esMatrixMultiply ( &mvp, ( ESMatrix * ) modelview, ( ESMatrix * ) projection );
+   esExtractFrustumPlanes ( &terrain->frustum, &mvp );
+
+   // Eye position, from the inverse of a modelview without scaling
+   for ( k = 0; k < 3; k++ )
+   {
+      terrain->eye[k] = - ( modelview->m[k][0] * modelview->m[3][0] +
+                            modelview->m[k][1] * modelview->m[3][1] +
+                            modelview->m[k][2] * modelview->m[3][2] );
+   }
+
+   // Pixels covered by one unit at unit distance from the eye
+   terrain->pixelScale = viewportHeight * 0.5f * projection->m[1][1];
+   terrain->pixelError = pixelError;
+
+   memset ( terrain->split, 0, terrain->nodeCount );
+   memset ( &terrain->stats, 0, sizeof ( ESTerrainStats ) );
+   terrain->chunkCount = 0;
+
+   Refine ( terrain, 0, 0, 0 );
+   Balance ( terrain );
+   Collect ( terrain, 0, 0, 0 );
+
+   // Upload the tiles that have arrived and queue this selection's requests
+   if ( terrain->tiles != NULL )
+   {
+      esTileCacheUpdate ( terrain->tiles );
+   }
+}
+
+///
+// esTerrainDraw()
+//
+void ESUTIL_API esTerrainDraw ( ESTerrain *terrain, GLuint positionLoc, GLint chunkLoc, GLint tileLoc )
+{
+   int quads = terrain->chunkSize - 1;
+   int i;
+
+   glBindBuffer ( GL_ARRAY_BUFFER, terrain->vertexBuffer );
+   glVertexAttribPointer ( positionLoc, 2, GL_UNSIGNED_SHORT, GL_FALSE, 2 * sizeof ( GLushort ), ( const void * ) NULL );
+   glEnableVertexAttribArray ( positionLoc );
+   glBindBuffer ( GL_ELEMENT_ARRAY_BUFFER, terrain->indexBuffer );
+
+   if ( terrain->tiles != NULL )
+   {
+      glBindTexture ( GL_TEXTURE_2D_ARRAY, esTileCacheGetTexture ( terrain->tiles ) );
+   }
+
+   for ( i = 0; i < terrain->chunkCount; i++ )
+   {
+      const TerrainChunk *chunk = &terrain->chunks[i];
+      int spacing = NodeSpacing ( terrain, chunk->level );
+
+      // Whole sample numbers, exact in floats, so chunks sharing an edge
+      // compute the same coordinates for it
+      glUniform4f ( chunkLoc, ( GLfloat ) ( chunk->x * quads * spacing ), ( GLfloat ) ( chunk->y * quads * spacing ),
+                    ( GLfloat ) spacing, 1.0f / ( terrain->size - 1 ) );
+
+      if ( terrain->tiles != NULL )
+      {
+         glUniform4f ( tileLoc, ( GLfloat ) chunk->texelX, ( GLfloat ) chunk->texelY, ( GLfloat ) chunk->layer, 0.0f );
+      }
+
+      glDrawElements ( GL_TRIANGLES, terrain->variantCount[chunk->variant], GL_UNSIGNED_SHORT,
+                       ( const void * ) ( size_t ) terrain->variantOffset[chunk->variant] );
+   }
+}
+
+///
+// esTerrainGetStats()
+//
+const ESTerrainStats *ESUTIL_API esTerrainGetStats ( ESTerrain *terrain )
+{
+   return &terrain->stats;
+}
+
+///
+// esTerrainGetTileCache()
+//
+ESTileCache *ESUTIL_API esTerrainGetTileCache ( ESTerrain *terrain )
+{
+   return terrain->tiles;
+}
@@ -0,0 +1,154 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esThread.h
+//
+//    Private, minimal thread/mutex/condition variable wrappers used by the
+//    Common library.  Maps onto Win32 primitives on Windows and pthreads
+//    everywhere else.
+//
+#ifndef ESTHREAD_H
+#define ESTHREAD_H
+
+///
+//  Includes
+//
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef _MSC_VER
+#define ES_THREAD_INLINE __inline
+#else
+#define ES_THREAD_INLINE inline
+#endif
+
+///
+//  Types
+//
+typedef void ( *ESThreadFunc ) ( void *arg );
+
+typedef struct
+{
+#ifdef _WIN32
+   HANDLE       handle;
+#else
+   pthread_t    handle;
+#endif
+   ESThreadFunc func;
+   void        *arg;
+} ESThread;
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION   ESMutex;
+typedef CONDITION_VARIABLE ESCond;
+#else
+typedef pthread_mutex_t    ESMutex;
+typedef pthread_cond_t     ESCond;
+#endif
+
+///
+//  Functions
+//
+#ifdef _WIN32
+
+static ES_THREAD_INLINE DWORD WINAPI esThreadEntry ( LPVOID param )
+{
+   ESThread *thread = ( ESThread * ) param;
+   thread->func ( thread->arg );
+   return 0;
+}
+
+/// The ESThread must stay at the same address until esThreadJoin() returns
+static ES_THREAD_INLINE int esThreadCreate ( ESThread *thread, ESThreadFunc func, void *arg )
+{
+   thread->func = func;
+   thread->arg = arg;
+   thread->handle = CreateThread ( NULL, 0, esThreadEntry, thread, 0, NULL );
+   return thread->handle != NULL;
+}
+
+static ES_THREAD_INLINE void esThreadJoin ( ESThread *thread )
+{
+   WaitForSingleObject ( thread->handle, INFINITE );
+   CloseHandle ( thread->handle );
+}
+
+static ES_THREAD_INLINE void esMutexInit ( ESMutex *mutex )       { InitializeCriticalSection ( mutex ); }
+static ES_THREAD_INLINE void esMutexDestroy ( ESMutex *mutex )    { DeleteCriticalSection ( mutex ); }
+static ES_THREAD_INLINE void esMutexLock ( ESMutex *mutex )       { EnterCriticalSection ( mutex ); }
+static ES_THREAD_INLINE void esMutexUnlock ( ESMutex *mutex )     { LeaveCriticalSection ( mutex ); }
+
+static ES_THREAD_INLINE void esCondInit ( ESCond *cond )          { InitializeConditionVariable ( cond ); }
+static ES_THREAD_INLINE void esCondDestroy ( ESCond *cond )       { ( void ) cond; }
+static ES_THREAD_INLINE void esCondWait ( ESCond *cond, ESMutex *mutex ) { SleepConditionVariableCS ( cond, mutex, INFINITE ); }
+static ES_THREAD_INLINE void esCondSignal ( ESCond *cond )        { WakeConditionVariable ( cond ); }
+static ES_THREAD_INLINE void esCondBroadcast ( ESCond *cond )     { WakeAllConditionVariable ( cond ); }
+
+#else
+
+static ES_THREAD_INLINE void *esThreadEntry ( void *param )
+{
+   ESThread *thread = ( ESThread * ) param;
+   thread->func ( thread->arg );
+   return NULL;
+}
+
+/// The ESThread must stay at the same address until esThreadJoin() returns
+static ES_THREAD_INLINE int esThreadCreate ( ESThread *thread, ESThreadFunc func, void *arg )
+{
+   thread->func = func;
+   thread->arg = arg;
+   return pthread_create ( &thread->handle, NULL, esThreadEntry, thread ) == 0;
+}
+
+static ES_THREAD_INLINE void esThreadJoin ( ESThread *thread )
+{
+   pthread_join ( thread->handle, NULL );
+}
+
+static ES_THREAD_INLINE void esMutexInit ( ESMutex *mutex )       { pthread_mutex_init ( mutex, NULL ); }
+static ES_THREAD_INLINE void esMutexDestroy ( ESMutex *mutex )    { pthread_mutex_destroy ( mutex ); }
+static ES_THREAD_INLINE void esMutexLock ( ESMutex *mutex )       { pthread_mutex_lock ( mutex ); }
+static ES_THREAD_INLINE void esMutexUnlock ( ESMutex *mutex )     { pthread_mutex_unlock ( mutex ); }
+
+static ES_THREAD_INLINE void esCondInit ( ESCond *cond )          { pthread_cond_init ( cond, NULL ); }
+static ES_THREAD_INLINE void esCondDestroy ( ESCond *cond )       { pthread_cond_destroy ( cond ); }
+static ES_THREAD_INLINE void esCondWait ( ESCond *cond, ESMutex *mutex ) { pthread_cond_wait ( cond, mutex ); }
+static ES_THREAD_INLINE void esCondSignal ( ESCond *cond )        { pthread_cond_signal ( cond ); }
+static ES_THREAD_INLINE void esCondBroadcast ( ESCond *cond )     { pthread_cond_broadcast ( cond ); }
+
+#endif
+
+#endif // ESTHREAD_H
@@ -0,0 +1,524 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esThreadPool.c
+//
+//    A fixed size pool of worker threads running queued tasks
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include "esThread.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__)
+#include <mach/mach_time.h>
+#endif
+
+#ifndef _WIN32
+#include <time.h>
+#include <unistd.h>
+#endif
+
+///
+//  Types
+//
+typedef struct ESThreadPoolTask
+{
+   ESTaskFunc  func;
+   void       *arg;
+   struct ESThreadPoolTask *next;
+} ESThreadPoolTask;
+
+struct ESThreadPool
+{
+   ESThread   *threads;
+   int         threadCount;
+
+   ESMutex     mutex;
+
+   // Signalled when a task is queued or the pool shuts down
+   ESCond      taskCond;
+
+   // Signalled when the queue drains and no task is running
+   ESCond      idleCond;
+
+   // Queued tasks, oldest first, and recycled task records
+   ESThreadPoolTask *head;
+   ESThreadPoolTask *tail;
+   ESThreadPoolTask *freeList;
+
+   // Number of tasks currently running
+   int         active;
+   int         shutdown;
+};
+
+// One esParallelFor call, shared by the caller and its helper tasks
+typedef struct
+{
+   ESRangeFunc func;
+   void       *arg;
+   int         count;
+   int         chunkSize;
+   int         chunkCount;
+
+   ESMutex     mutex;
+   ESCond      doneCond;
+
+   // Next chunk to hand out, chunks finished and helpers still running
+   int         nextChunk;
+   int         finishedChunks;
+   int         helpers;
+} ParallelForJob;
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// GetProcessorCount()
+//
+static int GetProcessorCount ( void )
+{
+#ifdef _WIN32
+   SYSTEM_INFO info;
+
+   GetSystemInfo ( &info );
+   return ( int ) info.dwNumberOfProcessors;
+#else
+   long count = sysconf ( _SC_NPROCESSORS_ONLN );
+
+   return count > 0 ? ( int ) count : 1;
+#endif
+}
+
+///
+// WorkerMain()
+//
+static void WorkerMain ( void *arg )
+{
+   ESThreadPool *pool = ( ESThreadPool * ) arg;
+
+   esMutexLock ( &pool->mutex );
+
+   for ( ;; )
+   {
+      ESThreadPoolTask *task;
+      ESTaskFunc func;
+      void *taskArg;
+
+      while ( pool->head == NULL && !pool->shutdown )
+      {
+         esCondWait ( &pool->taskCond, &pool->mutex );
+      }
+
+      if ( pool->head == NULL )
+      {
+         // Shutting down and nothing left to run
+         break;
+      }
+
+      task = pool->head;
+      pool->head = task->next;
+
+      if ( pool->head == NULL )
+      {
+         pool->tail = NULL;
+      }
+
+      func = task->func;
+      taskArg = task->arg;
+      task->next = pool->freeList;
+      pool->freeList = task;
+      pool->active++;
+
+      esMutexUnlock ( &pool->mutex );
+      func ( taskArg );
+      esMutexLock ( &pool->mutex );
+
+      pool->active--;
+
+      if ( pool->head == NULL && pool->active == 0 )
+      {
+         esCondBroadcast ( &pool->idleCond );
+      }
+   }
+
+   esMutexUnlock ( &pool->mutex );
+}
+
+///
+// RunChunks()
+//
+//    Take chunks of a parallel-for until there are none left
+//
+static void RunChunks ( ParallelForJob *job )
+{
+   int finished = 0;
+
+   for ( ;; )
+   {
+      int chunk;
+      int begin;
+      int end;
+
+      esMutexLock ( &job->mutex );
+      job->finishedChunks += finished;
+
+      if ( job->finishedChunks == job->chunkCount )
+      {
+         esCondBroadcast ( &job->doneCond );
+      }
+
+      chunk = job->nextChunk < job->chunkCount ? job->nextChunk++ : -1;
+      esMutexUnlock ( &job->mutex );
+
+      if ( chunk < 0 )
+      {
+         return;
+      }
+
+      begin = chunk * job->chunkSize;
+      end = begin + job->chunkSize < job->count ? begin + job->chunkSize : job->count;
+
+      job->func ( job->arg, begin, end );
+      finished = 1;
+   }
+}
+
+///
+// ParallelForHelper()
+//
+static void ParallelForHelper ( void *arg )
+{
+   ParallelForJob *job = ( ParallelForJob * ) arg;
+
+   RunChunks ( job );
+
+   esMutexLock ( &job->mutex );
+   job->helpers--;
+   esCondBroadcast ( &job->doneCond );
+   esMutexUnlock ( &job->mutex );
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esGetTimeNs()
+//
+//    Monotonic clock in nanoseconds.  It lives with the thread pool rather
+//    than in esUtil.c so programs without a window can link it.
+//
+GLuint64 ESUTIL_API esGetTimeNs ( void )
+{
+#if defined(__APPLE__)
+   static mach_timebase_info_data_t timebase;
+
+   if ( timebase.denom == 0 )
+   {
+      mach_timebase_info ( &timebase );
+   }
+
+   return ( GLuint64 ) mach_absolute_time() * timebase.numer / timebase.denom;
+#elif defined(_WIN32)
+   static LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+
+   if ( frequency.QuadPart == 0 )
+   {
+      QueryPerformanceFrequency ( &frequency );
+   }
+
+   QueryPerformanceCounter ( &counter );
+
+   // Split to avoid overflowing 64 bits after a few hours of uptime
+   return ( GLuint64 ) ( counter.QuadPart / frequency.QuadPart ) * 1000000000ULL +
+          ( GLuint64 ) ( counter.QuadPart % frequency.QuadPart ) * 1000000000ULL / frequency.QuadPart;
+#else
+   struct timespec ts;
+
+   clock_gettime ( CLOCK_MONOTONIC, &ts );
+   return ( GLuint64 ) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+///
+// esThreadPoolCreate()
+//
+//    Create a pool with threadCount workers, or one per processor if
+//    threadCount is 0
+//
+ESThreadPool *ESUTIL_API esThreadPoolCreate ( int threadCount )
+{
+   ESThreadPool *pool;
+   int i;
+
+   if ( threadCount <= 0 )
+   {
+      threadCount = GetProcessorCount ( );
+   }
+
+   pool = ( ESThreadPool * ) calloc ( 1, sizeof ( ESThreadPool ) );
+
+   if ( pool == NULL )
+   {
+      return NULL;
+   }
+
+   pool->threads = ( ESThread * ) calloc ( threadCount, sizeof ( ESThread ) );
+
+   if ( pool->threads == NULL )
+   {
+      free ( pool );
+      return NULL;
+   }
+
+   esMutexInit ( &pool->mutex );
+   esCondInit ( &pool->taskCond );
+   esCondInit ( &pool->idleCond );
+
+   for ( i = 0; i < threadCount; i++ )
+   {
+      if ( !esThreadCreate ( &pool->threads[i], WorkerMain, pool ) )
+      {
+         break;
+      }
+
+      pool->threadCount++;
+   }
+
+   if ( pool->threadCount == 0 )
+   {
+      esThreadPoolDestroy ( pool );
+      return NULL;
+   }
+
+   return pool;
+}
+
+///
+// esThreadPoolDestroy()
+//
+//    Run the remaining queued tasks, then stop and free the workers
+//
+void ESUTIL_API esThreadPoolDestroy ( ESThreadPool *pool )
+{
+   ESThreadPoolTask *task;
+   int i;
+
+   if ( pool == NULL )
+   {
+      return;
+   }
+
+   esMutexLock ( &pool->mutex );
+   pool->shutdown = 1;
+   esCondBroadcast ( &pool->taskCond );
+   esMutexUnlock ( &pool->mutex );
+
+   for ( i = 0; i < pool->threadCount; i++ )
+   {
+      esThreadJoin ( &pool->threads[i] );
+   }
+
+   while ( pool->freeList != NULL )
+   {
+      task = pool->freeList;
+      pool->freeList = task->next;
+      free ( task );
+   }
+
+   esCondDestroy ( &pool->idleCond );
+   esCondDestroy ( &pool->taskCond );
+   esMutexDestroy ( &pool->mutex );
+
+   free ( pool->threads );
+   free ( pool );
+}
+
+///
+// esThreadPoolSize()
+//
+int ESUTIL_API esThreadPoolSize ( ESThreadPool *pool )
+{
+   return pool != NULL ? pool->threadCount : 0;
+}
+
+///
+// esThreadPoolSubmit()
+//
+//    Queue func ( arg ) to run on one of the workers
+//
+GLboolean ESUTIL_API esThreadPoolSubmit ( ESThreadPool *pool, ESTaskFunc func, void *arg )
+{
+   ESThreadPoolTask *task;
+
+   esMutexLock ( &pool->mutex );
+
+   task = pool->freeList;
+
+   if ( task != NULL )
+   {
+      pool->freeList = task->next;
+   }
+   else
+   {
+      task = ( ESThreadPoolTask * ) malloc ( sizeof ( ESThreadPoolTask ) );
+
+      if ( task == NULL )
+      {
+         esMutexUnlock ( &pool->mutex );
+         return GL_FALSE;
+      }
+   }
+
+   task->func = func;
+   task->arg = arg;
+   task->next = NULL;
+
+   if ( pool->tail != NULL )
+   {
+      pool->tail->next = task;
+   }
+   else
+   {
+      pool->head = task;
+   }
+
+   pool->tail = task;
+
+   esCondSignal ( &pool->taskCond );
+   esMutexUnlock ( &pool->mutex );
+
+   return GL_TRUE;
+}
+
+///
+// esThreadPoolWait()
+//
+//    Block until every queued task has finished running
+//
+void ESUTIL_API esThreadPoolWait ( ESThreadPool *pool )
+{
+   esMutexLock ( &pool->mutex );
+
+   while ( pool->head != NULL || pool->active > 0 )
+   {
+      esCondWait ( &pool->idleCond, &pool->mutex );
+   }
+
+   esMutexUnlock ( &pool->mutex );
+}
+
+///
+// esParallelFor()
+//
+//    Split [0, count) into chunks and run them on the pool, with the
+//    calling thread taking chunks too.  Returns once every chunk is done.
+//
+void ESUTIL_API esParallelFor ( ESThreadPool *pool, int count, ESRangeFunc func, void *arg )
+{
+   ParallelForJob job;
+   int helpers;
+   int i;
+
+   if ( count <= 0 )
+   {
+      return;
+   }
+
+   if ( pool == NULL || pool->threadCount == 0 || count == 1 )
+   {
+      func ( arg, 0, count );
+      return;
+   }
+
+   // A few chunks per thread evens out uneven work without much overhead
+   job.func = func;
+   job.arg = arg;
+   job.count = count;
+   job.chunkCount = ( pool->threadCount + 1 ) * 4;
+
+   if ( job.chunkCount > count )
+   {
+      job.chunkCount = count;
+   }
+
+   job.chunkSize = ( count + job.chunkCount - 1 ) / job.chunkCount;
+   job.chunkCount = ( count + job.chunkSize - 1 ) / job.chunkSize;
+   job.nextChunk = 0;
+   job.finishedChunks = 0;
+   job.helpers = 0;
+
+   esMutexInit ( &job.mutex );
+   esCondInit ( &job.doneCond );
+
+   helpers = job.chunkCount - 1 < pool->threadCount ? job.chunkCount - 1 : pool->threadCount;
+
+   for ( i = 0; i < helpers; i++ )
+   {
+      esMutexLock ( &job.mutex );
+      job.helpers++;
+      esMutexUnlock ( &job.mutex );
+
+      if ( !esThreadPoolSubmit ( pool, ParallelForHelper, &job ) )
+      {
+         esMutexLock ( &job.mutex );
+         job.helpers--;
+         esMutexUnlock ( &job.mutex );
+         break;
+      }
+   }
+
+   RunChunks ( &job );
+
+   // The helpers reference job, so wait for them to let go of it as well
+   esMutexLock ( &job.mutex );
+
+   while ( job.finishedChunks < job.chunkCount || job.helpers > 0 )
+   {
+      esCondWait ( &job.doneCond, &job.mutex );
+   }
+
+   esMutexUnlock ( &job.mutex );
+
+   esCondDestroy ( &job.doneCond );
+   esMutexDestroy ( &job.mutex );
+}
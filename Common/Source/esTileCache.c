@@ -0,0 +1,849 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2013 Dan Ginsburg, Budirijanto Purnomo
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+//
+// Book:      OpenGL(R) ES 3.0 Programming Guide, 2nd Edition
+// Authors:   Dan Ginsburg, Budirijanto Purnomo, Dave Shreiner, Aaftab Munshi
+// ISBN-10:   0-321-93388-5
+// ISBN-13:   978-0-321-93388-1
+// Publisher: Addison-Wesley Professional
+// URLs:      http://www.opengles-book.com
+//            http://my.safaribooksonline.com/book/animation-and-3d/9780133440133
+//
+// esTileCache.c
+//
+//    Streams tiles of a file too large to load into a fixed number of
+//    layers of a 2D array texture.  The file is memory mapped; a loader
+//    thread copies requested tiles out of the mapping, so page faults on
+//    data that is not in memory yet never stall the GL thread, which only
+//    uploads finished tiles with glTexSubImage3D.  When every layer is in
+//    use the least recently used tile is evicted, so GPU memory stays the
+//    same however large the file is.
+//
+
+///
+//  Includes
+//
+#include "esUtil.h"
+#include "esFile.h"
+#include "esThread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+///
+//  Macros
+//
+#define TILE_FILE_MAGIC       0x46545345 // "ESTF"
+#define TILE_FILE_VERSION     1
+
+// Tiles start on a page boundary so each maps to whole pages
+#define TILE_ALIGNMENT        4096
+
+// Tiles the loader can have copied but not yet uploaded
+#define STAGING_BUFFER_COUNT  8
+
+///
+//  Types
+//
+
+// File header, followed by the user block and then the tiles, all in the
+// byte order of the machine that wrote them
+typedef struct
+{
+   GLuint         magic;
+   GLuint         version;
+   GLuint         tileWidth;
+   GLuint         tileHeight;
+   GLuint         tileCount;
+   GLuint         internalFormat;
+   GLuint         format;
+   GLuint         type;
+   GLuint         tileBytes;
+   GLuint         tileStride;
+   GLuint         userOffset;
+   GLuint         userSize;
+   GLuint         tileOffset;
+} TileFileHeader;
+
+// Where a tile is on its way from the file to the texture
+enum
+{
+   TILE_ABSENT,
+   TILE_QUEUED,
+   TILE_LOADING,
+   TILE_LOADED,
+   TILE_RESIDENT
+};
+
+typedef struct
+{
+   int            tile;
+   int            priority;
+} TileRequest;
+
+typedef struct StagingTile
+{
+   int            tile;
+   void          *pixels;
+   struct StagingTile *next;
+} StagingTile;
+
+struct ESTileCache
+{
+   // Mapping of the whole file
+   ESImage        file;
+   const unsigned char *tiles;
+   const void    *userData;
+   GLsizeiptr     userSize;
+
+   int            tileCount;
+   int            tileWidth;
+   int            tileHeight;
+   GLenum         format;
+   GLenum         type;
+   size_t         tileBytes;
+   size_t         tileStride;
+
+   // Array texture, one tile per layer
+   GLuint         texture;
+   int            slotCount;
+   int           *slotTile;
+   GLuint        *slotFrame;
+
+   // Layer of each tile or -1, and the frame it was last requested in, GL thread only
+   int           *tileSlot;
+   GLuint        *tileRequestFrame;
+   GLuint         frame;
+
+   // Requests made since the last update, GL thread only
+   TileRequest   *requests;
+   int            requestCount;
+
+   ESThread       thread;
+   ESMutex        mutex;
+   ESCond         wake;
+   ESCond         done;
+
+   // Everything below is guarded by mutex
+   GLubyte       *tileState;
+
+   // Tiles for the loader, most urgent first, it takes them from queueNext
+   TileRequest   *queue;
+   int            queueCount;
+   int            queueNext;
+
+   // Tiles being copied by the loader
+   int            loading;
+
+   StagingTile    staging[STAGING_BUFFER_COUNT];
+   StagingTile   *freeStaging;
+   StagingTile   *loadedHead;
+   StagingTile   *loadedTail;
+
+   GLboolean      quit;
+   GLboolean      running;
+
+   ESTileCacheStats stats;
+};
+
+//////////////////////////////////////////////////////////////////
+//
+//  Private Functions
+//
+//
+
+///
+// PixelSize()
+//
+//    Bytes per pixel of a format and type, 0 if not supported
+//
+static int PixelSize ( GLenum format, GLenum type )
+{
+   int components;
+   int size;
+
+   switch ( format )
+   {
+      case GL_RED:
+      case GL_RED_INTEGER:
+      case GL_ALPHA:
+      case GL_LUMINANCE:
+         components = 1;
+         break;
+
+      case GL_RG:
+      case GL_RG_INTEGER:
+      case GL_LUMINANCE_ALPHA:
+         components = 2;
+         break;
+
+      case GL_RGB:
+      case GL_RGB_INTEGER:
+         components = 3;
+         break;
+
+      case GL_RGBA:
+      case GL_RGBA_INTEGER:
+         components = 4;
+         break;
+
+      default:
+         return 0;
+   }
+
+   switch ( type )
+   {
+      case GL_UNSIGNED_BYTE:
+      case GL_BYTE:
+         size = 1;
+         break;
+
+      case GL_HALF_FLOAT:
+      case GL_UNSIGNED_SHORT:
+      case GL_SHORT:
+         size = 2;
+         break;
+
+      case GL_FLOAT:
+      case GL_UNSIGNED_INT:
+      case GL_INT:
+         size = 4;
+         break;
+
+      default:
+         return 0;
+   }
+
+   return components * size;
+}
+
+///
+// AlignUp()
+//
+static size_t AlignUp ( size_t value, size_t alignment )
+{
+   return ( value + alignment - 1 ) / alignment * alignment;
+}
+
+///
+// LoaderMain()
+//
+//    Loader thread: copy queued tiles out of the mapping into free staging
+//    buffers, touching the file pages here rather than on the GL thread
+//
+static void LoaderMain ( void *arg )
+{
+   ESTileCache *cache = ( ESTileCache * ) arg;
+
+   esMutexLock ( &cache->mutex );
+
+   while ( !cache->quit )
+   {
+      StagingTile *staging = cache->freeStaging;
+      int tile;
+
+      if ( cache->queueNext == cache->queueCount || staging == NULL )
+      {
+         esCondBroadcast ( &cache->done );
+         esCondWait ( &cache->wake, &cache->mutex );
+         continue;
+      }
+
+      tile = cache->queue[cache->queueNext++].tile;
+      cache->freeStaging = staging->next;
+      cache->tileState[tile] = TILE_LOADING;
+      cache->loading++;
+      esMutexUnlock ( &cache->mutex );
+
+      memcpy ( staging->pixels, cache->tiles + cache->tileStride * tile, cache->tileBytes );
+      staging->tile = tile;
+      staging->next = NULL;
+
+      esMutexLock ( &cache->mutex );
+
+      if ( cache->loadedTail != NULL )
+      {
+         cache->loadedTail->next = staging;
+      }
+      else
+      {
+         cache->loadedHead = staging;
+      }
+
+      cache->loadedTail = staging;
+      cache->tileState[tile] = TILE_LOADED;
+      cache->loading--;
+      esCondBroadcast ( &cache->done );
+   }
+
+   esMutexUnlock ( &cache->mutex );
+}
+
+///
+// FindSlot()
+//
+//    A free layer, or the least recently used one not touched this frame.
+//    Returns -1 if every layer is in use.
+//
+static int FindSlot ( ESTileCache *cache )
+{
+   int best = -1;
+   int i;
+
+   for ( i = 0; i < cache->slotCount; i++ )
+   {
+      if ( cache->slotTile[i] < 0 )
+      {
+         return i;
+      }
+
+      if ( cache->slotFrame[i] != cache->frame &&
+           ( best < 0 || cache->slotFrame[i] < cache->slotFrame[best] ) )
+      {
+         best = i;
+      }
+   }
+
+   return best;
+}
+
+///
+// UploadLoaded()
+//
+//    Upload the tiles the loader has finished, evicting old ones as needed,
+//    and hand their staging buffers back.  Returns the number uploaded.
+//
+static int UploadLoaded ( ESTileCache *cache )
+{
+   StagingTile *loaded;
+   StagingTile *staging;
+   StagingTile *next;
+   GLint unpackBuffer;
+   GLint unpackAlignment;
+   GLint textureArray;
+   int uploaded = 0;
+
+   esMutexLock ( &cache->mutex );
+   loaded = cache->loadedHead;
+   cache->loadedHead = NULL;
+   cache->loadedTail = NULL;
+   esMutexUnlock ( &cache->mutex );
+
+   if ( loaded == NULL )
+   {
+      return 0;
+   }
+
+   glGetIntegerv ( GL_PIXEL_UNPACK_BUFFER_BINDING, &unpackBuffer );
+   glGetIntegerv ( GL_UNPACK_ALIGNMENT, &unpackAlignment );
+   glGetIntegerv ( GL_TEXTURE_BINDING_2D_ARRAY, &textureArray );
+
+   // Tiles are tightly packed and read from client memory
+   glBindBuffer ( GL_PIXEL_UNPACK_BUFFER, 0 );
+   glPixelStorei ( GL_UNPACK_ALIGNMENT, 1 );
+   glBindTexture ( GL_TEXTURE_2D_ARRAY, cache->texture );
+
+   for ( staging = loaded; staging != NULL; staging = staging->next )
+   {
+      int tile = staging->tile;
+      int slot = cache->tileSlot[tile];
+
+      if ( slot < 0 )
+      {
+         slot = FindSlot ( cache );
+
+         if ( slot >= 0 )
+         {
+            if ( cache->slotTile[slot] >= 0 )
+            {
+               int evicted = cache->slotTile[slot];
+
+               // Back to the file, so the tile is queued again when next requested
+               esMutexLock ( &cache->mutex );
+               cache->tileState[evicted] = TILE_ABSENT;
+               esMutexUnlock ( &cache->mutex );
+
+               cache->tileSlot[evicted] = -1;
+               cache->stats.tilesEvicted++;
+            }
+            else
+            {
+               cache->stats.residentTiles++;
+            }
+
+            glTexSubImage3D ( GL_TEXTURE_2D_ARRAY, 0, 0, 0, slot, cache->tileWidth, cache->tileHeight, 1,
+                              cache->format, cache->type, staging->pixels );
+
+            cache->tileSlot[tile] = slot;
+            cache->slotTile[slot] = tile;
+            cache->slotFrame[slot] = cache->frame;
+            cache->stats.tilesLoaded++;
+            cache->stats.bytesUploaded += cache->tileBytes;
+            uploaded++;
+         }
+      }
+   }
+
+   glBindTexture ( GL_TEXTURE_2D_ARRAY, ( GLuint ) textureArray );
+   glPixelStorei ( GL_UNPACK_ALIGNMENT, unpackAlignment );
+   glBindBuffer ( GL_PIXEL_UNPACK_BUFFER, ( GLuint ) unpackBuffer );
+
+   esMutexLock ( &cache->mutex );
+
+   for ( staging = loaded; staging != NULL; staging = next )
+   {
+      int tile = staging->tile;
+
+      next = staging->next;
+
+      // Tiles that found no free layer go back to the file
+      cache->tileState[tile] = cache->tileSlot[tile] >= 0 ? TILE_RESIDENT : TILE_ABSENT;
+      staging->next = cache->freeStaging;
+      cache->freeStaging = staging;
+   }
+
+   esCondSignal ( &cache->wake );
+   esMutexUnlock ( &cache->mutex );
+
+   return uploaded;
+}
+
+///
+// CompareRequests()
+//
+//    qsort order: lowest priority value first, then by tile
+//
+static int CompareRequests ( const void *a, const void *b )
+{
+   const TileRequest *ra = ( const TileRequest * ) a;
+   const TileRequest *rb = ( const TileRequest * ) b;
+
+   if ( ra->priority != rb->priority )
+   {
+      return ra->priority < rb->priority ? -1 : 1;
+   }
+
+   return ra->tile - rb->tile;
+}
+
+///
+// SubmitRequests()
+//
+//    Replace the loader's queue with the requests made since the last call.
+//    Queued tiles nobody asked for again are dropped, and no more tiles are
+//    queued than there are layers that could take them.
+//
+static void SubmitRequests ( ESTileCache *cache )
+{
+   int room = 0;
+   int i;
+
+   for ( i = 0; i < cache->slotCount; i++ )
+   {
+      room += cache->slotTile[i] < 0 || cache->slotFrame[i] != cache->frame;
+   }
+
+   qsort ( cache->requests, cache->requestCount, sizeof ( TileRequest ), CompareRequests );
+
+   esMutexLock ( &cache->mutex );
+
+   for ( i = cache->queueNext; i < cache->queueCount; i++ )
+   {
+      cache->tileState[cache->queue[i].tile] = TILE_ABSENT;
+   }
+
+   cache->queueCount = 0;
+   cache->queueNext = 0;
+
+   // Tiles on their way already take up room too
+   room -= cache->loading;
+
+   for ( i = 0; i < cache->requestCount && cache->queueCount < room; i++ )
+   {
+      int tile = cache->requests[i].tile;
+
+      if ( cache->tileState[tile] == TILE_ABSENT )
+      {
+         cache->tileState[tile] = TILE_QUEUED;
+         cache->queue[cache->queueCount++] = cache->requests[i];
+      }
+   }
+
+   esCondSignal ( &cache->wake );
+   esMutexUnlock ( &cache->mutex );
+
+   cache->requestCount = 0;
+}
+
+//////////////////////////////////////////////////////////////////
+//
+//  Public Functions
+//
+//
+
+///
+// esTileFileWrite()
+//
+GLboolean ESUTIL_API esTileFileWrite ( const char *fileName, int tileWidth, int tileHeight, int tileCount,
+                                       GLenum internalFormat, GLenum format, GLenum type,
+                                       const void *userData, GLsizeiptr userSize,
+                                       ESTileFunc tileFunc, void *tileArg )
+{
+   TileFileHeader header;
+   unsigned char *pixels;
+   FILE *file;
+   int pixelSize = PixelSize ( format, type );
+   GLboolean ok = GL_TRUE;
+   int i;
+
+   if ( pixelSize == 0 || tileWidth <= 0 || tileHeight <= 0 || tileCount <= 0 || userSize < 0 || tileFunc == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   memset ( &header, 0, sizeof ( header ) );
+   header.magic = TILE_FILE_MAGIC;
+   header.version = TILE_FILE_VERSION;
+   header.tileWidth = tileWidth;
+   header.tileHeight = tileHeight;
+   header.tileCount = tileCount;
+   header.internalFormat = internalFormat;
+   header.format = format;
+   header.type = type;
+   header.tileBytes = ( GLuint ) tileWidth * tileHeight * pixelSize;
+   header.tileStride = ( GLuint ) AlignUp ( header.tileBytes, TILE_ALIGNMENT );
+   header.userOffset = ( GLuint ) AlignUp ( sizeof ( header ), 16 );
+   header.userSize = ( GLuint ) userSize;
+   header.tileOffset = ( GLuint ) AlignUp ( header.userOffset + header.userSize, TILE_ALIGNMENT );
+
+   // The padding after each part is written from the zeroed tile buffer
+   pixels = ( unsigned char * ) calloc ( 1, header.tileStride );
+   file = fopen ( fileName, "wb" );
+
+   if ( pixels == NULL || file == NULL )
+   {
+      free ( pixels );
+
+      if ( file != NULL )
+      {
+         fclose ( file );
+      }
+
+      return GL_FALSE;
+   }
+
+   ok = fwrite ( &header, sizeof ( header ), 1, file ) == 1 &&
+        ( header.userOffset == sizeof ( header ) ||
+          fwrite ( pixels, header.userOffset - sizeof ( header ), 1, file ) == 1 ) &&
+        ( userSize == 0 || fwrite ( userData, ( size_t ) userSize, 1, file ) == 1 ) &&
+        ( header.tileOffset == header.userOffset + header.userSize ||
+          fwrite ( pixels, header.tileOffset - header.userOffset - header.userSize, 1, file ) == 1 );
+
+   for ( i = 0; i < tileCount && ok; i++ )
+   {
+      tileFunc ( tileArg, i, pixels );
+      ok = fwrite ( pixels, header.tileStride, 1, file ) == 1;
+   }
+
+   ok = fclose ( file ) == 0 && ok;
+   free ( pixels );
+
+   if ( !ok )
+   {
+      remove ( fileName );
+   }
+
+   return ok;
+}
+
+///
+// esTileCacheCreate()
+//
+ESTileCache *ESUTIL_API esTileCacheCreate ( void *ioContext, const char *fileName, int slotCount )
+{
+   ESTileCache *cache;
+   const TileFileHeader *header;
+   unsigned char *data;
+   int writable;
+   GLboolean stagingFailed = GL_FALSE;
+   int i;
+
+   cache = ( ESTileCache * ) calloc ( 1, sizeof ( ESTileCache ) );
+
+   if ( cache == NULL )
+   {
+      return NULL;
+   }
+
+   data = esFileMap ( ioContext, fileName, &cache->file, &writable );
+   header = ( const TileFileHeader * ) data;
+
+   if ( data == NULL || cache->file.mappingSize < sizeof ( TileFileHeader ) ||
+        header->magic != TILE_FILE_MAGIC || header->version != TILE_FILE_VERSION ||
+        header->tileBytes != ( GLuint ) header->tileWidth * header->tileHeight * PixelSize ( header->format, header->type ) ||
+        header->tileBytes == 0 || header->tileStride < header->tileBytes ||
+        header->userOffset + ( size_t ) header->userSize > header->tileOffset ||
+        header->tileOffset + ( size_t ) header->tileStride * header->tileCount > cache->file.mappingSize ||
+        slotCount <= 0 )
+   {
+      esLogMessage ( "esTileCacheCreate: could not map a tile file from %s\n", fileName );
+      esFileUnmap ( &cache->file );
+      free ( cache );
+      return NULL;
+   }
+
+   cache->tiles = data + header->tileOffset;
+   cache->userData = data + header->userOffset;
+   cache->userSize = header->userSize;
+   cache->tileCount = header->tileCount;
+   cache->tileWidth = header->tileWidth;
+   cache->tileHeight = header->tileHeight;
+   cache->format = header->format;
+   cache->type = header->type;
+   cache->tileBytes = header->tileBytes;
+   cache->tileStride = header->tileStride;
+   cache->slotCount = slotCount < cache->tileCount ? slotCount : cache->tileCount;
+
+   cache->slotTile = ( int * ) malloc ( sizeof ( int ) * cache->slotCount );
+   cache->slotFrame = ( GLuint * ) calloc ( cache->slotCount, sizeof ( GLuint ) );
+   cache->tileSlot = ( int * ) malloc ( sizeof ( int ) * cache->tileCount );
+   cache->tileRequestFrame = ( GLuint * ) calloc ( cache->tileCount, sizeof ( GLuint ) );
+   cache->tileState = ( GLubyte * ) calloc ( cache->tileCount, 1 );
+   cache->requests = ( TileRequest * ) malloc ( sizeof ( TileRequest ) * cache->tileCount );
+   cache->queue = ( TileRequest * ) malloc ( sizeof ( TileRequest ) * cache->tileCount );
+
+   esMutexInit ( &cache->mutex );
+   esCondInit ( &cache->wake );
+   esCondInit ( &cache->done );
+
+   for ( i = 0; i < STAGING_BUFFER_COUNT; i++ )
+   {
+      cache->staging[i].pixels = malloc ( cache->tileBytes );
+      cache->staging[i].next = cache->freeStaging;
+      cache->freeStaging = &cache->staging[i];
+
+      if ( cache->staging[i].pixels == NULL )
+      {
+         stagingFailed = GL_TRUE;
+      }
+   }
+
+   if ( cache->slotTile == NULL || cache->slotFrame == NULL || cache->tileSlot == NULL ||
+        cache->tileRequestFrame == NULL || cache->tileState == NULL || cache->requests == NULL ||
+        cache->queue == NULL || stagingFailed )
+   {
+      esTileCacheDestroy ( cache );
+      return NULL;
+   }
+
+   for ( i = 0; i < cache->slotCount; i++ )
+   {
+      cache->slotTile[i] = -1;
+   }
+
+   for ( i = 0; i < cache->tileCount; i++ )
+   {
+      cache->tileSlot[i] = -1;
+   }
+
+   // Frame 0 is what unrequested tiles and unused layers hold
+   cache->frame = 1;
+   cache->stats.tileCount = cache->tileCount;
+   cache->stats.slotCount = cache->slotCount;
+
+   glGenTextures ( 1, &cache->texture );
+   glBindTexture ( GL_TEXTURE_2D_ARRAY, cache->texture );
+   glTexStorage3D ( GL_TEXTURE_2D_ARRAY, 1, header->internalFormat, cache->tileWidth, cache->tileHeight, cache->slotCount );
+   glTexParameteri ( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+   glTexParameteri ( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+   glTexParameteri ( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+   glTexParameteri ( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+   cache->running = esThreadCreate ( &cache->thread, LoaderMain, cache );
+
+   if ( !cache->running )
+   {
+      esTileCacheDestroy ( cache );
+      return NULL;
+   }
+
+   return cache;
+}
+
+///
+// esTileCacheDestroy()
+//
+void ESUTIL_API esTileCacheDestroy ( ESTileCache *cache )
+{
+   int i;
+
+   if ( cache == NULL )
+   {
+      return;
+   }
+
+   if ( cache->running )
+   {
+      esMutexLock ( &cache->mutex );
+      cache->quit = GL_TRUE;
+      esCondSignal ( &cache->wake );
+      esMutexUnlock ( &cache->mutex );
+      esThreadJoin ( &cache->thread );
+   }
+
+   esCondDestroy ( &cache->done );
+   esCondDestroy ( &cache->wake );
+   esMutexDestroy ( &cache->mutex );
+
+   glDeleteTextures ( 1, &cache->texture );
+
+   for ( i = 0; i < STAGING_BUFFER_COUNT; i++ )
+   {
+      free ( cache->staging[i].pixels );
+   }
+
+   free ( cache->slotTile );
+   free ( cache->slotFrame );
+   free ( cache->tileSlot );
+   free ( cache->tileRequestFrame );
+   free ( cache->tileState );
+   free ( cache->requests );
+   free ( cache->queue );
+   esFileUnmap ( &cache->file );
+   free ( cache );
+}
+
+///
+// esTileCacheGetUserData()
+//
+const void *ESUTIL_API esTileCacheGetUserData ( ESTileCache *cache, GLsizeiptr *size )
+{
+   if ( size != NULL )
+   {
+      *size = cache->userSize;
+   }
+
+   return cache->userData;
+}
+
+///
+// esTileCacheRequest()
+//
+void ESUTIL_API esTileCacheRequest ( ESTileCache *cache, int tile, int priority )
+{
+   TileRequest *request;
+
+   if ( tile < 0 || tile >= cache->tileCount || cache->tileSlot[tile] >= 0 ||
+        cache->tileRequestFrame[tile] == cache->frame )
+   {
+      return;
+   }
+
+   cache->tileRequestFrame[tile] = cache->frame;
+   request = &cache->requests[cache->requestCount++];
+   request->tile = tile;
+   request->priority = priority;
+}
+
+///
+// esTileCacheLookup()
+//
+int ESUTIL_API esTileCacheLookup ( ESTileCache *cache, int tile )
+{
+   int slot;
+
+   if ( tile < 0 || tile >= cache->tileCount )
+   {
+      return -1;
+   }
+
+   slot = cache->tileSlot[tile];
+
+   if ( slot >= 0 )
+   {
+      cache->slotFrame[slot] = cache->frame;
+   }
+
+   return slot;
+}
+
+///
+// esTileCacheUpdate()
+//
+int ESUTIL_API esTileCacheUpdate ( ESTileCache *cache )
+{
+   int uploaded = UploadLoaded ( cache );
+
+   SubmitRequests ( cache );
+   cache->frame++;
+
+   return uploaded;
+}
+
+///
+// esTileCacheFinish()
+//
+void ESUTIL_API esTileCacheFinish ( ESTileCache *cache )
+{
+   GLboolean busy = GL_TRUE;
+
+   if ( cache->requestCount > 0 )
+   {
+      SubmitRequests ( cache );
+   }
+
+   while ( busy )
+   {
+      esMutexLock ( &cache->mutex );
+
+      while ( cache->loadedHead == NULL && ( cache->loading > 0 || cache->queueNext < cache->queueCount ) )
+      {
+         esCondWait ( &cache->done, &cache->mutex );
+      }
+
+      busy = cache->loadedHead != NULL;
+      esMutexUnlock ( &cache->mutex );
+
+      UploadLoaded ( cache );
+   }
+}
+
+///
+// esTileCacheGetTexture()
+//
+GLuint ESUTIL_API esTileCacheGetTexture ( ESTileCache *cache )
+{
+   return cache->texture;
+}
+
+///
+// esTileCacheGetStats()
+//
+const ESTileCacheStats *ESUTIL_API esTileCacheGetStats ( ESTileCache *cache )
+{
+   esMutexLock ( &cache->mutex );
+   cache->stats.queuedTiles = cache->queueCount - cache->queueNext + cache->loading;
+   esMutexUnlock ( &cache->mutex );
+
+   return &cache->stats;
+}
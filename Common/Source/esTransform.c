@@ -40,6 +40,7 @@
 //  Includes
 //
 #include "esUtil.h"
+#include "esSimd.h"
 #include <math.h>
 #include <string.h>
 
@@ -195,9 +196,17 @@ esOrtho ( ESMatrix *result, float left, float right, float bottom, float top, fl
 }
 
 
-void ESUTIL_API
-esMatrixMultiply ( ESMatrix *result, ESMatrix *srcA, ESMatrix *srcB )
+///
+// esMatrixMultiplyRows()
+//
+//    result = srcA * srcB.  All four rows of srcB are held in registers and
+//    every output row is built from lane broadcasts of the matching srcA row,
+//    so the product is fully computed before anything is stored.  That keeps
+//    esRotate()-style calls where result aliases srcA or srcB correct.
+//
+static ES_INLINE void esMatrixMultiplyRows ( ESMatrix *result, const ESMatrix *srcA, const ESMatrix *srcB )
 {
+#ifdef ES_SIMD_SCALAR
    ESMatrix    tmp;
    int         i;
 
@@ -225,6 +234,95 @@ esMatrixMultiply ( ESMatrix *result, ESMatrix *srcA, ESMatrix *srcB )
    }
 
    memcpy ( result, &tmp, sizeof ( ESMatrix ) );
+#else
+   esVec4 b0 = esVec4Load ( srcB->m[0] );
+   esVec4 b1 = esVec4Load ( srcB->m[1] );
+   esVec4 b2 = esVec4Load ( srcB->m[2] );
+   esVec4 b3 = esVec4Load ( srcB->m[3] );
+   esVec4 a0 = esVec4Load ( srcA->m[0] );
+   esVec4 a1 = esVec4Load ( srcA->m[1] );
+   esVec4 a2 = esVec4Load ( srcA->m[2] );
+   esVec4 a3 = esVec4Load ( srcA->m[3] );
+   esVec4 r0, r1, r2, r3;
+
+   r0 = esVec4Mul ( esVec4Lane ( a0, 0 ), b0 );
+   r1 = esVec4Mul ( esVec4Lane ( a1, 0 ), b0 );
+   r2 = esVec4Mul ( esVec4Lane ( a2, 0 ), b0 );
+   r3 = esVec4Mul ( esVec4Lane ( a3, 0 ), b0 );
+
+   r0 = esVec4Madd ( esVec4Lane ( a0, 1 ), b1, r0 );
+   r1 = esVec4Madd ( esVec4Lane ( a1, 1 ), b1, r1 );
+   r2 = esVec4Madd ( esVec4Lane ( a2, 1 ), b1, r2 );
+   r3 = esVec4Madd ( esVec4Lane ( a3, 1 ), b1, r3 );
+
+   r0 = esVec4Madd ( esVec4Lane ( a0, 2 ), b2, r0 );
+   r1 = esVec4Madd ( esVec4Lane ( a1, 2 ), b2, r1 );
+   r2 = esVec4Madd ( esVec4Lane ( a2, 2 ), b2, r2 );
+   r3 = esVec4Madd ( esVec4Lane ( a3, 2 ), b2, r3 );
+
+   r0 = esVec4Madd ( esVec4Lane ( a0, 3 ), b3, r0 );
+   r1 = esVec4Madd ( esVec4Lane ( a1, 3 ), b3, r1 );
+   r2 = esVec4Madd ( esVec4Lane ( a2, 3 ), b3, r2 );
+   r3 = esVec4Madd ( esVec4Lane ( a3, 3 ), b3, r3 );
+
+   esVec4Store ( result->m[0], r0 );
+   esVec4Store ( result->m[1], r1 );
+   esVec4Store ( result->m[2], r2 );
+   esVec4Store ( result->m[3], r3 );
+#endif
+}
+
+#ifdef ES_SIMD_AVX
+///
+// esMatrixMultiplyRowsAVX()
+//
+//    8-wide variant of esMatrixMultiplyRows().  Each __m256 carries two
+//    output rows; the in-lane shuffle broadcasts srcA[i][k] and srcA[i+1][k]
+//    into their half while srcB row k is duplicated across both halves.
+//
+static ES_INLINE void esMatrixMultiplyRowsAVX ( ESMatrix *result, const ESMatrix *srcA, const ESMatrix *srcB )
+{
+   __m256 b0 = _mm256_broadcast_ps ( ( const __m128 * ) srcB->m[0] );
+   __m256 b1 = _mm256_broadcast_ps ( ( const __m128 * ) srcB->m[1] );
+   __m256 b2 = _mm256_broadcast_ps ( ( const __m128 * ) srcB->m[2] );
+   __m256 b3 = _mm256_broadcast_ps ( ( const __m128 * ) srcB->m[3] );
+   __m256 a01 = _mm256_loadu_ps ( srcA->m[0] );
+   __m256 a23 = _mm256_loadu_ps ( srcA->m[2] );
+   __m256 r01, r23;
+
+   r01 = _mm256_mul_ps ( _mm256_shuffle_ps ( a01, a01, 0x00 ), b0 );
+   r23 = _mm256_mul_ps ( _mm256_shuffle_ps ( a23, a23, 0x00 ), b0 );
+   r01 = _mm256_add_ps ( _mm256_mul_ps ( _mm256_shuffle_ps ( a01, a01, 0x55 ), b1 ), r01 );
+   r23 = _mm256_add_ps ( _mm256_mul_ps ( _mm256_shuffle_ps ( a23, a23, 0x55 ), b1 ), r23 );
+   r01 = _mm256_add_ps ( _mm256_mul_ps ( _mm256_shuffle_ps ( a01, a01, 0xAA ), b2 ), r01 );
+   r23 = _mm256_add_ps ( _mm256_mul_ps ( _mm256_shuffle_ps ( a23, a23, 0xAA ), b2 ), r23 );
+   r01 = _mm256_add_ps ( _mm256_mul_ps ( _mm256_shuffle_ps ( a01, a01, 0xFF ), b3 ), r01 );
+   r23 = _mm256_add_ps ( _mm256_mul_ps ( _mm256_shuffle_ps ( a23, a23, 0xFF ), b3 ), r23 );
+
+   _mm256_storeu_ps ( result->m[0], r01 );
+   _mm256_storeu_ps ( result->m[2], r23 );
+}
+#endif
+
+void ESUTIL_API
+esMatrixMultiply ( ESMatrix *result, ESMatrix *srcA, ESMatrix *srcB )
+{
+   esMatrixMultiplyRows ( result, srcA, srcB );
+}
+
+void ESUTIL_API
+esMatrixMultiplyBatch ( ESMatrix *out, const ESMatrix *a, const ESMatrix *b, int count )
+{
+   int i;
+
+   for ( i = 0; i < count; i++ )
+   {
+#ifdef ES_SIMD_AVX
+      esMatrixMultiplyRowsAVX ( &out[i], &a[i], &b[i] );
+#else
+      esMatrixMultiplyRows ( &out[i], &a[i], &b[i] );
+#endif
+   }
 }
 
 
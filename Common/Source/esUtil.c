@@ -45,6 +45,8 @@
 #include <string.h>
 #include "esUtil.h"
 #include "esUtil_win.h"
+#include "esArena.h"
+#include "esFile.h"
 
 #ifdef ANDROID
 #include <android/log.h>
@@ -57,6 +59,16 @@ typedef FILE esFile;
 
 #ifdef __APPLE__
 #include "FileWrapper.h"
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#if !defined(_WIN32) && !defined(ANDROID)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 ///
@@ -64,6 +76,16 @@ typedef FILE esFile;
 //
 #define INVERTED_BIT            (1 << 5)
 
+// TGA image types; TGA_RLE_BIT is set on the run-length encoded variants
+#define TGA_TYPE_COLORMAPPED    1
+#define TGA_TYPE_TRUECOLOR      2
+#define TGA_TYPE_GREY           3
+#define TGA_RLE_BIT             8
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA   0x31DD
+#endif
+
 ///
 //  Types
 //
@@ -119,6 +141,38 @@ EGLint GetContextRenderableType ( EGLDisplay eglDisplay )
    // extension is not supported
    return EGL_OPENGL_ES2_BIT;
 }
+
+///
+// GetHeadlessDisplay()
+//
+//    Return an EGL display that does not need a window system.  Prefer the
+//    Mesa surfaceless platform (works with llvmpipe on a plain Linux box) and
+//    fall back to the default display, which still supports pbuffers on most
+//    drivers.
+//
+static EGLDisplay GetHeadlessDisplay ( void )
+{
+#ifdef EGL_EXT_platform_base
+   const char *clientExtensions = eglQueryString ( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+
+   if ( clientExtensions != NULL && strstr ( clientExtensions, "EGL_MESA_platform_surfaceless" ) )
+   {
+      PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+         ( PFNEGLGETPLATFORMDISPLAYEXTPROC ) eglGetProcAddress ( "eglGetPlatformDisplayEXT" );
+
+      if ( getPlatformDisplay != NULL )
+      {
+         EGLDisplay display = getPlatformDisplay ( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+
+         if ( display != EGL_NO_DISPLAY )
+         {
+            return display;
+         }
+      }
+   }
+#endif
+   return eglGetDisplay ( EGL_DEFAULT_DISPLAY );
+}
 #endif
 
 //////////////////////////////////////////////////////////////////
@@ -138,6 +192,7 @@ EGLint GetContextRenderableType ( EGLDisplay eglDisplay )
 //          ES_WINDOW_DEPTH       - specifies that a depth buffer should be created
 //          ES_WINDOW_STENCIL     - specifies that a stencil buffer should be created
 //          ES_WINDOW_MULTISAMPLE - specifies that a multi-sample buffer should be created
+//          ES_WINDOW_HEADLESS    - render to a pbuffer instead of a native window
 //
 GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char *title, GLint width, GLint height, GLuint flags )
 {
@@ -160,14 +215,30 @@ GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char *title, G
 #else
    esContext->width = width;
    esContext->height = height;
+
+   // Allow any sample to be run without a display, e.g. on a CI machine
+   if ( getenv ( "ES_HEADLESS" ) != NULL )
+   {
+      flags |= ES_WINDOW_HEADLESS;
+   }
 #endif
 
-   if ( !WinCreate ( esContext, title ) )
+   esContext->flags = flags;
+
+   if ( flags & ES_WINDOW_HEADLESS )
    {
-      return GL_FALSE;
+      esContext->eglDisplay = GetHeadlessDisplay ( );
+   }
+   else
+   {
+      if ( !WinCreate ( esContext, title ) )
+      {
+         return GL_FALSE;
+      }
+
+      esContext->eglDisplay = eglGetDisplay( esContext->eglNativeDisplay );
    }
 
-   esContext->eglDisplay = eglGetDisplay( esContext->eglNativeDisplay );
    if ( esContext->eglDisplay == EGL_NO_DISPLAY )
    {
       return GL_FALSE;
@@ -190,6 +261,7 @@ GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char *title, G
          EGL_DEPTH_SIZE,     ( flags & ES_WINDOW_DEPTH ) ? 8 : EGL_DONT_CARE,
          EGL_STENCIL_SIZE,   ( flags & ES_WINDOW_STENCIL ) ? 8 : EGL_DONT_CARE,
          EGL_SAMPLE_BUFFERS, ( flags & ES_WINDOW_MULTISAMPLE ) ? 1 : 0,
+         EGL_SURFACE_TYPE,   ( flags & ES_WINDOW_HEADLESS ) ? EGL_PBUFFER_BIT : EGL_WINDOW_BIT,
          // if EGL_KHR_create_context extension is supported, then we will use
          // EGL_OPENGL_ES3_BIT_KHR instead of EGL_OPENGL_ES2_BIT in the attribute list
          EGL_RENDERABLE_TYPE, GetContextRenderableType ( esContext->eglDisplay ),
@@ -219,8 +291,22 @@ GLboolean ESUTIL_API esCreateWindow ( ESContext *esContext, const char *title, G
 #endif // ANDROID
 
    // Create a surface
-   esContext->eglSurface = eglCreateWindowSurface ( esContext->eglDisplay, config, 
-                                                    esContext->eglNativeWindow, NULL );
+   if ( flags & ES_WINDOW_HEADLESS )
+   {
+      EGLint pbufferAttribs[] =
+      {
+         EGL_WIDTH,  esContext->width,
+         EGL_HEIGHT, esContext->height,
+         EGL_NONE
+      };
+
+      esContext->eglSurface = eglCreatePbufferSurface ( esContext->eglDisplay, config, pbufferAttribs );
+   }
+   else
+   {
+      esContext->eglSurface = eglCreateWindowSurface ( esContext->eglDisplay, config,
+                                                       esContext->eglNativeWindow, NULL );
+   }
 
    if ( esContext->eglSurface == EGL_NO_SURFACE )
    {
@@ -283,6 +369,190 @@ void ESUTIL_API esRegisterKeyFunc ( ESContext *esContext,
 }
 
 
+///
+// HistogramBucket()
+//
+//    Log-linear bucket index.  Values below 2^ES_HISTOGRAM_SUB_BITS map to
+//    themselves; above that, each power of two is split into
+//    2^ES_HISTOGRAM_SUB_BITS equal sub-buckets.
+//
+static GLuint HistogramBucket ( GLuint value )
+{
+   GLuint exponent = ES_HISTOGRAM_SUB_BITS;
+
+   if ( value < ( 1u << ES_HISTOGRAM_SUB_BITS ) )
+   {
+      return value;
+   }
+
+   while ( exponent < 31 && ( value >> ( exponent + 1 ) ) != 0 )
+   {
+      exponent++;
+   }
+
+   return ( ( exponent - ES_HISTOGRAM_SUB_BITS + 1 ) << ES_HISTOGRAM_SUB_BITS ) +
+          ( ( value >> ( exponent - ES_HISTOGRAM_SUB_BITS ) ) & ( ( 1u << ES_HISTOGRAM_SUB_BITS ) - 1 ) );
+}
+
+///
+// HistogramBucketMax()
+//
+//    Largest value that maps to the given bucket
+//
+static GLuint64 HistogramBucketMax ( GLuint bucket )
+{
+   GLuint shift, sub;
+
+   if ( bucket < ( 1u << ES_HISTOGRAM_SUB_BITS ) )
+   {
+      return bucket;
+   }
+
+   shift = ( bucket >> ES_HISTOGRAM_SUB_BITS ) - 1;
+   sub = bucket & ( ( 1u << ES_HISTOGRAM_SUB_BITS ) - 1 );
+
+   return ( ( ( GLuint64 ) ( ( 1u << ES_HISTOGRAM_SUB_BITS ) + sub + 1 ) ) << shift ) - 1;
+}
+
+///
+// esHistogramReset()
+//
+void ESUTIL_API esHistogramReset ( ESHistogram *hist )
+{
+   memset ( hist, 0, sizeof ( ESHistogram ) );
+}
+
+///
+// esHistogramRecord()
+//
+void ESUTIL_API esHistogramRecord ( ESHistogram *hist, GLuint64 ns )
+{
+   GLuint value = ns > 0xFFFFFFFFu ? 0xFFFFFFFFu : ( GLuint ) ns;
+
+   if ( hist->count == ES_HISTOGRAM_WINDOW )
+   {
+      // Window is full, drop the oldest sample
+      GLuint oldest = hist->samples[hist->next];
+
+      hist->counts[HistogramBucket ( oldest )]--;
+      hist->sum -= oldest;
+   }
+   else
+   {
+      hist->count++;
+   }
+
+   hist->samples[hist->next] = value;
+   hist->next = ( hist->next + 1 ) % ES_HISTOGRAM_WINDOW;
+   hist->counts[HistogramBucket ( value )]++;
+   hist->sum += value;
+   hist->last = value;
+
+   if ( value > hist->max )
+   {
+      hist->max = value;
+   }
+}
+
+///
+// esHistogramPercentile()
+//
+GLuint64 ESUTIL_API esHistogramPercentile ( const ESHistogram *hist, float percentile )
+{
+   GLuint64 target;
+   GLuint64 seen = 0;
+   GLuint   bucket;
+
+   if ( hist->count == 0 )
+   {
+      return 0;
+   }
+
+   if ( percentile < 0.0f )
+   {
+      percentile = 0.0f;
+   }
+   else if ( percentile > 100.0f )
+   {
+      percentile = 100.0f;
+   }
+
+   target = ( GLuint64 ) ( percentile / 100.0f * hist->count + 0.5f );
+   target = target < 1 ? 1 : target;
+
+   for ( bucket = 0; bucket < ES_HISTOGRAM_BUCKETS; bucket++ )
+   {
+      seen += hist->counts[bucket];
+
+      if ( seen >= target )
+      {
+         return HistogramBucketMax ( bucket );
+      }
+   }
+
+   return hist->max;
+}
+
+///
+// esHistogramMean()
+//
+GLuint64 ESUTIL_API esHistogramMean ( const ESHistogram *hist )
+{
+   return hist->count ? hist->sum / hist->count : 0;
+}
+
+///
+// esResetFrameStats()
+//
+void ESUTIL_API esResetFrameStats ( ESContext *esContext )
+{
+   memset ( &esContext->frameStats, 0, sizeof ( ESFrameStats ) );
+}
+
+///
+// esRenderFrame()
+//
+//    Run update, draw and swap for one frame and record their durations
+//
+void esRenderFrame ( ESContext *esContext, float deltaTime )
+{
+   ESFrameStats *stats = &esContext->frameStats;
+   GLuint64 start = esGetTimeNs ( );
+   GLuint64 updated, drawn, swapped;
+
+   if ( esContext->updateFunc != NULL )
+   {
+      esContext->updateFunc ( esContext, deltaTime );
+   }
+
+   updated = esGetTimeNs ( );
+
+   if ( esContext->drawFunc != NULL )
+   {
+      esContext->drawFunc ( esContext );
+   }
+
+   drawn = esGetTimeNs ( );
+
+#ifndef __APPLE__
+   eglSwapBuffers ( esContext->eglDisplay, esContext->eglSurface );
+#endif
+
+   swapped = esGetTimeNs ( );
+
+   esHistogramRecord ( &stats->update, updated - start );
+   esHistogramRecord ( &stats->draw, drawn - updated );
+   esHistogramRecord ( &stats->swap, swapped - drawn );
+
+   if ( stats->frameCount > 0 )
+   {
+      esHistogramRecord ( &stats->frame, start - stats->lastFrameStart );
+   }
+
+   stats->lastFrameStart = start;
+   stats->frameCount++;
+}
+
 ///
 // esLogMessage()
 //
@@ -305,119 +575,563 @@ void ESUTIL_API esLogMessage ( const char *formatStr, ... )
    va_end ( params );
 }
 
+#ifdef ANDROID
 ///
-// esFileRead()
+// esFileOpen()
 //
-//    Wrapper for platform specific File open
+//    Open an asset, only esFileMap() needs it as the other platforms map
+//    files directly
 //
 static esFile *esFileOpen ( void *ioContext, const char *fileName )
 {
    esFile *pFile = NULL;
 
-#ifdef ANDROID
-
    if ( ioContext != NULL )
    {
       AAssetManager *assetManager = ( AAssetManager * ) ioContext;
       pFile = AAssetManager_open ( assetManager, fileName, AASSET_MODE_BUFFER );
    }
 
+   return pFile;
+}
+
+///
+// esFileClose()
+//
+//    Close an asset opened by esFileOpen()
+//
+static void esFileClose ( esFile *pFile )
+{
+   if ( pFile != NULL )
+   {
+      AAsset_close ( pFile );
+   }
+}
+#endif // ANDROID
+
+///
+// esFileMap()
+//
+//    Map a whole file into memory.  The mapping is copy-on-write where the
+//    platform allows it, in which case *writable is set and the caller may
+//    modify the pages without touching the file.
+//
+unsigned char *esFileMap ( void *ioContext, const char *fileName, ESImage *image, int *writable )
+{
+   unsigned char *data = NULL;
+
+   *writable = 0;
+
+#ifdef ANDROID
+   esFile *pFile = esFileOpen ( ioContext, fileName );
+
+   if ( pFile != NULL )
+   {
+      // AASSET_MODE_BUFFER keeps the asset mapped (or decompressed once) for us
+      data = ( unsigned char * ) AAsset_getBuffer ( pFile );
+
+      if ( data == NULL )
+      {
+         esFileClose ( pFile );
+         return NULL;
+      }
+
+      image->mappingHandle = pFile;
+      image->mappingSize = AAsset_getLength ( pFile );
+   }
+
+#elif defined(_WIN32)
+   HANDLE file;
+   HANDLE mapping;
+   LARGE_INTEGER fileSize;
+
+   file = CreateFileA ( fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+
+   if ( file == INVALID_HANDLE_VALUE )
+   {
+      return NULL;
+   }
+
+   if ( GetFileSizeEx ( file, &fileSize ) && fileSize.QuadPart > 0 )
+   {
+      mapping = CreateFileMappingA ( file, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+
+      if ( mapping != NULL )
+      {
+         data = ( unsigned char * ) MapViewOfFile ( mapping, FILE_MAP_COPY, 0, 0, 0 );
+         CloseHandle ( mapping );
+      }
+   }
+
+   CloseHandle ( file );
+
+   if ( data == NULL )
+   {
+      return NULL;
+   }
+
+   image->mapping = data;
+   image->mappingSize = ( size_t ) fileSize.QuadPart;
+   *writable = 1;
+
 #else
+   struct stat fileStat;
+   void *mapping;
+   int fd;
+
 #ifdef __APPLE__
    // iOS: Remap the filename to a path that can be opened from the bundle.
    fileName = GetBundleFileName ( fileName );
 #endif
 
-   pFile = fopen ( fileName, "rb" );
+   fd = open ( fileName, O_RDONLY );
+
+   if ( fd < 0 )
+   {
+      return NULL;
+   }
+
+   if ( fstat ( fd, &fileStat ) != 0 || fileStat.st_size <= 0 )
+   {
+      close ( fd );
+      return NULL;
+   }
+
+   // Private mapping: writes go to anonymous copies of the touched pages only
+   mapping = mmap ( NULL, ( size_t ) fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+   close ( fd );
+
+   if ( mapping == MAP_FAILED )
+   {
+      return NULL;
+   }
+
+   data = ( unsigned char * ) mapping;
+   image->mapping = mapping;
+   image->mappingSize = ( size_t ) fileStat.st_size;
+   *writable = 1;
 #endif
 
-   return pFile;
+   return data;
 }
 
 ///
-// esFileRead()
+// esFileUnmap()
 //
-//    Wrapper for platform specific File close
-//
-static void esFileClose ( esFile *pFile )
+void esFileUnmap ( ESImage *image )
 {
-   if ( pFile != NULL )
-   {
 #ifdef ANDROID
-      AAsset_close ( pFile );
+
+   if ( image->mappingHandle != NULL )
+   {
+      esFileClose ( ( esFile * ) image->mappingHandle );
+   }
+
+#elif defined(_WIN32)
+
+   if ( image->mapping != NULL )
+   {
+      UnmapViewOfFile ( image->mapping );
+   }
+
 #else
-      fclose ( pFile );
-      pFile = NULL;
+
+   if ( image->mapping != NULL )
+   {
+      munmap ( image->mapping, image->mappingSize );
+   }
+
 #endif
+
+   image->mapping = NULL;
+   image->mappingSize = 0;
+   image->mappingHandle = NULL;
+}
+
+///
+// FlipRows()
+//
+//    Reverse the order of the rows of an image in place
+//
+static void FlipRows ( unsigned char *pixels, int height, size_t rowSize )
+{
+   unsigned char temp[1024];
+   unsigned char *top = pixels;
+   unsigned char *bottom = pixels + ( size_t ) ( height - 1 ) * rowSize;
+
+   while ( top < bottom )
+   {
+      size_t offset;
+
+      for ( offset = 0; offset < rowSize; offset += sizeof ( temp ) )
+      {
+         size_t chunk = rowSize - offset < sizeof ( temp ) ? rowSize - offset : sizeof ( temp );
+
+         memcpy ( temp, top + offset, chunk );
+         memcpy ( top + offset, bottom + offset, chunk );
+         memcpy ( bottom + offset, temp, chunk );
+      }
+
+      top += rowSize;
+      bottom -= rowSize;
+   }
+}
+
+///
+// DecodeRLE()
+//
+//    Decode TGA run-length packets into dst.  Runs are filled by doubling
+//    memcpy so long runs cost a handful of copies rather than one per pixel.
+//    Returns the number of source bytes consumed, 0 if the data is truncated.
+//
+static size_t DecodeRLE ( const unsigned char *src, size_t srcSize, unsigned char *dst,
+                          size_t pixelCount, int pixelSize )
+{
+   const unsigned char *srcStart = src;
+   const unsigned char *srcEnd = src + srcSize;
+   size_t decoded = 0;
+
+   while ( decoded < pixelCount )
+   {
+      size_t count;
+      size_t bytes;
+
+      if ( src >= srcEnd )
+      {
+         return 0;
+      }
+
+      count = ( *src & 0x7F ) + 1;
+
+      if ( count > pixelCount - decoded )
+      {
+         // Clamp runs that overflow the image rather than rejecting the file
+         count = pixelCount - decoded;
+      }
+
+      bytes = count * pixelSize;
+
+      if ( *src++ & 0x80 )
+      {
+         // Run packet: one pixel repeated count times
+         if ( srcEnd - src < pixelSize )
+         {
+            return 0;
+         }
+
+         if ( pixelSize == 1 )
+         {
+            memset ( dst, *src, count );
+         }
+         else
+         {
+            size_t filled = pixelSize;
+
+            memcpy ( dst, src, pixelSize );
+
+            while ( filled < bytes )
+            {
+               size_t chunk = filled < bytes - filled ? filled : bytes - filled;
+
+               memcpy ( dst + filled, dst, chunk );
+               filled += chunk;
+            }
+         }
+
+         src += pixelSize;
+      }
+      else
+      {
+         // Raw packet: count literal pixels
+         if ( ( size_t ) ( srcEnd - src ) < bytes )
+         {
+            return 0;
+         }
+
+         memcpy ( dst, src, bytes );
+         src += bytes;
+      }
+
+      dst += bytes;
+      decoded += count;
    }
+
+   return src - srcStart;
 }
 
 ///
-// esFileRead()
+// DecodeTGA()
 //
-//    Wrapper for platform specific File read
+//    Fill in image from the TGA file contents in data.  Uncompressed images
+//    are used in place; everything else is decoded into image->allocation.
 //
-static int esFileRead ( esFile *pFile, int bytesToRead, void *buffer )
+static GLboolean DecodeTGA ( ESArena *arena, unsigned char *data, size_t size, int writable, ESImage *image )
 {
-   int bytesRead = 0;
+   TGA_HEADER     Header;
+   unsigned char *pixels;
+   const unsigned char *palette = NULL;
+   size_t         offset;
+   size_t         pixelCount;
+   size_t         imageSize;
+   int            imageType;
+   int            srcPixelSize;
+   int            paletteEntrySize = 0;
 
-   if ( pFile == NULL )
+   if ( size < sizeof ( TGA_HEADER ) )
    {
-      return bytesRead;
+      return GL_FALSE;
    }
 
-#ifdef ANDROID
-   bytesRead = AAsset_read ( pFile, buffer, bytesToRead );
-#else
-   bytesRead = fread ( buffer, bytesToRead, 1, pFile );
-#endif
+   memcpy ( &Header, data, sizeof ( TGA_HEADER ) );
+
+   imageType = Header.ImageType & ~TGA_RLE_BIT;
+   srcPixelSize = Header.ColorDepth / 8;
+   offset = sizeof ( TGA_HEADER ) + Header.IdSize;
+
+   if ( Header.MapType == 1 )
+   {
+      paletteEntrySize = ( Header.PaletteEntryDepth + 7 ) / 8;
+      palette = data + offset;
+      offset += ( size_t ) Header.PaletteSize * paletteEntrySize;
+   }
+
+   if ( imageType == TGA_TYPE_COLORMAPPED )
+   {
+      // 8-bit indices into a 24-bit or 32-bit palette
+      if ( palette == NULL || Header.ColorDepth != 8 || ( paletteEntrySize != 3 && paletteEntrySize != 4 ) )
+      {
+         return GL_FALSE;
+      }
+
+      image->bytesPerPixel = paletteEntrySize;
+   }
+   else if ( imageType == TGA_TYPE_TRUECOLOR || imageType == TGA_TYPE_GREY )
+   {
+      if ( Header.ColorDepth != 8 && Header.ColorDepth != 24 && Header.ColorDepth != 32 )
+      {
+         return GL_FALSE;
+      }
 
-   return bytesRead;
+      image->bytesPerPixel = srcPixelSize;
+   }
+   else
+   {
+      return GL_FALSE;
+   }
+
+   if ( offset > size || Header.Width == 0 || Header.Height == 0 )
+   {
+      return GL_FALSE;
+   }
+
+   image->width = Header.Width;
+   image->height = Header.Height;
+   pixelCount = ( size_t ) image->width * image->height;
+   imageSize = pixelCount * image->bytesPerPixel;
+
+   if ( !( Header.ImageType & TGA_RLE_BIT ) && imageType != TGA_TYPE_COLORMAPPED )
+   {
+      // Uncompressed: the pixels are already laid out the way GL wants them
+      if ( size - offset < imageSize )
+      {
+         return GL_FALSE;
+      }
+
+      pixels = data + offset;
+
+      if ( Header.Descriptor & INVERTED_BIT )
+      {
+         if ( !writable )
+         {
+            image->allocation = ( unsigned char * ) esArenaMalloc ( arena, imageSize );
+
+            if ( image->allocation == NULL )
+            {
+               return GL_FALSE;
+            }
+
+            memcpy ( image->allocation, pixels, imageSize );
+            pixels = image->allocation;
+         }
+
+         FlipRows ( pixels, image->height, ( size_t ) image->width * image->bytesPerPixel );
+      }
+
+      image->pixels = pixels;
+      return GL_TRUE;
+   }
+
+   image->allocation = ( unsigned char * ) esArenaMalloc ( arena, imageSize );
+
+   if ( image->allocation == NULL )
+   {
+      return GL_FALSE;
+   }
+
+   pixels = image->allocation;
+
+   if ( imageType == TGA_TYPE_COLORMAPPED )
+   {
+      // Decode the indices into the tail of the buffer, then expand them front to
+      // back; each palette entry is at least as wide as an index, so an index is
+      // always read before the expanded pixels reach it.
+      unsigned char *indices = pixels + imageSize - pixelCount;
+      size_t i;
+
+      if ( Header.ImageType & TGA_RLE_BIT )
+      {
+         if ( DecodeRLE ( data + offset, size - offset, indices, pixelCount, 1 ) == 0 )
+         {
+            return GL_FALSE;
+         }
+      }
+      else
+      {
+         if ( size - offset < pixelCount )
+         {
+            return GL_FALSE;
+         }
+
+         memcpy ( indices, data + offset, pixelCount );
+      }
+
+      for ( i = 0; i < pixelCount; i++ )
+      {
+         int index = indices[i] - Header.PaletteStart;
+
+         if ( index < 0 || index >= Header.PaletteSize )
+         {
+            index = 0;
+         }
+
+         memcpy ( pixels + i * paletteEntrySize, palette + index * paletteEntrySize, paletteEntrySize );
+      }
+   }
+   else if ( DecodeRLE ( data + offset, size - offset, pixels, pixelCount, srcPixelSize ) == 0 )
+   {
+      return GL_FALSE;
+   }
+
+   if ( Header.Descriptor & INVERTED_BIT )
+   {
+      FlipRows ( pixels, image->height, ( size_t ) image->width * image->bytesPerPixel );
+   }
+
+   image->pixels = pixels;
+   return GL_TRUE;
 }
 
 ///
-// esLoadTGA()
+// LoadTGAImage()
 //
-//    Loads a 8-bit, 24-bit or 32-bit TGA image from a file
+//    Loads a TGA image, returning a view into a mapping of the file when
+//    no decoding is required.  A decode buffer comes from the arena if one
+//    is given; it then belongs to the arena, not the image.
 //
-char *ESUTIL_API esLoadTGA ( void *ioContext, const char *fileName, int *width, int *height )
+static GLboolean LoadTGAImage ( ESArena *arena, void *ioContext, const char *fileName, ESImage *image )
 {
-   char        *buffer;
-   esFile      *fp;
-   TGA_HEADER   Header;
-   int          bytesRead;
+   unsigned char *data;
+   int            writable;
+
+   memset ( image, 0, sizeof ( ESImage ) );
 
-   // Open the file for reading
-   fp = esFileOpen ( ioContext, fileName );
+   data = esFileMap ( ioContext, fileName, image, &writable );
 
-   if ( fp == NULL )
+   if ( data == NULL )
    {
       // Log error as 'error in opening the input file from apk'
       esLogMessage ( "esLoadTGA FAILED to load : { %s }\n", fileName );
-      return NULL;
+      return GL_FALSE;
+   }
+
+   if ( !DecodeTGA ( arena, data, image->mappingSize, writable, image ) )
+   {
+      esLogMessage ( "esLoadTGA FAILED to decode : { %s }\n", fileName );
+      esArenaFree ( arena, image->allocation );
+      image->allocation = NULL;
+      esReleaseImage ( image );
+      return GL_FALSE;
+   }
+
+   if ( image->allocation != NULL )
+   {
+      // Everything was decoded, the file is no longer needed
+      esFileUnmap ( image );
    }
 
-   bytesRead = esFileRead ( fp, sizeof ( TGA_HEADER ), &Header );
+   return GL_TRUE;
+}
+
+///
+// esLoadTGAImage()
+//
+//    Loads a TGA image, returning a view into a mapping of the file when
+//    no decoding is required
+//
+GLboolean ESUTIL_API esLoadTGAImage ( void *ioContext, const char *fileName, ESImage *image )
+{
+   return LoadTGAImage ( NULL, ioContext, fileName, image );
+}
 
-   *width = Header.Width;
-   *height = Header.Height;
+///
+// esReleaseImage()
+//
+void ESUTIL_API esReleaseImage ( ESImage *image )
+{
+   esFileUnmap ( image );
+   free ( image->allocation );
+   memset ( image, 0, sizeof ( ESImage ) );
+}
 
-   if ( Header.ColorDepth == 8 ||
-         Header.ColorDepth == 24 || Header.ColorDepth == 32 )
+///
+// esLoadTGAArena()
+//
+//    Loads a 8-bit, 24-bit or 32-bit TGA image from a file into memory from
+//    an arena, or the heap if arena is NULL
+//
+char *ESUTIL_API esLoadTGAArena ( ESArena *arena, void *ioContext, const char *fileName, int *width, int *height )
+{
+   ESImage  image;
+   char    *buffer;
+
+   if ( !LoadTGAImage ( arena, ioContext, fileName, &image ) )
    {
-      int bytesToRead = sizeof ( char ) * ( *width ) * ( *height ) * Header.ColorDepth / 8;
+      return NULL;
+   }
 
-      // Allocate the image data buffer
-      buffer = ( char * ) malloc ( bytesToRead );
+   *width = image.width;
+   *height = image.height;
 
-      if ( buffer )
-      {
-         bytesRead = esFileRead ( fp, bytesToRead, buffer );
-         esFileClose ( fp );
+   if ( image.allocation != NULL )
+   {
+      // Hand the decode buffer over to the caller
+      buffer = ( char * ) image.allocation;
+      image.allocation = NULL;
+   }
+   else
+   {
+      size_t imageSize = ( size_t ) image.width * image.height * image.bytesPerPixel;
+
+      buffer = ( char * ) esArenaMalloc ( arena, imageSize );
 
-         return ( buffer );
+      if ( buffer != NULL )
+      {
+         memcpy ( buffer, image.pixels, imageSize );
       }
    }
 
-   return ( NULL );
+   esReleaseImage ( &image );
+
+   return buffer;
+}
+
+///
+// esLoadTGA()
+//
+//    Loads a 8-bit, 24-bit or 32-bit TGA image from a file
+//
+char *ESUTIL_API esLoadTGA ( void *ioContext, const char *fileName, int *width, int *height )
+{
+   return esLoadTGAArena ( NULL, ioContext, fileName, width, height );
 }